@@ -67,6 +67,8 @@ public:
     const int3 & get_size() const { return size; }
     T operator[](const int3 & coords) const { return voxels[coords.z * size.x * size.y + coords.y * size.x + coords.x]; }
     T & operator[](const int3 & coords) { return voxels[coords.z * size.x * size.y + coords.y * size.x + coords.x]; }
+    const T * data() const { return voxels.data(); } // x fastest, then y, then z
+    T * data() { return voxels.data(); }
 };
 
 class SuperFormula
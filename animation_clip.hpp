@@ -0,0 +1,353 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef animation_clip_hpp
+#define animation_clip_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "../lib-model-io/model-io.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A compact, read-only form of skeletal_animation for playback. Each bone has a rotation, a translation and a
+// scale channel, and each channel is a run of keys in flat arrays of its kind: key times in one, values in
+// another, so sampling touches a few contiguous floats instead of chasing a shared_ptr per keyframe.
+// Rotations can be stored in 48 bits ("smallest three": the largest component is dropped and rebuilt from
+// unit length), and keys that linear interpolation of their neighbours already reproduces within a
+// tolerance can be dropped, which leaves constant channels with a single key.
+//
+// Sampling goes through an AnimationCursor, which remembers the key each channel was last at. Playback moves
+// time forward a little every frame, so a channel's key is found by stepping at most a key or two from where
+// it was; only seeks and loops search. Keep a cursor per playing instance.
+
+namespace avl
+{
+    // 2 bits for the index of the dropped component, then the other three in 15 bits each, highest first
+    struct QuantizedRotation
+    {
+        uint16_t bits[3];
+    };
+
+    inline QuantizedRotation quantize_rotation(float4 q)
+    {
+        q = normalize(q);
+        int largest = 0;
+        for (int i = 1; i < 4; ++i) if (std::abs(q[i]) > std::abs(q[largest])) largest = i;
+        if (q[largest] < 0) q = -q; // q and -q are the same rotation; the dropped component is rebuilt positive
+
+        // The other components are within [-1/sqrt(2), 1/sqrt(2)]
+        uint64_t packed = uint64_t(largest);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i == largest) continue;
+            const float unit = clamp(q[i] * 0.70710678f + 0.5f, 0.0f, 1.0f);
+            packed = (packed << 15) | uint64_t(unit * 32767.0f + 0.5f);
+        }
+        return { { uint16_t(packed), uint16_t(packed >> 16), uint16_t(packed >> 32) } };
+    }
+
+    inline float4 dequantize_rotation(const QuantizedRotation & r)
+    {
+        const uint64_t packed = uint64_t(r.bits[0]) | (uint64_t(r.bits[1]) << 16) | (uint64_t(r.bits[2]) << 32);
+        const float scale = 1.41421356f / 32767.0f, bias = -0.70710678f;
+        const float a = float((packed >> 30) & 32767) * scale + bias;
+        const float b = float((packed >> 15) & 32767) * scale + bias;
+        const float c = float(packed & 32767) * scale + bias;
+        const float d = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+        switch (packed >> 45)
+        {
+        case 0: return float4(d, a, b, c);
+        case 1: return float4(a, d, b, c);
+        case 2: return float4(a, b, d, c);
+        default: return float4(a, b, c, d);
+        }
+    }
+
+    struct AnimationClipParams
+    {
+        float framesPerSecond = 24.0f;          // converts keyframe numbers to seconds, as skeletal_animation::total_time
+        bool quantizeRotations = true;
+        bool reduceKeys = true;
+        float rotationTolerance = 0.001f;       // radians
+        float translationTolerance = 0.0001f;   // in the units of the animation
+        float scaleTolerance = 0.0001f;
+    };
+
+    // A run of keys in the time and value arrays of one kind
+    struct AnimationChannel
+    {
+        uint32_t firstKey = 0;
+        uint32_t keyCount = 0;
+    };
+
+    struct AnimationClip
+    {
+        std::string name;
+        float duration = 0.0f;                  // seconds
+        uint32_t boneCount = 0;
+
+        // One channel of each kind per bone
+        std::vector<AnimationChannel> rotationChannels, translationChannels, scaleChannels;
+        std::vector<float> rotationTimes, translationTimes, scaleTimes;
+        std::vector<float4> rotations;                  // when not quantized...
+        std::vector<QuantizedRotation> packedRotations; // ...or when quantized
+        std::vector<float3> translations, scales;
+
+        size_t key_count() const { return rotationTimes.size() + translationTimes.size() + scaleTimes.size(); }
+
+        size_t size_bytes() const
+        {
+            return (rotationChannels.size() + translationChannels.size() + scaleChannels.size()) * sizeof(AnimationChannel)
+                + key_count() * sizeof(float) + rotations.size() * sizeof(float4) + packedRotations.size() * sizeof(QuantizedRotation)
+                + (translations.size() + scales.size()) * sizeof(float3);
+        }
+    };
+
+    // Local bone transforms as parallel arrays, one element per bone
+    struct AnimationPose
+    {
+        std::vector<float4> rotations;
+        std::vector<float3> translations;
+        std::vector<float3> scales;
+
+        void resize(size_t boneCount)
+        {
+            rotations.resize(boneCount, float4(0, 0, 0, 1));
+            translations.resize(boneCount, float3(0, 0, 0));
+            scales.resize(boneCount, float3(1, 1, 1));
+        }
+    };
+
+    // Where each channel of a clip was last sampled: rotations, then translations, then scales
+    struct AnimationCursor
+    {
+        std::vector<uint32_t> keys;
+    };
+
+    namespace impl
+    {
+        // The angle of the rotation between a and b. acos of their dot product loses small angles to rounding.
+        inline float rotation_error(const float4 & a, const float4 & b)
+        {
+            const float4 d = qmul(qconj(a), b);
+            return 2.0f * std::atan2(length(d.xyz()), std::abs(d.w));
+        }
+
+        // qnlerp with one square root and one division
+        inline float4 nlerp_rotation(const float4 & a, const float4 & b, float t)
+        {
+            const float4 q = lerp(a, dot(a, b) < 0 ? -b : b, t);
+            return q * (1.0f / std::sqrt(dot(q, q)));
+        }
+
+        // Greedily grows each segment from its first key until linear interpolation across it misses a key it
+        // spans by more than the tolerance, then starts the next segment at the last key that fit. Returns the
+        // indices of the keys to keep; a channel that never leaves the tolerance of its first key keeps one.
+        template<class T, class Interpolate, class Error>
+        std::vector<uint32_t> reduce_keys(const std::vector<float> & times, const std::vector<T> & stored, const std::vector<T> & exact,
+            float tolerance, Interpolate interpolate, Error error)
+        {
+            const uint32_t n = uint32_t(times.size());
+            std::vector<uint32_t> kept = { 0 };
+
+            bool constant = true;
+            for (uint32_t k = 1; k < n && constant; ++k) constant = error(stored[0], exact[k]) <= tolerance;
+            if (constant || n == 1) return kept;
+
+            uint32_t anchor = 0;
+            for (uint32_t end = 2; end < n; ++end)
+            {
+                bool fits = true;
+                for (uint32_t k = anchor + 1; k < end && fits; ++k)
+                {
+                    const float t = (times[k] - times[anchor]) / (times[end] - times[anchor]);
+                    fits = error(interpolate(stored[anchor], stored[end], t), exact[k]) <= tolerance;
+                }
+                if (!fits)
+                {
+                    anchor = end - 1;
+                    kept.push_back(anchor);
+                }
+            }
+            kept.push_back(n - 1);
+            return kept;
+        }
+
+        // The last key at or before t. Steps forward from the previous key for a few keys, as playback
+        // needs, and searches otherwise.
+        inline uint32_t seek_key(const float * times, uint32_t count, uint32_t key, float t)
+        {
+            if (key < count && times[key] <= t)
+            {
+                for (int step = 0; step < 4; ++step)
+                {
+                    if (key + 1 >= count || times[key + 1] > t) return key;
+                    ++key;
+                }
+            }
+            const uint32_t upper = uint32_t(std::upper_bound(times, times + count, t) - times);
+            return upper ? upper - 1 : 0;
+        }
+
+        inline float key_alpha(const float * times, uint32_t count, uint32_t key, float t)
+        {
+            if (key + 1 >= count) return 0.0f;
+            return clamp((t - times[key]) / (times[key + 1] - times[key]), 0.0f, 1.0f);
+        }
+    }
+
+    // Builds a clip from an imported animation. Bones without a track hold the identity transform; a bone
+    // count of zero uses one more than the largest bone index with a track.
+    inline AnimationClip make_animation_clip(const skeletal_animation & animation, uint32_t boneCount = 0, const AnimationClipParams & params = AnimationClipParams())
+    {
+        AnimationClip clip;
+        clip.name = animation.name;
+        clip.duration = animation.endFrame > animation.startFrame ? animation.total_time(params.framesPerSecond) : 0.0f;
+
+        std::vector<const animation_track *> tracks;
+        for (const auto & t : animation.tracks)
+        {
+            if (!t) continue;
+            if (t->boneIndex >= tracks.size()) tracks.resize(t->boneIndex + 1, nullptr);
+            tracks[t->boneIndex] = t.get();
+        }
+        clip.boneCount = boneCount ? boneCount : uint32_t(tracks.size());
+        tracks.resize(clip.boneCount, nullptr);
+
+        auto lerp3 = [](const float3 & a, const float3 & b, float t) { return lerp(a, b, t); };
+        auto distance3 = [](const float3 & a, const float3 & b) { return length(a - b); };
+
+        std::vector<float> times;
+        std::vector<float4> rotations, storedRotations;
+        std::vector<float3> translations, scales;
+        for (uint32_t b = 0; b < clip.boneCount; ++b)
+        {
+            times.clear(); rotations.clear(); translations.clear(); scales.clear();
+
+            std::vector<const animation_keyframe *> keys;
+            if (tracks[b]) for (const auto & k : tracks[b]->keyframes) if (k) keys.push_back(k.get());
+            std::stable_sort(keys.begin(), keys.end(), [](const animation_keyframe * a, const animation_keyframe * b) { return a->key < b->key; });
+
+            for (const animation_keyframe * k : keys)
+            {
+                times.push_back(k->key > animation.startFrame ? float(k->key - animation.startFrame) / params.framesPerSecond : 0.0f);
+                float4 q = normalize(k->rotation);
+                if (!rotations.empty() && dot(q, rotations.back()) < 0) q = -q; // keep neighbours in one hemisphere
+                rotations.push_back(q);
+                translations.push_back(k->translation);
+                scales.push_back(k->scale);
+            }
+            if (keys.empty())
+            {
+                times.push_back(0.0f);
+                rotations.push_back(float4(0, 0, 0, 1));
+                translations.push_back(float3(0, 0, 0));
+                scales.push_back(float3(1, 1, 1));
+            }
+
+            // Reduction interpolates what will be stored, so its error includes quantization
+            storedRotations = rotations;
+            if (params.quantizeRotations) for (auto & q : storedRotations) q = dequantize_rotation(quantize_rotation(q));
+
+            std::vector<uint32_t> rotationKeys, translationKeys, scaleKeys;
+            if (params.reduceKeys)
+            {
+                rotationKeys = impl::reduce_keys(times, storedRotations, rotations, params.rotationTolerance,
+                    impl::nlerp_rotation, impl::rotation_error);
+                translationKeys = impl::reduce_keys(times, translations, translations, params.translationTolerance, lerp3, distance3);
+                scaleKeys = impl::reduce_keys(times, scales, scales, params.scaleTolerance, lerp3, distance3);
+            }
+            else
+            {
+                for (uint32_t k = 0; k < times.size(); ++k) rotationKeys.push_back(k);
+                translationKeys = scaleKeys = rotationKeys;
+            }
+
+            clip.rotationChannels.push_back({ uint32_t(clip.rotationTimes.size()), uint32_t(rotationKeys.size()) });
+            for (uint32_t k : rotationKeys)
+            {
+                clip.rotationTimes.push_back(times[k]);
+                if (params.quantizeRotations) clip.packedRotations.push_back(quantize_rotation(rotations[k]));
+                else clip.rotations.push_back(rotations[k]);
+            }
+            clip.translationChannels.push_back({ uint32_t(clip.translationTimes.size()), uint32_t(translationKeys.size()) });
+            for (uint32_t k : translationKeys)
+            {
+                clip.translationTimes.push_back(times[k]);
+                clip.translations.push_back(translations[k]);
+            }
+            clip.scaleChannels.push_back({ uint32_t(clip.scaleTimes.size()), uint32_t(scaleKeys.size()) });
+            for (uint32_t k : scaleKeys)
+            {
+                clip.scaleTimes.push_back(times[k]);
+                clip.scales.push_back(scales[k]);
+            }
+        }
+        return clip;
+    }
+
+    // Samples every bone at a time in seconds, clamped to the clip. Rotations are normalized-lerped, translations
+    // and scales lerped. The cursor may be fresh or have last been used at any time with this clip.
+    inline void sample_animation_clip(const AnimationClip & clip, float time, AnimationCursor & cursor, AnimationPose & pose)
+    {
+        const uint32_t n = clip.boneCount;
+        const float t = clamp(time, 0.0f, clip.duration);
+        if (cursor.keys.size() != size_t(n) * 3) cursor.keys.assign(size_t(n) * 3, 0);
+        pose.resize(n);
+
+        // Channels with a single key, common after reduction, skip the search and the interpolation
+        const bool packed = !clip.packedRotations.empty();
+        uint32_t * keys = cursor.keys.data();
+        for (uint32_t b = 0; b < n; ++b)
+        {
+            const AnimationChannel & c = clip.rotationChannels[b];
+            if (c.keyCount == 1)
+            {
+                pose.rotations[b] = packed ? dequantize_rotation(clip.packedRotations[c.firstKey]) : clip.rotations[c.firstKey];
+                continue;
+            }
+            const float * times = clip.rotationTimes.data() + c.firstKey;
+            const uint32_t k = keys[b] = impl::seek_key(times, c.keyCount, keys[b], t);
+            const uint32_t k1 = std::min(k + 1, c.keyCount - 1);
+            const float alpha = impl::key_alpha(times, c.keyCount, k, t);
+            if (packed) pose.rotations[b] = impl::nlerp_rotation(dequantize_rotation(clip.packedRotations[c.firstKey + k]), dequantize_rotation(clip.packedRotations[c.firstKey + k1]), alpha);
+            else pose.rotations[b] = impl::nlerp_rotation(clip.rotations[c.firstKey + k], clip.rotations[c.firstKey + k1], alpha);
+        }
+
+        keys += n;
+        for (uint32_t b = 0; b < n; ++b)
+        {
+            const AnimationChannel & c = clip.translationChannels[b];
+            if (c.keyCount == 1)
+            {
+                pose.translations[b] = clip.translations[c.firstKey];
+                continue;
+            }
+            const float * times = clip.translationTimes.data() + c.firstKey;
+            const uint32_t k = keys[b] = impl::seek_key(times, c.keyCount, keys[b], t);
+            const uint32_t k1 = std::min(k + 1, c.keyCount - 1);
+            pose.translations[b] = lerp(clip.translations[c.firstKey + k], clip.translations[c.firstKey + k1], impl::key_alpha(times, c.keyCount, k, t));
+        }
+
+        keys += n;
+        for (uint32_t b = 0; b < n; ++b)
+        {
+            const AnimationChannel & c = clip.scaleChannels[b];
+            if (c.keyCount == 1)
+            {
+                pose.scales[b] = clip.scales[c.firstKey];
+                continue;
+            }
+            const float * times = clip.scaleTimes.data() + c.firstKey;
+            const uint32_t k = keys[b] = impl::seek_key(times, c.keyCount, keys[b], t);
+            const uint32_t k1 = std::min(k + 1, c.keyCount - 1);
+            pose.scales[b] = lerp(clip.scales[c.firstKey + k], clip.scales[c.firstKey + k1], impl::key_alpha(times, c.keyCount, k, t));
+        }
+    }
+}
+
+#endif // end animation_clip_hpp
@@ -8,41 +8,65 @@
 
 using namespace avl;
 
-inline std::vector<uint8_t> load_image_data(const std::string & path)
+// Decoded pixels, ready for upload. Decoding touches no GL state, so it can run on any thread.
+struct DecodedImage
+{
+    int width{ 0 }, height{ 0 }, channels{ 0 };
+    std::vector<uint8_t> pixels;
+};
+
+// Flips by hand rather than through stbi_set_flip_vertically_on_load, a global that concurrent decodes would race on
+inline DecodedImage decode_image(const std::vector<uint8_t> & file, bool flip = false)
 {
-    auto binaryFile = read_file_binary(path);
+    DecodedImage image;
+    auto data = stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &image.channels, 0);
+    if (!data) throw std::runtime_error(std::string("couldn't decode image: ") + stbi_failure_reason());
 
-    int width, height, nBytes;
-    auto data = stbi_load_from_memory(binaryFile.data(), (int)binaryFile.size(), &width, &height, &nBytes, 0);
-    std::vector<uint8_t> d(width * height * nBytes);
-    std::memcpy(d.data(), data, nBytes * width * height);
+    const size_t rowSize = size_t(image.width) * image.channels;
+    image.pixels.resize(rowSize * image.height);
+    for (int y = 0; y < image.height; ++y)
+    {
+        const int row = flip ? image.height - 1 - y : y;
+        std::memcpy(image.pixels.data() + rowSize * row, data + rowSize * y, rowSize);
+    }
     stbi_image_free(data);
-    return d;
+    return image;
 }
 
-// fixme - these functions belong in a gl-xyz.hpp file
-
-inline GlTexture2D load_image(const std::string & path, bool flip = false)
+inline std::vector<uint8_t> load_image_data(const std::string & path)
 {
-    auto binaryFile = avl::read_file_binary(path);
+    return decode_image(read_file_binary(path)).pixels;
+}
 
-    if (flip) stbi_set_flip_vertically_on_load(1);
-    else stbi_set_flip_vertically_on_load(0);
+// fixme - these functions belong in a gl-xyz.hpp file
 
-    int width, height, nBytes;
-    auto data = stbi_load_from_memory(binaryFile.data(), (int)binaryFile.size(), &width, &height, &nBytes, 0);
+inline GlTexture2D upload_image(const DecodedImage & image, const std::string & name = "")
+{
+    const uint8_t * data = image.pixels.data();
 
     GlTexture2D tex;
-    switch (nBytes)
+    switch (image.channels)
     {
-        case 1: tex.setup(width, height, GL_RED, GL_RED, GL_UNSIGNED_BYTE, data, true); break;
-        case 2: tex.setup(width, height, GL_RED, GL_RED, GL_UNSIGNED_SHORT, data, true); break;
-        case 3: tex.setup(width, height, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, data, true); break;
-        case 4: tex.setup(width, height, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, data, true); break;
+        case 1: tex.setup(image.width, image.height, GL_RED, GL_RED, GL_UNSIGNED_BYTE, data, true); break;
+        case 2: tex.setup(image.width, image.height, GL_RED, GL_RED, GL_UNSIGNED_SHORT, data, true); break;
+        case 3: tex.setup(image.width, image.height, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, data, true); break;
+        case 4: tex.setup(image.width, image.height, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, data, true); break;
         default: throw std::runtime_error("unsupported number of channels");
     }
-    tex.set_name(path);
-    stbi_image_free(data);
+    if (!name.empty()) tex.set_name(name);
+    return tex;
+}
+
+inline GlTexture2D load_image(const std::string & path, bool flip = false)
+{
+    return upload_image(decode_image(avl::read_file_binary(path), flip), path);
+}
+
+// Parses a dds cubemap; like decode_image, safe on any thread
+inline gli::texture_cube decode_cubemap(const std::vector<uint8_t> & file)
+{
+    gli::texture_cube tex(gli::load_dds(reinterpret_cast<const char *>(file.data()), file.size()));
+    if (tex.empty()) throw std::runtime_error("couldn't decode cubemap");
     return tex;
 }
 
@@ -0,0 +1,42 @@
+#version 330
+
+layout(location = 0) in vec2 gridPos;       // integer grid coordinates, 0 to u_gridResolution
+layout(location = 4) in vec4 chunk;         // world xz of the min corner, world size, level
+layout(location = 5) in vec4 tileUV;        // chunk offset and scale within its heightmap tile
+layout(location = 6) in vec4 morph;         // heightmap layer, morph start and end distance
+
+uniform sampler2DArray u_heightmaps;
+uniform float u_gridResolution;
+uniform float u_tileResolution;
+uniform vec3 u_eyePosition;
+uniform mat4 u_viewProj;
+
+out vec3 worldPos;
+out vec3 norm;
+out vec3 p;
+
+float sample_height(vec2 g)
+{
+    // Tiles store samples at their edges, so map [0, 1] onto texel centers
+    vec2 s = tileUV.xy + (g / u_gridResolution) * tileUV.zw;
+    vec2 uv = (s * (u_tileResolution - 1.0) + 0.5) / u_tileResolution;
+    return textureLod(u_heightmaps, vec3(uv, morph.x), 0.0).r;
+}
+
+void main()
+{
+    float cellSize = chunk.z / u_gridResolution;
+    vec2 xz = chunk.xy + gridPos * cellSize;
+    float d = distance(u_eyePosition, vec3(xz.x, sample_height(gridPos), xz.y));
+
+    // Odd vertices slide onto their even neighbours, matching the parent level's grid at the end of the range
+    float k = clamp((d - morph.y) / (morph.z - morph.y), 0.0, 1.0);
+    vec2 g = gridPos - fract(gridPos * 0.5) * 2.0 * k;
+
+    xz = chunk.xy + g * cellSize;
+    worldPos = vec3(xz.x, sample_height(g), xz.y);
+    gl_Position = u_viewProj * vec4(worldPos, 1.0);
+
+    p = worldPos;
+    norm = vec3(0, 1, 0);
+}
@@ -0,0 +1,27 @@
+// Decoding for meshes uploaded with make_packed_vertex_format (vertex_format.hpp). Declare the packed
+// attributes with these types:
+//
+// layout(location = 0) in vec3 inPosition;   // unorm16, see decode_position
+// layout(location = 1) in vec4 inNormal;     // octahedral in xy
+// layout(location = 3) in vec2 inTexCoord;   // half floats, no decoding needed
+// layout(location = 4) in vec4 inTangent;    // octahedral in xy, bitangent sign in w
+
+uniform vec3 u_positionOffset = vec3(0, 0, 0);
+uniform vec3 u_positionScale = vec3(1, 1, 1);
+
+vec3 decode_position(vec3 p)
+{
+    return u_positionOffset + u_positionScale * p;
+}
+
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0) v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+vec3 decode_bitangent(vec3 normal, vec3 tangent, float sign)
+{
+    return cross(normal, tangent) * (sign < 0 ? -1.0 : 1.0);
+}
@@ -0,0 +1,133 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef async_asset_loader_hpp
+#define async_asset_loader_hpp
+
+#include "parallel_for.hpp"
+#include "worker_pool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// Splits asset loading into a part that can run anywhere and a part that can't. A job's first stage reads and
+// decodes on a worker thread and returns its second stage, which runs on whichever thread calls process_uploads:
+// for textures, the one owning the GL context. process_uploads stops once a time budget is spent, so a frame
+// that finds a hundred decoded textures waiting uploads a few and leaves the rest for later frames. Nothing
+// here knows about GL; asset_io.hpp has the decode and upload halves for images, and lib-render/assets.hpp
+// ties them to asset handles.
+
+namespace avl
+{
+    class AsyncAssetLoader
+    {
+    public:
+
+        typedef std::function<void()> UploadFunction;
+        typedef std::function<UploadFunction()> DecodeFunction;
+        typedef std::function<void(const std::string &)> FailureFunction;
+
+    private:
+
+        std::deque<UploadFunction> uploads;
+        size_t pending = 0;             // submitted, not yet through process_uploads
+        mutable std::mutex mutex;
+        std::condition_variable uploadAvailable;
+        WorkerPool pool;                // last, so running decodes finish before the upload queue goes away
+
+        void run(const DecodeFunction & decode, const FailureFunction & failed)
+        {
+            // The failure callback runs on the upload thread too, where handles may be touched
+            UploadFunction upload;
+            try { upload = decode(); }
+            catch (const std::exception & e) { upload = std::bind(failed, std::string(e.what())); }
+            catch (...) { upload = std::bind(failed, std::string("unknown error")); }
+            if (!upload) upload = [] {};
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                uploads.push_back(std::move(upload));
+            }
+            uploadAvailable.notify_all();
+        }
+
+    public:
+
+        // Zero workers uses every hardware thread; the upload thread mostly waits on the GPU driver, not the CPU.
+        // On destruction queued jobs are dropped, and decoded ones are never uploaded.
+        explicit AsyncAssetLoader(uint32_t numWorkers = 0) : pool(numWorkers ? numWorkers : hardware_thread_count()) {}
+
+        // Decode runs on a worker. Its result, or failed with the message of whatever it threw, runs in process_uploads.
+        void submit(DecodeFunction decode, FailureFunction failed = [](const std::string &) {})
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++pending;
+            }
+            pool.submit([this, decode, failed]() { run(decode, failed); });
+        }
+
+        // Runs decoded jobs' upload stages on the calling thread until the budget is spent or none are left.
+        // At least one runs per call, so a budget smaller than any upload still makes progress. Returns how many ran.
+        size_t process_uploads(double budgetMs)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            size_t count = 0;
+            for (;;)
+            {
+                UploadFunction upload;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (uploads.empty()) break;
+                    upload = std::move(uploads.front());
+                    uploads.pop_front();
+                }
+                try { upload(); }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --pending;
+                    throw;
+                }
+                ++count;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --pending;
+                }
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+                if (elapsed.count() >= budgetMs) break;
+            }
+            return count;
+        }
+
+        // Uploads everything submitted so far on the calling thread, waiting for the workers as needed
+        void finish()
+        {
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    uploadAvailable.wait(lock, [this] { return pending == 0 || !uploads.empty(); });
+                    if (pending == 0) return;
+                }
+                process_uploads(std::numeric_limits<double>::infinity());
+            }
+        }
+
+        // Jobs submitted whose upload stage has not run yet
+        size_t pending_count() const { std::lock_guard<std::mutex> lock(mutex); return pending; }
+        // Jobs decoded and waiting for process_uploads
+        size_t ready_count() const { std::lock_guard<std::mutex> lock(mutex); return uploads.size(); }
+        size_t worker_count() const { return pool.worker_count(); }
+    };
+}
+
+#endif // end async_asset_loader_hpp
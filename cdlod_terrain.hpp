@@ -0,0 +1,415 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef cdlod_terrain_hpp
+#define cdlod_terrain_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "noise_field.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Continuous distance-dependent level of detail (CDLOD) terrain, after Strugar 2009. An implicit quadtree
+// over the terrain is traversed every frame, selecting nodes whose level matches their distance from the
+// camera. Every selected quadrant is drawn with the same grid mesh, scaled and offset by per-instance data;
+// the vertex shader morphs each level toward its parent as the range boundary approaches, so neighbouring
+// levels meet without cracks or popping. Heights come from tiles generated on worker threads into a bounded
+// cache; until a tile arrives, chunks read the closest ancestor tile that is resident. Everything here is
+// CPU side, the renderer only uploads finished tiles and the instance list.
+
+namespace avl
+{
+    struct CdlodSettings
+    {
+        float2 origin = { 0, 0 };       // xz of the terrain's min corner
+        float leafSize = 64.0f;         // world size of a level 0 node; the root covers leafSize * 2^(levels - 1)
+        uint32_t levels = 8;
+        uint32_t gridResolution = 32;   // quads along an edge of the shared chunk mesh; must be even
+        float leafRange = 160.0f;       // view distance drawn at level 0, doubling with each level
+        float morphStartRatio = 0.66f;  // fraction of a level's distance band before morphing toward the parent starts
+        float minHeight = -64.0f;       // conservative vertical extent for range and frustum tests
+        float maxHeight = 256.0f;
+    };
+
+    struct CdlodNode
+    {
+        uint32_t level, x, z; // node coordinates count nodes of that level from the terrain origin
+
+        uint64_t key() const { return (uint64_t(level) << 58) | (uint64_t(x) << 29) | uint64_t(z); }
+        CdlodNode parent() const { return{ level + 1, x >> 1, z >> 1 }; }
+        bool operator == (const CdlodNode & n) const { return level == n.level && x == n.x && z == n.z; }
+    };
+
+    // One instance of the shared grid mesh: a quadrant of a selected node, drawn at that node's level
+    struct CdlodChunk
+    {
+        CdlodNode node;         // the selected node; its heightmap tile covers the chunk
+        uint32_t quadrant;      // bit 0 = +x half, bit 1 = +z half
+        float2 origin;          // world xz of the chunk's min corner
+        float size;             // world edge length
+    };
+
+    class CdlodQuadtree
+    {
+        CdlodSettings settings;
+
+        static float distance_squared(const Bounds3D & box, const float3 & p)
+        {
+            const float3 d = max(max(box.min() - p, p - box.max()), float3(0.0f));
+            return dot(d, d);
+        }
+
+        enum class Result { OutOfRange, Selected };
+
+        Result select_node(const CdlodNode & n, const float3 & camera, const Frustum * frustum, std::vector<CdlodChunk> & out) const
+        {
+            const Bounds3D box = node_bounds(n);
+            const float d2 = distance_squared(box, camera);
+            if (d2 > range(n.level) * range(n.level)) return Result::OutOfRange;
+            if (frustum && !frustum->intersects(box.center(), box.size())) return Result::Selected; // handled, nothing to draw
+
+            if (n.level == 0 || d2 > range(n.level - 1) * range(n.level - 1))
+            {
+                for (uint32_t q = 0; q < 4; ++q) add_chunk(n, q, out);
+                return Result::Selected;
+            }
+
+            // Children beyond the next range are drawn at this level, one quadrant at a time
+            for (uint32_t q = 0; q < 4; ++q)
+            {
+                const CdlodNode child = { n.level - 1, n.x * 2 + (q & 1), n.z * 2 + (q >> 1) };
+                if (select_node(child, camera, frustum, out) == Result::OutOfRange) add_chunk(n, q, out);
+            }
+            return Result::Selected;
+        }
+
+        void add_chunk(const CdlodNode & n, uint32_t quadrant, std::vector<CdlodChunk> & out) const
+        {
+            const float half = node_size(n.level) * 0.5f;
+            const float2 origin = node_origin(n) + float2(float(quadrant & 1), float(quadrant >> 1)) * half;
+            out.push_back({ n, quadrant, origin, half });
+        }
+
+    public:
+
+        explicit CdlodQuadtree(const CdlodSettings & settings) : settings(settings)
+        {
+            if (settings.levels == 0 || settings.levels > 24) throw std::invalid_argument("cdlod level count out of range");
+            if (settings.gridResolution < 2 || settings.gridResolution % 2) throw std::invalid_argument("cdlod grid resolution must be even");
+        }
+
+        const CdlodSettings & get_settings() const { return settings; }
+
+        CdlodNode root() const { return{ settings.levels - 1, 0, 0 }; }
+        float node_size(uint32_t level) const { return settings.leafSize * float(1u << level); }
+        float range(uint32_t level) const { return settings.leafRange * float(1u << level); }
+        float2 node_origin(const CdlodNode & n) const { return settings.origin + float2(float(n.x), float(n.z)) * node_size(n.level); }
+
+        // Samples along the edge of a node's heightmap tile; each of its four chunks spans gridResolution quads
+        uint32_t tile_resolution() const { return settings.gridResolution * 2 + 1; }
+
+        Bounds3D node_bounds(const CdlodNode & n) const
+        {
+            const float2 o = node_origin(n);
+            const float s = node_size(n.level);
+            return Bounds3D(float3(o.x, settings.minHeight, o.y), float3(o.x + s, settings.maxHeight, o.y + s));
+        }
+
+        // Distances over which chunks of a level morph into their parent's grid, ending at the level's range
+        float2 morph_range(uint32_t level) const
+        {
+            const float end = range(level), start = level ? range(level - 1) : 0.0f;
+            return float2(start + (end - start) * settings.morphStartRatio, end);
+        }
+
+        // The vertex shader's morph, for a vertex at integer grid position g (0..gridResolution) of a chunk
+        // whose vertex lies `distance` from the camera; returns the morphed grid position
+        float2 morph_vertex(const float2 & g, uint32_t level, float distance) const
+        {
+            const float2 m = morph_range(level);
+            const float k = clamp((distance - m.x) / (m.y - m.x), 0.0f, 1.0f);
+            const float2 odd = float2(std::fmod(g.x, 2.0f), std::fmod(g.y, 2.0f));
+            return g - odd * k;
+        }
+
+        // Appends the chunks to draw from this camera position, coarse nodes before their children's
+        // siblings. A frustum, if given, culls nodes that are entirely outside it.
+        void select(const float3 & camera, const Frustum * frustum, std::vector<CdlodChunk> & out) const
+        {
+            select_node(root(), camera, frustum, out);
+        }
+    };
+
+    struct CdlodTile
+    {
+        CdlodNode node;
+        uint32_t resolution = 0;    // samples along an edge, covering the node from edge to edge
+        std::vector<float> heights; // row-major, x fastest
+    };
+
+    // Generates heightmap tiles on a pool of worker threads into a fixed number of slots (e.g. the layers
+    // of a texture array). Each frame the renderer requests the tiles it would like; resident tiles are
+    // returned immediately and missing ones are queued. When the slots run out, the least recently used
+    // tile that was not requested in the current frame is evicted; pending tiles are never evicted.
+    class CdlodTileCache
+    {
+    public:
+
+        typedef std::function<void(const CdlodNode &, CdlodTile &)> Generator;
+
+    private:
+
+        struct Entry
+        {
+            int slot;
+            bool ready = false;
+            uint64_t lastUsed = 0;
+            std::shared_ptr<const CdlodTile> tile;
+        };
+
+        Generator generator;
+        std::vector<bool> slotInUse;
+        std::unordered_map<uint64_t, Entry> entries;
+        std::deque<CdlodNode> jobs;
+        std::vector<std::pair<uint32_t, std::shared_ptr<const CdlodTile>>> completed;
+        uint64_t frame = 1;
+        size_t busy = 0;
+        bool stopping = false;
+
+        mutable std::mutex mutex;
+        std::condition_variable jobAvailable, idle;
+        std::vector<std::thread> workers;
+
+        int acquire_slot()
+        {
+            for (size_t s = 0; s < slotInUse.size(); ++s) if (!slotInUse[s]) return int(s);
+
+            auto victim = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+            {
+                if (!it->second.ready || it->second.lastUsed == frame) continue;
+                if (victim == entries.end() || it->second.lastUsed < victim->second.lastUsed) victim = it;
+            }
+            if (victim == entries.end()) return -1;
+
+            const int slot = victim->second.slot;
+            entries.erase(victim);
+            return slot;
+        }
+
+        void work()
+        {
+            for (;;)
+            {
+                CdlodNode node;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (stopping) return;
+                    node = jobs.front();
+                    jobs.pop_front();
+                    ++busy;
+                }
+
+                auto tile = std::make_shared<CdlodTile>();
+                tile->node = node;
+                generator(node, *tile);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                Entry & e = entries.at(node.key());
+                e.ready = true;
+                e.tile = tile;
+                completed.emplace_back(uint32_t(e.slot), tile);
+                if (--busy == 0 && jobs.empty()) idle.notify_all();
+            }
+        }
+
+    public:
+
+        CdlodTileCache(size_t capacity, Generator generator, uint32_t numThreads = 0) : generator(generator), slotInUse(capacity, false)
+        {
+            if (numThreads == 0) numThreads = std::max(1u, hardware_thread_count() - 1);
+            for (uint32_t t = 0; t < numThreads; ++t) workers.emplace_back(&CdlodTileCache::work, this);
+        }
+
+        ~CdlodTileCache()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            jobAvailable.notify_all();
+            for (auto & w : workers) w.join();
+        }
+
+        size_t capacity() const { return slotInUse.size(); }
+
+        // Starts a new frame; tiles requested during it are protected from eviction
+        void begin_frame()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++frame;
+        }
+
+        // Returns the slot of a resident tile, or -1 after queueing it (if a slot could be reserved)
+        int request(const CdlodNode & node)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(node.key());
+            if (it != entries.end())
+            {
+                it->second.lastUsed = frame;
+                return it->second.ready ? it->second.slot : -1;
+            }
+
+            const int slot = acquire_slot();
+            if (slot < 0) return -1;
+            slotInUse[slot] = true;
+
+            Entry e;
+            e.slot = slot;
+            e.lastUsed = frame;
+            entries.emplace(node.key(), e);
+            jobs.push_back(node);
+            jobAvailable.notify_one();
+            return -1;
+        }
+
+        // The slot of a resident tile without requesting it, or -1
+        int find(const CdlodNode & node) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(node.key());
+            return (it != entries.end() && it->second.ready) ? it->second.slot : -1;
+        }
+
+        // The slot of a resident tile, marking it used this frame like request does, or -1 without queueing it
+        int touch(const CdlodNode & node)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(node.key());
+            if (it == entries.end() || !it->second.ready) return -1;
+            it->second.lastUsed = frame;
+            return it->second.slot;
+        }
+
+        // Tiles finished since the last call, with the slot each one occupies, for upload
+        std::vector<std::pair<uint32_t, std::shared_ptr<const CdlodTile>>> take_completed()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<std::pair<uint32_t, std::shared_ptr<const CdlodTile>>> result;
+            result.swap(completed);
+            return result;
+        }
+
+        size_t resident_count() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t n = 0;
+            for (auto & e : entries) n += e.second.ready;
+            return n;
+        }
+
+        size_t pending_count() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.size() - std::count_if(entries.begin(), entries.end(), [](const std::pair<const uint64_t, Entry> & e) { return e.second.ready; });
+        }
+
+        // Blocks until every queued tile has been generated
+        void wait_idle()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this] { return jobs.empty() && busy == 0; });
+        }
+    };
+
+    // Per-instance vertex data of the shared grid mesh
+    struct CdlodInstance
+    {
+        float4 chunk;   // world xz of the min corner, world size, level
+        float4 tileUV;  // offset (xy) and scale (zw) of the chunk within its heightmap tile, in [0, 1] tile units
+        float4 morph;   // heightmap slot, morph start and end distance, unused
+    };
+
+    // Ties selection to the tile cache and produces the instance list for a frame
+    class CdlodTerrain
+    {
+        CdlodQuadtree tree;
+        CdlodTileCache cache;
+        std::vector<CdlodChunk> chunks;
+        std::vector<CdlodInstance> instances;
+
+    public:
+
+        CdlodTerrain(const CdlodSettings & settings, size_t tileCapacity, CdlodTileCache::Generator generator, uint32_t numThreads = 0)
+            : tree(settings), cache(tileCapacity, generator, numThreads) {}
+
+        const CdlodQuadtree & quadtree() const { return tree; }
+        CdlodTileCache & tiles() { return cache; }
+        const std::vector<CdlodChunk> & selected_chunks() const { return chunks; }
+
+        uint32_t tile_resolution() const { return tree.tile_resolution(); }
+
+        // Selects chunks for the camera, requests their tiles and builds instances. A chunk whose tile is
+        // still pending reads the nearest resident ancestor's tile; chunks without one are skipped.
+        const std::vector<CdlodInstance> & update(const float3 & camera, const Frustum * frustum = nullptr)
+        {
+            chunks.clear();
+            instances.clear();
+            tree.select(camera, frustum, chunks);
+
+            cache.begin_frame();
+            cache.request(tree.root()); // the fallback of last resort stays resident
+
+            for (const auto & c : chunks)
+            {
+                CdlodNode n = c.node;
+                int slot = cache.request(n);
+                while (slot < 0 && n.level < tree.root().level)
+                {
+                    n = n.parent();
+                    slot = cache.touch(n);
+                }
+                if (slot < 0) continue;
+
+                const float tileSize = tree.node_size(n.level);
+                const float2 uv = (c.origin - tree.node_origin(n)) / tileSize;
+                const float2 m = tree.morph_range(c.node.level);
+
+                CdlodInstance inst;
+                inst.chunk = float4(c.origin.x, c.origin.y, c.size, float(c.node.level));
+                inst.tileUV = float4(uv.x, uv.y, c.size / tileSize, c.size / tileSize);
+                inst.morph = float4(float(slot), m.x, m.y, 0.0f);
+                instances.push_back(inst);
+            }
+            return instances;
+        }
+    };
+
+    // A tile generator sampling layered simplex noise in world units; heights are params.amplitude scaled
+    inline CdlodTileCache::Generator make_noise_tile_generator(const noise::LayeredNoiseParams & params, const CdlodSettings & settings)
+    {
+        const CdlodQuadtree tree(settings);
+        return [params, tree](const CdlodNode & node, CdlodTile & tile)
+        {
+            noise::NoiseFieldGenerator field;
+            field.numThreads = 1; // tiles are already generated in parallel
+            tile.resolution = tree.tile_resolution();
+            const float spacing = tree.node_size(node.level) / float(tile.resolution - 1);
+            tile.heights = field.fill(params, uint2(tile.resolution), tree.node_origin(node), float2(spacing));
+        };
+    }
+}
+
+#endif // end cdlod_terrain_hpp
@@ -0,0 +1,332 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef curl_field_hpp
+#define curl_field_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "simplex_noise.hpp"
+#include "parallel_for.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Bakes curl noise into a regular 3D grid of velocities, so particle turbulence, flow maps and similar
+// consumers read a few interpolated values per sample instead of evaluating the noise derivative three
+// times. An animated field stores `frames` time slices spanning one full turn of the flow noise gradient
+// rotation, which makes playback loop seamlessly; lookups blend the two slices around the requested time.
+// Positions outside the baked bounds are clamped to the nearest face.
+
+namespace noise
+{
+    struct CurlFieldParams
+    {
+        uint32_t seed = 0;          // seeds a NoiseGenerator permutation; 0 uses the default generator
+        float frequency = 1.0f;     // scales world positions before evaluating the noise
+        float amplitude = 1.0f;     // scales the baked velocities
+        uint8_t octaves = 1;        // more than one sums octaves the way noise_curl(v, octaves, lacunarity, gain) does
+        float lacunarity = 2.0f;
+        float gain = 0.5f;
+        uint32_t frames = 1;        // time slices over one turn of the flow gradients; 1 bakes a static field
+        float period = 1.0f;        // seconds of animation covered by the slices before the loop repeats
+    };
+
+    class CurlFieldVolume
+    {
+        uint3 res{ 0, 0, 0 };
+        float3 origin, extent, invSpacing;
+        uint32_t frames = 0;
+        float period = 1.0f;
+        std::vector<float> data; // xyz velocity triplets, x fastest, then y, z and frame
+
+        size_t frame_stride() const { return size_t(res.x) * res.y * res.z * 3; }
+
+        struct FrameBlend { const float * a; const float * b; float w; };
+
+        FrameBlend frames_at(float time) const
+        {
+            if (frames == 1) return{ data.data(), data.data(), 0.0f };
+            float f = time / period * frames;
+            f -= std::floor(f / frames) * frames;
+            const uint32_t s = std::min(uint32_t(f), frames - 1);
+            return{ frame_data(s), frame_data((s + 1) % frames), f - s };
+        }
+
+        // Octave sum of the flow variant, normalized like NoiseGenerator::noise_fb_deriv
+        static float3 flow_curl(const NoiseGenerator & gen, const CurlFieldParams & params, const float3 & p, float angle)
+        {
+            if (params.octaves <= 1) return gen.noise_curl(p, angle);
+            float3 sum;
+            float freq = 1.0f, amp = 0.5f;
+            for (uint8_t i = 0; i < params.octaves; ++i)
+            {
+                sum += gen.noise_curl(p * freq, angle) * amp;
+                freq *= params.lacunarity;
+                amp *= params.gain;
+            }
+            return sum;
+        }
+
+        // One grid row of a static field: the curl is assembled from the batched derivatives of three
+        // decorrelated noise fields, at the same offsets the scalar noise_curl uses
+        static void bake_static_row(const NoiseGenerator & gen, const CurlFieldParams & params, const float3 & start, float dx, uint32_t count, float * out, std::vector<float> & scratch)
+        {
+            static const float3 offsets[3] = { float3(0, 0, 0), float3(123.456f, 789.012f, 345.678f), float3(901.234f, 567.891f, 234.567f) };
+            scratch.resize(size_t(count) * 16);
+            float * px = scratch.data(), * py = px + count, * pz = py + count, * value = pz + count;
+            float * d[3][3];
+            for (int f = 0; f < 3; ++f) for (int c = 0; c < 3; ++c) d[f][c] = value + count * (1 + f * 3 + c);
+
+            for (int f = 0; f < 3; ++f)
+            {
+                const float3 o = start * params.frequency + offsets[f];
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    px[i] = (start.x + dx * i) * params.frequency + offsets[f].x;
+                    py[i] = o.y;
+                    pz[i] = o.z;
+                }
+                if (params.octaves <= 1) gen.noise_deriv_batch(px, py, pz, value, d[f][0], d[f][1], d[f][2], count);
+                else gen.noise_fb_deriv_batch(px, py, pz, value, d[f][0], d[f][1], d[f][2], count, params.octaves, params.lacunarity, params.gain);
+            }
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                out[i * 3 + 0] = (d[2][1][i] - d[1][2][i]) * params.amplitude;
+                out[i * 3 + 1] = (d[0][2][i] - d[2][0][i]) * params.amplitude;
+                out[i * 3 + 2] = (d[1][0][i] - d[0][1][i]) * params.amplitude;
+            }
+        }
+
+        // Grid coordinate to the two (trilinear) or four (Catmull-Rom) taps along one axis
+        static void linear_taps(float g, int n, int (&idx)[2], float (&w)[2])
+        {
+            g = std::min(std::max(g, 0.0f), float(n - 1));
+            idx[0] = std::min(int(g), n - 2);
+            idx[1] = idx[0] + 1;
+            w[1] = g - idx[0];
+            w[0] = 1.0f - w[1];
+        }
+
+        static void cubic_taps(float g, int n, int (&idx)[4], float (&w)[4])
+        {
+            g = std::min(std::max(g, 0.0f), float(n - 1));
+            const int i = std::min(int(g), n - 2);
+            const float t = g - i;
+            idx[0] = std::max(i - 1, 0); idx[1] = i; idx[2] = i + 1; idx[3] = std::min(i + 2, n - 1);
+            w[0] = ((2.0f - t) * t - 1.0f) * t * 0.5f;
+            w[1] = ((3.0f * t - 5.0f) * t * t + 2.0f) * 0.5f;
+            w[2] = ((4.0f - 3.0f * t) * t + 1.0f) * t * 0.5f;
+            w[3] = (t - 1.0f) * t * t * 0.5f;
+        }
+
+        template<int Taps, typename TapFn>
+        float3 sample_scalar(const float3 & p, const FrameBlend & blend, TapFn && taps) const
+        {
+            const float3 g = (p - origin) * invSpacing;
+            int ix[Taps], iy[Taps], iz[Taps];
+            float wx[Taps], wy[Taps], wz[Taps];
+            taps(g.x, int(res.x), ix, wx);
+            taps(g.y, int(res.y), iy, wy);
+            taps(g.z, int(res.z), iz, wz);
+
+            float3 result;
+            const float * frame[2] = { blend.a, blend.b };
+            const float frameWeight[2] = { 1.0f - blend.w, blend.w };
+            for (int f = 0; f < (blend.w != 0.0f ? 2 : 1); ++f)
+            {
+                float3 sum;
+                for (int k = 0; k < Taps; ++k)
+                    for (int j = 0; j < Taps; ++j)
+                    {
+                        const int row = (iz[k] * int(res.y) + iy[j]) * int(res.x);
+                        const float wzy = wz[k] * wy[j];
+                        for (int i = 0; i < Taps; ++i)
+                        {
+                            const float * v = frame[f] + size_t(row + ix[i]) * 3;
+                            sum += float3(v[0], v[1], v[2]) * (wzy * wx[i]);
+                        }
+                    }
+                result += sum * frameWeight[f];
+            }
+            return result;
+        }
+
+#if defined(__AVX2__)
+
+        static void linear_taps(__m256 g, int n, __m256i (&idx)[2], __m256 (&w)[2])
+        {
+            g = _mm256_min_ps(_mm256_max_ps(g, _mm256_setzero_ps()), _mm256_set1_ps(float(n - 1)));
+            idx[0] = _mm256_min_epi32(_mm256_cvttps_epi32(g), _mm256_set1_epi32(n - 2));
+            idx[1] = _mm256_add_epi32(idx[0], _mm256_set1_epi32(1));
+            w[1] = _mm256_sub_ps(g, _mm256_cvtepi32_ps(idx[0]));
+            w[0] = _mm256_sub_ps(_mm256_set1_ps(1.0f), w[1]);
+        }
+
+        static void cubic_taps(__m256 g, int n, __m256i (&idx)[4], __m256 (&w)[4])
+        {
+            g = _mm256_min_ps(_mm256_max_ps(g, _mm256_setzero_ps()), _mm256_set1_ps(float(n - 1)));
+            const __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(g), _mm256_set1_epi32(n - 2));
+            const __m256i one = _mm256_set1_epi32(1);
+            idx[0] = _mm256_max_epi32(_mm256_sub_epi32(i, one), _mm256_setzero_si256());
+            idx[1] = i;
+            idx[2] = _mm256_add_epi32(i, one);
+            idx[3] = _mm256_min_epi32(_mm256_add_epi32(idx[2], one), _mm256_set1_epi32(n - 1));
+
+            const __m256 t = _mm256_sub_ps(g, _mm256_cvtepi32_ps(i)), t2 = _mm256_mul_ps(t, t), half = _mm256_set1_ps(0.5f);
+            const __m256 c1 = _mm256_set1_ps(1.0f), c2 = _mm256_set1_ps(2.0f), c3 = _mm256_set1_ps(3.0f), c4 = _mm256_set1_ps(4.0f), c5 = _mm256_set1_ps(5.0f);
+            w[0] = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(c2, t), t), c1), t), half);
+            w[1] = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(c3, t), c5), t2), c2), half);
+            w[2] = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(c4, _mm256_mul_ps(c3, t)), t), c1), t), half);
+            w[3] = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(t, c1), t2), half);
+        }
+
+        // Eight lookups at once; every tap gathers the three velocity components of its cell
+        template<int Taps, typename TapFn>
+        void sample_simd(const __m256 * p, __m256 * out, const FrameBlend & blend, TapFn && taps) const
+        {
+            __m256i ix[Taps], iy[Taps], iz[Taps];
+            __m256 wx[Taps], wy[Taps], wz[Taps];
+            taps(_mm256_mul_ps(_mm256_sub_ps(p[0], _mm256_set1_ps(origin.x)), _mm256_set1_ps(invSpacing.x)), int(res.x), ix, wx);
+            taps(_mm256_mul_ps(_mm256_sub_ps(p[1], _mm256_set1_ps(origin.y)), _mm256_set1_ps(invSpacing.y)), int(res.y), iy, wy);
+            taps(_mm256_mul_ps(_mm256_sub_ps(p[2], _mm256_set1_ps(origin.z)), _mm256_set1_ps(invSpacing.z)), int(res.z), iz, wz);
+
+            const __m256i nx = _mm256_set1_epi32(int(res.x)), ny = _mm256_set1_epi32(int(res.y));
+            const float * frame[2] = { blend.a, blend.b };
+            const float frameWeight[2] = { 1.0f - blend.w, blend.w };
+            for (int c = 0; c < 3; ++c) out[c] = _mm256_setzero_ps();
+            for (int f = 0; f < (blend.w != 0.0f ? 2 : 1); ++f)
+            {
+                __m256 sum[3] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+                for (int k = 0; k < Taps; ++k)
+                    for (int j = 0; j < Taps; ++j)
+                    {
+                        const __m256i row = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iz[k], ny), iy[j]), nx);
+                        const __m256 wzy = _mm256_mul_ps(wz[k], wy[j]);
+                        for (int i = 0; i < Taps; ++i)
+                        {
+                            const __m256i cell = _mm256_add_epi32(row, ix[i]);
+                            const __m256i index = _mm256_add_epi32(_mm256_add_epi32(cell, cell), cell);
+                            const __m256 weight = _mm256_mul_ps(wzy, wx[i]);
+                            for (int c = 0; c < 3; ++c)
+                                sum[c] = _mm256_add_ps(sum[c], _mm256_mul_ps(_mm256_i32gather_ps(frame[f] + c, index, 4), weight));
+                        }
+                    }
+                for (int c = 0; c < 3; ++c) out[c] = _mm256_add_ps(out[c], _mm256_mul_ps(sum[c], _mm256_set1_ps(frameWeight[f])));
+            }
+        }
+
+#endif
+
+    public:
+
+        enum class Filter { Trilinear, Tricubic };
+
+        uint32_t numThreads = 0; // threads used by bake(); 0 = all hardware threads
+
+        CurlFieldVolume() = default;
+
+        // Samples the curl of the configured noise at resolution.x * y * z points spanning bounds (both
+        // faces included) for every time slice. Slices are baked in parallel, one z slab per task.
+        void bake(const CurlFieldParams & params, uint3 resolution, const Bounds3D & bounds)
+        {
+            if (resolution.x < 2 || resolution.y < 2 || resolution.z < 2) throw std::invalid_argument("curl field needs at least two samples per axis");
+            if (uint64_t(resolution.x) * resolution.y * resolution.z * 3 > uint64_t(INT32_MAX)) throw std::invalid_argument("curl field slice is too large to index");
+            if (bounds.width() <= 0.0f || bounds.height() <= 0.0f || bounds.depth() <= 0.0f) throw std::invalid_argument("curl field bounds are empty");
+
+            res = resolution;
+            origin = bounds.min();
+            extent = bounds.size();
+            const float3 spacing = extent / float3((float) res.x - 1, (float) res.y - 1, (float) res.z - 1);
+            invSpacing = float3(1.0f) / spacing;
+            frames = std::max(1u, params.frames);
+            period = params.period;
+            data.assign(frame_stride() * frames, 0.0f);
+
+            const NoiseGenerator seeded(params.seed);
+            const NoiseGenerator & gen = params.seed ? seeded : default_generator();
+
+            parallel_for(0, size_t(frames) * res.z, [&](size_t task)
+            {
+                const uint32_t frame = uint32_t(task / res.z), z = uint32_t(task % res.z);
+                const float angle = float(ANVIL_TAU) * frame / frames;
+                float * slab = data.data() + frame * frame_stride() + size_t(z) * res.x * res.y * 3;
+                std::vector<float> scratch;
+                for (uint32_t y = 0; y < res.y; ++y)
+                {
+                    const float3 start = origin + spacing * float3(0.0f, (float) y, (float) z);
+                    float * row = slab + size_t(y) * res.x * 3;
+                    if (frames == 1)
+                    {
+                        bake_static_row(gen, params, start, spacing.x, res.x, row, scratch);
+                        continue;
+                    }
+                    for (uint32_t x = 0; x < res.x; ++x)
+                    {
+                        const float3 v = flow_curl(gen, params, float3(start.x + spacing.x * x, start.y, start.z) * params.frequency, angle) * params.amplitude;
+                        row[x * 3 + 0] = v.x; row[x * 3 + 1] = v.y; row[x * 3 + 2] = v.z;
+                    }
+                }
+            }, numThreads);
+        }
+
+        uint3 resolution() const { return res; }
+        uint32_t frame_count() const { return frames; }
+        float get_period() const { return period; }
+        Bounds3D bounds() const { return Bounds3D(origin, origin + extent); }
+        size_t size_bytes() const { return data.size() * sizeof(float); }
+
+        // Tightly packed RGB32F slice, ready for GlTexture3D::setup
+        const float * frame_data(uint32_t frame) const { return data.data() + frame * frame_stride(); }
+
+        float3 value_at(uint32_t x, uint32_t y, uint32_t z, uint32_t frame = 0) const
+        {
+            const float * v = frame_data(frame) + ((size_t(z) * res.y + y) * res.x + x) * 3;
+            return float3(v[0], v[1], v[2]);
+        }
+
+        // Velocity at a world position; time wraps over the period of an animated field and is ignored by a static one
+        float3 sample(const float3 & p, float time = 0.0f, Filter filter = Filter::Trilinear) const
+        {
+            const FrameBlend blend = frames_at(time);
+            if (filter == Filter::Tricubic) return sample_scalar<4>(p, blend, [](float g, int n, int (&i)[4], float (&w)[4]) { cubic_taps(g, n, i, w); });
+            return sample_scalar<2>(p, blend, [](float g, int n, int (&i)[2], float (&w)[2]) { linear_taps(g, n, i, w); });
+        }
+
+        // Samples `count` positions given as SoA arrays at a common time, eight at a time with AVX2
+        void sample(const float * x, const float * y, const float * z, float * vx, float * vy, float * vz, size_t count, float time = 0.0f, Filter filter = Filter::Trilinear) const
+        {
+#if defined(__AVX2__)
+            const FrameBlend blend = frames_at(time);
+            if (filter == Filter::Tricubic)
+            {
+                impl::simd::for_each_block<3, 3>({ x, y, z }, { vx, vy, vz }, count, [&](const __m256 * in, __m256 * out)
+                {
+                    sample_simd<4>(in, out, blend, [](__m256 g, int n, __m256i (&i)[4], __m256 (&w)[4]) { cubic_taps(g, n, i, w); });
+                });
+            }
+            else
+            {
+                impl::simd::for_each_block<3, 3>({ x, y, z }, { vx, vy, vz }, count, [&](const __m256 * in, __m256 * out)
+                {
+                    sample_simd<2>(in, out, blend, [](__m256 g, int n, __m256i (&i)[2], __m256 (&w)[2]) { linear_taps(g, n, i, w); });
+                });
+            }
+#else
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float3 v = sample(float3(x[i], y[i], z[i]), time, filter);
+                vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+            }
+#endif
+        }
+    };
+}
+
+#endif // end curl_field_hpp
@@ -45,7 +45,7 @@ struct ExperimentalApp : public GLFWApp
     ParabolicPointerParams params;
 	std::vector<float4x4> ptf;
      
-	std::future<Geometry> pointerFuture;
+	ProceduralMeshCache meshCache;
 	bool regeneratePointer = false;
 
 	struct BallisticProjectile 
@@ -198,26 +198,28 @@ struct ExperimentalApp : public GLFWApp
         time += e.timestep_ms;
         shaderMonitor.handle_recompile();
 
-		 // If a new mesh is ready, retrieve it
-		if (pointerFuture.valid())
+		// Scrubbing revisits earlier parameter sets, which come straight from the cache; new ones are
+		// generated on a worker while the last finished shape stays on screen
+		if (regeneratePointer)
 		{
-			auto status = pointerFuture.wait_for(std::chrono::seconds(0));
-			if (status != std::future_status::timeout)
+			auto result = meshCache.request(make_supershape_3d, 16, ssM, ssN1, ssN2, ssN3, 1.0f, 1.0f);
+			if (result.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
 			{
-				auto m = pointerFuture.get();
-				supershape = m;
-				supershape.pose.position = {0, 2, -2};
-				pointerFuture = {};
+				try
+				{
+					if (const GeometryHandle geometry = result.get())
+					{
+						supershape = *geometry;
+						supershape.pose.position = {0, 2, -2};
+					}
+				}
+				catch (const std::exception & e)
+				{
+					std::cerr << "failed to generate supershape: " << e.what() << std::endl;
+				}
+				regeneratePointer = false;
 			}
 		}
-
-		// If we don't currently have a background task, begin working on the next mesh
-		if (!pointerFuture.valid() && regeneratePointer) 
-		{
-			pointerFuture = std::async([]() {
-				return make_supershape_3d(16, ssM, ssN1, ssN2, ssN3);
-			});
-		}
     }
 
     void on_draw() override
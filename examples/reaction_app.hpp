@@ -17,7 +17,7 @@ struct ExperimentalApp : public GLFWApp
     GlTexture2D gsOutput;
     std::unique_ptr<GLTextureView> gsOutputView;
     
-    std::unique_ptr<GrayScottSimulator> gs;
+    std::unique_ptr<FastGrayScottSimulator<float>> gs;
     
     std::vector<uint8_t> pixels;
     std::vector<uint8_t> seedImagePixels;
@@ -40,7 +40,7 @@ struct ExperimentalApp : public GLFWApp
         camera.look_at({-5, 15, 0}, {0, 0, 0});
         
         pixels.resize(256 * 256 * 3, 150);
-        gs.reset(new GrayScottSimulator(float2(256, 256), false));
+        gs.reset(new FastGrayScottSimulator<float>(uint2(256, 256), false));
         gs->set_coefficients(0.023f, 0.077f, 0.12f, 0.08f);
         
         fullscreen_reaction_quad = make_fullscreen_quad();
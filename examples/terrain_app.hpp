@@ -83,6 +83,7 @@ struct ExperimentalApp : public GLFWApp
     std::shared_ptr<GlShader> basicShader;
     std::unique_ptr<GlShader> terrainShader;
     std::unique_ptr<GlShader> waterShader;
+    std::unique_ptr<GlShader> cdlodShader;
     
     GlMesh axisMesh, sphereMesh;
 
@@ -96,6 +97,12 @@ struct ExperimentalApp : public GLFWApp
     GlMesh terrainMesh;
     GlMesh icosahedronMesh;
 
+    // Kilometer-scale streamed terrain; the fixed 64x64 mesh remains for comparison
+    std::unique_ptr<CdlodTerrain> cdlodTerrain;
+    std::unique_ptr<GlCdlodTerrain> cdlodRenderer;
+    bool drawCdlod = true;
+    bool freezeCdlodSelection = false;
+
     const float clipPlaneOffset = 0.075f;
     
     float yWaterPlane = 0.0f;
@@ -128,6 +135,7 @@ struct ExperimentalApp : public GLFWApp
 
         terrainShader.reset(new GlShader(read_file_text("../assets/shaders/prototype/terrain_vert_debug.glsl"), read_file_text("../assets/shaders/prototype/terrain_frag_debug.glsl")));
         waterShader.reset(new GlShader(read_file_text("../assets/shaders/prototype/water_vert.glsl"), read_file_text("../assets/shaders/prototype/water_frag.glsl")));
+        cdlodShader.reset(new GlShader(read_file_text("../assets/shaders/prototype/cdlod_vert.glsl"), read_file_text("../assets/shaders/prototype/terrain_frag_debug.glsl")));
         
         sceneColorTexture.setup(width, height, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
         glNamedFramebufferTexture2DEXT(reflectionFramebuffer, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColorTexture, 0);
@@ -142,6 +150,26 @@ struct ExperimentalApp : public GLFWApp
         waterMesh = make_plane_mesh(112.f, 112.f, 256, 256);
         terrainMesh = make_mesh_from_geometry(make_perlin_mesh(64, 64));
         icosahedronMesh = make_icosahedron_mesh();
+
+        {
+            // 16 km on a side, centered on the origin, with 8 m leaves drawn as 32x32 quad chunks
+            CdlodSettings settings;
+            settings.leafSize = 8.0f;
+            settings.levels = 12;
+            settings.leafRange = 20.0f;
+            settings.origin = float2(-settings.leafSize * float(1 << (settings.levels - 1)) * 0.5f);
+            settings.minHeight = -40.0f;
+            settings.maxHeight = 120.0f;
+
+            noise::LayeredNoiseParams params;
+            params.frequency = 1.0f / 600.0f;
+            params.octaves = 6;
+            params.amplitude = 60.0f;
+            params.warpStrength = 0.5f;
+
+            cdlodTerrain.reset(new CdlodTerrain(settings, 512, make_noise_tile_generator(params, settings)));
+            cdlodRenderer.reset(new GlCdlodTerrain(*cdlodTerrain));
+        }
         
         gizmo.reset(new GlGizmo());
         igm.reset(new gui::ImGuiInstance(window));
@@ -182,11 +210,18 @@ struct ExperimentalApp : public GLFWApp
         
         auto mask = make_radial_mask(32);
         
+        // A single octave of fBm is half the base noise, so amplitude 2 reproduces noise(x * 0.1, z * 0.1)
+        noise::LayeredNoiseParams params;
+        params.octaves = 1;
+        params.amplitude = 2.0f;
+        const uint32_t verts = (uint32_t) gridSize + 1;
+        auto heights = noise::make_noise_field(params, uint2(verts, verts), float2(0, 0), float2(0.1f, 0.1f));
+        
         for (int x = 0; x <= gridSize; x++)
         {
             for (int z = 0; z <= gridSize; z++)
             {
-                float y = ((noise::noise(float2(x * 0.1f, z * 0.1f))) + 1.0f) / 2.0f;
+                float y = (heights[z * verts + x] + 1.0f) / 2.0f;
                 y = y * 10.0f;
                 //float w = 0.54 - 0.46 * cos(ANVIL_TAU * (x * gridSize + z) / ( gridSize));
                 auto w = mask[x * gridSize + z];
@@ -301,9 +336,25 @@ struct ExperimentalApp : public GLFWApp
         terrainShader->unbind();
         
         glDisable(GL_BLEND);
+
+        if (drawCdlod) draw_cdlod_terrain(viewProj, viewMatrix, cameraPosition, float4(0, 0, 0, 0), float3(95.f / 255.f, 189.f / 255.f, 192.f / 255.f));
         
         gl_check_error(__FILE__, __LINE__);
     }
+
+    void draw_cdlod_terrain(const float4x4 & viewProj, const float4x4 & viewMatrix, const float3 & eyePosition, const float4 & clipPlane, const float3 & color)
+    {
+        cdlodShader->bind();
+        cdlodShader->uniform("u_viewProj", viewProj);
+        cdlodShader->uniform("u_eyePosition", eyePosition);
+        cdlodShader->uniform("u_modelView", viewMatrix);
+        cdlodShader->uniform("u_modelMatrixIT", get_rotation_submatrix(inverse(transpose(viewMatrix))));
+        cdlodShader->uniform("u_lightPosition", float3(0.0, 10.0, 0.0));
+        cdlodShader->uniform("u_clipPlane", clipPlane);
+        cdlodShader->uniform("u_surfaceColor", color);
+        cdlodRenderer->draw(*cdlodShader);
+        cdlodShader->unbind();
+    }
     
     // Given position/normal of the plane, calculates plane in camera space.
     float4 camera_space_plane(float4x4 viewMatrix, float3 pos, float3 normal, float sideSign, float clipPlaneOffset)
@@ -359,6 +410,13 @@ struct ExperimentalApp : public GLFWApp
 
         skydome.render(viewProj, cameraPosition, camera.farclip);
 
+        // Selection runs once per frame; the reflection pass reuses it, which is conservative enough for a flat water plane
+        if (drawCdlod && !freezeCdlodSelection)
+        {
+            const Frustum frustum(viewProj);
+            cdlodRenderer->update(*cdlodTerrain, cameraPosition, &frustum);
+        }
+
         {
             // Wind in reverse order for reflection
             glFrontFace(GL_CW);
@@ -391,6 +449,8 @@ struct ExperimentalApp : public GLFWApp
 
             terrainShader->unbind();
 
+            if (drawCdlod) draw_cdlod_terrain(mul(viewProj, make_reflection_matrix(reflectionPlane)), viewMatrix, cameraPosition, reflectionPlane, float3(1, 1, 1));
+
             // Pop reverse winding
             glFrontFace(GL_CCW);
         }
@@ -482,6 +542,9 @@ struct ExperimentalApp : public GLFWApp
         igm->begin_frame();
         ImGui::SliderInt("Playback Index", &playbackIndex, 0, follower.parallelTransportFrames.size());
         ImGui::Checkbox("Follow", &cameraFollowing);
+        ImGui::Checkbox("CDLOD Terrain", &drawCdlod);
+        ImGui::Checkbox("Freeze CDLOD Selection", &freezeCdlodSelection);
+        ImGui::Text("CDLOD chunks %d, tiles resident %d, pending %d", (int) cdlodRenderer->instance_count(), (int) cdlodTerrain->tiles().resident_count(), (int) cdlodTerrain->tiles().pending_count());
         igm->end_frame();
 
         glfwSwapBuffers(window);
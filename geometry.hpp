@@ -3,6 +3,11 @@
 
 #include "math-core.hpp"
 #include "../lib-model-io/model-io.hpp"
+#include "parallel_for.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
 using namespace avl;
 
@@ -25,6 +30,7 @@ inline Bounds3D compute_bounds(const Geometry & g)
 
 // Lengyel, Eric. "Computing Tangent Space Basis Vectors for an Arbitrary Mesh".
 // Terathon Software 3D Graphics Library, 2001.
+// The fast approximate path; compute_mikktspace_tangents matches what baking tools expect.
 inline void compute_tangents(Geometry & g)
 {
     g.tangents.resize(g.vertices.size());
@@ -89,73 +95,256 @@ inline void compute_tangents(Geometry & g)
     }
 }
 
-inline void compute_normals(Geometry & g, bool smooth = true)
+// Lists the corners (face * 3 + corner) around every vertex in face order, with vertex v owning
+// corners[start[v] .. start[v + 1]). A corner belongs to vertexOf[index], or to the index itself if vertexOf is empty.
+inline void gather_vertex_corners(const std::vector<uint3> & faces, size_t vertexCount, const std::vector<uint32_t> & vertexOf, std::vector<uint32_t> & start, std::vector<uint32_t> & corners)
+{
+    auto vertex = [&](uint32_t index) { return vertexOf.empty() ? index : vertexOf[index]; };
+
+    start.assign(vertexCount + 1, 0);
+    corners.resize(faces.size() * 3);
+    for (const auto & f : faces) for (int c = 0; c < 3; ++c) ++start[vertex(f[c]) + 1];
+    for (size_t i = 0; i < vertexCount; ++i) start[i + 1] += start[i];
+
+    std::vector<uint32_t> cursor(start.begin(), start.end() - 1);
+    for (uint32_t i = 0; i < faces.size(); ++i) for (int c = 0; c < 3; ++c) corners[cursor[vertex(faces[i][c])]++] = i * 3 + c;
+}
+
+// Tangent frames that match Morten Mikkelsen's MikkTSpace, the convention most baking tools use, so normal
+// maps baked elsewhere shade correctly. Every corner contributes its triangle's texture-space S direction,
+// projected onto the vertex normal and weighted by the corner angle. A vertex sums the corners that share its
+// UV orientation, taking the larger total angle where mirrored UVs meet, and the bitangent is
+// sign * cross(normal, tangent), with a negative sign on mirrored triangles. Requires normals and texcoord0.
+// Corner contributions are computed in parallel over blocks of triangles into their own slots and gathered
+// per vertex, so nothing is shared between threads and the result does not depend on the thread count.
+// Unlike the reference implementation this never splits vertices.
+inline void compute_mikktspace_tangents(Geometry & g, uint32_t numThreads = 0)
 {
-    constexpr double NORMAL_EPSILON = 0.0001;
+    const size_t vertexCount = g.vertices.size(), faceCount = g.faces.size();
+    if (g.normals.size() != vertexCount || g.texcoord0.size() != vertexCount) throw std::runtime_error("tangents need a normal and texcoord0 per vertex");
 
-    g.normals.resize(g.vertices.size());
+    std::vector<float3> cornerTangents(faceCount * 3);  // angle * projected S direction
+    std::vector<float> cornerAngles(faceCount * 3);
+    std::vector<uint8_t> preserving(faceCount);         // UV winding matches the triangle winding
 
-    for (auto & n : g.normals) n = float3(0, 0, 0);
+    auto project = [](const float3 & v, const float3 & n) { return v - n * dot(n, v); };
 
-    std::vector<uint32_t> uniqueVertIndices(g.vertices.size(), 0);
-    if (smooth)
+    parallel_for(0, faceCount, [&](size_t i)
     {
-        for (uint32_t i = 0; i < uniqueVertIndices.size(); ++i)
+        const uint3 & f = g.faces[i];
+        const float3 d1 = g.vertices[f.y] - g.vertices[f.x], d2 = g.vertices[f.z] - g.vertices[f.x];
+        const float2 t21 = g.texcoord0[f.y] - g.texcoord0[f.x], t31 = g.texcoord0[f.z] - g.texcoord0[f.x];
+
+        const float signedArea = t21.x * t31.y - t21.y * t31.x;
+        preserving[i] = signedArea > 0.0f;
+
+        float3 os = d1 * t31.y - d2 * t21.y;
+        const float lengthOs = length(os);
+        os = (signedArea != 0.0f && lengthOs > 0.0f) ? os * ((signedArea > 0.0f ? 1.0f : -1.0f) / lengthOs) : float3(0, 0, 0);
+
+        for (int c = 0; c < 3; ++c)
         {
-            if (uniqueVertIndices[i] == 0)
-            {
-                uniqueVertIndices[i] = i + 1;
-                const float3 v0 = g.vertices[i];
-                for (auto j = i + 1; j < g.vertices.size(); ++j)
+            const float3 & n = g.normals[f[c]];
+            const float3 & p = g.vertices[f[c]];
+            const float3 v1 = safe_normalize(project(g.vertices[f[(c + 2) % 3]] - p, n));
+            const float3 v2 = safe_normalize(project(g.vertices[f[(c + 1) % 3]] - p, n));
+            const float angle = std::acos(clamp(dot(v1, v2), -1.0f, 1.0f));
+
+            cornerAngles[i * 3 + c] = angle;
+            cornerTangents[i * 3 + c] = safe_normalize(project(os, n)) * angle;
+        }
+    }, numThreads, 1024);
+
+    std::vector<uint32_t> start, corners;
+    gather_vertex_corners(g.faces, vertexCount, std::vector<uint32_t>(), start, corners);
+
+    g.tangents.resize(vertexCount);
+    g.bitangents.resize(vertexCount);
+    parallel_for(0, vertexCount, [&](size_t v)
+    {
+        float angle[2] = { 0, 0 };
+        for (uint32_t k = start[v]; k < start[v + 1]; ++k) angle[preserving[corners[k] / 3]] += cornerAngles[corners[k]];
+        const uint8_t orientation = angle[1] >= angle[0];
+
+        float3 t = float3(0, 0, 0);
+        for (uint32_t k = start[v]; k < start[v + 1]; ++k)
+        {
+            if (preserving[corners[k] / 3] == orientation) t += cornerTangents[corners[k]];
+        }
+
+        const float3 & n = g.normals[v];
+        t = safe_normalize(t);
+        if (length2(t) == 0.0f) t = safe_normalize(project(std::abs(n.x) < 0.9f ? float3(1, 0, 0) : float3(0, 1, 0), n)); // no usable UVs here
+
+        g.tangents[v] = t;
+        g.bitangents[v] = cross(n, t) * (orientation ? 1.0f : -1.0f);
+    }, numThreads, 1024);
+}
+
+// Maps every position to a representative index, welding positions closer than `epsilon`. Vertices are
+// visited in order: one becomes a representative unless an earlier representative lies within epsilon, in
+// which case it maps to the latest such representative. Representatives are found through a uniform grid
+// of 2 * epsilon cells, so this is linear in the vertex count. An epsilon of zero welds nothing.
+inline std::vector<uint32_t> weld_positions(const std::vector<float3> & positions, float epsilon)
+{
+    std::vector<uint32_t> representative(positions.size());
+    for (uint32_t i = 0; i < representative.size(); ++i) representative[i] = i;
+    if (epsilon <= 0.0f || positions.empty()) return representative;
+
+    struct Cell { int64_t x, y, z; uint32_t head; };
+    const uint32_t none = 0xffffffff;
+    const float cellSize = 2.0f * epsilon, epsilon2 = epsilon * epsilon;
+
+    size_t capacity = 64;
+    while (capacity < positions.size() * 2) capacity *= 2;
+    std::vector<Cell> cells(capacity, Cell{ 0, 0, 0, none });
+    std::vector<uint32_t> next(positions.size(), none); // chains representatives within a cell
+
+    auto slot_of = [&](int64_t x, int64_t y, int64_t z) -> size_t
+    {
+        uint64_t h = uint64_t(x) * 73856093ull ^ uint64_t(y) * 19349663ull ^ uint64_t(z) * 83492791ull;
+        h ^= h >> 29;
+        size_t slot = size_t(h * 0x9E3779B97F4A7C15ull) & (capacity - 1);
+        while (cells[slot].head != none && (cells[slot].x != x || cells[slot].y != y || cells[slot].z != z)) slot = (slot + 1) & (capacity - 1);
+        return slot;
+    };
+
+    for (uint32_t i = 0; i < positions.size(); ++i)
+    {
+        const float3 & p = positions[i];
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) continue;
+
+        const int64_t x0 = (int64_t) std::floor((p.x - epsilon) / cellSize), x1 = (int64_t) std::floor((p.x + epsilon) / cellSize);
+        const int64_t y0 = (int64_t) std::floor((p.y - epsilon) / cellSize), y1 = (int64_t) std::floor((p.y + epsilon) / cellSize);
+        const int64_t z0 = (int64_t) std::floor((p.z - epsilon) / cellSize), z1 = (int64_t) std::floor((p.z + epsilon) / cellSize);
+
+        uint32_t best = none;
+        for (int64_t z = z0; z <= z1; ++z)
+            for (int64_t y = y0; y <= y1; ++y)
+                for (int64_t x = x0; x <= x1; ++x)
                 {
-                    const float3 v1 = g.vertices[j];
-                    if (length2(v1 - v0) < NORMAL_EPSILON)
+                    const Cell & c = cells[slot_of(x, y, z)];
+                    for (uint32_t r = c.head; r != none; r = next[r])
                     {
-                        uniqueVertIndices[j] = uniqueVertIndices[i];
+                        if ((best == none || r > best) && length2(positions[r] - p) < epsilon2) best = r;
                     }
                 }
-            }
+
+        if (best != none)
+        {
+            representative[i] = best;
+            continue;
         }
+
+        const int64_t cx = (int64_t) std::floor(p.x / cellSize), cy = (int64_t) std::floor(p.y / cellSize), cz = (int64_t) std::floor(p.z / cellSize);
+        Cell & c = cells[slot_of(cx, cy, cz)];
+        c.x = cx; c.y = cy; c.z = cz;
+        next[i] = c.head;
+        c.head = i;
     }
+    return representative;
+}
 
-    uint32_t idx0, idx1, idx2;
-    for (size_t i = 0; i < g.faces.size(); ++i)
+struct NormalParams
+{
+    bool smooth = true;             // average across faces sharing a (welded) position
+    float weldEpsilon = 0.01f;      // positions closer than this are one vertex; faces with shorter edges are skipped
+    bool angleWeighted = false;     // weight face normals by their corner angle instead of equally
+    float creaseAngle = float(ANVIL_PI); // radians; faces further apart than this do not smooth into each other
+    uint32_t numThreads = 0;        // zero uses every hardware thread
+};
+
+// Face normals are computed in parallel, then every vertex sums the faces around its welded position in face
+// order, so the result does not depend on the thread count. Creases only separate vertices that are already
+// split: a vertex takes the welded faces within creaseAngle of one of its own faces, and no vertices are added.
+inline void compute_normals(Geometry & g, const NormalParams & params)
+{
+    const size_t vertexCount = g.vertices.size(), faceCount = g.faces.size();
+    const float epsilon2 = params.weldEpsilon * params.weldEpsilon;
+    const bool creased = params.smooth && params.creaseAngle < float(ANVIL_PI);
+    const float creaseCos = std::cos(params.creaseAngle);
+
+    g.normals.assign(vertexCount, float3(0, 0, 0));
+
+    const std::vector<uint32_t> group = params.smooth ? weld_positions(g.vertices, params.weldEpsilon) : weld_positions(g.vertices, 0.0f);
+
+    // Face normals and per-corner weights, from welded positions; degenerate faces get a zero normal
+    std::vector<float3> faceNormals(faceCount);
+    std::vector<float3> cornerWeights(params.angleWeighted ? faceCount : 0);
+    parallel_for(0, faceCount, [&](size_t i)
     {
-        const auto & f = g.faces[i];
+        const uint3 & f = g.faces[i];
+        const float3 v0 = g.vertices[group[f.x]];
+        const float3 v1 = g.vertices[group[f.y]];
+        const float3 v2 = g.vertices[group[f.z]];
 
-        idx0 = (smooth) ? uniqueVertIndices[f.x] - 1 : f.x;
-        idx1 = (smooth) ? uniqueVertIndices[f.y] - 1 : f.y;
-        idx2 = (smooth) ? uniqueVertIndices[f.z] - 1 : f.z;
+        const float3 e0 = v1 - v0, e1 = v2 - v0, e2 = v2 - v1;
+        if (length2(e0) < epsilon2 || length2(e1) < epsilon2 || length2(e2) < epsilon2)
+        {
+            faceNormals[i] = float3(0, 0, 0);
+            if (params.angleWeighted) cornerWeights[i] = float3(0, 0, 0);
+            return;
+        }
 
-        const float3 v0 = g.vertices[idx0];
-        const float3 v1 = g.vertices[idx1];
-        const float3 v2 = g.vertices[idx2];
+        faceNormals[i] = safe_normalize(cross(e0, e1));
+        if (params.angleWeighted)
+        {
+            auto angle = [](const float3 & a, const float3 & b) { return std::acos(clamp(dot(safe_normalize(a), safe_normalize(b)), -1.0f, 1.0f)); };
+            const float a0 = angle(e0, e1), a1 = angle(-e0, e2);
+            cornerWeights[i] = float3(a0, a1, float(ANVIL_PI) - a0 - a1);
+        }
+    }, params.numThreads, 1024);
 
-        float3 e0 = v1 - v0;
-        float3 e1 = v2 - v0;
-        float3 e2 = v2 - v1;
+    // Corners grouped by welded vertex
+    std::vector<uint32_t> groupStart, corners;
+    gather_vertex_corners(g.faces, vertexCount, group, groupStart, corners);
 
-        if (length2(e0) < NORMAL_EPSILON) continue;
-        if (length2(e1) < NORMAL_EPSILON) continue;
-        if (length2(e2) < NORMAL_EPSILON) continue;
+    auto contribution = [&](uint32_t corner)
+    {
+        const float3 & n = faceNormals[corner / 3];
+        return params.angleWeighted ? n * cornerWeights[corner / 3][corner % 3] : n;
+    };
 
-        const float3 n = safe_normalize(cross(e0, e1));
+    if (!creased)
+    {
+        // Every vertex of a group shares its sum
+        parallel_for(0, vertexCount, [&](size_t i)
+        {
+            if (group[i] != i) return;
+            float3 n = float3(0, 0, 0);
+            for (uint32_t k = groupStart[i]; k < groupStart[i + 1]; ++k) n += contribution(corners[k]);
+            g.normals[i] = safe_normalize(n);
+        }, params.numThreads, 1024);
+        parallel_for(0, vertexCount, [&](size_t i) { if (group[i] != i) g.normals[i] = g.normals[group[i]]; }, params.numThreads, 4096);
+        return;
+    }
 
-        g.normals[f.x] += n;
-        g.normals[f.y] += n;
-        g.normals[f.z] += n;
+    parallel_for(0, vertexCount, [&](size_t i)
+    {
+        const uint32_t begin = groupStart[group[i]], end = groupStart[group[i] + 1];
 
-        // Copy normals for non-unique verts
-        if (smooth)
+        std::vector<float3> own; // normals of the faces that reference this vertex directly
+        for (uint32_t k = begin; k < end; ++k)
         {
-            for (uint32_t i = 0; i < g.vertices.size(); ++i)
-            {
-                g.normals[i] = g.normals[uniqueVertIndices[i] - 1];
-            }
+            const float3 & faceNormal = faceNormals[corners[k] / 3];
+            if (g.faces[corners[k] / 3][corners[k] % 3] == i && length2(faceNormal) > 0.0f) own.push_back(faceNormal);
         }
-    }
 
-    for (auto & n : g.normals) n = safe_normalize(n);
+        float3 n = float3(0, 0, 0);
+        for (uint32_t k = begin; k < end; ++k)
+        {
+            const float3 & faceNormal = faceNormals[corners[k] / 3];
+            if (std::any_of(own.begin(), own.end(), [&](const float3 & o) { return dot(faceNormal, o) >= creaseCos; })) n += contribution(corners[k]);
+        }
+        g.normals[i] = safe_normalize(n);
+    }, params.numThreads, 256);
+}
+
+inline void compute_normals(Geometry & g, bool smooth = true)
+{
+    NormalParams params;
+    params.smooth = smooth;
+    compute_normals(g, params);
 }
 
 inline void rescale_geometry(Geometry & g, float radius = 1.0f)
@@ -0,0 +1,84 @@
+#ifndef gl_cdlod_terrain_hpp
+#define gl_cdlod_terrain_hpp
+
+#include "cdlod_terrain.hpp"
+#include "gl-api.hpp"
+
+namespace avl
+{
+    // GPU side of a CdlodTerrain: one grid mesh drawn once per selected chunk, and a texture array with a
+    // layer per tile cache slot. Expects assets/shaders/prototype/cdlod_vert.glsl, which reads the grid
+    // position from attribute 0 and the CdlodInstance fields from attributes 4, 5 and 6.
+    class GlCdlodTerrain
+    {
+        GlMesh grid;
+        GlTexture3D heightmaps;
+        uint32_t gridResolution, tileResolution;
+        GLsizei instanceCount = 0;
+
+    public:
+
+        explicit GlCdlodTerrain(CdlodTerrain & terrain) : gridResolution(terrain.quadtree().get_settings().gridResolution), tileResolution(terrain.tile_resolution())
+        {
+            const uint32_t n = gridResolution;
+            std::vector<float2> vertices;
+            for (uint32_t z = 0; z <= n; ++z)
+                for (uint32_t x = 0; x <= n; ++x) vertices.push_back(float2(float(x), float(z)));
+
+            std::vector<uint3> faces;
+            for (uint32_t z = 0; z < n; ++z)
+            {
+                for (uint32_t x = 0; x < n; ++x)
+                {
+                    const uint32_t i = z * (n + 1) + x;
+                    faces.push_back(uint3(i, i + n + 1, i + 1));
+                    faces.push_back(uint3(i + 1, i + n + 1, i + n + 2));
+                }
+            }
+
+            grid.set_vertices(vertices, GL_STATIC_DRAW);
+            grid.set_attribute(0, 2, GL_FLOAT, GL_FALSE, sizeof(float2), nullptr);
+            grid.set_elements(faces, GL_STATIC_DRAW);
+            grid.set_instance_data(sizeof(CdlodInstance), nullptr, GL_STREAM_DRAW);
+            grid.set_instance_attribute(4, 4, GL_FLOAT, GL_FALSE, sizeof(CdlodInstance), (GLvoid *) offsetof(CdlodInstance, chunk));
+            grid.set_instance_attribute(5, 4, GL_FLOAT, GL_FALSE, sizeof(CdlodInstance), (GLvoid *) offsetof(CdlodInstance, tileUV));
+            grid.set_instance_attribute(6, 4, GL_FLOAT, GL_FALSE, sizeof(CdlodInstance), (GLvoid *) offsetof(CdlodInstance, morph));
+
+            heightmaps.setup(GL_TEXTURE_2D_ARRAY, tileResolution, tileResolution, (GLsizei) terrain.tiles().capacity(), GL_R32F, GL_RED, GL_FLOAT, nullptr);
+            glTextureParameteriEXT(heightmaps, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteriEXT(heightmaps, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        // Uploads tiles the workers finished since the last frame, then selects and uploads this frame's chunks
+        void update(CdlodTerrain & terrain, const float3 & eyePosition, const Frustum * frustum = nullptr)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (const auto & t : terrain.tiles().take_completed())
+            {
+                // The upload reads a full layer, so a generator that filled fewer heights would read past them
+                const CdlodTile & tile = *t.second;
+                if (tile.resolution != tileResolution || tile.heights.size() != size_t(tileResolution) * tileResolution) throw std::runtime_error("cdlod tile does not match the terrain's tile resolution");
+                glTextureSubImage3DEXT(heightmaps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, t.first, tileResolution, tileResolution, 1, GL_RED, GL_FLOAT, tile.heights.data());
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            const auto & instances = terrain.update(eyePosition, frustum);
+            instanceCount = (GLsizei) instances.size();
+            if (instanceCount) grid.set_instance_data(instances.size() * sizeof(CdlodInstance), instances.data(), GL_STREAM_DRAW);
+        }
+
+        size_t instance_count() const { return instanceCount; }
+
+        // The shader must be bound; sets the uniforms that describe the grid and tile layout
+        void draw(const GlShader & shader, int textureUnit = 0) const
+        {
+            if (!instanceCount) return;
+            shader.uniform("u_gridResolution", float(gridResolution));
+            shader.uniform("u_tileResolution", float(tileResolution));
+            shader.texture("u_heightmaps", textureUnit, heightmaps, GL_TEXTURE_2D_ARRAY);
+            grid.draw_elements(instanceCount);
+        }
+    };
+}
+
+#endif // end gl_cdlod_terrain_hpp
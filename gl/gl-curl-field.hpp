@@ -0,0 +1,26 @@
+#ifndef gl_curl_field_hpp
+#define gl_curl_field_hpp
+
+#include "curl_field.hpp"
+#include "gl-api.hpp"
+
+namespace avl
+{
+    // Uploads one time slice of a baked curl field as an RGB 3D texture. RGB16F halves the footprint and
+    // is plenty for turbulence; pass GL_RGB32F to keep the baked precision. The field is not periodic in
+    // space, so the texture clamps at its faces like CurlFieldVolume::sample does.
+    inline GlTexture3D make_curl_field_texture(const noise::CurlFieldVolume & field, uint32_t frame = 0, GLenum internalFormat = GL_RGB16F)
+    {
+        const uint3 res = field.resolution();
+        GlTexture3D tex;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        tex.setup(GL_TEXTURE_3D, res.x, res.y, res.z, internalFormat, GL_RGB, GL_FLOAT, field.frame_data(frame));
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTextureParameteriEXT(tex, GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteriEXT(tex, GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteriEXT(tex, GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return tex;
+    }
+}
+
+#endif // end gl_curl_field_hpp
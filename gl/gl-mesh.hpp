@@ -7,6 +7,7 @@
 #include "file_io.hpp"
 #include "asset_io.hpp"
 #include "geometry.hpp"
+#include "vertex_format.hpp"
 
 #include <sstream>
 #include <vector>
@@ -22,97 +23,73 @@
 
 namespace avl
 {
-    inline GlMesh make_mesh_from_geometry(const Geometry & geometry, const GLenum usage = GL_STATIC_DRAW)
+    struct GlVertexEncoding
     {
-        assert(geometry.vertices.size() > 0);
-
-        GlMesh m;
-
-        int vertexOffset = 0;
-        int normalOffset = 0;
-        int colorOffset = 0;
-        int texOffset = 0;
-        int tanOffset = 0;
-        int bitanOffset = 0;
-
-        int components = 3;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+    };
 
-        if (geometry.normals.size() != 0)
-        {
-            normalOffset = components; components += 3;
-        }
-
-        if (geometry.colors.size() != 0)
+    inline GlVertexEncoding gl_vertex_encoding(VertexEncoding e)
+    {
+        switch (e)
         {
-            colorOffset = components; components += 3;
+        case VertexEncoding::float2: return{ 2, GL_FLOAT, GL_FALSE };
+        case VertexEncoding::float3: return{ 3, GL_FLOAT, GL_FALSE };
+        case VertexEncoding::float4: return{ 4, GL_FLOAT, GL_FALSE };
+        case VertexEncoding::unorm16x4: return{ 3, GL_UNSIGNED_SHORT, GL_TRUE };
+        case VertexEncoding::oct_10_10_10_2: return{ 4, GL_INT_2_10_10_10_REV, GL_TRUE };
+        case VertexEncoding::half2: return{ 2, GL_HALF_FLOAT, GL_FALSE };
+        case VertexEncoding::unorm8x4: return{ 4, GL_UNSIGNED_BYTE, GL_TRUE };
+        case VertexEncoding::uint8x4: return{ 4, GL_UNSIGNED_BYTE, GL_FALSE };
         }
+        return{ 0, GL_FLOAT, GL_FALSE };
+    }
 
-        if (geometry.texcoord0.size() != 0)
+    // Declares every element of the format against the mesh's vertex buffer
+    inline void set_vertex_format(GlMesh & mesh, const VertexFormat & format)
+    {
+        for (const auto & e : format.elements)
         {
-            texOffset = components; components += 2;
+            const GlVertexEncoding gl = gl_vertex_encoding(e.encoding);
+            mesh.set_attribute(e.location, gl.size, gl.type, gl.normalized, format.stride, (const GLvoid *)(size_t) e.offset);
         }
+    }
 
-        if (geometry.tangents.size() != 0)
-        {
-            tanOffset = components; components += 3;
-        }
+    // Position dequantization for shaders including packed_vertex.glsl
+    inline void set_vertex_format_uniforms(const GlShader & shader, const VertexFormat & format)
+    {
+        shader.uniform("u_positionOffset", format.positionOffset);
+        shader.uniform("u_positionScale", format.positionScale);
+    }
 
-        if (geometry.bitangents.size() != 0)
-        {
-            bitanOffset = components; components += 3;
-        }
+    inline GlMesh make_mesh_from_geometry(const Geometry & geometry, const VertexFormat & format, const GLenum usage = GL_STATIC_DRAW, const VertexBoneStreams & bones = {})
+    {
+        assert(geometry.vertices.size() > 0);
 
-        std::vector<float> buffer;
-        buffer.reserve(geometry.vertices.size() * components);
+        GlMesh m;
 
-        for (size_t i = 0; i < geometry.vertices.size(); ++i)
+        // Encode straight into the mapped buffer; if the driver loses the contents on unmap, upload a copy instead
+        const GLsizeiptr bytes = GLsizeiptr(geometry.vertices.size() * format.stride);
+        m.set_vertex_data(bytes, nullptr, usage);
+        GlBuffer & vertexBuffer = m.get_vertex_data_buffer();
+        bool uploaded = false;
+        if (void * mapped = glMapNamedBufferRangeEXT(vertexBuffer, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT))
         {
-            buffer.push_back(geometry.vertices[i].x);
-            buffer.push_back(geometry.vertices[i].y);
-            buffer.push_back(geometry.vertices[i].z);
-
-            if (normalOffset)
-            {
-                buffer.push_back(geometry.normals[i].x);
-                buffer.push_back(geometry.normals[i].y);
-                buffer.push_back(geometry.normals[i].z);
-            }
-
-            if (colorOffset)
-            {
-                buffer.push_back(geometry.colors[i].x);
-                buffer.push_back(geometry.colors[i].y);
-                buffer.push_back(geometry.colors[i].z);
-            }
-
-            if (texOffset)
-            {
-                buffer.push_back(geometry.texcoord0[i].x);
-                buffer.push_back(geometry.texcoord0[i].y);
-            }
-
-            if (tanOffset)
-            {
-                buffer.push_back(geometry.tangents[i].x);
-                buffer.push_back(geometry.tangents[i].y);
-                buffer.push_back(geometry.tangents[i].z);
-            }
-
-            if (bitanOffset)
+            try { encode_vertices(geometry, format, static_cast<uint8_t *>(mapped), bones); }
+            catch (...)
             {
-                buffer.push_back(geometry.bitangents[i].x);
-                buffer.push_back(geometry.bitangents[i].y);
-                buffer.push_back(geometry.bitangents[i].z);
+                glUnmapNamedBufferEXT(vertexBuffer);
+                throw;
             }
+            uploaded = glUnmapNamedBufferEXT(vertexBuffer) == GL_TRUE;
         }
-
-        m.set_vertex_data(buffer.size() * sizeof(float), buffer.data(), usage);
-        m.set_attribute(0, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + vertexOffset);
-        if (normalOffset) m.set_attribute(1, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + normalOffset);
-        if (colorOffset) m.set_attribute(2, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + colorOffset);
-        if (texOffset) m.set_attribute(3, 2, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + texOffset);
-        if (tanOffset) m.set_attribute(4, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + tanOffset);
-        if (bitanOffset) m.set_attribute(5, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + bitanOffset);
+        if (!uploaded)
+        {
+            const std::vector<uint8_t> buffer = encode_vertices(geometry, format, bones);
+            m.set_vertex_data(buffer.size(), buffer.data(), usage);
+        }
+        set_vertex_format(m, format);
 
         if (geometry.faces.size() > 0)
         {
@@ -122,6 +99,22 @@ namespace avl
         return m;
     }
 
+    inline GlMesh make_mesh_from_geometry(const Geometry & geometry, const GLenum usage = GL_STATIC_DRAW)
+    {
+        return make_mesh_from_geometry(geometry, make_float_vertex_format(geometry), usage);
+    }
+
+    // Half the size or less of the float layout; draw with shaders that include packed_vertex.glsl
+    inline GlMesh make_packed_mesh_from_geometry(const Geometry & geometry, const GLenum usage = GL_STATIC_DRAW)
+    {
+        return make_mesh_from_geometry(geometry, make_packed_vertex_format(geometry), usage);
+    }
+
+    inline GlMesh make_packed_mesh_from_geometry(const runtime_skinned_mesh & mesh, const GLenum usage = GL_STATIC_DRAW)
+    {
+        return make_mesh_from_geometry(mesh, make_packed_vertex_format(mesh), usage, bone_streams(mesh));
+    }
+
 }
 
 #pragma warning(pop)
@@ -0,0 +1,77 @@
+#ifndef gl_procedural_mesh_cache_hpp
+#define gl_procedural_mesh_cache_hpp
+
+#include "procedural_mesh_cache.hpp"
+#include "gl-mesh.hpp"
+
+namespace avl
+{
+    // Shares one uploaded GlMesh per memoized geometry. Uploads happen on the calling (GL) thread; a mesh lives
+    // as long as its geometry is held by the ProceduralMeshCache or by anyone else, and collect() releases
+    // meshes whose geometry is gone. Call it once a frame.
+    class GlProceduralMeshCache
+    {
+        struct Entry
+        {
+            std::weak_ptr<const Geometry> geometry;
+            std::shared_ptr<GlMesh> mesh;
+        };
+
+        ProceduralMeshCache & cache;
+        std::unordered_map<ProceduralMeshKey, Entry, ProceduralMeshKeyHash> meshes;
+
+    public:
+
+        explicit GlProceduralMeshCache(ProceduralMeshCache & cache) : cache(cache) {}
+
+        ProceduralMeshCache & geometry_cache() { return cache; }
+
+        // Returns the mesh uploaded for this geometry, uploading it on first use
+        std::shared_ptr<GlMesh> upload(const ProceduralMeshKey & key, const GeometryHandle & geometry)
+        {
+            Entry & e = meshes[key];
+            if (e.mesh && e.geometry.lock() == geometry) return e.mesh;
+            e.geometry = geometry;
+            e.mesh = std::make_shared<GlMesh>(make_mesh_from_geometry(*geometry));
+            return e.mesh;
+        }
+
+        // Generates on this thread on a miss
+        template<class... P, class... A>
+        std::shared_ptr<GlMesh> get(Geometry(*generator)(P...), const A & ... args)
+        {
+            return upload(make_procedural_mesh_key(generator, args...), cache.get(generator, args...));
+        }
+
+        // Queues generation on a miss and returns null until the geometry is finished
+        template<class... P, class... A>
+        std::shared_ptr<GlMesh> try_get(Geometry(*generator)(P...), const A & ... args)
+        {
+            const ProceduralMeshKey key = make_procedural_mesh_key(generator, args...);
+            auto it = meshes.find(key);
+            if (it != meshes.end() && it->second.mesh && !it->second.geometry.expired())
+            {
+                cache.try_get(key); // keeps the geometry recently used while its mesh is drawn
+                return it->second.mesh;
+            }
+
+            const auto result = cache.request(generator, args...);
+            if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return nullptr;
+            const GeometryHandle geometry = result.get();
+            return geometry ? upload(key, geometry) : nullptr;
+        }
+
+        void collect()
+        {
+            for (auto it = meshes.begin(); it != meshes.end();)
+            {
+                if (it->second.geometry.expired()) it = meshes.erase(it);
+                else ++it;
+            }
+        }
+
+        size_t mesh_count() const { return meshes.size(); }
+    };
+}
+
+#endif // end gl_procedural_mesh_cache_hpp
@@ -16,6 +16,19 @@
 #include "splines.hpp"
 #include "reaction_diffusion.hpp"
 #include "simplex_noise.hpp"
+#include "noise_field.hpp"
+#include "curl_field.hpp"
+#include "cdlod_terrain.hpp"
+#include "procedural_mesh_cache.hpp"
+#include "isosurface.hpp"
+#include "sparse_voxel_array.hpp"
+#include "mesh_lod.hpp"
+#include "worker_pool.hpp"
+#include "model_import_cache.hpp"
+#include "animation_clip.hpp"
+#include "skinning.hpp"
+#include "async_asset_loader.hpp"
+#include "vertex_format.hpp"
 #include "poisson_disk.hpp"
 #include "movement_tracker.hpp"
 #include "oriented_bounding_box.hpp"
@@ -37,6 +50,9 @@
 #include "gl-mesh.hpp"
 #include "gl-nvg.hpp"
 #include "gl-procedural-mesh.hpp"
+#include "gl-procedural-mesh-cache.hpp"
+#include "gl-curl-field.hpp"
+#include "gl-cdlod-terrain.hpp"
 #include "gl-procedural-sky.hpp"
 #include "gl-renderable-grid.hpp"
 #include "gl-renderable-meshline.hpp"
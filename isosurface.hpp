@@ -0,0 +1,368 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef isosurface_hpp
+#define isosurface_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "geometry.hpp"
+#include "algo_misc.hpp"
+#include "parallel_for.hpp"
+
+#include <functional>
+#include <vector>
+
+// Marching cubes over a regular grid of scalar samples, either a VoxelArray<float> or a callback. The grid
+// is split into slabs of cell layers that are extracted in parallel. Every vertex belongs to one grid edge
+// and is created once, by the slab that owns the edge; triangles refer to vertices through per-edge index
+// slices, so the mesh comes out welded without searching for duplicates. The only edges a slab does not
+// own are those on its top slice, which it references symbolically and which are resolved against the
+// next slab's indices when the slabs are concatenated. Slabs have a fixed height, so the output is the same
+// for any thread count.
+//
+// The surface separates samples below the iso value ("inside") from the rest. Normals, when requested, are
+// the normalized field gradient from central differences, pointing toward increasing values; triangles are
+// wound counter-clockwise around them. A signed distance field therefore gets outward normals.
+
+namespace avl
+{
+    struct ScalarField3D
+    {
+        int3 size;                                  // samples along each axis
+        float3 origin = float3(0, 0, 0);            // world position of sample (0, 0, 0)
+        float3 spacing = float3(1, 1, 1);           // world distance between neighbouring samples
+        std::function<void(int z, float * slice)> fill_slice;  // writes the size.x * size.y samples of slice z, x fastest
+    };
+
+    // Wraps a voxel array without copying it
+    inline ScalarField3D make_scalar_field(const VoxelArray<float> & voxels, const float3 & origin = float3(0, 0, 0), const float3 & spacing = float3(1, 1, 1))
+    {
+        ScalarField3D field;
+        field.size = voxels.get_size();
+        field.origin = origin;
+        field.spacing = spacing;
+        const VoxelArray<float> * src = &voxels;
+        field.fill_slice = [src](int z, float * slice)
+        {
+            const size_t n = size_t(src->get_size().x) * src->get_size().y;
+            std::copy(src->data() + n * z, src->data() + n * (z + 1), slice);
+        };
+        return field;
+    }
+
+    // Evaluates fn(world position) at every sample
+    inline ScalarField3D make_scalar_field(const int3 & size, const float3 & origin, const float3 & spacing, std::function<float(const float3 &)> fn)
+    {
+        ScalarField3D field;
+        field.size = size;
+        field.origin = origin;
+        field.spacing = spacing;
+        field.fill_slice = [size, origin, spacing, fn](int z, float * slice)
+        {
+            for (int y = 0; y < size.y; ++y)
+                for (int x = 0; x < size.x; ++x)
+                    *slice++ = fn(origin + spacing * float3(float(x), float(y), float(z)));
+        };
+        return field;
+    }
+
+    struct IsosurfaceParams
+    {
+        float isoValue = 0.0f;
+        bool computeNormals = true;
+        uint32_t slabCells = 8;     // cell layers per parallel task; changes vertex order, not the surface
+        uint32_t numThreads = 0;    // 0 = all hardware threads
+    };
+
+    namespace impl
+    {
+        // Triangulations of the 256 corner configurations, derived rather than transcribed. The crossing
+        // edges of each face are joined into segments that cut off runs of inside corners (on the two
+        // ambiguous face configurations this separates the inside corners, a choice both cells sharing the
+        // face agree on, so the surface stays closed). Chaining the segments gives closed polygons on the
+        // cube surface, which are fanned into triangles.
+        struct MarchingCubesTables
+        {
+            // Corner i sits at (i & 1, (i >> 1) & 1, i >> 2). Edge axis * 4 + k runs along `axis` from the
+            // corner whose other two coordinates are k's bits, in cyclic axis order.
+            uint8_t edgeCorners[12][2];
+            uint8_t triangleCount[256];
+            uint8_t triangles[256][36]; // edge ids, three per triangle
+
+            static int corner(int x, int y, int z) { return x | (y << 1) | (z << 2); }
+
+            int edge_between(int a, int b) const
+            {
+                for (int e = 0; e < 12; ++e)
+                    if ((edgeCorners[e][0] == a && edgeCorners[e][1] == b) || (edgeCorners[e][0] == b && edgeCorners[e][1] == a)) return e;
+                return -1;
+            }
+
+            MarchingCubesTables()
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        int c[3];
+                        c[axis] = 0;
+                        c[(axis + 1) % 3] = k & 1;
+                        c[(axis + 2) % 3] = k >> 1;
+                        edgeCorners[axis * 4 + k][0] = uint8_t(corner(c[0], c[1], c[2]));
+                        c[axis] = 1;
+                        edgeCorners[axis * 4 + k][1] = uint8_t(corner(c[0], c[1], c[2]));
+                    }
+                }
+
+                // Face corners counter-clockwise seen from outside the cube
+                int faces[6][4];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                    const int ccw[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+                    for (int side = 0; side < 2; ++side)
+                    {
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            const int * uv = ccw[side ? i : (4 - i) % 4];
+                            int c[3];
+                            c[axis] = side;
+                            c[u] = uv[0];
+                            c[v] = uv[1];
+                            faces[axis * 2 + side][i] = corner(c[0], c[1], c[2]);
+                        }
+                    }
+                }
+
+                for (int config = 0; config < 256; ++config)
+                {
+                    // next[entry edge] = exit edge of the segment crossing a face
+                    int next[12];
+                    for (int & n : next) n = -1;
+
+                    for (const auto & f : faces)
+                    {
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            const bool in = (config >> f[i]) & 1, prevIn = (config >> f[(i + 3) % 4]) & 1;
+                            if (!in || prevIn) continue;
+                            int j = i;
+                            while ((config >> f[(j + 1) % 4]) & 1) j = (j + 1) % 4;
+                            next[edge_between(f[(i + 3) % 4], f[i])] = edge_between(f[j], f[(j + 1) % 4]);
+                        }
+                    }
+
+                    int count = 0;
+                    bool visited[12] = {};
+                    for (int start = 0; start < 12; ++start)
+                    {
+                        if (next[start] < 0 || visited[start]) continue;
+                        std::vector<int> polygon;
+                        for (int e = start; !visited[e]; e = next[e])
+                        {
+                            visited[e] = true;
+                            polygon.push_back(e);
+                        }
+                        for (size_t i = 1; i + 1 < polygon.size(); ++i)
+                        {
+                            triangles[config][count * 3 + 0] = uint8_t(polygon[0]);
+                            triangles[config][count * 3 + 1] = uint8_t(polygon[i]);
+                            triangles[config][count * 3 + 2] = uint8_t(polygon[i + 1]);
+                            ++count;
+                        }
+                    }
+                    triangleCount[config] = uint8_t(count);
+                }
+            }
+        };
+
+        inline const MarchingCubesTables & marching_cubes_tables()
+        {
+            static const MarchingCubesTables tables;
+            return tables;
+        }
+
+        struct IsosurfaceSlab
+        {
+            std::vector<float3> positions, normals;
+            std::vector<uint3> faces;
+            std::vector<uint32_t> bottomEdges; // local vertex of each x and y edge on the first slice
+        };
+
+        static const uint32_t borrowedEdge = 0x80000000u; // marks an edge index on the next slab's first slice
+
+        class MarchingCubesSlab
+        {
+            const ScalarField3D & field;
+            const IsosurfaceParams & params;
+            const int nx, ny, nz;
+            const size_t sliceSize;
+            int firstSlice;                 // slice held at the start of `values`
+            std::vector<float> values;      // slices firstSlice onward
+            IsosurfaceSlab & out;
+
+            float at(int x, int y, int z) const { return values[(z - firstSlice) * sliceSize + size_t(y) * nx + x]; }
+
+            float3 gradient(int x, int y, int z) const
+            {
+                const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, nx - 1);
+                const int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, ny - 1);
+                const int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, nz - 1);
+                return float3((at(x1, y, z) - at(x0, y, z)) / (float(x1 - x0) * field.spacing.x),
+                              (at(x, y1, z) - at(x, y0, z)) / (float(y1 - y0) * field.spacing.y),
+                              (at(x, y, z1) - at(x, y, z0)) / (float(z1 - z0) * field.spacing.z));
+            }
+
+            // Adds the vertex on the edge from sample a to a + unit step along axis, if the surface crosses it
+            uint32_t edge_vertex(int x, int y, int z, int axis)
+            {
+                const int3 b(x + (axis == 0), y + (axis == 1), z + (axis == 2));
+                const float va = at(x, y, z), vb = at(b.x, b.y, b.z);
+                if ((va < params.isoValue) == (vb < params.isoValue)) return ~0u;
+
+                const float t = (params.isoValue - va) / (vb - va);
+                float3 g((float) x, (float) y, (float) z);
+                g[axis] += t;
+                out.positions.push_back(field.origin + field.spacing * g);
+                if (params.computeNormals)
+                {
+                    const float3 n = gradient(x, y, z) * (1.0f - t) + gradient(b.x, b.y, b.z) * t;
+                    const float len = length(n);
+                    out.normals.push_back(len > 0.0f ? n / len : float3(0, 1, 0));
+                }
+                return uint32_t(out.positions.size() - 1);
+            }
+
+            // Indices of the x edges, then the y edges, of slice z
+            void slice_edges(int z, bool borrowed, std::vector<uint32_t> & edges)
+            {
+                edges.assign(sliceSize * 2, ~0u);
+                for (int y = 0; y < ny; ++y)
+                {
+                    for (int x = 0; x < nx; ++x)
+                    {
+                        const size_t i = size_t(y) * nx + x;
+                        for (int axis = 0; axis < 2; ++axis)
+                        {
+                            if ((axis == 0 && x + 1 == nx) || (axis == 1 && y + 1 == ny)) continue;
+                            if (!borrowed) edges[axis * sliceSize + i] = edge_vertex(x, y, z, axis);
+                            else
+                            {
+                                const float va = at(x, y, z), vb = at(x + (axis == 0), y + (axis == 1), z);
+                                if ((va < params.isoValue) != (vb < params.isoValue)) edges[axis * sliceSize + i] = borrowedEdge | uint32_t(axis * sliceSize + i);
+                            }
+                        }
+                    }
+                }
+            }
+
+        public:
+
+            MarchingCubesSlab(const ScalarField3D & field, const IsosurfaceParams & params, IsosurfaceSlab & out)
+                : field(field), params(params), nx(field.size.x), ny(field.size.y), nz(field.size.z), sliceSize(size_t(field.size.x) * field.size.y), out(out) {}
+
+            void extract(int z0, int z1)
+            {
+                // Gradients reach one slice beyond the slab on either side
+                const int pad = params.computeNormals ? 1 : 0;
+                firstSlice = std::max(z0 - pad, 0);
+                const int lastSlice = std::min(z1 + pad, nz - 1);
+                values.resize(sliceSize * (lastSlice - firstSlice + 1));
+                for (int z = firstSlice; z <= lastSlice; ++z) field.fill_slice(z, values.data() + (z - firstSlice) * sliceSize);
+
+                const auto & tables = marching_cubes_tables();
+                std::vector<uint32_t> bottom, top, vertical(sliceSize);
+                slice_edges(z0, false, bottom);
+                out.bottomEdges = bottom;
+
+                for (int z = z0; z < z1; ++z)
+                {
+                    for (int y = 0; y < ny; ++y)
+                        for (int x = 0; x < nx; ++x) vertical[size_t(y) * nx + x] = edge_vertex(x, y, z, 2);
+
+                    slice_edges(z + 1, z + 1 == z1 && z1 != nz - 1, top);
+
+                    const std::vector<uint32_t> * slices[2] = { &bottom, &top };
+                    for (int y = 0; y + 1 < ny; ++y)
+                    {
+                        for (int x = 0; x + 1 < nx; ++x)
+                        {
+                            int config = 0;
+                            for (int c = 0; c < 8; ++c)
+                            {
+                                if (at(x + (c & 1), y + ((c >> 1) & 1), z + (c >> 2)) < params.isoValue) config |= 1 << c;
+                            }
+                            const int count = tables.triangleCount[config];
+                            if (!count) continue;
+
+                            uint32_t edges[12];
+                            for (int k = 0; k < 4; ++k)
+                            {
+                                // x edges: k = y + 2z, y edges: k = z + 2x, z edges: k = x + 2y
+                                edges[0 + k] = (*slices[k >> 1])[size_t(y + (k & 1)) * nx + x];
+                                edges[4 + k] = (*slices[k & 1])[sliceSize + size_t(y) * nx + x + (k >> 1)];
+                                edges[8 + k] = vertical[size_t(y + (k >> 1)) * nx + x + (k & 1)];
+                            }
+
+                            const uint8_t * tri = tables.triangles[config];
+                            for (int t = 0; t < count; ++t, tri += 3) out.faces.push_back(uint3(edges[tri[0]], edges[tri[1]], edges[tri[2]]));
+                        }
+                    }
+                    std::swap(bottom, top);
+                }
+            }
+        };
+    }
+
+    // Extracts the isosurface as an indexed, welded mesh; normals are filled if params.computeNormals is set
+    inline runtime_mesh marching_cubes(const ScalarField3D & field, const IsosurfaceParams & params = IsosurfaceParams())
+    {
+        runtime_mesh mesh;
+        const int nz = field.size.z;
+        if (field.size.x < 2 || field.size.y < 2 || nz < 2) return mesh;
+
+        const int slabCells = int(std::max(1u, params.slabCells));
+        const int numSlabs = (nz - 1 + slabCells - 1) / slabCells;
+        std::vector<impl::IsosurfaceSlab> slabs(numSlabs);
+
+        parallel_for(0, numSlabs, [&](size_t s)
+        {
+            const int z0 = int(s) * slabCells;
+            impl::MarchingCubesSlab(field, params, slabs[s]).extract(z0, std::min(z0 + slabCells, nz - 1));
+        }, params.numThreads);
+
+        std::vector<uint32_t> vertexOffset(numSlabs + 1, 0), faceOffset(numSlabs + 1, 0);
+        for (int s = 0; s < numSlabs; ++s)
+        {
+            vertexOffset[s + 1] = vertexOffset[s] + uint32_t(slabs[s].positions.size());
+            faceOffset[s + 1] = faceOffset[s] + uint32_t(slabs[s].faces.size());
+        }
+
+        mesh.vertices.resize(vertexOffset[numSlabs]);
+        if (params.computeNormals) mesh.normals.resize(vertexOffset[numSlabs]);
+        mesh.faces.resize(faceOffset[numSlabs]);
+
+        parallel_for(0, numSlabs, [&](size_t s)
+        {
+            const auto & slab = slabs[s];
+            std::copy(slab.positions.begin(), slab.positions.end(), mesh.vertices.begin() + vertexOffset[s]);
+            if (params.computeNormals) std::copy(slab.normals.begin(), slab.normals.end(), mesh.normals.begin() + vertexOffset[s]);
+
+            const uint32_t base = vertexOffset[s];
+            auto resolve = [&](uint32_t i) { return (i & impl::borrowedEdge) ? vertexOffset[s + 1] + slabs[s + 1].bottomEdges[i & ~impl::borrowedEdge] : base + i; };
+            uint3 * dst = mesh.faces.data() + faceOffset[s];
+            for (const auto & f : slab.faces) *dst++ = uint3(resolve(f.x), resolve(f.y), resolve(f.z));
+        }, params.numThreads);
+
+        return mesh;
+    }
+
+    inline runtime_mesh marching_cubes(const VoxelArray<float> & voxels, const IsosurfaceParams & params = IsosurfaceParams(), const float3 & origin = float3(0, 0, 0), const float3 & spacing = float3(1, 1, 1))
+    {
+        return marching_cubes(make_scalar_field(voxels, origin, spacing), params);
+    }
+}
+
+#endif // end isosurface_hpp
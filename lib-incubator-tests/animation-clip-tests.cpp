@@ -0,0 +1,232 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "animation_clip.hpp"
+#include "parallel_for.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <iostream>
+#include <random>
+
+using namespace avl;
+
+// Bones swing around their own axes; a third of them also slide linearly, a third bob, and a few scale.
+// One in five bones is static, which reduction collapses to single keys.
+static skeletal_animation make_test_animation(uint32_t boneCount, uint32_t frames, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    skeletal_animation a;
+    a.name = "test";
+    a.startFrame = 10;
+    a.endFrame = 10 + frames - 1;
+    for (uint32_t b = 0; b < boneCount; ++b)
+    {
+        auto track = std::make_shared<animation_track>();
+        track->boneIndex = b;
+        const float3 axis = normalize(float3(dist(rng), dist(rng), dist(rng)));
+        const float speed = 0.05f + 0.1f * std::abs(dist(rng)), amplitude = 0.5f + dist(rng) * 0.4f;
+        const float3 offset(dist(rng), dist(rng), dist(rng)), velocity(dist(rng) * 0.01f, 0, dist(rng) * 0.01f);
+        const bool still = (b % 5) == 4;
+
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            auto k = std::make_shared<animation_keyframe>();
+            k->key = a.startFrame + f;
+            k->rotation = still ? float4(0, 0, 0, 1) : rotation_quat(axis, amplitude * std::sin(f * speed));
+            if (!still && (b % 3) == 0) k->translation = offset + velocity * float(f);
+            else if (!still && (b % 3) == 1) k->translation = offset + float3(0, 0.1f * std::sin(f * speed * 2.0f), 0);
+            else k->translation = offset;
+            if (!still && (b % 7) == 0) k->scale = float3(1.0f + 0.2f * std::sin(f * speed));
+            track->keyframes.push_back(k);
+        }
+        track->keyframeCount = uint32_t(track->keyframes.size());
+        a.tracks.push_back(track);
+    }
+    a.trackCount = uint32_t(a.tracks.size());
+    return a;
+}
+
+// What sampling the imported structure directly looks like: a search through keyframe pointers per track
+static void sample_reference(const skeletal_animation & a, float fps, float time, AnimationPose & pose)
+{
+    pose.resize(a.tracks.size());
+    const float frame = a.startFrame + clamp(time, 0.0f, a.total_time(fps)) * fps;
+    for (const auto & track : a.tracks)
+    {
+        const auto & keys = track->keyframes;
+        auto next = std::upper_bound(keys.begin(), keys.end(), frame, [](float f, const std::shared_ptr<animation_keyframe> & k) { return f < float(k->key); });
+        const auto & k0 = *(next == keys.begin() ? next : next - 1);
+        const auto & k1 = (next == keys.end()) ? k0 : *next;
+
+        const float t0 = float(k0->key - a.startFrame) / fps, t1 = float(k1->key - a.startFrame) / fps;
+        const float alpha = (k0 == k1) ? 0.0f : clamp((time - t0) / (t1 - t0), 0.0f, 1.0f);
+        pose.rotations[track->boneIndex] = qnlerp(k0->rotation, k1->rotation, alpha);
+        pose.translations[track->boneIndex] = lerp(k0->translation, k1->translation, alpha);
+        pose.scales[track->boneIndex] = lerp(k0->scale, k1->scale, alpha);
+    }
+}
+
+static float rotation_angle(const float4 & a, const float4 & b)
+{
+    const float4 d = qmul(qconj(a), b);
+    return 2.0f * std::atan2(length(d.xyz()), std::abs(d.w));
+}
+
+static float max_rotation_error(const AnimationPose & a, const AnimationPose & b)
+{
+    float e = 0;
+    for (size_t i = 0; i < a.rotations.size(); ++i) e = std::max(e, rotation_angle(a.rotations[i], b.rotations[i]));
+    return e;
+}
+
+static float max_distance(const std::vector<float3> & a, const std::vector<float3> & b)
+{
+    float e = 0;
+    for (size_t i = 0; i < a.size(); ++i) e = std::max(e, length(a[i] - b[i]));
+    return e;
+}
+
+TEST_CASE("quantized rotations round trip within a fraction of a milliradian")
+{
+    std::mt19937 rng(5);
+    std::normal_distribution<float> dist;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const float4 q = normalize(float4(dist(rng), dist(rng), dist(rng), dist(rng)));
+        const float4 r = dequantize_rotation(quantize_rotation(q)), s = dequantize_rotation(quantize_rotation(-q));
+        REQUIRE(rotation_angle(q, r) < 2e-4f);
+        REQUIRE(std::memcmp(&r, &s, sizeof(r)) == 0);
+    }
+    const float4 identity = dequantize_rotation(quantize_rotation(float4(0, 0, 0, 1)));
+    REQUIRE(identity.w == 1.0f);
+}
+
+TEST_CASE("animation clip without reduction samples like the keyframes")
+{
+    const float fps = 30.0f;
+    const skeletal_animation a = make_test_animation(20, 90, 1);
+
+    AnimationClipParams params;
+    params.framesPerSecond = fps;
+    params.quantizeRotations = false;
+    params.reduceKeys = false;
+    const AnimationClip clip = make_animation_clip(a, 0, params);
+    REQUIRE(clip.boneCount == 20);
+    REQUIRE(clip.key_count() == 20 * 90 * 3);
+    REQUIRE(clip.duration == Approx(89 / fps));
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> dist(-0.5f, clip.duration + 0.5f);
+    AnimationCursor cursor;
+    AnimationPose sampled, reference;
+    for (int i = 0; i < 500; ++i)
+    {
+        const float t = (i % 4 == 0) ? (i % 90) / fps : dist(rng); // on keys and between them
+        sample_animation_clip(clip, t, cursor, sampled);
+        sample_reference(a, fps, t, reference);
+        REQUIRE(max_rotation_error(sampled, reference) < 1e-3f);
+        REQUIRE(max_distance(sampled.translations, reference.translations) < 1e-5f);
+        REQUIRE(max_distance(sampled.scales, reference.scales) < 1e-5f);
+    }
+}
+
+TEST_CASE("reduced and quantized animation clip stays within its tolerances")
+{
+    const float fps = 30.0f;
+    const skeletal_animation a = make_test_animation(50, 300, 3);
+
+    AnimationClipParams params;
+    params.framesPerSecond = fps;
+    const AnimationClip clip = make_animation_clip(a, 0, params);
+
+    AnimationClipParams exactParams = params;
+    exactParams.quantizeRotations = exactParams.reduceKeys = false;
+    const AnimationClip exact = make_animation_clip(a, 0, exactParams);
+
+    // Static bones keep one key per channel; linear slides keep their ends
+    REQUIRE(clip.rotationChannels[4].keyCount == 1);
+    REQUIRE(clip.translationChannels[4].keyCount == 1);
+    REQUIRE(clip.translationChannels[3].keyCount == 2);
+    REQUIRE(clip.scaleChannels[1].keyCount == 1);
+    REQUIRE(clip.key_count() < exact.key_count() / 3);
+    REQUIRE(clip.size_bytes() < exact.size_bytes() / 4);
+    std::cout << "keys: " << exact.key_count() << " to " << clip.key_count() << ", bytes: " << exact.size_bytes() << " to " << clip.size_bytes() << std::endl;
+
+    AnimationCursor cursor;
+    AnimationPose sampled, reference;
+    for (uint32_t f = 0; f < 300; ++f)
+    {
+        sample_animation_clip(clip, f / fps, cursor, sampled);
+        sample_reference(a, fps, f / fps, reference);
+        REQUIRE(max_rotation_error(sampled, reference) < params.rotationTolerance + 2e-4f);
+        REQUIRE(max_distance(sampled.translations, reference.translations) < params.translationTolerance + 1e-5f);
+        REQUIRE(max_distance(sampled.scales, reference.scales) < params.scaleTolerance + 1e-5f);
+    }
+}
+
+TEST_CASE("animation cursors sample like a fresh search after playback, loops and seeks")
+{
+    const AnimationClip clip = make_animation_clip(make_test_animation(30, 120, 4));
+
+    std::mt19937 rng(6);
+    std::uniform_real_distribution<float> seek(0.0f, clip.duration);
+    AnimationCursor cursor;
+    AnimationPose played, searched;
+    float t = 0;
+    for (int frame = 0; frame < 2000; ++frame)
+    {
+        if (frame % 97 == 0) t = seek(rng);                 // scrubbing
+        else t = std::fmod(t + 1.0f / 60.0f, clip.duration); // looping playback
+
+        AnimationCursor fresh;
+        sample_animation_clip(clip, t, cursor, played);
+        sample_animation_clip(clip, t, fresh, searched);
+        REQUIRE(std::memcmp(played.rotations.data(), searched.rotations.data(), played.rotations.size() * sizeof(float4)) == 0);
+        REQUIRE(std::memcmp(played.translations.data(), searched.translations.data(), played.translations.size() * sizeof(float3)) == 0);
+        REQUIRE(cursor.keys == fresh.keys);
+    }
+}
+
+TEST_CASE("animation clip sampling benchmark", "[.][benchmark]")
+{
+    // 1000 skeletons of 100 bones playing one 10 second clip at different phases
+    const float fps = 30.0f;
+    const uint32_t instances = 1000, bones = 100, frames = 60;
+    const skeletal_animation a = make_test_animation(bones, 300, 9);
+
+    AnimationClipParams params;
+    params.framesPerSecond = fps;
+    const AnimationClip clip = make_animation_clip(a, 0, params);
+    AnimationClipParams exactParams = params;
+    exactParams.quantizeRotations = exactParams.reduceKeys = false;
+    const AnimationClip exact = make_animation_clip(a, 0, exactParams);
+    std::cout << "keyframe structs: " << 300 * bones * (sizeof(animation_keyframe) + sizeof(std::shared_ptr<animation_keyframe>)) << " bytes plus a heap block each; exact clip "
+        << exact.size_bytes() << " bytes; reduced and quantized " << clip.size_bytes() << " bytes" << std::endl;
+
+    std::vector<float> phase(instances);
+    for (uint32_t i = 0; i < instances; ++i) phase[i] = std::fmod(i * 0.7919f, clip.duration);
+    std::vector<AnimationPose> poses(instances);
+    std::vector<AnimationCursor> cursors(instances);
+
+    auto time = [&](const char * name, std::function<void(uint32_t, float)> sample, uint32_t threads)
+    {
+        SimpleTimer t;
+        t.start();
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            parallel_for(0, instances, [&](size_t i) { sample(uint32_t(i), std::fmod(phase[i] + f / 60.0f, clip.duration)); }, threads, 16);
+        }
+        std::cout << name << ": " << t.microseconds().count() / (1000.0 * frames) << " ms per frame" << std::endl;
+    };
+
+    time("keyframe pointers, searched", [&](uint32_t i, float t) { sample_reference(a, fps, t, poses[i]); }, 1);
+    time("exact clip, searched", [&](uint32_t i, float t) { std::fill(cursors[i].keys.begin(), cursors[i].keys.end(), 0u); sample_animation_clip(exact, t, cursors[i], poses[i]); }, 1);
+    time("exact clip, cursors", [&](uint32_t i, float t) { sample_animation_clip(exact, t, cursors[i], poses[i]); }, 1);
+    for (auto & c : cursors) c.keys.clear();
+    time("reduced and quantized clip, cursors", [&](uint32_t i, float t) { sample_animation_clip(clip, t, cursors[i], poses[i]); }, 1);
+    time("reduced and quantized clip, cursors, all threads", [&](uint32_t i, float t) { sample_animation_clip(clip, t, cursors[i], poses[i]); }, 0);
+    REQUIRE(poses[0].rotations.size() == bones);
+}
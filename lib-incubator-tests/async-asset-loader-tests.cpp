@@ -0,0 +1,160 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "async_asset_loader.hpp"
+#include "asset_io.hpp"
+#include "simple_timer.hpp"
+#include "third_party/stb/stb_image_write.h"
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+using namespace avl;
+
+// A smooth gradient with some grain, so it compresses like a photo rather than like noise or a flat fill
+static std::vector<uint8_t> make_test_pixels(int width, int height, int channels, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> grain(0, 15);
+    std::vector<uint8_t> pixels(size_t(width) * height * channels);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                pixels[(size_t(y) * width + x) * channels + c] = uint8_t((x * (c + 1) + y * (3 - c) + seed * 37) / 8 + grain(rng));
+            }
+        }
+    }
+    return pixels;
+}
+
+static std::string write_test_png(const std::string & path, const std::vector<uint8_t> & pixels, int width, int height, int channels)
+{
+    REQUIRE(stbi_write_png(path.c_str(), width, height, channels, pixels.data(), width * channels) != 0);
+    return path;
+}
+
+TEST_CASE("decode_image reads pixels and flips rows without the global stb flag")
+{
+    const int width = 37, height = 23;
+    const std::vector<uint8_t> pixels = make_test_pixels(width, height, 3, 1);
+    const std::string path = write_test_png("./async-asset-loader-test.png", pixels, width, height, 3);
+    const std::vector<uint8_t> file = read_file_binary(path);
+
+    const DecodedImage image = decode_image(file);
+    REQUIRE(image.width == width);
+    REQUIRE(image.height == height);
+    REQUIRE(image.channels == 3);
+    REQUIRE(image.pixels == pixels);
+    REQUIRE(load_image_data(path) == pixels);
+
+    const DecodedImage flipped = decode_image(file, true);
+    for (int y = 0; y < height; ++y)
+    {
+        REQUIRE(std::memcmp(flipped.pixels.data() + y * width * 3, pixels.data() + (height - 1 - y) * width * 3, width * 3) == 0);
+    }
+
+    const std::vector<uint8_t> garbage(64, 0x5a);
+    REQUIRE_THROWS(decode_image(garbage));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("async asset loader decodes on workers and uploads only when asked")
+{
+    AsyncAssetLoader loader(3);
+    REQUIRE(loader.worker_count() == 3);
+
+    const std::thread::id mainThread = std::this_thread::get_id();
+    std::atomic<int> decodedOnMain(0);
+    std::vector<int> uploaded, failed;
+    std::vector<std::string> errors;
+
+    for (int i = 0; i < 20; ++i)
+    {
+        loader.submit([&, i]() -> AsyncAssetLoader::UploadFunction
+        {
+            if (std::this_thread::get_id() == mainThread) ++decodedOnMain;
+            if (i % 7 == 3) throw std::runtime_error("bad file " + std::to_string(i));
+            return [&, i]() { REQUIRE(std::this_thread::get_id() == mainThread); uploaded.push_back(i); };
+        }, [&, i](const std::string & error) { failed.push_back(i); errors.push_back(error); });
+    }
+    REQUIRE(uploaded.empty());
+
+    loader.finish();
+    REQUIRE(decodedOnMain == 0);
+    REQUIRE(loader.pending_count() == 0);
+    REQUIRE(uploaded.size() == 17);
+    REQUIRE(failed.size() == 3);
+    REQUIRE(errors[0].find("bad file") == 0);
+    REQUIRE(loader.process_uploads(1.0) == 0);
+}
+
+TEST_CASE("async asset loader spreads uploads over frames within a budget")
+{
+    AsyncAssetLoader loader(2);
+    const int count = 12;
+    int uploaded = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        loader.submit([&]() -> AsyncAssetLoader::UploadFunction
+        {
+            return [&]() { std::this_thread::sleep_for(std::chrono::milliseconds(4)); ++uploaded; };
+        });
+    }
+    while (loader.ready_count() < count) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Each upload overruns a 1 ms budget by itself, so every frame does exactly one; a 10 ms budget fits a few
+    int frames = 0;
+    while (loader.pending_count() > 0)
+    {
+        const size_t done = loader.process_uploads(frames < 4 ? 1.0 : 10.0);
+        if (frames < 4) REQUIRE(done <= 1);
+        else REQUIRE(done <= 3);
+        ++frames;
+    }
+    REQUIRE(uploaded == count);
+    REQUIRE(frames >= 4 + (count - 4) / 3);
+}
+
+TEST_CASE("async asset loader decode benchmark", "[.][benchmark]")
+{
+    // A preload manifest of 2k textures, decoded without a GL context
+    const int size = 1024, count = 16;
+    std::vector<std::vector<uint8_t>> files;
+    for (int i = 0; i < count; ++i)
+    {
+        const std::string path = "./async-asset-loader-bench-" + std::to_string(i) + ".png";
+        write_test_png(path, make_test_pixels(size, size, 4, i), size, size, 4);
+        files.push_back(read_file_binary(path));
+        std::remove(path.c_str());
+    }
+    std::cout << count << " textures of " << size << "x" << size << ", " << files[0].size() / 1024 << " kb each" << std::endl;
+
+    std::vector<DecodedImage> images(count);
+    SimpleTimer t;
+    t.start();
+    for (int i = 0; i < count; ++i) images[i] = decode_image(files[i]);
+    const double serial = t.microseconds().count() / 1000.0;
+    std::cout << "decode on the calling thread: " << serial << " ms" << std::endl;
+
+    AsyncAssetLoader loader;
+    std::vector<DecodedImage> loaded(count);
+    t.start();
+    for (int i = 0; i < count; ++i)
+    {
+        loader.submit([&, i]() -> AsyncAssetLoader::UploadFunction
+        {
+            auto image = std::make_shared<DecodedImage>(decode_image(files[i]));
+            return [&, i, image]() { loaded[i] = std::move(*image); };
+        });
+    }
+    loader.finish();
+    const double parallel = t.microseconds().count() / 1000.0;
+    std::cout << "decode on " << loader.worker_count() << " workers: " << parallel << " ms (" << serial / parallel << "x)" << std::endl;
+    for (int i = 0; i < count; ++i) REQUIRE(loaded[i].pixels == images[i].pixels);
+}
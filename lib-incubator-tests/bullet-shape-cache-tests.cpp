@@ -0,0 +1,234 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "bullet_shape_cache.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+using namespace avl;
+
+static void remove_directory(const std::string & path)
+{
+#if defined(_WIN32)
+    _rmdir(path.c_str());
+#else
+    rmdir(path.c_str());
+#endif
+}
+
+struct RayHit
+{
+    bool hit = false;
+    float fraction = 1;
+    float3 normal;
+};
+
+// Casts rays from a sphere around the origin towards points near it, as a world query would
+static std::vector<RayHit> cast_rays(const BulletShapeVR & shape, uint32_t count, uint32_t seed)
+{
+    btCollisionObject object;
+    object.setCollisionShape(shape.get());
+    object.setWorldTransform(btTransform::getIdentity());
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist;
+    std::vector<RayHit> hits;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float3 from = normalize(float3(dist(rng), dist(rng), dist(rng))) * 4.0f, to = float3(dist(rng), dist(rng), dist(rng)) * 0.2f;
+        btCollisionWorld::ClosestRayResultCallback callback(to_bt(from), to_bt(to));
+        btTransform fromXform(btQuaternion::getIdentity(), to_bt(from)), toXform(btQuaternion::getIdentity(), to_bt(to));
+        btCollisionWorld::rayTestSingle(fromXform, toXform, &object, shape.get(), object.getWorldTransform(), callback);
+
+        RayHit h;
+        h.hit = callback.hasHit();
+        h.fraction = callback.m_closestHitFraction;
+        h.normal = from_bt(callback.m_hitNormalWorld);
+        hits.push_back(h);
+    }
+    return hits;
+}
+
+static void require_same_hits(const std::vector<RayHit> & a, const std::vector<RayHit> & b)
+{
+    REQUIRE(a.size() == b.size());
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        REQUIRE(a[i].hit == b[i].hit);
+        if (!a[i].hit) continue;
+        REQUIRE(a[i].fraction == b[i].fraction);
+        REQUIRE(a[i].normal == b[i].normal);
+    }
+}
+
+TEST_CASE("bullet shape cache reuses a baked triangle mesh bvh")
+{
+    const std::string directory = "./bullet-shape-cache-test";
+    const Geometry mesh = make_supershape_3d(64, 5, 7, 4, 12);
+
+    std::string path;
+    std::vector<RayHit> baked;
+    {
+        BulletShapeCacheVR cache(directory, 1);
+        const BulletShapeHandle first = cache.bake(mesh);
+        REQUIRE_FALSE(first->fromCache);
+        REQUIRE(first->get()->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE);
+        path = cache.shape_path(first->key);
+        REQUIRE(std::ifstream(path).good());
+
+        baked = cast_rays(*first, 2000, 1);
+        size_t hitCount = 0;
+        for (auto & h : baked) hitCount += h.hit;
+        REQUIRE(hitCount > 1900); // the rays end well inside the shape
+
+        // Already on disk: the second bake is a load
+        const BulletShapeHandle second = cache.bake(mesh);
+        REQUIRE(second->fromCache);
+        REQUIRE(second->key == first->key);
+        REQUIRE(cache.hit_count() == 1);
+        REQUIRE(cache.miss_count() == 1);
+    }
+
+    // The file outlives the cache object, and the loaded tree answers queries exactly as the built one
+    {
+        BulletShapeCacheVR cache(directory, 1);
+        const BulletShapeHandle loaded = cache.bake(mesh);
+        REQUIRE(loaded->fromCache);
+        require_same_hits(cast_rays(*loaded, 2000, 1), baked);
+
+        // Other parameters or other geometry are other keys
+        BulletShapeParams params;
+        params.quantizeBvh = false;
+        const BulletShapeHandle unquantized = cache.bake(mesh, params);
+        REQUIRE_FALSE(unquantized->fromCache);
+        REQUIRE(unquantized->key != loaded->key);
+        std::remove(cache.shape_path(unquantized->key).c_str());
+
+        Geometry moved = mesh;
+        moved.vertices[0].x += 0.001f;
+        REQUIRE(bullet_shape_impl::hash_geometry(moved, BulletShapeParams()) != loaded->key);
+
+        // A damaged file is rebaked
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(-5, std::ios::end);
+            file.put(0x5a);
+        }
+        const BulletShapeHandle rebaked = cache.bake(mesh);
+        REQUIRE_FALSE(rebaked->fromCache);
+        require_same_hits(cast_rays(*rebaked, 2000, 1), baked);
+        REQUIRE(cache.bake(mesh)->fromCache);
+    }
+
+    std::remove(path.c_str());
+    remove_directory(directory);
+}
+
+TEST_CASE("bullet shape cache reduces and stores convex hulls")
+{
+    const std::string directory = "./bullet-shape-cache-test-hull";
+    const Geometry mesh = make_supershape_3d(48, 3, 7, 4, 12);
+
+    BulletShapeParams params;
+    params.type = BulletShapeType::ConvexHull;
+
+    BulletShapeCacheVR cache(directory, 1);
+    const BulletShapeHandle hull = cache.bake(mesh, params);
+    REQUIRE_FALSE(hull->fromCache);
+    REQUIRE(hull->get()->getShapeType() == CONVEX_HULL_SHAPE_PROXYTYPE);
+    REQUIRE(hull->vertices.size() <= 42);
+    REQUIRE(hull->vertices.size() >= 4);
+
+    // Hull points are points of the mesh
+    for (auto & p : hull->vertices)
+    {
+        float closest = std::numeric_limits<float>::max();
+        for (auto & v : mesh.vertices) closest = std::min(closest, length(p - v));
+        REQUIRE(closest < 1e-5f);
+    }
+
+    const BulletShapeHandle loaded = cache.bake(mesh, params);
+    REQUIRE(loaded->fromCache);
+    REQUIRE(loaded->vertices == hull->vertices);
+    REQUIRE(loaded->get()->getMargin() == params.margin);
+    require_same_hits(cast_rays(*loaded, 500, 2), cast_rays(*hull, 500, 2));
+
+    std::remove(cache.shape_path(hull->key).c_str());
+    remove_directory(directory);
+}
+
+TEST_CASE("bullet shape cache bakes on worker threads")
+{
+    const std::string directory = "./bullet-shape-cache-test-async";
+    std::vector<Geometry> meshes;
+    for (int i = 0; i < 4; ++i) meshes.push_back(make_supershape_3d(32 + 8 * i, 3.0f + i, 7, 4, 12));
+
+    BulletShapeCacheVR cache(directory, 2);
+    std::vector<std::shared_future<BulletShapeHandle>> pending;
+    for (auto & m : meshes) pending.push_back(cache.request(m));
+
+    // A shape already in flight is shared, not baked twice
+    auto duplicate = cache.request(meshes[0]);
+    auto empty = cache.request(Geometry());
+
+    std::vector<uint64_t> keys;
+    for (auto & p : pending)
+    {
+        const BulletShapeHandle shape = p.get();
+        REQUIRE(shape);
+        REQUIRE(shape->get());
+        keys.push_back(shape->key);
+    }
+    REQUIRE(duplicate.get()->key == keys[0]);
+    REQUIRE_THROWS(empty.get());
+    REQUIRE(cache.miss_count() == meshes.size());
+
+    for (auto & m : meshes) REQUIRE(cache.request(m).get()->fromCache);
+
+    for (auto k : keys) std::remove(cache.shape_path(k).c_str());
+    remove_directory(directory);
+}
+
+TEST_CASE("bullet shape cache benchmark", "[.][benchmark]")
+{
+    // About 700k triangles of static level geometry
+    const std::string directory = "./bullet-shape-cache-bench";
+    const Geometry mesh = make_supershape_3d(600, 5, 7, 4, 12);
+    std::cout << mesh.faces.size() << " triangles" << std::endl;
+
+    auto time = [](const char * name, std::function<BulletShapeHandle()> fn)
+    {
+        SimpleTimer t;
+        t.start();
+        const BulletShapeHandle shape = fn();
+        std::cout << name << ": " << t.microseconds().count() / 1000.0 << " ms" << std::endl;
+        REQUIRE(shape->get());
+        return shape;
+    };
+
+    BulletShapeCacheVR cache(directory);
+    time("build bvh", [&]() { return make_bullet_shape(mesh); });
+    const BulletShapeHandle baked = time("build and store bvh", [&]() { return cache.bake(mesh); });
+    const BulletShapeHandle loaded = time("load bvh", [&]() { return cache.bake(mesh); });
+    REQUIRE(loaded->fromCache);
+    std::cout << "bvh file: " << loaded->bvhBufferSize / 1024 << " kb" << std::endl;
+
+    BulletShapeParams hullParams;
+    hullParams.type = BulletShapeType::ConvexHull;
+    const BulletShapeHandle hull = time("build and store hull", [&]() { return cache.bake(mesh, hullParams); });
+    time("load hull", [&]() { return cache.bake(mesh, hullParams); });
+
+    std::remove(cache.shape_path(baked->key).c_str());
+    std::remove(cache.shape_path(hull->key).c_str());
+    remove_directory(directory);
+}
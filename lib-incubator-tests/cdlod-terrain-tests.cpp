@@ -0,0 +1,259 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "cdlod_terrain.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+using namespace avl;
+
+static CdlodSettings test_settings()
+{
+    CdlodSettings s;
+    s.origin = float2(-4096, -4096);
+    s.leafSize = 64.0f;
+    s.levels = 8;
+    s.minHeight = -10.0f;
+    s.maxHeight = 40.0f;
+    return s;
+}
+
+// Rasterizes selected chunks into a grid of cells half a leaf wide, recording each cell's level
+static std::vector<int> rasterize_levels(const CdlodQuadtree & tree, const std::vector<CdlodChunk> & chunks, uint32_t & cellsPerEdge, int & overlaps)
+{
+    const auto & s = tree.get_settings();
+    const float cell = s.leafSize * 0.5f;
+    cellsPerEdge = 2u << (s.levels - 1);
+    std::vector<int> levels(cellsPerEdge * cellsPerEdge, -1);
+    overlaps = 0;
+
+    for (const auto & c : chunks)
+    {
+        const uint32_t x0 = uint32_t((c.origin.x - s.origin.x) / cell + 0.5f), z0 = uint32_t((c.origin.y - s.origin.y) / cell + 0.5f);
+        const uint32_t n = uint32_t(c.size / cell + 0.5f);
+        for (uint32_t z = z0; z < z0 + n; ++z)
+            for (uint32_t x = x0; x < x0 + n; ++x)
+            {
+                if (levels[z * cellsPerEdge + x] >= 0) ++overlaps;
+                levels[z * cellsPerEdge + x] = int(c.node.level);
+            }
+    }
+    return levels;
+}
+
+TEST_CASE("cdlod selection covers the terrain once with neighbouring levels differing by at most one")
+{
+    const CdlodQuadtree tree(test_settings());
+
+    for (float3 camera : { float3(0, 20, 0), float3(-4000, 5, 3000), float3(1234, 300, -777), float3(0, 3000, 0) })
+    {
+        std::vector<CdlodChunk> chunks;
+        tree.select(camera, nullptr, chunks);
+        REQUIRE(!chunks.empty());
+
+        float area = 0.0f;
+        for (const auto & c : chunks) area += c.size * c.size;
+        const float root = tree.node_size(tree.root().level);
+        REQUIRE(area == Approx(root * root));
+
+        uint32_t edge;
+        int overlaps;
+        const auto levels = rasterize_levels(tree, chunks, edge, overlaps);
+        REQUIRE(overlaps == 0);
+        REQUIRE(std::count(levels.begin(), levels.end(), -1) == 0);
+
+        for (uint32_t z = 0; z < edge; ++z)
+            for (uint32_t x = 0; x < edge; ++x)
+            {
+                const int l = levels[z * edge + x];
+                if (x + 1 < edge) REQUIRE(std::abs(l - levels[z * edge + x + 1]) <= 1);
+                if (z + 1 < edge) REQUIRE(std::abs(l - levels[(z + 1) * edge + x]) <= 1);
+            }
+
+        // The chunk under the camera is at the finest level the camera height allows
+        const float2 c2(camera.x, camera.z);
+        for (const auto & c : chunks)
+        {
+            if (c2.x < c.origin.x || c2.y < c.origin.y || c2.x >= c.origin.x + c.size || c2.y >= c.origin.y + c.size) continue;
+            if (camera.y < tree.range(0)) REQUIRE(c.node.level == 0);
+        }
+    }
+}
+
+TEST_CASE("cdlod morphing reaches the parent grid at the end of each level's range")
+{
+    const CdlodQuadtree tree(test_settings());
+    const uint32_t n = tree.get_settings().gridResolution;
+
+    for (uint32_t level = 0; level < 4; ++level)
+    {
+        const float2 m = tree.morph_range(level);
+        REQUIRE(m.y == tree.range(level));
+        REQUIRE(m.x < m.y);
+        if (level) REQUIRE(m.x > tree.range(level - 1));
+
+        for (uint32_t j = 0; j <= n; ++j)
+            for (uint32_t i = 0; i <= n; ++i)
+            {
+                const float2 g((float) i, (float) j);
+                REQUIRE(tree.morph_vertex(g, level, m.x) == g);
+
+                // Fully morphed vertices coincide with vertices of a grid with half the resolution
+                const float2 morphed = tree.morph_vertex(g, level, m.y + 1.0f);
+                REQUIRE(std::fmod(morphed.x, 2.0f) == 0.0f);
+                REQUIRE(std::fmod(morphed.y, 2.0f) == 0.0f);
+                REQUIRE(std::abs(morphed.x - g.x) <= 1.0f);
+            }
+    }
+}
+
+TEST_CASE("cdlod selection culls nodes outside the frustum")
+{
+    const CdlodQuadtree tree(test_settings());
+    const float3 eye(0, 50, 0);
+    const Pose pose = look_at_pose_rh(eye, float3(1000, 0, 0));
+    const Frustum frustum(mul(make_projection_matrix(1.0f, 1.0f, 0.1f, 10000.0f), pose.view_matrix()));
+
+    std::vector<CdlodChunk> all, culled;
+    tree.select(eye, nullptr, all);
+    tree.select(eye, &frustum, culled);
+    REQUIRE(!culled.empty());
+    REQUIRE(culled.size() < all.size());
+
+    // Culling only drops chunks, and it drops every node behind the camera
+    for (const auto & c : culled)
+    {
+        REQUIRE(tree.node_bounds(c.node).max().x > -100.0f);
+        REQUIRE(std::find_if(all.begin(), all.end(), [&](const CdlodChunk & a) { return a.node == c.node && a.quadrant == c.quadrant; }) != all.end());
+    }
+}
+
+TEST_CASE("cdlod tile cache is bounded and evicts the least recently used tile")
+{
+    std::atomic<int> generated(0);
+    CdlodTileCache cache(3, [&](const CdlodNode & n, CdlodTile & t)
+    {
+        t.resolution = 2;
+        t.heights.assign(4, float(n.x));
+        ++generated;
+    }, 2);
+
+    const CdlodNode a = { 0, 1, 0 }, b = { 0, 2, 0 }, c = { 0, 3, 0 }, d = { 0, 4, 0 };
+    cache.begin_frame();
+    REQUIRE(cache.request(a) == -1);
+    REQUIRE(cache.request(b) == -1);
+    REQUIRE(cache.request(c) == -1);
+    REQUIRE(cache.request(d) == -1); // every slot is pending or requested this frame
+    cache.wait_idle();
+    REQUIRE(generated == 3);
+    REQUIRE(cache.resident_count() == 3);
+    REQUIRE(cache.pending_count() == 0);
+
+    const auto done = cache.take_completed();
+    REQUIRE(done.size() == 3);
+    for (const auto & u : done) REQUIRE(u.second->heights[0] == float(u.second->node.x));
+    REQUIRE(cache.take_completed().empty());
+
+    // a is used in the frame before d arrives; b is now the oldest
+    cache.begin_frame();
+    const int slotA = cache.request(a), slotB = cache.find(b);
+    REQUIRE(slotA >= 0);
+    cache.begin_frame();
+    REQUIRE(cache.request(c) >= 0);
+    REQUIRE(cache.request(d) == -1);
+    cache.wait_idle();
+    REQUIRE(cache.find(b) == -1);
+    REQUIRE(cache.find(a) == slotA);
+    REQUIRE(cache.find(d) == slotB);
+    REQUIRE(cache.resident_count() == 3);
+    REQUIRE(generated == 4);
+
+    // a is the oldest, but touching it (as a fallback ancestor) keeps it resident
+    cache.begin_frame();
+    REQUIRE(cache.touch(a) == slotA);
+    REQUIRE(cache.touch(b) == -1);
+    REQUIRE(cache.request(b) == -1);
+    cache.wait_idle();
+    REQUIRE(cache.find(a) == slotA);
+    REQUIRE(cache.find(b) >= 0);
+    REQUIRE(generated == 5);
+}
+
+TEST_CASE("cdlod terrain falls back to resident ancestor tiles")
+{
+    CdlodSettings s = test_settings();
+    s.levels = 4;
+    s.gridResolution = 8;
+
+    noise::LayeredNoiseParams params;
+    params.frequency = 1.0f / 200.0f;
+    params.amplitude = 30.0f;
+
+    CdlodTerrain terrain(s, 64, make_noise_tile_generator(params, s), 2);
+    REQUIRE(terrain.tile_resolution() == 17);
+
+    const float3 camera(-3800, 10, -3800);
+    terrain.update(camera);
+    terrain.tiles().wait_idle();
+    REQUIRE(terrain.tiles().pending_count() == 0);
+
+    const auto & instances = terrain.update(camera);
+    REQUIRE(instances.size() == terrain.selected_chunks().size());
+    for (size_t i = 0; i < instances.size(); ++i)
+    {
+        const auto & chunk = terrain.selected_chunks()[i];
+        REQUIRE(instances[i].chunk == float4(chunk.origin.x, chunk.origin.y, chunk.size, float(chunk.node.level)));
+        REQUIRE(instances[i].tileUV.z == Approx(0.5f));
+    }
+
+    // A single slot holds the root, so every chunk maps into the root tile
+    CdlodTerrain rootOnly(s, 1, make_noise_tile_generator(params, s), 1);
+    rootOnly.tiles().request(rootOnly.quadtree().root());
+    rootOnly.tiles().wait_idle();
+    const std::vector<CdlodInstance> fallback = rootOnly.update(camera);
+    REQUIRE(fallback.size() == rootOnly.selected_chunks().size());
+    const float rootSize = rootOnly.quadtree().node_size(s.levels - 1);
+    for (const auto & inst : fallback)
+    {
+        REQUIRE(inst.morph.x == float(rootOnly.tiles().find(rootOnly.quadtree().root())));
+        REQUIRE(inst.tileUV.x == Approx((inst.chunk.x - s.origin.x) / rootSize));
+        REQUIRE(inst.tileUV.z == Approx(inst.chunk.z / rootSize));
+    }
+
+    // Tile samples match the noise field at the node's corners
+    for (const auto & u : rootOnly.tiles().take_completed())
+    {
+        const float2 o = rootOnly.quadtree().node_origin(u.second->node);
+        const float expected = params.amplitude * noise::noise_fb(o * params.frequency);
+        REQUIRE(u.second->heights[0] == Approx(expected).margin(1e-3f));
+    }
+}
+
+TEST_CASE("cdlod selection and tile generation rates", "[.][benchmark]")
+{
+    CdlodSettings s;
+    s.levels = 10;
+    const CdlodQuadtree tree(s);
+    const float3 camera(s.leafSize * 200, 40, s.leafSize * 300);
+    const Pose pose = look_at_pose_rh(camera, camera + float3(1, -0.2f, 1));
+    const Frustum frustum(mul(make_projection_matrix(1.2f, 16.0f / 9.0f, 0.1f, 40000.0f), pose.view_matrix()));
+
+    std::vector<CdlodChunk> chunks;
+    SimpleTimer t(true);
+    const int frames = 1000;
+    for (int i = 0; i < frames; ++i)
+    {
+        chunks.clear();
+        tree.select(camera + float3(float(i), 0, 0), &frustum, chunks);
+    }
+    std::cout << "select over " << tree.node_size(s.levels - 1) / 1000.0f << " km: " << t.microseconds().count() / double(frames) << " us/frame, " << chunks.size() << " chunks" << std::endl;
+
+    noise::LayeredNoiseParams params;
+    params.frequency = 1.0f / 512.0f;
+    params.octaves = 6;
+    CdlodTileCache cache(256, make_noise_tile_generator(params, s));
+    t.start();
+    for (uint32_t i = 0; i < 128; ++i) cache.request({ 0, i % 16, i / 16 });
+    cache.wait_idle();
+    std::cout << "128 tiles of " << s.gridResolution * 2 + 1 << "^2: " << t.microseconds().count() * 1e-3 << " ms" << std::endl;
+}
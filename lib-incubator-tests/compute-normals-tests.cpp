@@ -0,0 +1,202 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <random>
+
+using namespace avl;
+
+// compute_normals before the welding rewrite, kept to check the new path reproduces it
+static void reference_compute_normals(Geometry & g, bool smooth)
+{
+    constexpr double NORMAL_EPSILON = 0.0001;
+
+    g.normals.resize(g.vertices.size());
+    for (auto & n : g.normals) n = float3(0, 0, 0);
+
+    std::vector<uint32_t> uniqueVertIndices(g.vertices.size(), 0);
+    if (smooth)
+    {
+        for (uint32_t i = 0; i < uniqueVertIndices.size(); ++i)
+        {
+            if (uniqueVertIndices[i] == 0)
+            {
+                uniqueVertIndices[i] = i + 1;
+                const float3 v0 = g.vertices[i];
+                for (auto j = i + 1; j < g.vertices.size(); ++j)
+                {
+                    if (length2(g.vertices[j] - v0) < NORMAL_EPSILON) uniqueVertIndices[j] = uniqueVertIndices[i];
+                }
+            }
+        }
+    }
+
+    for (const auto & f : g.faces)
+    {
+        const float3 v0 = g.vertices[smooth ? uniqueVertIndices[f.x] - 1 : f.x];
+        const float3 v1 = g.vertices[smooth ? uniqueVertIndices[f.y] - 1 : f.y];
+        const float3 v2 = g.vertices[smooth ? uniqueVertIndices[f.z] - 1 : f.z];
+
+        const float3 e0 = v1 - v0, e1 = v2 - v0, e2 = v2 - v1;
+        if (length2(e0) < NORMAL_EPSILON || length2(e1) < NORMAL_EPSILON || length2(e2) < NORMAL_EPSILON) continue;
+
+        const float3 n = safe_normalize(cross(e0, e1));
+        g.normals[f.x] += n;
+        g.normals[f.y] += n;
+        g.normals[f.z] += n;
+    }
+
+    for (auto & n : g.normals) n = safe_normalize(n);
+}
+
+// An indexed height field with no coincident vertices
+static Geometry make_bumpy_grid(uint32_t n)
+{
+    Geometry g;
+    for (uint32_t z = 0; z <= n; ++z)
+        for (uint32_t x = 0; x <= n; ++x) g.vertices.push_back(float3((float) x, std::sin(x * 0.7f) * std::cos(z * 0.4f), (float) z) * 0.1f);
+    for (uint32_t z = 0; z < n; ++z)
+        for (uint32_t x = 0; x < n; ++x)
+        {
+            const uint32_t i = z * (n + 1) + x;
+            g.faces.push_back(uint3(i, i + n + 1, i + 1));
+            g.faces.push_back(uint3(i + 1, i + n + 1, i + n + 2));
+        }
+    return g;
+}
+
+TEST_CASE("compute_normals reproduces the previous output on meshes without coincident vertices")
+{
+    std::vector<Geometry> meshes = { make_bumpy_grid(24), make_bumpy_grid(80) };
+    for (auto & mesh : meshes)
+    {
+        const auto welded = weld_positions(mesh.vertices, 0.01f);
+        for (uint32_t i = 0; i < welded.size(); ++i) REQUIRE(welded[i] == i);
+
+        for (bool smooth : { true, false })
+        {
+            Geometry a = mesh, b = mesh;
+            reference_compute_normals(a, smooth);
+            compute_normals(b, smooth);
+            REQUIRE(a.normals.size() == b.normals.size());
+            for (size_t i = 0; i < a.normals.size(); ++i) REQUIRE(a.normals[i] == b.normals[i]);
+        }
+    }
+
+    // Flat normals match on any mesh
+    Geometry a = make_torus(), b = make_torus();
+    reference_compute_normals(a, false);
+    compute_normals(b, false);
+    for (size_t i = 0; i < a.normals.size(); ++i) REQUIRE(a.normals[i] == b.normals[i]);
+}
+
+TEST_CASE("weld_positions picks the same representatives as a brute force search")
+{
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f), jitter(-0.004f, 0.004f);
+
+    std::vector<float3> positions;
+    for (int i = 0; i < 400; ++i) positions.push_back(float3(coord(gen), coord(gen), coord(gen)));
+    for (int i = 0; i < 1200; ++i)
+    {
+        const float3 p = positions[gen() % positions.size()];
+        positions.push_back(p + float3(jitter(gen), jitter(gen), jitter(gen)));
+    }
+    std::shuffle(positions.begin(), positions.end(), gen);
+
+    const float epsilon = 0.005f;
+    std::vector<uint32_t> expected(positions.size());
+    std::vector<uint32_t> representatives;
+    for (uint32_t i = 0; i < positions.size(); ++i)
+    {
+        expected[i] = i;
+        for (uint32_t r : representatives) if (length2(positions[r] - positions[i]) < epsilon * epsilon) expected[i] = r;
+        if (expected[i] == i) representatives.push_back(i);
+    }
+
+    REQUIRE(weld_positions(positions, epsilon) == expected);
+    REQUIRE(representatives.size() < positions.size());
+}
+
+TEST_CASE("compute_normals welds split vertices, with optional angle weighting and creases")
+{
+    Geometry cube = make_cube(); // 24 vertices, four per face
+    REQUIRE(cube.vertices.size() == 24);
+
+    auto corner_normal = [](const float3 & p) { return normalize(float3(p.x > 0 ? 1.0f : -1.0f, p.y > 0 ? 1.0f : -1.0f, p.z > 0 ? 1.0f : -1.0f)); };
+
+    // Equal weights favour faces whose diagonal ends at the corner, so coincident vertices agree but lean
+    compute_normals(cube, true);
+    for (size_t i = 0; i < 24; ++i)
+        for (size_t j = 0; j < 24; ++j)
+            if (cube.vertices[i] == cube.vertices[j]) REQUIRE(cube.normals[i] == cube.normals[j]);
+
+    // Each face spans 90 degrees at every corner, so angle weighting points exactly along the diagonal
+    NormalParams weighted;
+    weighted.angleWeighted = true;
+    compute_normals(cube, weighted);
+    for (size_t i = 0; i < 24; ++i) REQUIRE(length(cube.normals[i] - corner_normal(cube.vertices[i])) < 1e-5f);
+
+    // A crease below 90 degrees keeps the faces flat
+    NormalParams creased;
+    creased.creaseAngle = to_radians(60.0f);
+    compute_normals(cube, creased);
+    Geometry flat = make_cube();
+    compute_normals(flat, false);
+    for (size_t i = 0; i < 24; ++i) REQUIRE(length(cube.normals[i] - flat.normals[i]) < 1e-6f);
+
+    // Above 90 degrees it smooths like no crease at all
+    creased.creaseAngle = to_radians(100.0f);
+    Geometry smooth = make_cube();
+    compute_normals(cube, creased);
+    compute_normals(smooth, true);
+    for (size_t i = 0; i < 24; ++i) REQUIRE(cube.normals[i] == smooth.normals[i]);
+}
+
+TEST_CASE("compute_normals does not depend on the thread count")
+{
+    Geometry a = make_supershape_3d(64, 5, 30, 15, 15), b = a;
+    NormalParams params;
+    params.angleWeighted = true;
+    params.numThreads = 1;
+    compute_normals(a, params);
+    params.numThreads = 4;
+    compute_normals(b, params);
+    for (size_t i = 0; i < a.normals.size(); ++i) REQUIRE(a.normals[i] == b.normals[i]);
+}
+
+TEST_CASE("compute_normals on a half million triangle scan", "[.][benchmark]")
+{
+    Geometry scan = make_supershape_3d(500, 5, 30, 15, 15);
+
+    // Split every triangle, as scans exported without indices are
+    Geometry soup;
+    for (const auto & f : scan.faces)
+    {
+        const uint32_t base = (uint32_t) soup.vertices.size();
+        for (int c = 0; c < 3; ++c) soup.vertices.push_back(scan.vertices[f[c]]);
+        soup.faces.push_back(uint3(base, base + 1, base + 2));
+    }
+
+    SimpleTimer t(true);
+    const auto welded = weld_positions(soup.vertices, 0.0001f);
+    const double weldMs = t.microseconds().count() * 1e-3;
+
+    NormalParams params;
+    params.weldEpsilon = 0.0001f;
+    t.start();
+    compute_normals(soup, params);
+    const double smoothMs = t.microseconds().count() * 1e-3;
+
+    params.angleWeighted = true;
+    params.creaseAngle = to_radians(45.0f);
+    t.start();
+    compute_normals(soup, params);
+    const double creaseMs = t.microseconds().count() * 1e-3;
+
+    std::cout << soup.faces.size() << " triangles, " << soup.vertices.size() << " vertices: weld " << weldMs << " ms, smooth " << smoothMs
+        << " ms, angle weighted with crease " << creaseMs << " ms (" << hardware_thread_count() << " threads)" << std::endl;
+}
@@ -0,0 +1,154 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "curl_field.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+using namespace avl;
+
+static bool near3(const float3 & a, const float3 & b, float tolerance)
+{
+    return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+}
+
+static const Bounds3D fieldBounds(float3(-4, -2, -3), float3(4, 6, 5));
+
+TEST_CASE("baked curl field nodes match analytic curl noise")
+{
+    noise::CurlFieldParams params;
+    params.frequency = 0.4f;
+    params.amplitude = 2.0f;
+    const uint3 res(19, 11, 9);
+
+    noise::CurlFieldVolume field;
+    field.bake(params, res, fieldBounds);
+    REQUIRE(field.frame_count() == 1);
+
+    const float3 spacing = fieldBounds.size() / float3(18, 10, 8);
+    for (uint32_t z = 0; z < res.z; z += 2)
+        for (uint32_t y = 0; y < res.y; ++y)
+            for (uint32_t x = 0; x < res.x; ++x)
+            {
+                const float3 p = fieldBounds.min() + spacing * float3((float) x, (float) y, (float) z);
+                REQUIRE(near3(field.value_at(x, y, z), noise::noise_curl(p * 0.4f) * 2.0f, 2e-3f));
+            }
+
+    // Fractal sums and seeds go through the same generator functions
+    params.octaves = 3;
+    params.seed = 9;
+    field.bake(params, res, fieldBounds);
+    const noise::NoiseGenerator gen(9);
+    const float3 p = fieldBounds.min() + spacing * float3(5, 7, 3);
+    REQUIRE(near3(field.value_at(5, 7, 3), gen.noise_curl(p * 0.4f, 3, 2.0f, 0.5f) * 2.0f, 1e-2f));
+}
+
+TEST_CASE("animated curl field slices follow the flow noise rotation and loop")
+{
+    noise::CurlFieldParams params;
+    params.frequency = 0.3f;
+    params.frames = 8;
+    params.period = 4.0f;
+
+    noise::CurlFieldVolume field;
+    field.numThreads = 3;
+    field.bake(params, uint3(9, 9, 9), fieldBounds);
+    REQUIRE(field.frame_count() == 8);
+
+    const float3 node = fieldBounds.min() + fieldBounds.size() * 0.5f;
+    for (uint32_t f = 0; f < 8; ++f)
+        REQUIRE(near3(field.value_at(4, 4, 4, f), noise::noise_curl(node * 0.3f, float(ANVIL_TAU) * f / 8.0f), 1e-4f));
+
+    // Slice times hit the slices exactly, times in between blend, and time wraps over the period
+    REQUIRE(near3(field.sample(node, 1.5f), field.value_at(4, 4, 4, 3), 1e-5f));
+    REQUIRE(near3(field.sample(node, 1.75f), (field.value_at(4, 4, 4, 3) + field.value_at(4, 4, 4, 4)) * 0.5f, 1e-5f));
+    REQUIRE(near3(field.sample(node, 3.9f), field.sample(node, 3.9f + 4.0f * 3), 1e-4f));
+    REQUIRE(near3(field.sample(node, -0.25f), field.sample(node, 3.75f), 1e-4f));
+
+    noise::CurlFieldVolume single;
+    single.numThreads = 1;
+    single.bake(params, uint3(9, 9, 9), fieldBounds);
+    REQUIRE(std::equal(field.frame_data(0), field.frame_data(0) + 9 * 9 * 9 * 3 * 8, single.frame_data(0)));
+}
+
+TEST_CASE("batched curl field sampling matches scalar sampling")
+{
+    noise::CurlFieldParams params;
+    params.frequency = 0.5f;
+    params.frames = 4;
+
+    noise::CurlFieldVolume field;
+    field.bake(params, uint3(17, 13, 15), fieldBounds);
+
+    // Includes points outside the bounds, which clamp to the faces, and a partial block
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> d(-6.0f, 8.0f);
+    const size_t n = 203;
+    std::vector<float> x(n), y(n), z(n), vx(n), vy(n), vz(n);
+    for (size_t i = 0; i < n; ++i) { x[i] = d(gen); y[i] = d(gen); z[i] = d(gen); }
+
+    for (auto filter : { noise::CurlFieldVolume::Filter::Trilinear, noise::CurlFieldVolume::Filter::Tricubic })
+    {
+        for (float time : { 0.0f, 0.6f })
+        {
+            field.sample(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), n, time, filter);
+            for (size_t i = 0; i < n; ++i)
+                REQUIRE(near3(float3(vx[i], vy[i], vz[i]), field.sample(float3(x[i], y[i], z[i]), time, filter), 1e-4f));
+        }
+    }
+
+    // Both filters interpolate: they reproduce the baked values at grid nodes
+    const float3 node = fieldBounds.min() + fieldBounds.size() * float3(3.0f / 16, 5.0f / 12, 7.0f / 14);
+    REQUIRE(near3(field.sample(node), field.value_at(3, 5, 7), 1e-4f));
+    REQUIRE(near3(field.sample(node, 0.0f, noise::CurlFieldVolume::Filter::Tricubic), field.value_at(3, 5, 7), 1e-4f));
+}
+
+TEST_CASE("curl field bake and sample rates", "[.][benchmark]")
+{
+    noise::CurlFieldParams params;
+    params.frequency = 0.1f;
+    params.frames = 16;
+    const Bounds3D bounds(float3(-32, -32, -32), float3(32, 32, 32));
+
+    for (uint32_t threads : { 1u, hardware_thread_count() })
+    {
+        noise::CurlFieldVolume field;
+        field.numThreads = threads;
+        SimpleTimer t(true);
+        field.bake(params, uint3(64, 64, 64), bounds);
+        std::cout << "bake 64^3 x 16 frames (" << threads << " threads): " << t.microseconds().count() * 1e-3 << " ms, " << field.size_bytes() / (1024 * 1024) << " MB" << std::endl;
+    }
+
+    noise::CurlFieldVolume field;
+    field.bake(params, uint3(64, 64, 64), bounds);
+
+    const size_t n = 1 << 18;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> d(-32.0f, 32.0f);
+    std::vector<float> x(n), y(n), z(n), vx(n), vy(n), vz(n);
+    for (size_t i = 0; i < n; ++i) { x[i] = d(gen); y[i] = d(gen); z[i] = d(gen); }
+    std::sort(z.begin(), z.end()); // particles of a system are spatially coherent; fully random access is cache bound
+
+    float sink = 0.0f;
+    SimpleTimer t(true);
+    for (size_t i = 0; i < n; ++i) sink += noise::noise_curl(float3(x[i], y[i], z[i]) * 0.1f, 0.5f).x;
+    const double analytic = t.microseconds().count() * 1e-6;
+
+    t.start();
+    for (size_t i = 0; i < n; ++i) sink += field.sample(float3(x[i], y[i], z[i]), 0.3f).x;
+    const double scalar = t.microseconds().count() * 1e-6;
+
+    t.start();
+    field.sample(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), n, 0.3f);
+    const double trilinear = t.microseconds().count() * 1e-6;
+
+    t.start();
+    field.sample(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), n, 0.3f, noise::CurlFieldVolume::Filter::Tricubic);
+    const double tricubic = t.microseconds().count() * 1e-6;
+
+    std::cout << "analytic flow curl: " << n / analytic << " samples/sec" << std::endl;
+    std::cout << "baked scalar trilinear: " << n / scalar << " samples/sec" << std::endl;
+    std::cout << "baked batch trilinear: " << n / trilinear << " samples/sec (" << analytic / trilinear << "x analytic)" << std::endl;
+    std::cout << "baked batch tricubic: " << n / tricubic << " samples/sec (" << analytic / tricubic << "x analytic)" << std::endl;
+    std::cout << "(checksum " << sink + vx[0] << ")" << std::endl;
+}
@@ -0,0 +1,174 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "isosurface.hpp"
+#include "simplex_noise.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <map>
+#include <set>
+
+using namespace avl;
+
+static ScalarField3D make_sphere_field(int n, float radius, const float3 & center)
+{
+    const float spacing = 2.0f / float(n - 1);
+    return make_scalar_field(int3(n, n, n), float3(-1, -1, -1), float3(spacing), [=](const float3 & p) { return length(p - center) - radius; });
+}
+
+// Counts uses of every directed edge; a closed, consistently wound surface uses each exactly once, opposite its twin
+static bool is_closed_and_oriented(const runtime_mesh & mesh)
+{
+    std::map<std::pair<uint32_t, uint32_t>, int> directed;
+    for (const auto & f : mesh.faces)
+    {
+        if (f.x == f.y || f.y == f.z || f.z == f.x) return false;
+        for (int i = 0; i < 3; ++i) ++directed[std::make_pair(f[i], f[(i + 1) % 3])];
+    }
+    for (const auto & e : directed)
+    {
+        if (e.second != 1) return false;
+        auto twin = directed.find(std::make_pair(e.first.second, e.first.first));
+        if (twin == directed.end() || twin->second != 1) return false;
+    }
+    return true;
+}
+
+TEST_CASE("marching cubes tables triangulate every configuration into closed polygons")
+{
+    const auto & t = impl::marching_cubes_tables();
+    REQUIRE(t.triangleCount[0] == 0);
+    REQUIRE(t.triangleCount[255] == 0);
+    REQUIRE(t.triangleCount[1] == 1);
+    REQUIRE(t.triangleCount[0x0f] == 2); // four corners of one face: a quad
+
+    for (int config = 1; config < 255; ++config)
+    {
+        REQUIRE(t.triangleCount[config] >= 1);
+        REQUIRE(t.triangleCount[config] <= 12);
+
+        // Every edge the surface crosses is used, and no other
+        for (int e = 0; e < 12; ++e)
+        {
+            const bool crossing = ((config >> t.edgeCorners[e][0]) & 1) != ((config >> t.edgeCorners[e][1]) & 1);
+            bool used = false;
+            for (int i = 0; i < t.triangleCount[config] * 3; ++i) used |= (t.triangles[config][i] == e);
+            REQUIRE(used == crossing);
+        }
+    }
+}
+
+TEST_CASE("marching cubes extracts a welded, closed and outward facing sphere")
+{
+    const float radius = 0.7f;
+    const auto field = make_sphere_field(41, radius, float3(0.03f, -0.02f, 0.01f));
+    IsosurfaceParams params;
+    params.slabCells = 6;
+    const runtime_mesh mesh = marching_cubes(field, params);
+
+    REQUIRE(mesh.faces.size() > 1000);
+    REQUIRE(mesh.normals.size() == mesh.vertices.size());
+    REQUIRE(is_closed_and_oriented(mesh));
+
+    // Genus 0: V - E + F = 2, with E = 3F / 2 for a closed triangle mesh
+    REQUIRE(int(mesh.vertices.size()) - int(mesh.faces.size() * 3 / 2) + int(mesh.faces.size()) == 2);
+
+    // Welded: one vertex per crossing edge, so no two share a position
+    std::set<std::tuple<float, float, float>> unique;
+    for (const auto & v : mesh.vertices) unique.insert(std::make_tuple(v.x, v.y, v.z));
+    REQUIRE(unique.size() == mesh.vertices.size());
+
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const float3 d = mesh.vertices[i] - float3(0.03f, -0.02f, 0.01f);
+        REQUIRE(std::abs(length(d) - radius) < 2e-3f);
+        REQUIRE(dot(mesh.normals[i], normalize(d)) > 0.999f);
+    }
+    for (const auto & f : mesh.faces)
+    {
+        const float3 n = cross(mesh.vertices[f.y] - mesh.vertices[f.x], mesh.vertices[f.z] - mesh.vertices[f.x]);
+        if (length(n) > 1e-6f) REQUIRE(dot(normalize(n), mesh.normals[f.x]) > 0.0f); // slivers have no reliable direction
+    }
+}
+
+TEST_CASE("marching cubes output does not depend on threads, slabs or the field source")
+{
+    const int n = 33;
+    VoxelArray<float> voxels(int3(n, n, n));
+    for (int z = 0; z < n; ++z)
+        for (int y = 0; y < n; ++y)
+            for (int x = 0; x < n; ++x) voxels[int3(x, y, z)] = noise::noise(float3(float(x), float(y), float(z)) * 0.11f);
+
+    IsosurfaceParams params;
+    params.isoValue = 0.1f;
+    params.numThreads = 1;
+    const runtime_mesh reference = marching_cubes(voxels, params);
+    REQUIRE(is_closed_and_oriented(reference) == false); // the noise surface is cut open by the volume bounds
+    REQUIRE(reference.faces.size() > 1000);
+
+    params.numThreads = 4;
+    const runtime_mesh threaded = marching_cubes(voxels, params);
+    REQUIRE(threaded.vertices == reference.vertices);
+    REQUIRE(threaded.faces == reference.faces);
+
+    const auto callback = make_scalar_field(int3(n, n, n), float3(0, 0, 0), float3(1, 1, 1), [](const float3 & p) { return noise::noise(p * 0.11f); });
+    REQUIRE(marching_cubes(callback, params).faces == reference.faces);
+
+    // Other slab heights emit the same triangles in another order
+    auto triangle_set = [](const runtime_mesh & m)
+    {
+        std::set<std::vector<float>> tris;
+        for (const auto & f : m.faces)
+        {
+            std::vector<float> t;
+            for (int i = 0; i < 3; ++i) for (int c = 0; c < 3; ++c) t.push_back(m.vertices[f[i]][c]);
+            tris.insert(t);
+        }
+        return tris;
+    };
+    for (uint32_t slab : { 1u, 5u, 64u })
+    {
+        params.slabCells = slab;
+        const runtime_mesh other = marching_cubes(voxels, params);
+        REQUIRE(other.vertices.size() == reference.vertices.size());
+        REQUIRE(triangle_set(other) == triangle_set(reference));
+    }
+
+    params.computeNormals = false;
+    REQUIRE(marching_cubes(voxels, params).normals.empty());
+}
+
+TEST_CASE("marching cubes extraction rate", "[.][benchmark]")
+{
+    auto gyroid = [](const float3 & p) { return std::sin(p.x) * std::cos(p.y) + std::sin(p.y) * std::cos(p.z) + std::sin(p.z) * std::cos(p.x); };
+
+    {
+        const int n = 256;
+        VoxelArray<float> voxels(int3(n, n, n));
+        parallel_for(0, n, [&](size_t z)
+        {
+            for (int y = 0; y < n; ++y)
+                for (int x = 0; x < n; ++x) voxels[int3(x, y, int(z))] = gyroid(float3(float(x), float(y), float(z)) * 0.08f);
+        });
+
+        for (uint32_t threads : { 1u, hardware_thread_count() })
+        {
+            IsosurfaceParams params;
+            params.numThreads = threads;
+            SimpleTimer t(true);
+            const auto mesh = marching_cubes(voxels, params);
+            std::cout << "256^3 voxel array (" << threads << " threads): " << t.microseconds().count() * 1e-3 << " ms, " << mesh.faces.size() << " triangles" << std::endl;
+        }
+    }
+
+    {
+        const int n = 512;
+        const auto field = make_scalar_field(int3(n, n, n), float3(0, 0, 0), float3(0.04f), gyroid);
+        IsosurfaceParams params;
+        params.computeNormals = false;
+        SimpleTimer t(true);
+        const auto mesh = marching_cubes(field, params);
+        std::cout << "512^3 callback, no normals (" << hardware_thread_count() << " threads): " << t.microseconds().count() * 1e-3 << " ms, " << mesh.faces.size() << " triangles" << std::endl;
+    }
+}
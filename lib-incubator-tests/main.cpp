@@ -0,0 +1,5 @@
+// Unit tests and micro-benchmarks for lib-incubator. Benchmarks are tagged [.][benchmark] so they
+// are hidden from a default run; invoke them with `lib-incubator-tests.exe [benchmark]` in release.
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
@@ -0,0 +1,290 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "mesh_lod.hpp"
+#include "../lib-model-io/model-io-util.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <fstream>
+#include <iostream>
+
+using namespace avl;
+
+// A mesh with every section the format has
+static runtime_mesh make_full_mesh(uint32_t segments)
+{
+    runtime_mesh m = make_supershape_3d(segments, 5, 7, 4, 12);
+    compute_normals(m);
+    m.texcoord0.clear();
+    for (const auto & v : m.vertices)
+    {
+        m.texcoord0.push_back(float2(v.x, v.z) * 0.5f + 0.5f);
+        m.texcoord1.push_back(float2(v.y, v.x));
+        m.colors.push_back(float4(v * 0.5f + 0.5f, 1.0f));
+    }
+    compute_mikktspace_tangents(m);
+    for (size_t f = 0; f < m.faces.size(); ++f) m.material.push_back(uint32_t(f % 3));
+
+    mesh_optimization_options options;
+    options.buildMeshlets = true;
+    m.material.clear();
+    optimize_model(m, options);
+    m.material.assign(m.faces.size(), 0);
+    m.material[m.faces.size() / 2] = 1;
+
+    LodChainParams lodParams;
+    lodParams.levels = { { 0.5f }, { 0.25f } };
+    generate_lod_chain(m, lodParams);
+    return m;
+}
+
+template<class T> static bool same_bytes(const std::vector<T> & a, const std::vector<T> & b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static void require_same_mesh(const runtime_mesh & a, const runtime_mesh & b)
+{
+    REQUIRE(same_bytes(a.vertices, b.vertices));
+    REQUIRE(same_bytes(a.normals, b.normals));
+    REQUIRE(same_bytes(a.colors, b.colors));
+    REQUIRE(same_bytes(a.texcoord0, b.texcoord0));
+    REQUIRE(same_bytes(a.texcoord1, b.texcoord1));
+    REQUIRE(same_bytes(a.tangents, b.tangents));
+    REQUIRE(same_bytes(a.bitangents, b.bitangents));
+    REQUIRE(same_bytes(a.faces, b.faces));
+    REQUIRE(same_bytes(a.material, b.material));
+    REQUIRE(a.lods.size() == b.lods.size());
+    for (size_t l = 0; l < a.lods.size(); ++l)
+    {
+        REQUIRE(same_bytes(a.lods[l].faces, b.lods[l].faces));
+        REQUIRE(a.lods[l].error == b.lods[l].error);
+    }
+    REQUIRE(a.meshlets.size() == b.meshlets.size());
+    REQUIRE(same_bytes(a.meshletVertices, b.meshletVertices));
+    REQUIRE(same_bytes(a.meshletTriangles, b.meshletTriangles));
+}
+
+static size_t file_size(const std::string & path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return size_t(f.tellg());
+}
+
+TEST_CASE("mesh binary version 2 round trips every section, compressed or not")
+{
+    runtime_mesh m = make_full_mesh(48);
+    REQUIRE(m.lods.size() == 2);
+    REQUIRE(m.meshlets.size() > 0);
+
+    const std::string path = "mesh-binary-test.mesh", packedPath = "mesh-binary-test-compressed.mesh";
+    export_mesh_binary(path, m, false);
+    export_mesh_binary(packedPath, m, true);
+
+    require_same_mesh(import_mesh_binary(path), m);
+    require_same_mesh(import_mesh_binary(packedPath), m);
+    REQUIRE(file_size(packedPath) < file_size(path));
+
+    // Uncompressed sections are read in place, aligned for SIMD loads
+    mapped_runtime_mesh mapped(path);
+    const runtime_mesh_view & view = mapped.view();
+    REQUIRE(view.vertices.size == m.vertices.size());
+    REQUIRE(reinterpret_cast<uintptr_t>(view.vertices.data) % runtime_mesh_binary_alignment == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(view.lods[1].faces.data) % runtime_mesh_binary_alignment == 0);
+    REQUIRE(view.lods[1].error == m.lods[1].error);
+    require_same_mesh(view.to_mesh(), m);
+
+    std::remove(path.c_str());
+    std::remove(packedPath.c_str());
+}
+
+TEST_CASE("mesh binary import still reads version 1 files")
+{
+    runtime_mesh m = make_full_mesh(16);
+
+    // Version 1 as the previous exporter wrote it: positions through materials, then the lod block
+    runtime_mesh_binary_header h;
+    h.verticesBytes = (uint32_t) m.vertices.size() * sizeof(float3);
+    h.normalsBytes = (uint32_t) m.normals.size() * sizeof(float3);
+    h.texcoord0Bytes = (uint32_t) m.texcoord0.size() * sizeof(float2);
+    h.facesBytes = (uint32_t) m.faces.size() * sizeof(uint3);
+
+    const std::string path = "mesh-binary-test-v1.mesh";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char *) &h, sizeof(h));
+        file.write((const char *) m.vertices.data(), h.verticesBytes);
+        file.write((const char *) m.normals.data(), h.normalsBytes);
+        file.write((const char *) m.texcoord0.data(), h.texcoord0Bytes);
+        file.write((const char *) m.faces.data(), h.facesBytes);
+        const uint32_t lodCount = 1, lodBytes = (uint32_t) m.lods[0].faces.size() * sizeof(uint3);
+        file.write((const char *) &lodCount, 4);
+        file.write((const char *) &m.lods[0].error, 4);
+        file.write((const char *) &lodBytes, 4);
+        file.write((const char *) m.lods[0].faces.data(), lodBytes);
+    }
+
+    const runtime_mesh imported = import_mesh_binary(path);
+    REQUIRE(same_bytes(imported.vertices, m.vertices));
+    REQUIRE(same_bytes(imported.normals, m.normals));
+    REQUIRE(same_bytes(imported.texcoord0, m.texcoord0));
+    REQUIRE(same_bytes(imported.faces, m.faces));
+    REQUIRE(imported.lods.size() == 1);
+    REQUIRE(same_bytes(imported.lods[0].faces, m.lods[0].faces));
+
+    // Mapping is for version 2 only
+    REQUIRE_THROWS(mapped_runtime_mesh(path));
+
+    // Level and byte counts larger than the rest of the file are rejected rather than allocated
+    for (uint32_t lodCount : { 0xffffffffu, 1u })
+    {
+        {
+            std::ofstream file(path, std::ios::binary);
+            file.write((const char *) &h, sizeof(h));
+            file.write((const char *) m.vertices.data(), h.verticesBytes);
+            file.write((const char *) m.normals.data(), h.normalsBytes);
+            file.write((const char *) m.texcoord0.data(), h.texcoord0Bytes);
+            file.write((const char *) m.faces.data(), h.facesBytes);
+            const uint32_t lodBytes = 0xfffffff0;
+            file.write((const char *) &lodCount, 4);
+            file.write((const char *) &m.lods[0].error, 4);
+            file.write((const char *) &lodBytes, 4);
+            file.write((const char *) m.lods[0].faces.data(), m.lods[0].faces.size() * sizeof(uint3));
+        }
+        REQUIRE_THROWS(import_mesh_binary(path));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mesh binary version 2 rejects corrupted sections")
+{
+    runtime_mesh m = make_full_mesh(16);
+    const std::string path = "mesh-binary-test-corrupt.mesh";
+
+    for (bool compressed : { false, true })
+    {
+        export_mesh_binary(path, m, compressed);
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(std::streamoff(file_size(path) - 5));
+            file.put(0x5a);
+        }
+        REQUIRE_THROWS(import_mesh_binary(path));
+        REQUIRE_NOTHROW(mapped_runtime_mesh(path, false)); // unverified, the flipped byte is just data
+    }
+
+    // Truncation is caught by the header's file size before any section is read
+    export_mesh_binary(path, m, false);
+    const size_t size = file_size(path);
+    std::vector<char> bytes(size);
+    {
+        std::ifstream in(path, std::ios::binary);
+        in.read(bytes.data(), size);
+    }
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(bytes.data(), size - 100);
+    }
+    REQUIRE_THROWS(import_mesh_binary(path));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mesh binary version 2 checks the section table before trusting it")
+{
+    runtime_mesh m = make_full_mesh(16);
+    const std::string path = "mesh-binary-test-table.mesh";
+
+    // Rewrites one section's entry with a valid table checksum, as a forged or buggy writer would
+    auto rewrite_section = [&](bool compressed, runtime_mesh_section type, std::function<void(runtime_mesh_binary_section &)> edit, bool fixChecksum)
+    {
+        export_mesh_binary(path, m, compressed);
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        runtime_mesh_binary_header_v2 h;
+        file.read((char *) &h, sizeof(h));
+        std::vector<runtime_mesh_binary_section> sections(h.sectionCount);
+        file.read((char *) sections.data(), sections.size() * sizeof(runtime_mesh_binary_section));
+        for (auto & s : sections) if (s.type == type) { edit(s); break; }
+        if (fixChecksum)
+        {
+            const uint32_t stored = h.tableChecksum;
+            h.tableChecksum = 0;
+            h.tableChecksum = crc32c(sections.data(), sections.size() * sizeof(runtime_mesh_binary_section), crc32c(&h, sizeof(h)));
+            REQUIRE(h.tableChecksum != stored);
+        }
+        file.seekp(0);
+        file.write((const char *) &h, sizeof(h));
+        file.write((const char *) sections.data(), sections.size() * sizeof(runtime_mesh_binary_section));
+    };
+
+    // A damaged table is rejected even when payloads go unverified
+    rewrite_section(false, runtime_mesh_section::vertices, [](runtime_mesh_binary_section & s) { s.elementCount += 1; }, false);
+    REQUIRE_THROWS(mapped_runtime_mesh(path, false));
+
+    // Counts the stored bytes cannot hold are rejected before anything is allocated for them
+    for (bool compressed : { false, true })
+    {
+        rewrite_section(compressed, runtime_mesh_section::vertices, [](runtime_mesh_binary_section & s) { s.elementCount = uint64_t(1) << 62; }, true);
+        REQUIRE_THROWS(mapped_runtime_mesh(path, false));
+        rewrite_section(compressed, runtime_mesh_section::faces, [](runtime_mesh_binary_section & s) { s.elementCount = s.storedBytes; }, true);
+        REQUIRE_THROWS(mapped_runtime_mesh(path, false));
+    }
+
+    // So are levels no section table could describe
+    rewrite_section(false, runtime_mesh_section::lod_faces, [](runtime_mesh_binary_section & s) { s.index = 0xffffffff; }, true);
+    REQUIRE_THROWS(mapped_runtime_mesh(path, false));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mesh binary load benchmark", "[.][benchmark]")
+{
+    runtime_mesh m = make_full_mesh(600);
+    std::cout << m.vertices.size() << " vertices, " << m.faces.size() << " triangles" << std::endl;
+
+    const std::string v1Path = "mesh-binary-bench-v1.mesh", v2Path = "mesh-binary-bench.mesh", packedPath = "mesh-binary-bench-compressed.mesh";
+    {
+        runtime_mesh_binary_header h;
+        h.verticesBytes = (uint32_t) m.vertices.size() * sizeof(float3);
+        h.normalsBytes = (uint32_t) m.normals.size() * sizeof(float3);
+        h.texcoord0Bytes = (uint32_t) m.texcoord0.size() * sizeof(float2);
+        h.tangentsBytes = (uint32_t) m.tangents.size() * sizeof(float3);
+        h.bitangentsBytes = (uint32_t) m.bitangents.size() * sizeof(float3);
+        h.facesBytes = (uint32_t) m.faces.size() * sizeof(uint3);
+        std::ofstream file(v1Path, std::ios::binary);
+        file.write((const char *) &h, sizeof(h));
+        file.write((const char *) m.vertices.data(), h.verticesBytes);
+        file.write((const char *) m.normals.data(), h.normalsBytes);
+        file.write((const char *) m.texcoord0.data(), h.texcoord0Bytes);
+        file.write((const char *) m.tangents.data(), h.tangentsBytes);
+        file.write((const char *) m.bitangents.data(), h.bitangentsBytes);
+        file.write((const char *) m.faces.data(), h.facesBytes);
+    }
+    m.colors.clear(); m.texcoord1.clear(); m.material.clear(); m.lods.clear(); m.meshlets.clear(); m.meshletVertices.clear(); m.meshletTriangles.clear();
+    export_mesh_binary(v2Path, m, false);
+    export_mesh_binary(packedPath, m, true);
+    std::cout << "file bytes: v1 " << file_size(v1Path) << ", v2 " << file_size(v2Path) << ", v2 compressed " << file_size(packedPath) << std::endl;
+
+    auto time = [](const char * name, std::function<size_t()> fn)
+    {
+        SimpleTimer t;
+        t.start();
+        size_t count = 0;
+        for (int r = 0; r < 10; ++r) count += fn();
+        std::cout << name << ": " << t.microseconds().count() / 10000.0 << " ms" << std::endl;
+        REQUIRE(count > 0);
+    };
+
+    time("import v1", [&]() { return import_mesh_binary(v1Path).vertices.size(); });
+    time("import v2", [&]() { return import_mesh_binary(v2Path).vertices.size(); });
+    time("import v2 compressed", [&]() { return import_mesh_binary(packedPath).vertices.size(); });
+    time("map v2, verified", [&]() { return mapped_runtime_mesh(v2Path).view().vertices.size; });
+    time("map v2, unverified", [&]() { return mapped_runtime_mesh(v2Path, false).view().vertices.size; });
+
+    std::remove(v1Path.c_str());
+    std::remove(v2Path.c_str());
+    std::remove(packedPath.c_str());
+}
@@ -0,0 +1,204 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "mesh_lod.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <fstream>
+#include <map>
+#include <set>
+
+using namespace avl;
+
+// A height field with nonlinear texture coordinates, which carry information the positions do not
+static Geometry make_uv_grid(uint32_t n, float amplitude)
+{
+    Geometry g;
+    for (uint32_t z = 0; z <= n; ++z)
+    {
+        for (uint32_t x = 0; x <= n; ++x)
+        {
+            const float fx = (float) x / n, fz = (float) z / n;
+            g.vertices.push_back(float3(fx, amplitude * std::sin(fx * 6.0f) * std::cos(fz * 5.0f), fz));
+            g.texcoord0.push_back(float2(0.5f * std::sin(fx * 12.0f), 0.5f * std::sin(fz * 12.0f)));
+        }
+    }
+    for (uint32_t z = 0; z < n; ++z)
+    {
+        for (uint32_t x = 0; x < n; ++x)
+        {
+            const uint32_t i = z * (n + 1) + x;
+            g.faces.push_back(uint3(i, i + n + 1, i + 1));
+            g.faces.push_back(uint3(i + 1, i + n + 1, i + n + 2));
+        }
+    }
+    compute_normals(g);
+    return g;
+}
+
+// Undirected position-space edges and how many faces use each
+static std::map<std::pair<uint32_t, uint32_t>, int> welded_edges(const Geometry & g, const std::vector<uint3> & faces)
+{
+    const auto group = weld_positions(g.vertices, 1e-5f);
+    std::map<std::pair<uint32_t, uint32_t>, int> edges;
+    for (const auto & f : faces)
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t a = group[f[c]], b = group[f[(c + 1) % 3]];
+            ++edges[std::make_pair(std::min(a, b), std::max(a, b))];
+        }
+    return edges;
+}
+
+TEST_CASE("lod chain of a closed mesh with uv seams stays closed")
+{
+    Geometry torus = make_torus(48); // seams where u and v wrap
+    generate_lod_chain(torus);
+
+    REQUIRE(torus.lods.size() >= 3);
+    size_t previous = torus.faces.size();
+    float previousError = 0.0f;
+    for (const auto & lod : torus.lods)
+    {
+        REQUIRE(lod.faces.size() < previous);
+        REQUIRE(lod.error >= previousError);
+        previous = lod.faces.size();
+        previousError = lod.error;
+
+        for (const auto & f : lod.faces)
+        {
+            REQUIRE(f.x < torus.vertices.size());
+            REQUIRE(f.y < torus.vertices.size());
+            REQUIRE(f.z < torus.vertices.size());
+            REQUIRE(f.x != f.y);
+            REQUIRE(f.y != f.z);
+            REQUIRE(f.x != f.z);
+        }
+        for (const auto & e : welded_edges(torus, lod.faces)) REQUIRE(e.second == 2);
+    }
+
+    // Half the triangles at the first level
+    REQUIRE(torus.lods[0].faces.size() <= torus.faces.size() / 2);
+}
+
+TEST_CASE("lod chain keeps borders in place")
+{
+    Geometry grid = make_uv_grid(32, 0.1f);
+    generate_lod_chain(grid);
+    REQUIRE(!grid.lods.empty());
+
+    std::set<std::pair<uint32_t, uint32_t>> border;
+    for (const auto & e : welded_edges(grid, grid.faces)) if (e.second == 1) border.insert(e.first);
+    REQUIRE(border.size() == 32 * 4);
+
+    for (const auto & lod : grid.lods)
+    {
+        std::set<std::pair<uint32_t, uint32_t>> lodBorder;
+        for (const auto & e : welded_edges(grid, lod.faces)) if (e.second == 1) lodBorder.insert(e.first);
+        REQUIRE(lodBorder == border);
+    }
+}
+
+TEST_CASE("lod chain accounts for texture coordinates")
+{
+    // A flat grid loses nothing geometrically, so only the uv error limits it
+    LodChainParams params;
+    params.levels = { { 0.0f, 0.002f } };
+
+    Geometry flat = make_uv_grid(32, 0.0f);
+    generate_lod_chain(flat, params);
+
+    params.texcoordWeight = 0.0f;
+    Geometry positionsOnly = make_uv_grid(32, 0.0f);
+    generate_lod_chain(positionsOnly, params);
+
+    REQUIRE(flat.lods.size() == 1);
+    REQUIRE(positionsOnly.lods.size() == 1);
+    REQUIRE(positionsOnly.lods[0].error < 1e-4f);
+    REQUIRE(flat.lods[0].error <= 0.002f);
+    REQUIRE(flat.lods[0].faces.size() > positionsOnly.lods[0].faces.size() * 2);
+}
+
+TEST_CASE("lod chains for several meshes build in parallel")
+{
+    std::vector<Geometry> meshes = { make_torus(32), make_uv_grid(24, 0.2f), make_torus(20) };
+    std::vector<Geometry> serial = meshes;
+
+    std::vector<runtime_mesh *> list;
+    for (auto & m : meshes) list.push_back(&m);
+    generate_lod_chains(list, LodChainParams(), 3);
+    for (auto & m : serial) generate_lod_chain(m);
+
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        REQUIRE(meshes[i].lods.size() == serial[i].lods.size());
+        for (size_t l = 0; l < meshes[i].lods.size(); ++l)
+        {
+            REQUIRE(meshes[i].lods[l].faces == serial[i].lods[l].faces);
+            REQUIRE(meshes[i].lods[l].error == serial[i].lods[l].error);
+        }
+    }
+}
+
+// Enough of the PLY format for assets/models/stanford/lucy.ply: binary little endian float positions and triangle lists
+static bool load_stanford_ply(const std::string & path, Geometry & g)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) return false;
+
+    std::string line;
+    uint32_t vertexCount = 0, faceCount = 0;
+    while (std::getline(file, line) && line != "end_header")
+    {
+        if (line.compare(0, 15, "element vertex ") == 0) vertexCount = std::stoi(line.substr(15));
+        if (line.compare(0, 13, "element face ") == 0) faceCount = std::stoi(line.substr(13));
+    }
+
+    g.vertices.resize(vertexCount);
+    file.read((char *) g.vertices.data(), vertexCount * sizeof(float3));
+    for (uint32_t f = 0; f < faceCount; ++f)
+    {
+        uint8_t count = 0;
+        int32_t indices[3];
+        file.read((char *) &count, 1);
+        if (count != 3) return false;
+        file.read((char *) indices, sizeof(indices));
+        g.faces.push_back(uint3(indices[0], indices[1], indices[2]));
+    }
+    return file.good();
+}
+
+TEST_CASE("lod chain error and triangle curves", "[.][benchmark]")
+{
+    LodChainParams params;
+    params.levels.clear();
+    for (float ratio = 0.5f; ratio > 0.002f; ratio *= 0.5f) params.levels.push_back({ ratio });
+
+    std::vector<std::pair<std::string, Geometry>> meshes;
+
+    Geometry lucy;
+    for (const std::string prefix : { "", "../", "../../" })
+    {
+        if (load_stanford_ply(prefix + "assets/models/stanford/lucy.ply", lucy)) break;
+        lucy = Geometry();
+    }
+    if (lucy.faces.size())
+    {
+        compute_normals(lucy);
+        meshes.emplace_back("stanford lucy", lucy);
+    }
+    else std::cout << "assets/models/stanford/lucy.ply not found, run from the repository root" << std::endl;
+
+    meshes.emplace_back("torus (uv seams)", make_torus(256));
+    meshes.emplace_back("supershape", make_supershape_3d(256, 5, 30, 15, 15));
+
+    for (auto & m : meshes)
+    {
+        SimpleTimer t(true);
+        generate_lod_chain(m.second, params);
+        std::cout << m.first << ": " << m.second.faces.size() << " triangles, chain in " << t.microseconds().count() * 1e-3 << " ms" << std::endl;
+        for (const auto & lod : m.second.lods) std::cout << "    " << lod.faces.size() << " triangles, error " << lod.error << std::endl;
+    }
+}
@@ -0,0 +1,117 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+using namespace avl;
+
+// A flat strip across x = [-1, 1] with uv = (|x|, z), so the left half is mirrored in u
+static Geometry make_mirrored_strip(uint32_t n)
+{
+    Geometry g;
+    for (uint32_t z = 0; z <= n; ++z)
+    {
+        for (uint32_t x = 0; x <= 2 * n; ++x)
+        {
+            const float px = (float) x / n - 1.0f, pz = (float) z / n;
+            g.vertices.push_back(float3(px, 0, pz));
+            g.normals.push_back(float3(0, 1, 0));
+            g.texcoord0.push_back(float2(std::abs(px), pz));
+        }
+    }
+    for (uint32_t z = 0; z < n; ++z)
+    {
+        for (uint32_t x = 0; x < 2 * n; ++x)
+        {
+            const uint32_t i = z * (2 * n + 1) + x;
+            g.faces.push_back(uint3(i, i + 2 * n + 1, i + 1));
+            g.faces.push_back(uint3(i + 1, i + 2 * n + 1, i + 2 * n + 2));
+        }
+    }
+    return g;
+}
+
+TEST_CASE("mikktspace tangents follow texture derivatives across a mirrored seam")
+{
+    Geometry g = make_mirrored_strip(8);
+    compute_mikktspace_tangents(g);
+
+    for (size_t i = 0; i < g.vertices.size(); ++i)
+    {
+        const float x = g.vertices[i].x;
+        REQUIRE(std::abs(length(g.tangents[i]) - 1.0f) < 1e-5f);
+        REQUIRE(std::abs(g.tangents[i].x) > 0.9999f);
+        if (x == 0.0f) continue; // the seam takes either side
+
+        // dp/du flips with the mirror, dp/dv does not, and the bitangent sign keeps the frame on dp/dv
+        const float3 dpdu = float3(x > 0 ? 1.0f : -1.0f, 0, 0), dpdv = float3(0, 0, 1);
+        REQUIRE(dot(g.tangents[i], dpdu) > 0.9999f);
+        REQUIRE(dot(g.bitangents[i], dpdv) > 0.9999f);
+    }
+
+    // The approximate path is still available and agrees on the unmirrored half
+    Geometry approximate = make_mirrored_strip(8);
+    compute_tangents(approximate);
+    for (size_t i = 0; i < g.vertices.size(); ++i)
+    {
+        if (g.vertices[i].x > 0.0f) REQUIRE(dot(safe_normalize(approximate.tangents[i]), g.tangents[i]) > 0.9999f);
+    }
+}
+
+TEST_CASE("mikktspace tangents match the analytic frame of the torus")
+{
+    const uint32_t segments = 48;
+    Geometry torus = make_torus(segments);
+    compute_mikktspace_tangents(torus);
+
+    // make_torus sweeps u around y and v around the tube, see procedural_mesh.hpp
+    for (uint32_t i = 0; i <= segments; ++i)
+    {
+        const auto a = make_rotation_quat_axis_angle({ 0, 1, 0 }, (i % segments) * ANVIL_TAU / segments);
+        for (uint32_t j = 0; j <= segments; ++j)
+        {
+            const float b = float((j % segments) * ANVIL_TAU / segments);
+            const uint32_t v = i * (segments + 1) + j;
+            const float3 dpdu = normalize(cross(float3(0, 1, 0), torus.vertices[v]));
+            const float3 dpdv = qrot(a, float3(-std::sin(b), std::cos(b), 0));
+
+            REQUIRE(dot(torus.tangents[v], dpdu) > 0.995f);
+            REQUIRE(dot(torus.bitangents[v], dpdv) > 0.995f);
+            REQUIRE(std::abs(dot(torus.tangents[v], torus.normals[v])) < 1e-5f);
+        }
+    }
+}
+
+TEST_CASE("mikktspace tangents do not depend on the thread count")
+{
+    Geometry a = make_torus(64), b = a;
+    compute_mikktspace_tangents(a, 1);
+    compute_mikktspace_tangents(b, 4);
+    for (size_t i = 0; i < a.tangents.size(); ++i)
+    {
+        REQUIRE(a.tangents[i] == b.tangents[i]);
+        REQUIRE(a.bitangents[i] == b.bitangents[i]);
+    }
+
+    Geometry missing;
+    missing.vertices = a.vertices;
+    missing.faces = a.faces;
+    REQUIRE_THROWS(compute_mikktspace_tangents(missing));
+}
+
+TEST_CASE("mikktspace tangents on a million triangles", "[.][benchmark]")
+{
+    Geometry torus = make_torus(700);
+
+    SimpleTimer t(true);
+    compute_tangents(torus);
+    const double approximateMs = t.microseconds().count() * 1e-3;
+
+    t.start();
+    compute_mikktspace_tangents(torus);
+    const double mikkMs = t.microseconds().count() * 1e-3;
+
+    std::cout << torus.faces.size() << " triangles: approximate " << approximateMs << " ms, mikktspace " << mikkMs << " ms (" << hardware_thread_count() << " threads)" << std::endl;
+}
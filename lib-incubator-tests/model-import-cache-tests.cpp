@@ -0,0 +1,252 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "model_import_cache.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#include <unistd.h>
+#endif
+
+using namespace avl;
+
+// Writes a supershape as an obj with two groups, its upper and lower halves
+static void write_supershape_obj(const std::string & path, int segments, float m)
+{
+    runtime_mesh g = make_supershape_3d(segments, m, 7, 4, 12);
+    compute_normals(g);
+    g.texcoord0.clear();
+    for (auto & v : g.vertices) g.texcoord0.push_back(float2(v.x, v.z) * 0.5f + 0.5f);
+
+    std::ofstream obj(path, std::ios::binary);
+    obj << "mtllib none.mtl\n";
+    for (auto & v : g.vertices) obj << "v " << v.x << " " << v.y << " " << v.z << "\n";
+    for (auto & t : g.texcoord0) obj << "vt " << t.x << " " << t.y << "\n";
+    for (auto & n : g.normals) obj << "vn " << n.x << " " << n.y << " " << n.z << "\n";
+    for (size_t f = 0; f < g.faces.size(); ++f)
+    {
+        if (f == 0) obj << "g upper\n";
+        if (f == g.faces.size() / 2) obj << "g lower\n";
+        const uint3 t = g.faces[f] + uint3(1);
+        obj << "f " << t.x << "/" << t.x << "/" << t.x << " " << t.y << "/" << t.y << "/" << t.y << " " << t.z << "/" << t.z << "/" << t.z << "\n";
+    }
+}
+
+// Backdates a file, as if it had been written long before its record
+static void set_file_age(const std::string & path, int seconds)
+{
+#if defined(_WIN32)
+    struct _utimbuf t;
+    t.actime = t.modtime = std::time(nullptr) - seconds;
+    _utime(path.c_str(), &t);
+#else
+    struct utimbuf t;
+    t.actime = t.modtime = std::time(nullptr) - seconds;
+    utime(path.c_str(), &t);
+#endif
+}
+
+static void remove_directory(const std::string & path)
+{
+#if defined(_WIN32)
+    _rmdir(path.c_str());
+#else
+    rmdir(path.c_str());
+#endif
+}
+
+template<class T> static bool same_bytes(const std::vector<T> & a, const std::vector<T> & b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static void require_same_meshes(const std::map<std::string, runtime_mesh> & a, const std::map<std::string, runtime_mesh> & b)
+{
+    REQUIRE(a.size() == b.size());
+    for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib)
+    {
+        REQUIRE(ia->first == ib->first);
+        REQUIRE(same_bytes(ia->second.vertices, ib->second.vertices));
+        REQUIRE(same_bytes(ia->second.normals, ib->second.normals));
+        REQUIRE(same_bytes(ia->second.texcoord0, ib->second.texcoord0));
+        REQUIRE(same_bytes(ia->second.tangents, ib->second.tangents));
+        REQUIRE(same_bytes(ia->second.faces, ib->second.faces));
+        REQUIRE(ia->second.lods.size() == ib->second.lods.size());
+        for (size_t l = 0; l < ia->second.lods.size(); ++l) REQUIRE(same_bytes(ia->second.lods[l].faces, ib->second.lods[l].faces));
+    }
+}
+
+static void remove_artifacts(ModelImportCache & cache, const std::vector<uint64_t> & keys, const std::vector<std::string> & sources)
+{
+    for (auto key : keys) for (auto & p : cache.artifact_paths(key)) std::remove(p.c_str());
+    for (auto & s : sources)
+    {
+        cache.invalidate(s);
+        std::remove(s.c_str());
+    }
+}
+
+TEST_CASE("model import cache reuses artifacts until the source changes")
+{
+    const std::string directory = "./model-import-cache-test", path = "./model-import-cache-test.obj";
+    write_supershape_obj(path, 24, 5);
+    set_file_age(path, 100);
+
+    std::vector<uint64_t> keys;
+    {
+        ModelImportCache cache(directory, 1);
+
+        const auto first = cache.import(path);
+        REQUIRE_FALSE(first->fromCache);
+        REQUIRE(first->sourceHashed);
+        REQUIRE(first->meshes.size() == 2);
+        REQUIRE(first->meshes.at("upper").lods.size() > 0);
+        REQUIRE(first->meshes.at("upper").tangents.size() == first->meshes.at("upper").vertices.size());
+        keys.push_back(first->key);
+
+        // Unchanged: the record is trusted and the source is not read
+        const auto second = cache.import(path);
+        REQUIRE(second->fromCache);
+        REQUIRE_FALSE(second->sourceHashed);
+        REQUIRE(second->key == first->key);
+        require_same_meshes(second->meshes, first->meshes);
+
+        // Touched but unchanged: rehashed, still a hit
+        set_file_age(path, 50);
+        const auto touched = cache.import(path);
+        REQUIRE(touched->fromCache);
+        REQUIRE(touched->sourceHashed);
+        REQUIRE(touched->key == first->key);
+
+        // Other options are other artifacts
+        ModelImportOptions options;
+        options.generateLods = false;
+        const auto noLods = cache.import(path, options);
+        REQUIRE_FALSE(noLods->fromCache);
+        REQUIRE(noLods->key != first->key);
+        REQUIRE(noLods->meshes.at("upper").lods.empty());
+        keys.push_back(noLods->key);
+        REQUIRE(cache.hit_count() == 2);
+        REQUIRE(cache.miss_count() == 2);
+    }
+
+    // Records and artifacts outlive the cache object
+    {
+        ModelImportCache cache(directory, 1);
+        const auto reopened = cache.import(path);
+        REQUIRE(reopened->fromCache);
+        REQUIRE_FALSE(reopened->sourceHashed);
+        REQUIRE(reopened->key == keys[0]);
+
+        // A damaged artifact is rebuilt
+        const std::string lastMesh = cache.artifact_paths(keys[0]).back();
+        {
+            std::fstream file(lastMesh, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(-5, std::ios::end);
+            file.put(0x5a);
+        }
+        const auto rebuilt = cache.import(path);
+        REQUIRE_FALSE(rebuilt->fromCache);
+        require_same_meshes(rebuilt->meshes, reopened->meshes);
+
+        // So is one behind a damaged manifest, here claiming four billion meshes
+        const std::string manifest = cache.artifact_paths(keys[0]).front();
+        {
+            std::fstream file(manifest, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(4);
+            for (int i = 0; i < 4; ++i) file.put(char(0xff));
+        }
+        REQUIRE(cache.artifact_paths(keys[0]).empty());
+        const auto remanifested = cache.import(path);
+        REQUIRE_FALSE(remanifested->fromCache);
+        require_same_meshes(remanifested->meshes, reopened->meshes);
+        REQUIRE(cache.artifact_paths(keys[0]).front() == manifest);
+
+        // An edited source misses
+        write_supershape_obj(path, 24, 6);
+        set_file_age(path, 10);
+        const auto edited = cache.import(path);
+        REQUIRE_FALSE(edited->fromCache);
+        REQUIRE(edited->key != keys[0]);
+        keys.push_back(edited->key);
+
+        // Modified no earlier than its record was taken (here, dated in the future): never trusted
+        write_supershape_obj(path, 24, 7);
+        set_file_age(path, -100);
+        const auto racy = cache.import(path);
+        keys.push_back(racy->key);
+        const auto racyAgain = cache.import(path);
+        REQUIRE(racyAgain->fromCache);
+        REQUIRE(racyAgain->sourceHashed);
+
+        remove_artifacts(cache, keys, { path });
+    }
+    remove_directory(directory);
+}
+
+TEST_CASE("model import cache imports on worker threads")
+{
+    const std::string directory = "./model-import-cache-test-async";
+    const std::vector<std::string> paths = { "./model-import-cache-test-a.obj", "./model-import-cache-test-b.obj", "./model-import-cache-test-c.obj" };
+    for (size_t i = 0; i < paths.size(); ++i) write_supershape_obj(paths[i], 16, 3.0f + i);
+
+    ModelImportCache cache(directory, 2, 1);
+    std::vector<std::shared_future<ModelImportHandle>> pending;
+    for (auto & p : paths) pending.push_back(cache.request(p));
+
+    // A request already in flight is shared, not queued twice
+    auto duplicate = cache.request(paths[0]);
+    auto missing = cache.request("./model-import-cache-test-missing.obj");
+
+    std::vector<uint64_t> keys;
+    for (auto & p : pending)
+    {
+        const ModelImportHandle result = p.get();
+        REQUIRE(result);
+        REQUIRE(result->meshes.size() == 2);
+        keys.push_back(result->key);
+    }
+    REQUIRE(duplicate.get()->key == keys[0]);
+    REQUIRE_THROWS(missing.get());
+    REQUIRE(cache.miss_count() + cache.hit_count() == paths.size());
+
+    for (auto & p : paths) REQUIRE(cache.request(p).get()->fromCache);
+
+    remove_artifacts(cache, keys, paths);
+    remove_directory(directory);
+}
+
+TEST_CASE("model import cache benchmark", "[.][benchmark]")
+{
+    const std::string directory = "./model-import-cache-bench", path = "./model-import-cache-bench.obj";
+    write_supershape_obj(path, 300, 5);
+    set_file_age(path, 100);
+
+    ModelImportCache cache(directory);
+    auto time = [](const char * name, std::function<size_t()> fn)
+    {
+        SimpleTimer t;
+        t.start();
+        const size_t count = fn();
+        std::cout << name << ": " << t.microseconds().count() / 1000.0 << " ms" << std::endl;
+        REQUIRE(count > 0);
+    };
+
+    uint64_t key = 0;
+    time("import and process", [&]() { auto r = cache.import(path); key = r->key; return r->meshes.size(); });
+    time("cached, source rehashed", [&]() { cache.invalidate(path); return cache.import(path)->meshes.size(); });
+    time("cached", [&]() { return cache.import(path)->meshes.size(); });
+
+    remove_artifacts(cache, { key }, { path });
+    remove_directory(directory);
+}
@@ -0,0 +1,182 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "mesh_lod.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+using namespace avl;
+
+// Every triangle as a string of its corners' attributes, starting from its smallest corner, so two meshes
+// describe the same triangles exactly when their sorted lists are equal
+template<class M, class F>
+static std::vector<std::string> describe_triangles(const M & m, const std::vector<uint3> & faces, F corner)
+{
+    std::vector<std::string> result;
+    for (const auto & f : faces)
+    {
+        std::string c[3] = { corner(m, f.x), corner(m, f.y), corner(m, f.z) };
+        const int first = int(std::min_element(c, c + 3) - c);
+        result.push_back(c[first] + "|" + c[(first + 1) % 3] + "|" + c[(first + 2) % 3]);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static std::string mesh_corner(const runtime_mesh & m, uint32_t v)
+{
+    std::ostringstream s;
+    s << m.vertices[v] << m.normals[v] << m.texcoord0[v] << m.tangents[v];
+    return s.str();
+}
+
+static std::string skinned_corner(const runtime_skinned_mesh & m, uint32_t v)
+{
+    std::ostringstream s;
+    s << mesh_corner(m, v) << m.boneIndices[v] << m.boneWeights[v];
+    return s.str();
+}
+
+// Splits every triangle into its own vertices and shuffles the triangles, as an unoptimized export would be
+template<class M>
+static M make_triangle_soup(const M & input, uint32_t seed)
+{
+    std::vector<uint3> faces = input.faces;
+    std::shuffle(faces.begin(), faces.end(), std::mt19937(seed));
+
+    M soup = input;
+    soup.vertices.clear(); soup.normals.clear(); soup.texcoord0.clear(); soup.tangents.clear(); soup.bitangents.clear();
+    soup.faces.clear();
+    for (const auto & f : faces)
+    {
+        const uint32_t base = (uint32_t) soup.vertices.size();
+        for (int c = 0; c < 3; ++c)
+        {
+            soup.vertices.push_back(input.vertices[f[c]]);
+            soup.normals.push_back(input.normals[f[c]]);
+            soup.texcoord0.push_back(input.texcoord0[f[c]]);
+            soup.tangents.push_back(input.tangents[f[c]]);
+            soup.bitangents.push_back(input.bitangents[f[c]]);
+        }
+        soup.faces.push_back(uint3(base, base + 1, base + 2));
+    }
+    return soup;
+}
+
+TEST_CASE("optimize_model remaps every vertex stream together")
+{
+    const Geometry torus = make_torus(32);
+    Geometry soup = make_triangle_soup(torus, 1);
+    const auto expected = describe_triangles(soup, soup.faces, mesh_corner);
+
+    const mesh_optimization_stats stats = optimize_model(soup);
+
+    REQUIRE(stats.verticesBefore == torus.faces.size() * 3);
+    REQUIRE(stats.verticesAfter == torus.vertices.size());
+    REQUIRE(soup.vertices.size() == torus.vertices.size());
+    REQUIRE(soup.normals.size() == soup.vertices.size());
+    REQUIRE(soup.bitangents.size() == soup.vertices.size());
+    REQUIRE(describe_triangles(soup, soup.faces, mesh_corner) == expected);
+
+    REQUIRE(stats.acmrAfter < stats.acmrBefore);
+    REQUIRE(stats.acmrAfter < 1.0f);
+    REQUIRE(stats.atvrAfter < 1.6f);
+
+    // Vertices are numbered in order of first use
+    uint32_t next = 0;
+    for (const auto & f : soup.faces) for (int c = 0; c < 3; ++c) if (f[c] >= next) REQUIRE(f[c] == next++);
+}
+
+TEST_CASE("optimize_model carries skin data and lods and groups materials")
+{
+    const Geometry torus = make_torus(24);
+
+    runtime_skinned_mesh skinned;
+    static_cast<runtime_mesh &>(skinned) = torus;
+    for (size_t v = 0; v < torus.vertices.size(); ++v)
+    {
+        skinned.boneIndices.push_back(int4(int(v % 7), int(v % 5), 0, 0));
+        skinned.boneWeights.push_back(float4(0.75f, 0.25f, 0, 0));
+    }
+    for (size_t f = 0; f < torus.faces.size(); ++f) skinned.material.push_back(uint32_t(f % 3));
+    generate_lod_chain(skinned);
+    REQUIRE(!skinned.lods.empty());
+
+    auto with_material = [](const runtime_skinned_mesh & m)
+    {
+        std::vector<std::string> result;
+        for (size_t f = 0; f < m.faces.size(); ++f)
+        {
+            std::vector<uint3> one = { m.faces[f] };
+            result.push_back(describe_triangles(m, one, skinned_corner)[0] + "#" + std::to_string(m.material[f]));
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    const auto expected = with_material(skinned);
+    const auto expectedLod = describe_triangles(skinned, skinned.lods.back().faces, skinned_corner);
+
+    mesh_optimization_options options;
+    options.buildMeshlets = true;
+    optimize_model(skinned, options);
+
+    REQUIRE(skinned.boneIndices.size() == skinned.vertices.size());
+    REQUIRE(with_material(skinned) == expected);
+    REQUIRE(describe_triangles(skinned, skinned.lods.back().faces, skinned_corner) == expectedLod);
+    REQUIRE(std::is_sorted(skinned.material.begin(), skinned.material.end()));
+
+    // Meshlets cover the faces in order, within their limits, without crossing materials
+    size_t face = 0;
+    for (const auto & meshlet : skinned.meshlets)
+    {
+        REQUIRE(meshlet.vertexCount <= options.meshletMaxVertices);
+        REQUIRE(meshlet.triangleCount <= options.meshletMaxTriangles);
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t, ++face)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint8_t local = skinned.meshletTriangles[(meshlet.triangleOffset + t) * 3 + c];
+                REQUIRE(local < meshlet.vertexCount);
+                REQUIRE(skinned.meshletVertices[meshlet.vertexOffset + local] == skinned.faces[face][c]);
+            }
+            REQUIRE(skinned.material[face] == skinned.material[meshlet.triangleOffset]);
+        }
+    }
+    REQUIRE(face == skinned.faces.size());
+}
+
+TEST_CASE("optimize_models runs meshes in parallel")
+{
+    std::map<std::string, runtime_mesh> meshes = { { "torus", make_triangle_soup(make_torus(20), 2) }, { "capsule", make_capsule(16, 1.0f, 2.0f) }, { "ring", make_3d_ring() } };
+    for (auto & m : meshes) if (m.second.tangents.size() != m.second.vertices.size()) m.second.tangents.clear(), m.second.bitangents.clear();
+    auto serial = meshes;
+
+    const auto stats = optimize_models(meshes, mesh_optimization_options(), 3);
+    REQUIRE(stats.size() == 3);
+    for (auto & m : serial)
+    {
+        const auto s = optimize_model(m.second);
+        REQUIRE(stats.at(m.first).acmrAfter == s.acmrAfter);
+        REQUIRE(meshes[m.first].faces == m.second.faces);
+        REQUIRE(meshes[m.first].vertices == m.second.vertices);
+    }
+}
+
+TEST_CASE("optimize_model statistics on a large scrambled mesh", "[.][benchmark]")
+{
+    Geometry soup = make_triangle_soup(make_torus(400), 3);
+
+    mesh_optimization_options options;
+    options.buildMeshlets = true;
+
+    SimpleTimer t(true);
+    const auto stats = optimize_model(soup, options);
+    std::cout << soup.faces.size() << " triangles in " << t.microseconds().count() * 1e-3 << " ms: vertices " << stats.verticesBefore << " -> " << stats.verticesAfter
+        << ", acmr " << stats.acmrBefore << " -> " << stats.acmrAfter << ", atvr " << stats.atvrBefore << " -> " << stats.atvrAfter << ", " << stats.meshletCount << " meshlets" << std::endl;
+}
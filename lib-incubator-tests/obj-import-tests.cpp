@@ -0,0 +1,213 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "geometry.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace avl;
+
+template<class T> static bool same_bytes(const std::vector<T> & a, const std::vector<T> & b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static void require_same_meshes(const std::map<std::string, runtime_mesh> & a, const std::map<std::string, runtime_mesh> & b)
+{
+    REQUIRE(a.size() == b.size());
+    for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib)
+    {
+        REQUIRE(ia->first == ib->first);
+        REQUIRE(same_bytes(ia->second.vertices, ib->second.vertices));
+        REQUIRE(same_bytes(ia->second.normals, ib->second.normals));
+        REQUIRE(same_bytes(ia->second.texcoord0, ib->second.texcoord0));
+        REQUIRE(same_bytes(ia->second.faces, ib->second.faces));
+        REQUIRE(same_bytes(ia->second.material, ib->second.material));
+    }
+}
+
+// Exporters mostly write fixed six-digit reals; the other forms take tinyobj's slower paths
+static std::string format_real(std::mt19937 & rng, bool mixedFormats, float v)
+{
+    char buf[64];
+    switch (mixedFormats ? rng() % 5 : 4)
+    {
+    case 0: snprintf(buf, sizeof(buf), "%.4f", v); break;
+    case 1: snprintf(buf, sizeof(buf), "%.9f", v); break;   // more digits than the power table covers
+    case 2: snprintf(buf, sizeof(buf), "%e", v); break;
+    case 3: snprintf(buf, sizeof(buf), "%g", v); break;
+    default: snprintf(buf, sizeof(buf), "%.6f", v); break;
+    }
+    return buf;
+}
+
+// Writes a scene the way common exporters do: groups and objects, material switches, polygons,
+// relative indices, normals without texcoords and positions repeated under new indices
+static void write_test_obj(const std::string & path, uint32_t groups, uint32_t gridSize, uint32_t seed, bool mixedFormats = true)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::ofstream obj(path, std::ios::binary);
+    std::ofstream mtl(path + ".mtl", std::ios::binary);
+    for (const char * m : { "stone", "wood", "cloth" }) mtl << "newmtl " << m << "\nKd 0.5 0.5 0.5\n\n";
+
+    const std::string mtlName = path.substr(path.find_last_of("/\\") + 1) + ".mtl";
+    obj << "# generated\nmtllib " << mtlName << "\n";
+
+    const char * materials[] = { "stone", "wood", "cloth", "missing" };
+    int totalPositions = 0, total = 0;
+    for (uint32_t gi = 0; gi < groups; ++gi)
+    {
+        const char * eol = (gi % 3 == 1) ? "\r\n" : "\n";
+        if (gi % 4 == 3) obj << "o object_" << (gi % 5) << eol;
+        else obj << "g group_" << (gi % 5) << " extra" << eol;
+        obj << "usemtl " << materials[rng() % 4] << eol;
+
+        const uint32_t n = gridSize + 1;
+        for (uint32_t y = 0; y < n; ++y)
+        {
+            for (uint32_t x = 0; x < n; ++x)
+            {
+                const float h = dist(rng);
+                obj << "v " << format_real(rng, mixedFormats, float(x)) << " " << format_real(rng, mixedFormats, h) << " " << format_real(rng, mixedFormats, float(y)) << eol;
+                obj << "vt " << format_real(rng, mixedFormats, x / float(gridSize)) << "\t" << format_real(rng, mixedFormats, y / float(gridSize)) << eol;
+                const float3 nrm = normalize(float3(dist(rng), 100.0f, dist(rng)));
+                obj << "vn " << format_real(rng, mixedFormats, nrm.x) << " " << format_real(rng, mixedFormats, nrm.y) << " " << format_real(rng, mixedFormats, nrm.z) << eol;
+            }
+        }
+        // A repeated position, to be merged with the original by value
+        obj << "v 0 " << format_real(rng, mixedFormats, 1.0f) << " 0" << eol;
+
+        // Positions have one more element per group than texcoords and normals
+        const bool relative = (gi % 2) == 0, withTexcoords = (gi % 5) != 2;
+        auto index = [&](int local, int groupCount, int before) { return std::to_string(relative ? local - groupCount : before + local + 1); };
+        auto corner = [&](uint32_t x, uint32_t y)
+        {
+            const int local = int(y * n + x);
+            const std::string attribute = index(local, int(n * n), total);
+            return index(local, int(n * n + 1), totalPositions) + (withTexcoords ? "/" + attribute + "/" : "//") + attribute;
+        };
+
+        for (uint32_t y = 0; y < gridSize; ++y)
+        {
+            for (uint32_t x = 0; x < gridSize; ++x)
+            {
+                if ((x + y) % 7 == 3) obj << "usemtl " << materials[rng() % 4] << eol;
+                if ((x + y) % 3 == 0) obj << "f " << corner(x, y) << " " << corner(x + 1, y) << " " << corner(x + 1, y + 1) << " " << corner(x, y + 1) << eol;
+                else if ((x + y) % 3 == 1) obj << "f  " << corner(x, y) << "   " << corner(x + 1, y) << " " << corner(x + 1, y + 1) << eol << "f " << corner(x, y) << " " << corner(x + 1, y + 1) << " " << corner(x, y + 1) << " " << eol;
+                else obj << "f " << corner(x, y) << " " << corner(x + 1, y) << " " << corner(x + 1, y + 1) << " " << corner(x, y + 1) << " " << corner(x, y) << eol;
+            }
+        }
+        obj << "f " << index(int(n * n), int(n * n + 1), totalPositions) << "//" << index(0, int(n * n), total) << " " << corner(1, 0) << " " << corner(1, 1) << eol;
+        totalPositions += int(n * n) + 1;
+        total += int(n * n);
+
+        // A trailing material switch that leaves nothing pending
+        if (gi % 6 == 5) obj << "usemtl " << materials[rng() % 4] << eol;
+    }
+}
+
+TEST_CASE("native obj import matches tinyobj byte for byte")
+{
+    const std::string path = "./obj-import-test.obj";
+    write_test_obj(path, 12, 12, 7);
+
+    const auto reference = import_obj_model_tinyobj(path);
+    REQUIRE(reference.size() == 8);
+    require_same_meshes(import_obj_model(path), reference);
+    require_same_meshes(import_obj_model(path, 1), reference);
+
+    std::remove(path.c_str());
+    std::remove((path + ".mtl").c_str());
+}
+
+TEST_CASE("native obj import follows tinyobj on unusual files")
+{
+    // Faces before any group, old Mac line ends, colors and w components, tabs, exponents, a bare g,
+    // an o that flushes nothing, repeated usemtl and a file that ends without a line break
+    const std::string path = "./obj-import-test-unusual.obj";
+    {
+        std::ofstream mtl(path + ".mtl", std::ios::binary);
+        mtl << "newmtl a\nnewmtl b\nnewmtl a\n";
+        std::ofstream obj(path, std::ios::binary);
+        obj << "mtllib missing.mtl obj-import-test-unusual.obj.mtl\n"
+            << "v 0 0 0 1 0 0\rv 1 0 0\r\nv\t1 1 0\nv 0 1e0 0\nv 0 0 1.5E+1 2\nv -0 -0.0 +2.\n"
+            << "vt 0 0 0\nvt 1\nvt .5 -.5\nvn 0 0 1\nvn 0 1 0\n"
+            << "f 1/1/1 2/2/1 3/3/1\n  f\t1/1/1 3/3/1 4/1/1\n# comment\n"
+            << "usemtl b\nusemtl b\nf -4//-2 -3//-2 -2//-1\n"
+            << "g\nf 1//1 2//1 3//1\nusemtl a\nf 1/1/2 2/2/2 6/3/2\no first\nusemtl b\no second\nf 4//2 5//2 6//2 1//1\n"
+            << "g tagged group\nusemtl none\nf 6/3/2 5/2/2 4/1/2\nusemtl a";
+    }
+
+    const auto reference = import_obj_model_tinyobj(path);
+    REQUIRE(reference.size() == 3); // "first" is dropped, and the unnamed shapes share a mesh
+    require_same_meshes(import_obj_model(path), reference);
+
+    std::remove(path.c_str());
+    std::remove((path + ".mtl").c_str());
+}
+
+TEST_CASE("native obj import resolves relative indices across chunks")
+{
+    // Large enough for many chunks, each starting mid-group
+    const std::string path = "./obj-import-test-chunks.obj";
+    write_test_obj(path, 40, 48, 11);
+
+    const auto reference = import_obj_model_tinyobj(path);
+    for (uint32_t threads : { 1u, 4u, 16u }) require_same_meshes(import_obj_model(path, threads), reference);
+
+    std::remove(path.c_str());
+    std::remove((path + ".mtl").c_str());
+}
+
+TEST_CASE("native obj import rejects bad face indices")
+{
+    const std::string path = "obj-import-test-bad.obj";
+    for (const char * face : { "f 1 2 0\n", "f 1 2 9\n", "f 1 2 -9\n", "f 1/1/1 2/1/1 3/9/1\n" })
+    {
+        {
+            std::ofstream obj(path, std::ios::binary);
+            obj << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n" << face;
+        }
+        REQUIRE_THROWS(import_obj_model(path));
+    }
+    REQUIRE(import_obj_model("obj-import-test-missing.obj").empty());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("obj import benchmark", "[.][benchmark]")
+{
+    // Sponza-sized: about 400 groups and 300k triangles
+    const std::string path = "./obj-import-bench.obj";
+    write_test_obj(path, 400, 20, 3, false);
+
+    auto time = [](const char * name, std::function<size_t()> fn)
+    {
+        SimpleTimer t;
+        t.start();
+        size_t count = 0;
+        for (int r = 0; r < 3; ++r) count += fn();
+        std::cout << name << ": " << t.microseconds().count() / 3000.0 << " ms" << std::endl;
+        REQUIRE(count > 0);
+    };
+
+    auto triangles = [](const std::map<std::string, runtime_mesh> & meshes)
+    {
+        size_t count = 0;
+        for (auto & m : meshes) count += m.second.faces.size();
+        return count;
+    };
+
+    std::cout << triangles(import_obj_model(path)) << " triangles" << std::endl;
+    time("tinyobj", [&]() { return triangles(import_obj_model_tinyobj(path)); });
+    time("native, one thread", [&]() { return triangles(import_obj_model(path, 1)); });
+    time("native", [&]() { return triangles(import_obj_model(path)); });
+
+    std::remove(path.c_str());
+    std::remove((path + ".mtl").c_str());
+}
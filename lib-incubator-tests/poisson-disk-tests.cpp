@@ -0,0 +1,99 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "poisson_disk.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+using namespace avl;
+
+template<class T> float min_separation(const std::vector<T> & points)
+{
+    float minDist2 = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < points.size(); ++i)
+        for (size_t j = i + 1; j < points.size(); ++j)
+            minDist2 = std::min(minDist2, distance2(points[i], points[j]));
+    return std::sqrt(minDist2);
+}
+
+TEST_CASE("tiled poisson disk 2d respects separation and bounds")
+{
+    const Bounds2D bounds(float2(-20, -10), float2(30, 25));
+    poisson::TiledPoissonDiskGenerator2D gen;
+    gen.tileSize = 4;
+    auto points = gen.build(bounds, 1.0f, 1234);
+
+    // A maximal distribution at separation r covers roughly 0.55 to 0.7 points per r^2
+    REQUIRE(points.size() > size_t(0.5f * bounds.area()));
+    REQUIRE(min_separation(points) >= 1.0f);
+    for (auto & p : points) REQUIRE(bounds.contains(p));
+}
+
+TEST_CASE("tiled poisson disk 3d respects separation and bounds")
+{
+    const Bounds3D bounds(float3(-4, -4, -4), float3(6, 5, 4));
+    auto points = poisson::make_tiled_poisson_disk_distribution(bounds, 1.0f, 77);
+
+    REQUIRE(points.size() > size_t(0.3f * bounds.volume()));
+    REQUIRE(min_separation(points) >= 1.0f);
+    for (auto & p : points) REQUIRE(bounds.contains(p));
+}
+
+TEST_CASE("tiled poisson disk output only depends on the seed")
+{
+    const Bounds2D bounds(float2(0, 0), float2(80, 80));
+
+    poisson::TiledPoissonDiskGenerator2D serial;
+    serial.numThreads = 1;
+    poisson::TiledPoissonDiskGenerator2D threaded;
+    threaded.numThreads = 8;
+
+    auto a = serial.build(bounds, 0.5f, 42);
+    auto b = threaded.build(bounds, 0.5f, 42);
+    auto c = threaded.build(bounds, 0.5f, 43);
+
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+
+    poisson::TiledPoissonDiskGenerator3D serial3;
+    serial3.numThreads = 1;
+    poisson::TiledPoissonDiskGenerator3D threaded3;
+    REQUIRE(serial3.build(Bounds3D(float3(0.f), float3(12.f)), 0.5f, 9) == threaded3.build(Bounds3D(float3(0.f), float3(12.f)), 0.5f, 9));
+}
+
+TEST_CASE("tiled poisson disk honors the rejection function")
+{
+    poisson::TiledPoissonDiskGenerator2D gen;
+    gen.boundsFunction = [](const float2 & p) { return length(p) > 10.f; };
+    auto points = gen.build(Bounds2D(float2(-12, -12), float2(12, 12)), 1.0f, 5);
+    REQUIRE(points.size() > 0);
+    for (auto & p : points) REQUIRE(length(p) <= 10.f);
+}
+
+TEST_CASE("poisson disk points per second", "[.][benchmark]")
+{
+    const Bounds2D area(float2(0, 0), float2(2048, 2048));
+    const Bounds3D volume(float3(0.f), float3(128.f));
+
+    for (uint32_t threads : { 1u, hardware_thread_count() })
+    {
+        poisson::TiledPoissonDiskGenerator2D gen2;
+        gen2.numThreads = threads;
+        SimpleTimer t(true);
+        const size_t n2 = gen2.build(area, 1.0f, 1).size();
+        const double s2 = t.microseconds().count() * 1e-6;
+
+        poisson::TiledPoissonDiskGenerator3D gen3;
+        gen3.numThreads = threads;
+        t.start();
+        const size_t n3 = gen3.build(volume, 1.0f, 1).size();
+        const double s3 = t.microseconds().count() * 1e-6;
+
+        std::cout << "tiled 2d (" << threads << " threads): " << n2 << " points, " << (n2 / s2) << " points/sec" << std::endl;
+        std::cout << "tiled 3d (" << threads << " threads): " << n3 << " points, " << (n3 / s3) << " points/sec" << std::endl;
+    }
+
+    SimpleTimer t(true);
+    const size_t legacy = poisson::make_poisson_disk_distribution(Bounds2D(float2(0, 0), float2(256, 256)), {}, 30, 1.0f).size();
+    std::cout << "legacy 2d (1 thread): " << legacy << " points, " << (legacy / (t.microseconds().count() * 1e-6)) << " points/sec" << std::endl;
+}
@@ -0,0 +1,142 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh_cache.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <atomic>
+
+using namespace avl;
+
+static std::atomic<int> countedCalls(0);
+
+static Geometry make_counted_quad(float size, int fail)
+{
+    ++countedCalls;
+    if (fail) throw std::runtime_error("generator failed");
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    Geometry g;
+    g.vertices = { { 0, 0, 0 }, { size, 0, 0 }, { size, size, 0 }, { 0, size, 0 } };
+    g.faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+    return g;
+}
+
+TEST_CASE("procedural mesh cache shares geometry for identical generator arguments")
+{
+    ProceduralMeshCache cache(1 << 20, 1);
+
+    const auto a = cache.get(make_sphere, 1.0f);
+    const auto b = cache.get(make_sphere, 1); // converted to the parameter type before keying
+    const auto c = cache.get(make_sphere, 2.0f);
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+    REQUIRE(a->vertices == make_sphere(1.0f).vertices);
+    REQUIRE(cache.hit_count() == 1);
+    REQUIRE(cache.miss_count() == 2);
+
+    // Same arguments through a different generator are a different key
+    const auto s1 = cache.get(make_supershape_3d, 16, 5, 7, 4, 12, 1.0f, 1.0f);
+    const auto s2 = cache.get(make_supershape_3d, 16, 5.0f, 7.0f, 4.0f, 12.0f, 1.0f, 1.0f);
+    REQUIRE(s1 == s2);
+    REQUIRE(s1->faces == make_supershape_3d(16, 5, 7, 4, 12).faces);
+    REQUIRE(make_procedural_mesh_key(make_icosasphere, 2) != make_procedural_mesh_key(make_torus, 2));
+
+    REQUIRE(cache.entry_count() == 3);
+    REQUIRE(cache.size_bytes() == geometry_size_bytes(*a) + geometry_size_bytes(*c) + geometry_size_bytes(*s1));
+}
+
+TEST_CASE("procedural mesh cache generates requests once on worker threads")
+{
+    ProceduralMeshCache cache(1 << 20, 3);
+    countedCalls = 0;
+
+    std::vector<std::shared_future<GeometryHandle>> results;
+    for (int i = 0; i < 12; ++i) results.push_back(cache.request(make_counted_quad, float(i % 4), 0));
+    REQUIRE(cache.try_get(make_procedural_mesh_key(make_counted_quad, 9.0f, 0)) == nullptr);
+
+    for (int i = 0; i < 12; ++i)
+    {
+        const GeometryHandle g = results[i].get();
+        REQUIRE(g == results[i % 4].get());
+        REQUIRE(g->vertices[2] == float3(float(i % 4), float(i % 4), 0));
+    }
+    REQUIRE(countedCalls == 4);
+
+    // A synchronous get waits for the worker rather than generating again
+    const auto pending = cache.request(make_counted_quad, 10.0f, 0);
+    REQUIRE(cache.get(make_counted_quad, 10.0f, 0) == pending.get());
+    REQUIRE(countedCalls == 5);
+    REQUIRE(cache.try_get(make_procedural_mesh_key(make_counted_quad, 10.0f, 0)) == pending.get());
+}
+
+TEST_CASE("procedural mesh cache evicts least recently used geometry over its budget")
+{
+    const size_t quadBytes = geometry_size_bytes(make_counted_quad(1.0f, 0));
+    ProceduralMeshCache cache(quadBytes * 3, 1);
+
+    const auto held = cache.get(make_counted_quad, 1.0f, 0);
+    cache.get(make_counted_quad, 2.0f, 0);
+    cache.get(make_counted_quad, 3.0f, 0);
+    cache.get(make_counted_quad, 1.0f, 0); // 2 is now the oldest
+    cache.get(make_counted_quad, 4.0f, 0);
+
+    REQUIRE(cache.entry_count() == 3);
+    REQUIRE(cache.size_bytes() == quadBytes * 3);
+    REQUIRE_FALSE(cache.contains(make_procedural_mesh_key(make_counted_quad, 2.0f, 0)));
+    REQUIRE(cache.contains(make_procedural_mesh_key(make_counted_quad, 1.0f, 0)));
+
+    // Handles outlive eviction
+    cache.set_budget(0);
+    REQUIRE(cache.entry_count() == 0);
+    REQUIRE(held->vertices.size() == 4);
+
+    // Failures reach the caller and are not cached
+    countedCalls = 0;
+    REQUIRE_THROWS(cache.get(make_counted_quad, 1.0f, 1));
+    REQUIRE_THROWS(cache.request(make_counted_quad, 1.0f, 1).get());
+    REQUIRE(countedCalls == 2);
+    REQUIRE(cache.entry_count() == 0);
+}
+
+TEST_CASE("procedural mesh cache keeps a result larger than its budget until the next one")
+{
+    const size_t quadBytes = geometry_size_bytes(make_counted_quad(1.0f, 0));
+    ProceduralMeshCache cache(quadBytes / 2, 1);
+    countedCalls = 0;
+
+    // A caller polling request() for an oversized result gets it, rather than a regeneration every poll
+    const auto first = cache.request(make_counted_quad, 1.0f, 0).get();
+    REQUIRE(cache.request(make_counted_quad, 1.0f, 0).get() == first);
+    REQUIRE(cache.get(make_counted_quad, 1.0f, 0) == first);
+    REQUIRE(countedCalls == 1);
+    REQUIRE(cache.entry_count() == 1);
+    REQUIRE(cache.size_bytes() == quadBytes);
+
+    // The next result displaces it
+    cache.get(make_counted_quad, 2.0f, 0);
+    REQUIRE(cache.entry_count() == 1);
+    REQUIRE_FALSE(cache.contains(make_procedural_mesh_key(make_counted_quad, 1.0f, 0)));
+    REQUIRE(countedCalls == 2);
+}
+
+TEST_CASE("procedural mesh cache supershape scrubbing", "[.][benchmark]")
+{
+    ProceduralMeshCache cache(256 * 1024 * 1024);
+
+    // A slider swept back and forth over 30 values, once per frame
+    std::vector<int> frames;
+    for (int sweep = 0; sweep < 10; ++sweep)
+        for (int m = 1; m <= 30; ++m) frames.push_back(sweep % 2 ? 31 - m : m);
+
+    SimpleTimer t(true);
+    size_t sink = 0;
+    for (int m : frames) sink += make_supershape_3d(32, float(m), 7, 4, 12).vertices.size();
+    const double uncached = t.microseconds().count() * 1e-3;
+
+    t.start();
+    for (int m : frames) sink += cache.get(make_supershape_3d, 32, m, 7, 4, 12, 1.0f, 1.0f)->vertices.size();
+    const double cached = t.microseconds().count() * 1e-3;
+
+    std::cout << frames.size() << " frames of supershape scrubbing: regenerate " << uncached << " ms, memoized " << cached << " ms (" << cache.size_bytes() / 1024 << " KB cached, checksum " << sink << ")" << std::endl;
+}
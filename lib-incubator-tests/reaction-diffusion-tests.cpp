@@ -0,0 +1,190 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "reaction_diffusion.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <cstring>
+
+using namespace avl;
+
+template<typename T>
+static double max_difference(GrayScottSimulator & reference, const FastGrayScottSimulator<T> & fast, uint32_t w, uint32_t h)
+{
+    double err = 0.0;
+    for (uint32_t y = 0; y < h; ++y)
+    {
+        for (uint32_t x = 0; x < w; ++x)
+        {
+            err = std::max(err, std::abs(reference.u_parameter_at(x, y) - double(fast.u_parameter_at(x, y))));
+            err = std::max(err, std::abs(reference.v_parameter_at(x, y) - double(fast.v_parameter_at(x, y))));
+        }
+    }
+    return err;
+}
+
+template<typename T>
+static double run_against_reference(bool tile, uint32_t steps, uint32_t threads)
+{
+    const uint32_t w = 67, h = 45; // odd sizes exercise the masked tail of the SIMD rows
+
+    GrayScottSimulator reference(float2((float) w, (float) h), tile);
+    FastGrayScottSimulator<T> fast(uint2(w, h), tile);
+    fast.numThreads = threads;
+    fast.bandHeight = 4;
+
+    // Straddle the right edge so the periodic boundary carries the pattern
+    reference.trigger_region(w - 4, h / 2, 12, 10);
+    fast.trigger_region(w - 4, h / 2, 12, 10);
+    reference.trigger_region(20, 10, 6, 6);
+    fast.trigger_region(20, 10, 6, 6);
+
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+        reference.update(1.0);
+        fast.step(1.0);
+    }
+    return max_difference(reference, fast, w, h);
+}
+
+TEST_CASE("fast gray-scott in double precision matches the reference simulator")
+{
+    REQUIRE(run_against_reference<double>(false, 500, 1) < 1e-9);
+    REQUIRE(run_against_reference<double>(true, 500, 1) < 1e-9);
+    REQUIRE(run_against_reference<double>(true, 500, 4) < 1e-9);
+}
+
+TEST_CASE("fast gray-scott in single precision tracks the reference simulator")
+{
+    REQUIRE(run_against_reference<float>(false, 500, 1) < 1e-3);
+    REQUIRE(run_against_reference<float>(true, 500, 4) < 1e-3);
+}
+
+TEST_CASE("fast gray-scott results do not depend on thread count")
+{
+    FastGrayScottSimulator<float> a(uint2(128, 96), true), b(uint2(128, 96), true);
+    a.numThreads = 1;
+    b.numThreads = 3;
+    a.bandHeight = b.bandHeight = 5;
+    a.trigger_region(64, 48, 20, 20);
+    b.trigger_region(64, 48, 20, 20);
+    for (int i = 0; i < 200; ++i) { a.step(1.0); b.step(1.0); }
+    REQUIRE(a.output_u() == b.output_u());
+    REQUIRE(a.output_v() == b.output_v());
+}
+
+// Index of the first cell that differs bitwise, or -1; keeps Catch from printing whole grids on failure
+template<typename T>
+static int64_t first_mismatch(const std::vector<T> & a, const std::vector<T> & b)
+{
+    if (a.size() != b.size()) return 0;
+    for (size_t i = 0; i < a.size(); ++i) if (std::memcmp(&a[i], &b[i], sizeof(T)) != 0) return int64_t(i);
+    return -1;
+}
+
+template<typename T>
+static void check_advance_matches_step(bool tile, uint32_t threads)
+{
+    const uint2 size(157, 93);
+    FastGrayScottSimulator<T> stepped(size, tile), advanced(size, tile);
+    advanced.numThreads = threads;
+    advanced.tileWidth = 40; // small tiles so the aprons cross tile and grid edges
+    advanced.tileHeight = 24;
+    advanced.tileSteps = 6;
+
+    for (auto * sim : { &stepped, &advanced })
+    {
+        sim->trigger_region(2, 3, 16, 16); // corner straddling region
+        sim->trigger_region(80, 50, 30, 20);
+    }
+
+    for (uint32_t n : { 1u, 5u, 6u, 37u })
+    {
+        for (uint32_t i = 0; i < n; ++i) stepped.step(1.0);
+        advanced.advance(n, 1.0);
+        INFO("tiled " << tile << ", " << threads << " threads, " << n << " steps");
+        REQUIRE(first_mismatch(stepped.output_u(), advanced.output_u()) == -1);
+        REQUIRE(first_mismatch(stepped.output_v(), advanced.output_v()) == -1);
+    }
+}
+
+TEST_CASE("temporally blocked advance is bit-identical to repeated steps")
+{
+    check_advance_matches_step<float>(true, 1);
+    check_advance_matches_step<float>(false, 1);
+    check_advance_matches_step<float>(true, 3);
+    check_advance_matches_step<double>(true, 2);
+    check_advance_matches_step<double>(false, 2);
+}
+
+TEST_CASE("temporally blocked advance treats zero tile sizes as one cell")
+{
+    const uint2 size(41, 29);
+    FastGrayScottSimulator<float> stepped(size, true), advanced(size, true);
+    advanced.tileWidth = 0;
+    advanced.tileHeight = 0;
+    advanced.tileSteps = 0;
+    for (auto * sim : { &stepped, &advanced }) sim->trigger_region(10, 8, 12, 10);
+
+    for (int i = 0; i < 7; ++i) stepped.step(1.0);
+    advanced.advance(7, 1.0);
+    REQUIRE(first_mismatch(stepped.output_u(), advanced.output_u()) == -1);
+    REQUIRE(first_mismatch(stepped.output_v(), advanced.output_v()) == -1);
+}
+
+TEST_CASE("gray-scott steps per second", "[.][benchmark]")
+{
+    const uint32_t n = 1024;
+    const int legacySteps = 10, fastSteps = 200;
+
+    GrayScottSimulator reference(float2((float) n, (float) n), true);
+    reference.trigger_region(n / 2, n / 2, 64, 64);
+    SimpleTimer t(true);
+    for (int i = 0; i < legacySteps; ++i) reference.update(1.0);
+    const double legacyRate = legacySteps / (t.microseconds().count() * 1e-6);
+    std::cout << "reference double (1 thread): " << legacyRate << " steps/sec" << std::endl;
+
+    for (uint32_t threads : { 1u, hardware_thread_count() })
+    {
+        FastGrayScottSimulator<float> fastF(uint2(n, n), true);
+        fastF.numThreads = threads;
+        fastF.trigger_region(n / 2, n / 2, 64, 64);
+        t.start();
+        for (int i = 0; i < fastSteps; ++i) fastF.step(1.0);
+        const double floatRate = fastSteps / (t.microseconds().count() * 1e-6);
+
+        FastGrayScottSimulator<double> fastD(uint2(n, n), true);
+        fastD.numThreads = threads;
+        fastD.trigger_region(n / 2, n / 2, 64, 64);
+        t.start();
+        for (int i = 0; i < fastSteps; ++i) fastD.step(1.0);
+        const double doubleRate = fastSteps / (t.microseconds().count() * 1e-6);
+
+        std::cout << "fast float (" << threads << " threads): " << floatRate << " steps/sec, " << (floatRate / legacyRate) << "x" << std::endl;
+        std::cout << "fast double (" << threads << " threads): " << doubleRate << " steps/sec, " << (doubleRate / legacyRate) << "x" << std::endl;
+    }
+}
+
+TEST_CASE("gray-scott temporal blocking throughput", "[.][benchmark]")
+{
+    for (uint32_t n : { 4096u, 8192u })
+    {
+        const uint32_t steps = 32;
+        const double bytesPerStep = 4.0 * double(n) * n * sizeof(float); // read and write both fields
+
+        FastGrayScottSimulator<float> sim(uint2(n, n), true);
+        sim.trigger_region(n / 2, n / 2, 256, 256);
+
+        SimpleTimer t(true);
+        for (uint32_t i = 0; i < steps; ++i) sim.step(1.0);
+        const double stepRate = steps / (t.microseconds().count() * 1e-6);
+
+        t.start();
+        sim.advance(steps, 1.0);
+        const double advanceRate = steps / (t.microseconds().count() * 1e-6);
+
+        std::cout << n << "^2 step:    " << stepRate << " steps/sec, " << (stepRate * bytesPerStep * 1e-9) << " GB/s effective" << std::endl;
+        std::cout << n << "^2 advance: " << advanceRate << " steps/sec, " << (advanceRate * bytesPerStep * 1e-9) << " GB/s effective" << std::endl;
+    }
+}
@@ -0,0 +1,78 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "sample_elimination.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+using namespace avl;
+
+static float min_separation(const std::vector<poisson::SurfaceSample> & samples, size_t count)
+{
+    float minDist2 = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < count; ++i)
+        for (size_t j = i + 1; j < count; ++j)
+            minDist2 = std::min(minDist2, distance2(samples[i].position, samples[j].position));
+    return std::sqrt(minDist2);
+}
+
+// Poisson disk radius of a maximal hexagonal packing of n samples over area a
+static float max_radius(float area, size_t n) { return std::sqrt(area / (2.0f * std::sqrt(3.0f) * n)); }
+
+TEST_CASE("sample elimination over a plane is blue noise at every power of two prefix")
+{
+    const Geometry plane = make_plane(10.f, 10.f, 8, 8);
+    const size_t count = 2048;
+    auto samples = poisson::make_mesh_poisson_disk_distribution(plane, count, 3);
+
+    REQUIRE(samples.size() == count);
+    for (auto & s : samples)
+    {
+        REQUIRE(std::abs(s.position.x) <= 5.0f);
+        REQUIRE(std::abs(s.position.y) <= 5.0f);
+        REQUIRE(std::abs(s.normal.z) == Approx(1.0f));
+    }
+
+    // Sample elimination typically reaches 0.7 - 0.8 of r_max; a random set would be far lower
+    for (size_t prefix : { count, count / 4, count / 32 })
+    {
+        REQUIRE(min_separation(samples, prefix) > 0.65f * max_radius(100.f, prefix));
+    }
+}
+
+TEST_CASE("sample elimination is deterministic and thread count independent")
+{
+    const Geometry sphere = make_sphere(1.0f);
+
+    poisson::MeshSampleEliminator serial;
+    serial.numThreads = 1;
+    poisson::MeshSampleEliminator threaded;
+    threaded.numThreads = 4;
+
+    auto a = serial.build(sphere, 500, 11);
+    auto b = threaded.build(sphere, 500, 11);
+    REQUIRE(a.size() == b.size());
+    for (size_t i = 0; i < a.size(); ++i) REQUIRE(a[i].position == b[i].position);
+}
+
+TEST_CASE("sample elimination follows a per-vertex density")
+{
+    const Geometry plane = make_plane(10.f, 10.f, 8, 8);
+
+    poisson::MeshSampleEliminator gen;
+    for (auto & v : plane.vertices) gen.vertexDensity.push_back(v.x < 0.0f ? 4.0f : 1.0f);
+    auto samples = gen.build(plane, 1000, 7);
+
+    size_t left = 0;
+    for (auto & s : samples) if (s.position.x < 0.0f) ++left;
+    REQUIRE(left > 650); // vertex densities are interpolated across the seam, so not the full 4:1
+}
+
+TEST_CASE("sample elimination of one million surface samples", "[.][benchmark]")
+{
+    const Geometry sphere = make_sphere(10.0f);
+    SimpleTimer t(true);
+    auto samples = poisson::make_mesh_poisson_disk_distribution(sphere, 1000000, 1);
+    std::cout << "sample elimination: " << samples.size() << " samples in " << t.milliseconds().count() << " ms" << std::endl;
+}
@@ -0,0 +1,239 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "simplex_noise.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <thread>
+
+using namespace avl;
+
+// SoA coordinates spread over positive and negative cells, with a count that leaves a partial block
+struct NoiseInputs
+{
+    std::vector<float> x, y, z;
+    NoiseInputs(size_t count, float extent)
+    {
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<float> d(-extent, extent);
+        for (size_t i = 0; i < count; ++i)
+        {
+            x.push_back(d(gen));
+            y.push_back(d(gen));
+            z.push_back(d(gen));
+        }
+    }
+};
+
+// Contraction into FMAs differs between the paths; fBm variants also amplify coordinate rounding through
+// the octave frequencies, so they are compared with fbTolerance
+static const float fbTolerance = 1e-3f;
+
+static bool close_to(float a, float b, float tolerance = 1e-4f)
+{
+    return std::abs(a - b) <= tolerance * std::max(1.0f, std::abs(b));
+}
+
+TEST_CASE("batched 2d simplex noise matches scalar noise")
+{
+    const NoiseInputs p(1003, 300.0f);
+    const size_t n = p.x.size();
+    std::vector<float> v(n), d(n), dx(n), dy(n), fb(n), fbd(n), fbdx(n), fbdy(n);
+
+    noise::noise_batch(p.x.data(), p.y.data(), v.data(), n);
+    noise::noise_deriv_batch(p.x.data(), p.y.data(), d.data(), dx.data(), dy.data(), n);
+    noise::noise_fb_batch(p.x.data(), p.y.data(), fb.data(), n, 5, 2.1f, 0.45f);
+    noise::noise_fb_deriv_batch(p.x.data(), p.y.data(), fbd.data(), fbdx.data(), fbdy.data(), n, 5, 2.1f, 0.45f);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const float2 q(p.x[i], p.y[i]);
+        REQUIRE(close_to(v[i], noise::noise(q)));
+
+        const float3 sd = noise::noise_deriv(q);
+        REQUIRE(close_to(d[i], sd.x));
+        REQUIRE(close_to(dx[i], sd.y));
+        REQUIRE(close_to(dy[i], sd.z));
+
+        REQUIRE(close_to(fb[i], noise::noise_fb(q, 5, 2.1f, 0.45f), fbTolerance));
+
+        const float3 sfd = noise::noise_fb_deriv(q, 5, 2.1f, 0.45f);
+        REQUIRE(close_to(fbd[i], sfd.x, fbTolerance));
+        REQUIRE(close_to(fbdx[i], sfd.y, fbTolerance));
+        REQUIRE(close_to(fbdy[i], sfd.z, fbTolerance));
+    }
+}
+
+TEST_CASE("batched 3d simplex noise matches scalar noise")
+{
+    const NoiseInputs p(1003, 300.0f);
+    const size_t n = p.x.size();
+    std::vector<float> v(n), d(n), dx(n), dy(n), dz(n), fb(n), fbd(n), fbdx(n), fbdy(n), fbdz(n);
+
+    noise::noise_batch(p.x.data(), p.y.data(), p.z.data(), v.data(), n);
+    noise::noise_deriv_batch(p.x.data(), p.y.data(), p.z.data(), d.data(), dx.data(), dy.data(), dz.data(), n);
+    noise::noise_fb_batch(p.x.data(), p.y.data(), p.z.data(), fb.data(), n);
+    noise::noise_fb_deriv_batch(p.x.data(), p.y.data(), p.z.data(), fbd.data(), fbdx.data(), fbdy.data(), fbdz.data(), n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const float3 q(p.x[i], p.y[i], p.z[i]);
+        REQUIRE(close_to(v[i], noise::noise(q)));
+
+        const float4 sd = noise::noise_deriv(q);
+        REQUIRE(close_to(d[i], sd.x));
+        REQUIRE(close_to(dx[i], sd.y));
+        REQUIRE(close_to(dy[i], sd.z));
+        REQUIRE(close_to(dz[i], sd.w));
+
+        REQUIRE(close_to(fb[i], noise::noise_fb(q), fbTolerance));
+
+        const float4 sfd = noise::noise_fb_deriv(q);
+        REQUIRE(close_to(fbd[i], sfd.x, fbTolerance));
+        REQUIRE(close_to(fbdx[i], sfd.y, fbTolerance));
+        REQUIRE(close_to(fbdy[i], sfd.z, fbTolerance));
+        REQUIRE(close_to(fbdz[i], sfd.w, fbTolerance));
+    }
+}
+
+TEST_CASE("batched simplex noise handles lattice-aligned inputs")
+{
+    // Integer and tied coordinates exercise the >= / > edges of the simplex ordering
+    std::vector<float> x, y, z;
+    for (int i = -3; i <= 3; ++i) for (int j = -3; j <= 3; ++j) for (int k = -1; k <= 1; ++k)
+    {
+        x.push_back(i * 0.5f); y.push_back(j * 0.5f); z.push_back(k * 0.5f);
+    }
+    std::vector<float> v2(x.size()), v3(x.size());
+    noise::noise_batch(x.data(), y.data(), v2.data(), x.size());
+    noise::noise_batch(x.data(), y.data(), z.data(), v3.data(), x.size());
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        REQUIRE(close_to(v2[i], noise::noise(float2(x[i], y[i]))));
+        REQUIRE(close_to(v3[i], noise::noise(float3(x[i], y[i], z[i]))));
+    }
+}
+
+TEST_CASE("default noise generator matches the free functions")
+{
+    const noise::NoiseGenerator gen;
+    const NoiseInputs p(200, 50.0f);
+    for (size_t i = 0; i < p.x.size(); ++i)
+    {
+        const float2 q2(p.x[i], p.y[i]);
+        const float3 q3(p.x[i], p.y[i], p.z[i]);
+        const float4 q4(p.x[i], p.y[i], p.z[i], p.y[i] - p.x[i]);
+        REQUIRE(gen.noise(p.x[i]) == noise::noise(p.x[i]));
+        REQUIRE(gen.noise(q2) == noise::noise(q2));
+        REQUIRE(gen.noise(q3) == noise::noise(q3));
+        REQUIRE(gen.noise(q4) == noise::noise(q4));
+        REQUIRE(gen.noise_deriv(q3) == noise::noise_deriv(q3));
+        REQUIRE(gen.noise_deriv(q4) == noise::noise_deriv(q4));
+        REQUIRE(gen.noise_worley(q3, 2.0f) == noise::noise_worley(q3, 2.0f));
+        REQUIRE(gen.noise_flow(q3, 0.7f) == noise::noise_flow(q3, 0.7f));
+        REQUIRE(gen.noise_flow_deriv(q2, 0.7f) == noise::noise_flow_deriv(q2, 0.7f));
+        REQUIRE(gen.noise_curl(q3) == noise::noise_curl(q3));
+        REQUIRE(gen.noise_fb(q4) == noise::noise_fb(q4));
+        REQUIRE(gen.noise_ridged_mf(q2) == noise::noise_ridged_mf(q2));
+        REQUIRE(gen.noise_iq_fb(q3) == noise::noise_iq_fb(q3));
+    }
+}
+
+TEST_CASE("seeded noise generators are independent permutations")
+{
+    const noise::NoiseGenerator a(1), b(2), c(1);
+    for (auto * g : { &a, &b })
+    {
+        const auto & perm = g->get_tables().perm;
+        std::vector<uint8_t> sorted(perm, perm + 256);
+        std::sort(sorted.begin(), sorted.end());
+        for (int i = 0; i < 256; ++i) REQUIRE(sorted[i] == i);
+        REQUIRE(std::equal(perm, perm + 256, perm + 256));
+    }
+
+    const float3 q(3.3f, -7.1f, 12.9f);
+    REQUIRE(a.noise(q) != b.noise(q));
+    REQUIRE(a.noise(q) == c.noise(q));
+
+    // Reseeding one instance leaves the others, including the default one, alone
+    noise::NoiseGenerator d(1);
+    d.reseed(2);
+    REQUIRE(d.noise(q) == b.noise(q));
+    REQUIRE(c.noise(q) == a.noise(q));
+    REQUIRE(noise::noise(q) == noise::NoiseGenerator().noise(q));
+
+    // Batched evaluation reads the instance tables too
+    const NoiseInputs p(37, 40.0f);
+    std::vector<float> out(p.x.size());
+    b.noise_batch(p.x.data(), p.y.data(), p.z.data(), out.data(), out.size());
+    for (size_t i = 0; i < out.size(); ++i) REQUIRE(close_to(out[i], b.noise(float3(p.x[i], p.y[i], p.z[i]))));
+}
+
+TEST_CASE("differently seeded noise generators run concurrently")
+{
+    const NoiseInputs p(4096, 100.0f);
+    const size_t n = p.x.size();
+    const uint32_t seeds[] = { 11, 22, 33, 44 };
+
+    auto evaluate = [&](uint32_t seed, std::vector<float> & out)
+    {
+        const noise::NoiseGenerator gen(seed);
+        out.resize(n * 2);
+        gen.noise_fb_batch(p.x.data(), p.y.data(), p.z.data(), out.data(), n, 5);
+        for (size_t i = 0; i < n; ++i) out[n + i] = gen.noise_ridged_mf(float2(p.x[i], p.y[i]));
+    };
+
+    std::vector<float> serial[4], threaded[4];
+    for (int s = 0; s < 4; ++s) evaluate(seeds[s], serial[s]);
+
+    std::vector<std::thread> threads;
+    for (int s = 0; s < 4; ++s) threads.emplace_back([&, s]() { evaluate(seeds[s], threaded[s]); });
+    for (auto & t : threads) t.join();
+
+    for (int s = 0; s < 4; ++s) REQUIRE(serial[s] == threaded[s]);
+    REQUIRE(serial[0] != serial[1]);
+}
+
+TEST_CASE("simplex noise points per second", "[.][benchmark]")
+{
+    const NoiseInputs p(1 << 20, 1000.0f);
+    const size_t n = p.x.size();
+    std::vector<float> out(n), dx(n), dy(n), dz(n);
+    float sink = 0.0f;
+
+    auto report = [&](const char * name, double scalarSeconds, double batchSeconds)
+    {
+        std::cout << name << ": scalar " << (n / scalarSeconds) << " points/sec, batch " << (n / batchSeconds) << " points/sec (" << (scalarSeconds / batchSeconds) << "x)" << std::endl;
+    };
+
+    SimpleTimer t(true);
+    for (size_t i = 0; i < n; ++i) sink += noise::noise(float2(p.x[i], p.y[i]));
+    double scalar = t.microseconds().count() * 1e-6;
+    t.start();
+    noise::noise_batch(p.x.data(), p.y.data(), out.data(), n);
+    report("2d noise", scalar, t.microseconds().count() * 1e-6);
+
+    t.start();
+    for (size_t i = 0; i < n; ++i) sink += noise::noise(float3(p.x[i], p.y[i], p.z[i]));
+    scalar = t.microseconds().count() * 1e-6;
+    t.start();
+    noise::noise_batch(p.x.data(), p.y.data(), p.z.data(), out.data(), n);
+    report("3d noise", scalar, t.microseconds().count() * 1e-6);
+
+    t.start();
+    for (size_t i = 0; i < n; ++i) sink += noise::noise_deriv(float3(p.x[i], p.y[i], p.z[i])).x;
+    scalar = t.microseconds().count() * 1e-6;
+    t.start();
+    noise::noise_deriv_batch(p.x.data(), p.y.data(), p.z.data(), out.data(), dx.data(), dy.data(), dz.data(), n);
+    report("3d noise_deriv", scalar, t.microseconds().count() * 1e-6);
+
+    t.start();
+    for (size_t i = 0; i < n; ++i) sink += noise::noise_fb(float2(p.x[i], p.y[i]));
+    scalar = t.microseconds().count() * 1e-6;
+    t.start();
+    noise::noise_fb_batch(p.x.data(), p.y.data(), out.data(), n);
+    report("2d noise_fb (4 octaves)", scalar, t.microseconds().count() * 1e-6);
+
+    std::cout << "(checksum " << sink + out[0] << ")" << std::endl;
+}
@@ -0,0 +1,272 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "skinning.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <iostream>
+#include <random>
+
+using namespace avl;
+
+static float4 random_rotation(std::mt19937 & rng)
+{
+    std::normal_distribution<float> dist;
+    return normalize(float4(dist(rng), dist(rng), dist(rng), dist(rng)));
+}
+
+static AnimationPose random_pose(std::mt19937 & rng, uint32_t boneCount)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    AnimationPose pose;
+    pose.resize(boneCount);
+    for (uint32_t b = 0; b < boneCount; ++b)
+    {
+        pose.rotations[b] = random_rotation(rng);
+        pose.translations[b] = float3(dist(rng), dist(rng), dist(rng));
+        pose.scales[b] = float3(1.0f + 0.2f * dist(rng), 1.0f + 0.2f * dist(rng), 1.0f + 0.2f * dist(rng));
+    }
+    return pose;
+}
+
+static float4x4 local_matrix(const AnimationPose & pose, uint32_t b)
+{
+    return mul(pose_matrix(pose.rotations[b], pose.translations[b]), scaling_matrix(pose.scales[b]));
+}
+
+// Full 4x4 products, walking up to the root for every bone
+static float4x4 reference_model_matrix(const std::vector<bone> & bones, const AnimationPose & pose, uint32_t b)
+{
+    const uint32_t parent = bones[b].parentIndex;
+    if (parent >= bones.size() || parent == b) return local_matrix(pose, b);
+    return mul(reference_model_matrix(bones, pose, parent), local_matrix(pose, b));
+}
+
+// A random tree, listed in shuffled order so some bones come before their parents, bound in a random rest pose
+static runtime_skinned_mesh make_test_skinned_mesh(std::mt19937 & rng, uint32_t boneCount, uint32_t vertexCount)
+{
+    std::vector<uint32_t> shuffled(boneCount);
+    for (uint32_t b = 0; b < boneCount; ++b) shuffled[b] = b;
+    std::shuffle(shuffled.begin() + 1, shuffled.end(), rng);
+    std::vector<uint32_t> slot(boneCount);
+    for (uint32_t b = 0; b < boneCount; ++b) slot[shuffled[b]] = b;
+
+    runtime_skinned_mesh mesh;
+    mesh.bones.resize(boneCount);
+    for (uint32_t t = 0; t < boneCount; ++t)
+    {
+        // Tree node t has a parent among nodes before it; the bone for node t sits at slot[t]
+        bone & b = mesh.bones[slot[t]];
+        b.name = "bone" + std::to_string(t);
+        b.parentIndex = t ? slot[rng() % t] : uint32_t(-1);
+    }
+
+    const AnimationPose rest = random_pose(rng, boneCount);
+    for (uint32_t b = 0; b < boneCount; ++b) mesh.bones[b].initialPose = local_matrix(rest, b);
+    for (uint32_t b = 0; b < boneCount; ++b) mesh.bones[b].bindPose = reference_model_matrix(mesh.bones, rest, b);
+
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        mesh.vertices.push_back(float3(dist(rng), dist(rng), dist(rng)) * 2.0f);
+        mesh.normals.push_back(normalize(float3(dist(rng), dist(rng), dist(rng)) + float3(0, 0, 2)));
+
+        // One to four influences; unused ones carry zero weight and sometimes an index of -1
+        const int used = 1 + int(rng() % 4);
+        int4 index;
+        float4 weight;
+        float sum = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            index[i] = i < used ? int(rng() % boneCount) : ((rng() % 2) ? -1 : 0);
+            weight[i] = i < used ? 0.1f + std::abs(dist(rng)) : 0.0f;
+            sum += weight[i];
+        }
+        mesh.boneIndices.push_back(index);
+        mesh.boneWeights.push_back(weight / sum);
+    }
+    return mesh;
+}
+
+static float max_difference(const std::vector<float3> & a, const std::vector<float3> & b)
+{
+    float e = 0;
+    for (size_t i = 0; i < a.size(); ++i) e = std::max(e, length(a[i] - b[i]));
+    return e;
+}
+
+TEST_CASE("skinning rig evaluates the hierarchy like the full matrix products")
+{
+    std::mt19937 rng(1);
+    const runtime_skinned_mesh mesh = make_test_skinned_mesh(rng, 40, 0);
+    const SkinningRig rig = make_skinning_rig(mesh.bones);
+
+    // Parents precede children in the evaluation order, though not in the bone list
+    std::vector<uint32_t> position(rig.bone_count());
+    for (uint32_t i = 0; i < rig.order.size(); ++i) position[rig.order[i]] = i;
+    bool listedBeforeParent = false;
+    for (uint32_t b = 0; b < rig.bone_count(); ++b)
+    {
+        if (rig.is_root(b)) continue;
+        REQUIRE(position[rig.parents[b]] < position[b]);
+        listedBeforeParent |= rig.parents[b] > b;
+    }
+    REQUIRE(listedBeforeParent);
+
+    const AnimationPose pose = random_pose(rng, 40);
+    std::vector<float4x4> model(40);
+    local_to_model(rig, pose, model.data());
+    for (uint32_t b = 0; b < 40; ++b)
+    {
+        const float4x4 expected = reference_model_matrix(mesh.bones, pose, b);
+        for (int c = 0; c < 4; ++c) REQUIRE(length(model[b][c] - expected[c]) < 1e-3f * (1.0f + length(expected[c])));
+    }
+
+    // The rest pose reproduces the bind pose, so its palette is the identity
+    std::vector<float4x4> palette;
+    make_skinning_palette(rig, rig.restPose, palette);
+    for (auto & m : palette) for (int c = 0; c < 4; ++c) REQUIRE(length(m[c] - Identity4x4[c]) < 1e-3f);
+
+    REQUIRE_THROWS(make_skinning_rig({ { "a", 1, {}, Identity4x4 }, { "b", 0, {}, Identity4x4 } }));
+}
+
+TEST_CASE("pose blending interpolates and layers additive differences")
+{
+    std::mt19937 rng(2);
+    const AnimationPose a = random_pose(rng, 30), b = random_pose(rng, 30), reference = random_pose(rng, 30);
+
+    AnimationPose out;
+    blend_poses(a, b, 0.0f, out);
+    REQUIRE(max_difference(out.translations, a.translations) == 0.0f);
+    blend_poses(a, b, 1.0f, out);
+    REQUIRE(max_difference(out.translations, b.translations) == 0.0f);
+    for (size_t i = 0; i < 30; ++i) REQUIRE(std::abs(dot(out.rotations[i], b.rotations[i])) == Approx(1.0f));
+    blend_poses(a, b, 0.25f, out);
+    for (size_t i = 0; i < 30; ++i)
+    {
+        REQUIRE(length(out.translations[i] - lerp(a.translations[i], b.translations[i], 0.25f)) < 1e-6f);
+        REQUIRE(std::abs(dot(out.rotations[i], qnlerp(a.rotations[i], b.rotations[i], 0.25f))) == Approx(1.0f));
+    }
+
+    // The full difference of b from the reference, layered on the reference, is b; no weight leaves the base
+    AnimationPose difference;
+    make_additive_pose(b, reference, difference);
+    apply_additive_pose(reference, difference, 1.0f, out);
+    REQUIRE(max_difference(out.translations, b.translations) < 1e-5f);
+    REQUIRE(max_difference(out.scales, b.scales) < 1e-5f);
+    for (size_t i = 0; i < 30; ++i) REQUIRE(std::abs(dot(out.rotations[i], b.rotations[i])) == Approx(1.0f));
+    apply_additive_pose(a, difference, 0.0f, out);
+    REQUIRE(max_difference(out.translations, a.translations) == 0.0f);
+    for (size_t i = 0; i < 30; ++i) REQUIRE(std::abs(dot(out.rotations[i], a.rotations[i])) == Approx(1.0f));
+}
+
+TEST_CASE("simd skinning matches the scalar reference")
+{
+    std::mt19937 rng(3);
+    const runtime_skinned_mesh mesh = make_test_skinned_mesh(rng, 60, 1001);
+    const SkinningRig rig = make_skinning_rig(mesh.bones);
+
+    std::vector<float4x4> palette;
+    make_skinning_palette(rig, random_pose(rng, 60), palette);
+
+    std::vector<float3> positions(mesh.vertices.size()), normals(mesh.vertices.size());
+    std::vector<float3> expectedPositions(mesh.vertices.size()), expectedNormals(mesh.vertices.size());
+    skin_vertices_scalar(mesh, palette.data(), palette.size(), expectedPositions.data(), expectedNormals.data(), 0, mesh.vertices.size());
+
+    // Odd ranges, so a vertex is left over after the pairs
+    skin_vertices(mesh, palette.data(), palette.size(), positions.data(), normals.data(), 0, 333);
+    skin_vertices(mesh, palette.data(), palette.size(), positions.data(), normals.data(), 333, 668);
+    REQUIRE(max_difference(positions, expectedPositions) < 1e-4f);
+    REQUIRE(max_difference(normals, expectedNormals) < 1e-5f);
+    for (auto & n : normals) REQUIRE(length(n) == Approx(1.0f));
+
+    // Without normals only positions are written
+    runtime_skinned_mesh bare = mesh;
+    bare.normals.clear();
+    SkinnedVertices out;
+    skin_vertices(bare, palette, out);
+    REQUIRE(out.normals.empty());
+    REQUIRE(max_difference(out.positions, expectedPositions) < 1e-4f);
+}
+
+TEST_CASE("skinning many instances in parallel matches skinning each alone")
+{
+    std::mt19937 rng(4);
+    const runtime_skinned_mesh mesh = make_test_skinned_mesh(rng, 20, 9000); // several vertex ranges
+    const SkinningRig rig = make_skinning_rig(mesh.bones);
+
+    std::vector<AnimationPose> poses;
+    for (int i = 0; i < 6; ++i) poses.push_back(random_pose(rng, 20));
+    std::vector<SkinnedVertices> out(poses.size());
+    skin_instances(rig, mesh, poses.data(), poses.size(), out.data(), 4);
+
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        std::vector<float4x4> palette;
+        make_skinning_palette(rig, poses[i], palette);
+        REQUIRE(std::memcmp(palette.data(), out[i].palette.data(), palette.size() * sizeof(float4x4)) == 0);
+
+        SkinnedVertices alone;
+        skin_vertices(mesh, palette, alone);
+        REQUIRE(max_difference(out[i].positions, alone.positions) == 0.0f);
+        REQUIRE(max_difference(out[i].normals, alone.normals) == 0.0f);
+    }
+}
+
+TEST_CASE("crowd skinning benchmark", "[.][benchmark]")
+{
+    // 200 characters of 8000 vertices and 60 bones, each playing its own phase of a clip
+    std::mt19937 rng(5);
+    const uint32_t instances = 200, bones = 60;
+    const runtime_skinned_mesh mesh = make_test_skinned_mesh(rng, bones, 8000);
+    const SkinningRig rig = make_skinning_rig(mesh.bones);
+
+    skeletal_animation animation;
+    animation.startFrame = 0;
+    animation.endFrame = 99;
+    for (uint32_t b = 0; b < bones; ++b)
+    {
+        auto track = std::make_shared<animation_track>();
+        track->boneIndex = b;
+        const float3 axis = normalize(float3(0.3f, 1.0f, 0.2f * b));
+        for (uint32_t f = 0; f < 100; ++f)
+        {
+            auto k = std::make_shared<animation_keyframe>();
+            k->key = f;
+            k->rotation = qmul(rig.restPose.rotations[b], rotation_quat(axis, 0.3f * std::sin(f * 0.1f)));
+            k->translation = rig.restPose.translations[b];
+            k->scale = rig.restPose.scales[b];
+            track->keyframes.push_back(k);
+        }
+        animation.tracks.push_back(track);
+    }
+    const AnimationClip clip = make_animation_clip(animation, bones);
+
+    std::vector<AnimationCursor> cursors(instances);
+    std::vector<AnimationPose> poses(instances);
+    std::vector<SkinnedVertices> out(instances);
+    for (uint32_t i = 0; i < instances; ++i) sample_animation_clip(clip, i * 0.013f, cursors[i], poses[i]);
+    skin_instances(rig, mesh, poses.data(), instances, out.data(), 1);
+
+    auto time = [&](const char * name, std::function<void()> fn)
+    {
+        SimpleTimer t;
+        t.start();
+        for (int r = 0; r < 5; ++r) fn();
+        std::cout << name << ": " << t.microseconds().count() / 5000.0 << " ms per frame" << std::endl;
+    };
+
+    time("palettes", [&]() { for (uint32_t i = 0; i < instances; ++i) make_skinning_palette(rig, poses[i], out[i].palette); });
+    time("skinning, scalar", [&]()
+    {
+        for (auto & o : out) skin_vertices_scalar(mesh, o.palette.data(), o.palette.size(), o.positions.data(), o.normals.data(), 0, mesh.vertices.size());
+    });
+    time("skinning", [&]() { for (auto & o : out) skin_vertices(mesh, o.palette.data(), o.palette.size(), o.positions.data(), o.normals.data(), 0, mesh.vertices.size()); });
+    time("sample, palettes and skinning, all threads", [&]()
+    {
+        parallel_for(0, instances, [&](size_t i) { sample_animation_clip(clip, i * 0.013f + 0.5f, cursors[i], poses[i]); });
+        skin_instances(rig, mesh, poses.data(), instances, out.data());
+    });
+    REQUIRE(out[0].positions.size() == mesh.vertices.size());
+}
@@ -0,0 +1,185 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "algo_misc.hpp"
+#include "sparse_voxel_array.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <random>
+
+using namespace avl;
+
+// A thin spherical shell: the kind of mostly empty density field the sparse array is for
+static float shell_density(const int3 & c, float n)
+{
+    const float3 p = float3((float) c.x, (float) c.y, (float) c.z) / n - float3(0.5f);
+    return std::max(0.0f, 1.0f - std::abs(length(p) - 0.35f) * n * 0.25f);
+}
+
+TEST_CASE("sparse voxel array matches a dense voxel array under the same writes")
+{
+    const int3 size(45, 37, 29); // not a multiple of the brick or page size
+    VoxelArray<float> dense(size);
+    SparseVoxelArray<float> sparse(size);
+    const SparseVoxelArray<float> & view = sparse;
+    REQUIRE(view[int3(3, 4, 5)] == 0.0f);
+    REQUIRE(sparse.memory_bytes() < 64);
+
+    std::mt19937 gen(7);
+    for (int i = 0; i < 5000; ++i)
+    {
+        const int3 c(gen() % size.x, gen() % size.y, gen() % size.z);
+        const float v = float(gen() % 4);
+        dense[c] = v;
+        if (i % 2) sparse[c] = v;
+        else sparse.set(c, v);
+    }
+
+    for (int z = 0; z < size.z; ++z)
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x) REQUIRE(view[int3(x, y, z)] == dense[int3(x, y, z)]);
+
+    // Writable access reads the same values
+    REQUIRE(sparse[int3(44, 36, 28)] == dense[int3(44, 36, 28)]);
+}
+
+TEST_CASE("sparse voxel array keeps unwritten and uniform bricks without storage")
+{
+    SparseVoxelArray<uint8_t> v(int3(256, 256, 256), 0);
+    const SparseVoxelArray<uint8_t> & r = v; // reads through operator[] const, which never allocates
+
+    // Writing the background value allocates nothing
+    v.set(int3(10, 10, 10), 0);
+    REQUIRE(v.allocated_brick_count() == 0);
+
+    v.set(int3(10, 10, 10), 5);
+    REQUIRE(v.allocated_brick_count() == 1);
+    REQUIRE(r[int3(10, 10, 10)] == 5);
+    REQUIRE(r[int3(11, 10, 10)] == 0);
+
+    // A constant brick reads as its value everywhere and expands on the first differing write
+    v.fill_brick(int3(4, 4, 4), 9);
+    REQUIRE(v.constant_brick_count() == 1);
+    REQUIRE(r[int3(32, 39, 35)] == 9);
+    v.set(int3(33, 33, 33), 9);
+    REQUIRE(v.allocated_brick_count() == 1);
+    v.set(int3(33, 33, 33), 2);
+    REQUIRE(v.allocated_brick_count() == 2);
+    REQUIRE(v.constant_brick_count() == 0);
+    REQUIRE(r[int3(33, 33, 33)] == 2);
+    REQUIRE(r[int3(34, 33, 33)] == 9);
+
+    // Dense writes of uniform regions collapse back
+    for (int z = 64; z < 80; ++z)
+        for (int y = 64; y < 80; ++y)
+            for (int x = 64; x < 80; ++x) v[int3(x, y, z)] = (x < 72) ? 3 : 0;
+    REQUIRE(v.allocated_brick_count() == 10);
+    REQUIRE(v.optimize() == 8);
+    REQUIRE(v.allocated_brick_count() == 2);
+    REQUIRE(v.constant_brick_count() == 4);
+    REQUIRE(r[int3(65, 70, 75)] == 3);
+    REQUIRE(r[int3(75, 70, 65)] == 0);
+
+    // Only non-background bricks are visited
+    size_t constant = 0, allocated = 0;
+    v.for_each_active_brick([&](const SparseVoxelArray<uint8_t>::BrickView & b)
+    {
+        if (b.voxels) ++allocated;
+        else
+        {
+            ++constant;
+            REQUIRE(b.value == 3);
+            REQUIRE(b.origin.x == 64);
+        }
+    });
+    REQUIRE(allocated == 2);
+    REQUIRE(constant == 4);
+    REQUIRE(v.active_bricks().size() == 6);
+
+    // Freed pool slots are reused
+    const size_t bytes = v.memory_bytes();
+    v[int3(200, 200, 200)] = 1;
+    REQUIRE(v.memory_bytes() == bytes + 16 * 16 * 16 * sizeof(uint32_t)); // a new page, but no new pool block
+}
+
+TEST_CASE("sparse voxel array memory and access versus dense", "[.][benchmark]")
+{
+    const int n = 256;
+    VoxelArray<float> dense(int3(n, n, n));
+    SparseVoxelArray<float> sparse(int3(n, n, n));
+
+    SimpleTimer t(true);
+    for (int z = 0; z < n; ++z)
+        for (int y = 0; y < n; ++y)
+            for (int x = 0; x < n; ++x) dense[int3(x, y, z)] = shell_density(int3(x, y, z), float(n));
+    const double denseWrite = t.microseconds().count() * 1e-3;
+
+    t.start();
+    for (int z = 0; z < n; ++z)
+        for (int y = 0; y < n; ++y)
+            for (int x = 0; x < n; ++x) sparse.set(int3(x, y, z), shell_density(int3(x, y, z), float(n)));
+    const double sparseWrite = t.microseconds().count() * 1e-3;
+
+    std::cout << n << "^3 shell: dense " << (size_t(n) * n * n * sizeof(float)) / (1024 * 1024) << " MB, sparse " << sparse.memory_bytes() / (1024 * 1024) << " MB ("
+        << sparse.allocated_brick_count() << " bricks); write dense " << denseWrite << " ms, sparse " << sparseWrite << " ms" << std::endl;
+
+    float sink = 0.0f;
+    t.start();
+    for (int z = 0; z < n; ++z)
+        for (int y = 0; y < n; ++y)
+            for (int x = 0; x < n; ++x) sink += dense[int3(x, y, z)];
+    const double denseLinear = t.microseconds().count() * 1e-3;
+
+    const SparseVoxelArray<float> & cs = sparse;
+    t.start();
+    for (int z = 0; z < n; ++z)
+        for (int y = 0; y < n; ++y)
+            for (int x = 0; x < n; ++x) sink += cs[int3(x, y, z)];
+    const double sparseLinear = t.microseconds().count() * 1e-3;
+
+    std::mt19937 gen(1);
+    std::vector<int3> coords(1 << 22);
+    for (auto & c : coords) c = int3(gen() % n, gen() % n, gen() % n);
+
+    t.start();
+    for (const auto & c : coords) sink += dense[c];
+    const double denseRandom = t.microseconds().count() * 1e-3;
+
+    t.start();
+    for (const auto & c : coords) sink += cs[c];
+    const double sparseRandom = t.microseconds().count() * 1e-3;
+
+    t.start();
+    cs.for_each_active_brick([&](const SparseVoxelArray<float>::BrickView & b) { if (b.voxels) for (int i = 0; i < SparseVoxelArray<float>::brickVoxels; ++i) sink += b.voxels[i]; });
+    const double sparseBricks = t.microseconds().count() * 1e-3;
+
+    std::cout << "linear read dense " << denseLinear << " ms, sparse " << sparseLinear << " ms, active bricks only " << sparseBricks << " ms" << std::endl;
+    std::cout << "4M random reads dense " << denseRandom << " ms, sparse " << sparseRandom << " ms" << std::endl;
+
+    // A 2048^3 field would need 32 GB dense
+    const int big = 2048;
+    SparseVoxelArray<float> large(int3(big, big, big));
+    t.start();
+    const float scale = float(big);
+    for (int z = 0; z < big; z += 2)
+        for (int y = 0; y < big; y += 2)
+        {
+            // Only the shell's bounding rows matter; sample the sphere at half resolution and splat 2^3
+            const float py = y / scale - 0.5f, pz = z / scale - 0.5f;
+            const float r2 = py * py + pz * pz;
+            if (r2 > 0.36f * 0.36f) continue;
+            const float xs = std::sqrt(std::max(0.0f, 0.35f * 0.35f - r2));
+            for (float side : { -1.0f, 1.0f })
+            {
+                const int x = int((0.5f + side * xs) * scale);
+                for (int dx = -4; dx <= 4; ++dx)
+                {
+                    if (x + dx < 0 || x + dx >= big) continue;
+                    const float v = shell_density(int3(x + dx, y, z), scale);
+                    for (int k = 0; k < 8; ++k) large.set(int3(x + dx, y + (k & 1), z + (k >> 2)), v);
+                }
+            }
+        }
+    std::cout << big << "^3 shell: sparse " << large.memory_bytes() / (1024 * 1024) << " MB in " << t.microseconds().count() * 1e-3 << " ms (checksum " << sink << ")" << std::endl;
+}
@@ -0,0 +1,382 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "procedural_mesh.hpp"
+#include "vertex_format.hpp"
+#include "simple_timer.hpp"
+
+#include "catch.hpp"
+
+#include <functional>
+#include <iostream>
+#include <random>
+
+using namespace avl;
+
+static float angle_between(const float3 & a, const float3 & b)
+{
+    return std::acos(clamp(dot(normalize(a), normalize(b)), -1.0f, 1.0f));
+}
+
+// A supershape with spherical texture coordinates and MikkTSpace tangents
+static Geometry make_tangent_space_shape(int segments)
+{
+    Geometry g = make_supershape_3d(segments, 5, 7, 4, 12);
+    compute_normals(g);
+    g.texcoord0.clear();
+    for (const auto & v : g.vertices) g.texcoord0.push_back(float2(std::atan2(v.z, v.x) / float(ANVIL_TAU) + 0.5f, v.y * 0.5f));
+    compute_mikktspace_tangents(g);
+    return g;
+}
+
+TEST_CASE("half floats round trip within half precision")
+{
+    // Exactly representable values survive unchanged
+    for (float f : { 0.0f, -0.0f, 1.0f, -2.0f, 0.5f, 65504.0f, -65504.0f, 6.103515625e-05f, 5.9604645e-08f })
+    {
+        REQUIRE(half_to_float(float_to_half(f)) == f);
+    }
+
+    REQUIRE(float_to_half(1.0f) == 0x3c00);
+    REQUIRE(float_to_half(65520.0f) == 0x7c00);     // rounds past the largest half
+    REQUIRE(std::isinf(half_to_float(float_to_half(std::numeric_limits<float>::infinity()))));
+    REQUIRE(std::isnan(half_to_float(float_to_half(std::numeric_limits<float>::quiet_NaN()))));
+    REQUIRE(float_to_half(1.0f + 1.0f / 2048.0f) == 0x3c00); // ties go to even
+    REQUIRE(float_to_half(1.0f + 3.0f / 2048.0f) == 0x3c02);
+
+    // Every half converts to a float and back to itself
+    for (uint32_t h = 0; h < 0x10000; ++h)
+    {
+        if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff)) continue; // NaN payloads
+        REQUIRE(float_to_half(half_to_float(uint16_t(h))) == h);
+    }
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    for (int i = 0; i < 10000; ++i)
+    {
+        const float f = dist(gen);
+        REQUIRE(std::abs(half_to_float(float_to_half(f)) - f) <= std::abs(f) * (1.0f / 2048.0f));
+    }
+}
+
+TEST_CASE("octahedral 10:10:10:2 unit vectors round trip")
+{
+    std::mt19937 gen(11);
+    std::normal_distribution<float> dist;
+
+    float maxError = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+        const float3 v = normalize(float3(dist(gen), dist(gen), dist(gen)));
+        const float4 d = unpack_oct_10_10_10_2(pack_oct_10_10_10_2(v, i % 2 ? -1.0f : 1.0f));
+        maxError = std::max(maxError, angle_between(v, float3(d.x, d.y, d.z)));
+        REQUIRE(d.w == (i % 2 ? -1.0f : 1.0f));
+    }
+    REQUIRE(maxError < to_radians(0.2f));
+
+    // Axes, including the folded -z hemisphere, are exact
+    for (const float3 & axis : { float3(1, 0, 0), float3(0, -1, 0), float3(0, 0, 1), float3(0, 0, -1) })
+    {
+        const float4 d = unpack_oct_10_10_10_2(pack_oct_10_10_10_2(axis));
+        REQUIRE(angle_between(axis, float3(d.x, d.y, d.z)) < 1e-4f);
+    }
+}
+
+TEST_CASE("float vertex format matches the historical layout exactly")
+{
+    const Geometry g = make_tangent_space_shape(32);
+
+    const VertexFormat format = make_float_vertex_format(g);
+    REQUIRE(format.stride == 56);
+    REQUIRE(format.find(VertexAttribute::tangent)->offset == 32);
+    REQUIRE(format.find(VertexAttribute::tangent)->location == 4);
+    REQUIRE(format.find(VertexAttribute::bitangent)->location == 5);
+
+    const std::vector<uint8_t> buffer = encode_vertices(g, format);
+    REQUIRE(buffer.size() == g.vertices.size() * 56);
+
+    std::vector<float> expected;
+    for (size_t i = 0; i < g.vertices.size(); ++i)
+    {
+        for (int c = 0; c < 3; ++c) expected.push_back(g.vertices[i][c]);
+        for (int c = 0; c < 3; ++c) expected.push_back(g.normals[i][c]);
+        for (int c = 0; c < 2; ++c) expected.push_back(g.texcoord0[i][c]);
+        for (int c = 0; c < 3; ++c) expected.push_back(g.tangents[i][c]);
+        for (int c = 0; c < 3; ++c) expected.push_back(g.bitangents[i][c]);
+    }
+    REQUIRE(std::memcmp(buffer.data(), expected.data(), buffer.size()) == 0);
+}
+
+TEST_CASE("packed vertex format round trips a tangent-space mesh within quantization error")
+{
+    Geometry g = make_tangent_space_shape(64);
+    for (auto & v : g.vertices) v = v * 40.0f + float3(100, -20, 5);
+    for (auto & uv : g.texcoord0) uv *= 8.0f;
+
+    const VertexFormat packed = make_packed_vertex_format(g);
+    const VertexFormat full = make_float_vertex_format(g);
+    REQUIRE(packed.stride == 20);
+    REQUIRE(packed.find(VertexAttribute::bitangent) == nullptr);
+    REQUIRE(packed.stride * 2 < full.stride);
+
+    const std::vector<uint8_t> buffer = encode_vertices(g, packed);
+    REQUIRE(buffer.size() == g.vertices.size() * packed.stride);
+
+    const float3 step = packed.positionScale / 65535.0f;
+    float maxNormalError = 0, maxTangentError = 0, maxBitangentError = 0, maxUvError = 0;
+    for (size_t i = 0; i < g.vertices.size(); ++i)
+    {
+        const uint8_t * vertex = buffer.data() + i * packed.stride;
+
+        const float4 p = decode_vertex_attribute(packed, VertexAttribute::position, vertex);
+        for (int c = 0; c < 3; ++c) REQUIRE(std::abs(p[c] - g.vertices[i][c]) <= step[c] * 0.5f + 1e-4f);
+
+        const float4 n = decode_vertex_attribute(packed, VertexAttribute::normal, vertex);
+        const float4 t = decode_vertex_attribute(packed, VertexAttribute::tangent, vertex);
+        const float3 normal(n.x, n.y, n.z), tangent(t.x, t.y, t.z);
+        maxNormalError = std::max(maxNormalError, angle_between(normal, g.normals[i]));
+        maxTangentError = std::max(maxTangentError, angle_between(tangent, g.tangents[i]));
+
+        // What packed_vertex.glsl reconstructs from the normal, tangent and sign
+        maxBitangentError = std::max(maxBitangentError, angle_between(cross(normal, tangent) * t.w, g.bitangents[i]));
+
+        const float4 uv = decode_vertex_attribute(packed, VertexAttribute::texcoord0, vertex);
+        maxUvError = std::max(maxUvError, std::max(std::abs(uv.x - g.texcoord0[i].x), std::abs(uv.y - g.texcoord0[i].y)));
+    }
+
+    REQUIRE(maxNormalError < to_radians(0.2f));
+    REQUIRE(maxTangentError < to_radians(0.2f));
+    REQUIRE(maxBitangentError < to_radians(0.5f));
+    REQUIRE(maxUvError <= 8.0f / 2048.0f);
+}
+
+TEST_CASE("packed bone streams keep indices and renormalize weights")
+{
+    runtime_skinned_mesh m;
+    m.vertices = { float3(0, 0, 0), float3(1, 2, 3), float3(-1, 5, 2) };
+    m.colors = { float4(1, 0, 0.5f, 1), float4(0, 0, 0, 0), float4(0.25f, 0.75f, 1, 0.5f) };
+    m.boneIndices = { int4(0, 1, 2, 3), int4(255, 7, 0, 0), int4(12, 0, 0, 0) };
+    m.boneWeights = { float4(0.25f, 0.25f, 0.25f, 0.25f), float4(0.6f, 0.3f, 0, 0), float4(1, 0, 0, 0) };
+
+    const VertexFormat packed = make_packed_vertex_format(m);
+    REQUIRE(packed.stride == 20);
+    REQUIRE(packed.find(VertexAttribute::boneIndices)->location == 6);
+    REQUIRE(make_float_vertex_format(m).stride == 12 + 12 + 16 + 16);
+
+    const std::vector<uint8_t> buffer = encode_vertices(m, packed, bone_streams(m));
+    for (size_t i = 0; i < m.vertices.size(); ++i)
+    {
+        const uint8_t * vertex = buffer.data() + i * packed.stride;
+        const float4 indices = decode_vertex_attribute(packed, VertexAttribute::boneIndices, vertex);
+        const float4 weights = decode_vertex_attribute(packed, VertexAttribute::boneWeights, vertex);
+        const float4 color = decode_vertex_attribute(packed, VertexAttribute::color, vertex);
+
+        for (int c = 0; c < 4; ++c) REQUIRE(indices[c] == (float) m.boneIndices[i][c]);
+        REQUIRE(std::abs(weights.x + weights.y + weights.z + weights.w - 1.0f) < 1e-6f);
+
+        const float4 expected = m.boneWeights[i] / (m.boneWeights[i].x + m.boneWeights[i].y + m.boneWeights[i].z + m.boneWeights[i].w);
+        for (int c = 0; c < 4; ++c)
+        {
+            REQUIRE(std::abs(weights[c] - expected[c]) <= 1.5f / 255.0f);
+            REQUIRE(std::abs(color[c] - m.colors[i][c]) <= 0.5f / 255.0f + 1e-6f);
+        }
+    }
+
+    m.boneIndices[1].x = 256;
+    REQUIRE_THROWS(encode_vertices(m, packed, bone_streams(m)));
+
+    // A format may not ask for streams the mesh lacks
+    REQUIRE_THROWS(encode_vertices(m, packed));
+}
+
+// One vertex at a time with the public conversions, as a reference for the block writer
+static std::vector<uint8_t> encode_vertices_reference(const runtime_mesh & m, const VertexFormat & format, const VertexBoneStreams & bones = {})
+{
+    std::vector<uint8_t> out(m.vertices.size() * format.stride);
+    float3 invScale;
+    for (int c = 0; c < 3; ++c) invScale[c] = format.positionScale[c] > 0 ? 1.0f / format.positionScale[c] : 0.0f;
+
+    for (size_t i = 0; i < m.vertices.size(); ++i)
+    {
+        for (const auto & e : format.elements)
+        {
+            uint8_t * d = out.data() + i * format.stride + e.offset;
+            float4 v;
+            switch (e.attribute)
+            {
+            case VertexAttribute::position: v = float4(m.vertices[i], 0); break;
+            case VertexAttribute::normal: v = float4(m.normals[i], 0); break;
+            case VertexAttribute::color: v = m.colors[i]; break;
+            case VertexAttribute::texcoord0: v = float4(m.texcoord0[i].x, m.texcoord0[i].y, 0, 0); break;
+            case VertexAttribute::tangent: v = float4(m.tangents[i], m.bitangents.empty() ? 1.0f : sign_not_zero(dot(cross(m.normals[i], m.tangents[i]), m.bitangents[i]))); break;
+            case VertexAttribute::bitangent: v = float4(m.bitangents[i], 0); break;
+            case VertexAttribute::boneIndices: v = float4((float) bones.indices[i].x, (float) bones.indices[i].y, (float) bones.indices[i].z, (float) bones.indices[i].w); break;
+            case VertexAttribute::boneWeights: v = bones.weights[i]; break;
+            }
+
+            switch (e.encoding)
+            {
+            case VertexEncoding::float2: std::memcpy(d, &v.x, 8); break;
+            case VertexEncoding::float3: std::memcpy(d, &v.x, 12); break;
+            case VertexEncoding::float4: std::memcpy(d, &v.x, 16); break;
+            case VertexEncoding::unorm16x4:
+            {
+                uint16_t q[4] = { 0, 0, 0, 0 };
+                for (int c = 0; c < 3; ++c) q[c] = impl::quantize_position(v[c], format.positionOffset[c], invScale[c]);
+                std::memcpy(d, q, 8);
+                break;
+            }
+            case VertexEncoding::oct_10_10_10_2:
+            {
+                const uint32_t p = pack_oct_10_10_10_2(float3(v.x, v.y, v.z), e.attribute == VertexAttribute::tangent ? v.w : 0.0f);
+                std::memcpy(d, &p, 4);
+                break;
+            }
+            case VertexEncoding::half2:
+            {
+                const uint16_t h[2] = { float_to_half(v.x), float_to_half(v.y) };
+                std::memcpy(d, h, 4);
+                break;
+            }
+            case VertexEncoding::unorm8x4:
+                if (e.attribute == VertexAttribute::boneWeights) quantize_bone_weights(v, d);
+                else for (int c = 0; c < 4; ++c) d[c] = quantize_unorm8(v[c]);
+                break;
+            case VertexEncoding::uint8x4: for (int c = 0; c < 4; ++c) d[c] = uint8_t(v[c]); break;
+            }
+        }
+    }
+    return out;
+}
+
+// A large skinned mesh with every stream filled with noise, sized to take the parallel path
+static runtime_skinned_mesh make_noise_mesh(size_t count, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> bone(0, 255);
+
+    runtime_skinned_mesh m;
+    for (size_t i = 0; i < count; ++i)
+    {
+        m.vertices.push_back(float3(u(gen), u(gen), u(gen)) * 30.0f);
+        m.normals.push_back(safe_normalize(float3(u(gen), u(gen), u(gen))));
+        m.colors.push_back(float4(u(gen), u(gen), u(gen), u(gen)) * 0.5f + 0.5f);
+        m.texcoord0.push_back(float2(u(gen), u(gen)) * 4.0f);
+        m.tangents.push_back(safe_normalize(cross(m.normals.back(), float3(u(gen), u(gen), u(gen)))));
+        m.bitangents.push_back(cross(m.normals.back(), m.tangents.back()) * (u(gen) < 0 ? -1.0f : 1.0f));
+        m.boneIndices.push_back(int4(bone(gen), bone(gen), bone(gen), bone(gen)));
+        m.boneWeights.push_back(float4(u(gen), u(gen), u(gen), u(gen)) * 0.5f + 0.5f);
+    }
+    m.normals[7] = float3(0, 0, 0); // degenerate vectors take the same path as the rest
+    m.tangents[9] = float3(0, 0, -1);
+    return m;
+}
+
+// Element bytes must match, except that octahedral grid points may differ by one step: a compiler may fuse
+// the reference's multiply-adds where the SIMD path does not, which moves near-ties
+static bool same_vertices(const VertexFormat & format, const std::vector<uint8_t> & a, const std::vector<uint8_t> & b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size() / format.stride; ++i)
+    {
+        for (const auto & e : format.elements)
+        {
+            const size_t at = i * format.stride + e.offset;
+            if (e.encoding != VertexEncoding::oct_10_10_10_2)
+            {
+                if (std::memcmp(a.data() + at, b.data() + at, vertex_encoding_size(e.encoding))) return false;
+                continue;
+            }
+            uint32_t pa, pb;
+            std::memcpy(&pa, a.data() + at, 4);
+            std::memcpy(&pb, b.data() + at, 4);
+            const int4 qa = unpack_snorm_10_10_10_2(pa), qb = unpack_snorm_10_10_10_2(pb);
+            if (std::abs(qa.x - qb.x) > 1 || std::abs(qa.y - qb.y) > 1 || qa.z != qb.z || qa.w != qb.w) return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("block vertex writer matches a per-vertex reference on every thread count")
+{
+    const runtime_skinned_mesh m = make_noise_mesh(70001, 5);
+    const VertexBoneStreams bones = bone_streams(m);
+
+    VertexFormat floats = make_float_vertex_format(m), packed = make_packed_vertex_format(m);
+
+    // Arbitrary formats: streams in a different order, padded floats, mixed encodings
+    VertexFormat mixed;
+    mixed.add(VertexAttribute::texcoord0, VertexEncoding::half2);
+    mixed.add(VertexAttribute::normal, VertexEncoding::float4);
+    mixed.add(VertexAttribute::position, VertexEncoding::float3);
+    mixed.add(VertexAttribute::tangent, VertexEncoding::oct_10_10_10_2);
+    mixed.add(VertexAttribute::color, VertexEncoding::float4);
+    mixed.elements[1].encoding = VertexEncoding::float3; // a float3 in a float4 slot leaves four bytes of padding
+
+    for (const VertexFormat * format : { &floats, &packed })
+    {
+        const std::vector<uint8_t> expected = encode_vertices_reference(m, *format, bones);
+        for (uint32_t threads : { 1u, 3u })
+        {
+            REQUIRE(same_vertices(*format, encode_vertices(m, *format, bones, threads), expected));
+        }
+    }
+
+    // Padding is left alone, which same_vertices does not look at
+    std::vector<uint8_t> written(m.vertices.size() * mixed.stride, 0xcd);
+    encode_vertices(m, mixed, written.data(), {}, 2);
+    REQUIRE(same_vertices(mixed, written, encode_vertices_reference(m, mixed)));
+
+    // Small meshes take the single-threaded path and a partial last block
+    runtime_mesh small;
+    small.vertices.assign(m.vertices.begin(), m.vertices.begin() + 13);
+    small.normals.assign(m.normals.begin(), m.normals.begin() + 13);
+    small.texcoord0.assign(m.texcoord0.begin(), m.texcoord0.begin() + 13);
+    const VertexFormat smallFormat = make_packed_vertex_format(small);
+    REQUIRE(same_vertices(smallFormat, encode_vertices(small, smallFormat), encode_vertices_reference(small, smallFormat)));
+}
+
+// The interleaving make_mesh_from_geometry used before block writing
+static std::vector<float> interleave_with_push_back(const Geometry & g)
+{
+    std::vector<float> buffer;
+    for (size_t i = 0; i < g.vertices.size(); ++i)
+    {
+        buffer.push_back(g.vertices[i].x); buffer.push_back(g.vertices[i].y); buffer.push_back(g.vertices[i].z);
+        if (g.normals.size()) { buffer.push_back(g.normals[i].x); buffer.push_back(g.normals[i].y); buffer.push_back(g.normals[i].z); }
+        if (g.colors.size()) { buffer.push_back(g.colors[i].x); buffer.push_back(g.colors[i].y); buffer.push_back(g.colors[i].z); }
+        if (g.texcoord0.size()) { buffer.push_back(g.texcoord0[i].x); buffer.push_back(g.texcoord0[i].y); }
+        if (g.tangents.size()) { buffer.push_back(g.tangents[i].x); buffer.push_back(g.tangents[i].y); buffer.push_back(g.tangents[i].z); }
+        if (g.bitangents.size()) { buffer.push_back(g.bitangents[i].x); buffer.push_back(g.bitangents[i].y); buffer.push_back(g.bitangents[i].z); }
+    }
+    return buffer;
+}
+
+TEST_CASE("block vertex writer benchmark", "[.][benchmark]")
+{
+    // Roughly Sponza: 280k vertices with normals, UVs, tangents and bitangents
+    runtime_mesh m = make_noise_mesh(280000, 9);
+    m.colors.clear();
+
+    auto time = [](const char * name, int runs, std::function<void()> fn)
+    {
+        SimpleTimer t;
+        t.start();
+        for (int r = 0; r < runs; ++r) fn();
+        std::cout << name << ": " << t.microseconds().count() / 1000.0 / runs << " ms" << std::endl;
+    };
+
+    std::vector<float> legacy;
+    time("push_back interleave", 10, [&]() { legacy = interleave_with_push_back(m); });
+
+    const VertexFormat floats = make_float_vertex_format(m), packed = make_packed_vertex_format(m);
+    std::vector<uint8_t> out(m.vertices.size() * floats.stride);
+    time("block writer, float layout, 1 thread", 10, [&]() { encode_vertices(m, floats, out.data(), {}, 1); });
+    time("block writer, float layout, all threads", 10, [&]() { encode_vertices(m, floats, out.data()); });
+    REQUIRE(std::memcmp(out.data(), legacy.data(), out.size()) == 0);
+
+    time("block writer, packed layout, 1 thread", 10, [&]() { encode_vertices(m, packed, out.data(), {}, 1); });
+    time("block writer, packed layout, all threads", 10, [&]() { encode_vertices(m, packed, out.data()); });
+    std::cout << "bytes per vertex: " << floats.stride << " float, " << packed.stride << " packed" << std::endl;
+}
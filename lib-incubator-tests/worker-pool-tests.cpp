@@ -0,0 +1,79 @@
+#include "util.hpp"
+#include "math-core.hpp"
+#include "worker_pool.hpp"
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace avl;
+
+TEST_CASE("worker pool runs every job submitted before it stops")
+{
+    std::atomic<int> done(0);
+    {
+        WorkerPool pool(3);
+        REQUIRE(pool.worker_count() == 3);
+        std::promise<void> finished;
+        for (int i = 0; i < 100; ++i) pool.submit([&]() { if (++done == 100) finished.set_value(); });
+        finished.get_future().wait();
+    }
+    REQUIRE(done == 100);
+}
+
+TEST_CASE("worker pool parallel_for visits every index once per call")
+{
+    WorkerPool pool(3);
+    std::vector<std::atomic<int>> visits(1000);
+    for (int call = 0; call < 50; ++call) pool.parallel_for(0, visits.size(), [&](size_t i) { ++visits[i]; }, 7);
+    for (auto & v : visits) REQUIRE(v == 50);
+    pool.parallel_for(5, 5, [&](size_t) { FAIL("empty range"); });
+}
+
+TEST_CASE("keyed worker pool shares one job per key")
+{
+    KeyedWorkerPool<std::string, std::shared_ptr<int>> pool(2);
+    std::atomic<int> calls(0);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    // The first job holds a worker until released, so the duplicate request finds it in flight
+    auto first = pool.request("a", [&]() { ++calls; released.wait(); return std::make_shared<int>(1); });
+    auto duplicate = pool.request("a", [&]() { ++calls; return std::make_shared<int>(2); });
+    release.set_value();
+    REQUIRE(*first.get() == 1);
+    REQUIRE(*duplicate.get() == 1);
+    REQUIRE(calls == 1);
+
+    // Finished keys are released: the next call runs again, here on the calling thread
+    REQUIRE(*pool.run("a", [&]() { ++calls; return std::make_shared<int>(3); }) == 3);
+    REQUIRE(calls == 2);
+
+    // A throwing job hands its exception to every waiter, and the key can be retried
+    REQUIRE_THROWS_AS(pool.run("b", []() -> std::shared_ptr<int> { throw std::runtime_error("failed"); }), std::runtime_error);
+    REQUIRE(*pool.request("b", []() { return std::make_shared<int>(4); }).get() == 4);
+}
+
+TEST_CASE("keyed worker pool resolves queued keys to a default result when destroyed")
+{
+    std::promise<void> started, release;
+    std::shared_future<void> released = release.get_future().share();
+    std::shared_future<std::shared_ptr<int>> running, queued;
+    std::thread releaser;
+    {
+        // The only worker is busy until well after destruction starts, so the second key never leaves the queue
+        KeyedWorkerPool<int, std::shared_ptr<int>> pool(1);
+        running = pool.request(0, [&]() { started.set_value(); released.wait(); return std::make_shared<int>(0); });
+        queued = pool.request(1, []() { return std::make_shared<int>(1); });
+        started.get_future().wait();
+        releaser = std::thread([&]() { std::this_thread::sleep_for(std::chrono::milliseconds(50)); release.set_value(); });
+    }
+    releaser.join();
+    REQUIRE(*running.get() == 0);
+    REQUIRE(queued.get() == nullptr);
+}
@@ -35,4 +35,20 @@ struct unordered_map_generator
 };
 
 
+// CRC32C (Castagnoli) using the SSE 4.2 instruction, eight bytes at a time
+inline uint32_t crc32c(const void * data, size_t size, uint32_t crc = 0)
+{
+    const uint8_t * p = static_cast<const uint8_t *>(data);
+    uint64_t c = ~crc;
+    for (; size >= 8; size -= 8, p += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    uint32_t c32 = uint32_t(c);
+    for (; size > 0; --size) c32 = _mm_crc32_u8(c32, *p++);
+    return ~c32;
+}
+
 #endif // end model_io_util_hpp
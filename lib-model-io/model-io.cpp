@@ -1,19 +1,101 @@
 #include "model-io.hpp"
 
 #include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
 #include <fstream>
+#include <sstream>
 
 #include "third-party/tinyobj/tiny_obj_loader.h"
 #include "third-party/tinyply/tinyply.h"
 #include "third-party/meshoptimizer/meshoptimizer.hpp"
 #include "fbx-importer.hpp"
 #include "model-io-util.hpp"
+#include "parallel_for.hpp"
+
+#if defined(ANVIL_PLATFORM_WINDOWS)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    // A whole file mapped read-only, shared by the OBJ importer and mapped_runtime_mesh
+    struct file_mapping
+    {
+        const uint8_t * data = nullptr;
+        size_t size = 0;
+
+#if defined(ANVIL_PLATFORM_WINDOWS)
+        HANDLE fileHandle = INVALID_HANDLE_VALUE;
+        HANDLE mappingHandle = nullptr;
+
+        explicit file_mapping(const std::string & path)
+        {
+            fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (fileHandle == INVALID_HANDLE_VALUE) throw std::runtime_error("couldn't open " + path);
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(fileHandle, &fileSize);
+            size = size_t(fileSize.QuadPart);
+            if (size == 0) return;
+            mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mappingHandle) data = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+            if (!data)
+            {
+                release();
+                throw std::runtime_error("couldn't map " + path);
+            }
+        }
+
+        ~file_mapping() { release(); }
+
+        void release()
+        {
+            if (data) UnmapViewOfFile(data);
+            if (mappingHandle) CloseHandle(mappingHandle);
+            if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+            data = nullptr; mappingHandle = nullptr; fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        explicit file_mapping(const std::string & path)
+        {
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw std::runtime_error("couldn't open " + path);
+            struct stat st;
+            if (fstat(fd, &st) == 0) size = size_t(st.st_size);
+            if (size > 0)
+            {
+                void * p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) data = static_cast<const uint8_t *>(p);
+            }
+            close(fd);
+            if (size > 0 && !data) throw std::runtime_error("couldn't map " + path);
+        }
+
+        ~file_mapping() { if (data) munmap(const_cast<uint8_t *>(data), size); }
+#endif
+
+        file_mapping(const file_mapping &) = delete;
+        file_mapping & operator = (const file_mapping &) = delete;
+    };
+}
 
 std::map<std::string, runtime_mesh> import_model(const std::string & path)
 {
     std::map<std::string, runtime_mesh> results;
 
-    auto & ext = get_extension(path);
+    const auto ext = get_extension(path);
 
     if (ext == "FBX" || ext == "fbx")
     {
@@ -58,7 +140,7 @@ std::map<std::string, runtime_mesh> import_fbx_model(const std::string & path)
     return {};
 }
 
-std::map<std::string, runtime_mesh> import_obj_model(const std::string & path)
+std::map<std::string, runtime_mesh> import_obj_model_tinyobj(const std::string & path)
 {
     std::map<std::string, runtime_mesh> meshes;
 
@@ -148,112 +230,1342 @@ std::map<std::string, runtime_mesh> import_obj_model(const std::string & path)
     return meshes;
 }
 
-void optimize_model(runtime_mesh & input)
+namespace
 {
-    constexpr size_t cacheSize = 32;
+    // The native OBJ path maps the file and parses line-aligned chunks in parallel. Token
+    // rules follow tinyobj's scans over its zero-terminated lines, with line breaks standing in for the
+    // terminator, so the imported meshes match import_obj_model_tinyobj byte for byte on text files.
+
+    inline bool obj_space(char c) { return c == ' ' || c == '\t'; }
+    inline bool obj_digit(char c) { return static_cast<unsigned int>(c - '0') < 10u; }
+    inline bool obj_line_end(char c) { return c == '\n' || c == '\r' || c == '\0'; }
+    inline bool obj_token_end(char c) { return obj_space(c) || obj_line_end(c); }
+
+    inline const char * obj_skip_space(const char * p) { while (obj_space(*p)) ++p; return p; }
+    inline const char * obj_find_token_end(const char * p) { while (!obj_token_end(*p)) ++p; return p; }
+    inline const char * obj_find_index_end(const char * p) { while (*p != '/' && !obj_token_end(*p)) ++p; return p; }
+    inline const char * obj_find_line_end(const char * p) { while (!obj_line_end(*p)) ++p; return p; }
+
+    // tinyobj's tryParseDouble step for step, so imported values keep their exact bits. Every token ends
+    // in a space, tab or line break, none of which continues a number, so the scan needs no end pointer.
+    // Returns where the number stopped, or null where tinyobj fails and keeps the default.
+    const char * obj_parse_double(const char * p, double & result)
+    {
+        static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+
+        bool negative = false;
+        if (*p == '+' || *p == '-') negative = (*p++ == '-');
+
+        // Below 10^15 every step of the double accumulation is exact, so an integer gives the same value
+        int read = 0;
+        uint64_t whole = 0;
+        for (; obj_digit(*p) && read < 15; ++p, ++read) whole = whole * 10 + uint64_t(*p - '0');
+        double mantissa = double(whole);
+        for (; obj_digit(*p); ++p, ++read)
+        {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*p - '0');
+        }
+        if (read == 0) return nullptr;
+
+        if (*p == '.')
+        {
+            ++p;
+            for (read = 1; obj_digit(*p); ++read, ++p)
+            {
+                mantissa += static_cast<int>(*p - '0') * (read < 8 ? powLut[read] : std::pow(10.0, -read));
+            }
+        }
+
+        int exponent = 0;
+        if (*p == 'e' || *p == 'E')
+        {
+            ++p;
+            bool negativeExponent = false;
+            if (*p == '+' || *p == '-') negativeExponent = (*p++ == '-');
+            else if (!obj_digit(*p)) return nullptr;
+
+            for (read = 0; obj_digit(*p); ++p, ++read)
+            {
+                exponent *= 10;
+                exponent += static_cast<int>(*p - '0');
+            }
+            if (read == 0) return nullptr;
+            if (negativeExponent) exponent = -exponent;
+        }
+
+        result = (negative ? -1 : 1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return p;
+    }
+
+    inline float obj_parse_real(const char *& p, double defaultValue = 0.0)
+    {
+        p = obj_skip_space(p);
+        double value = defaultValue;
+        const char * stop = obj_parse_double(p, value);
+        p = obj_find_token_end(stop ? stop : p);
+        return static_cast<float>(value);
+    }
+
+    // atoi and then a skip to the next '/', space or tab, as in tinyobj's parseTriple. atoi may skip
+    // leading spaces that the separator scan then stops at.
+    inline int obj_parse_index(const char *& token)
+    {
+        const char * p = token;
+        while (*p == ' ' || *p == '\t' || *p == '\v' || *p == '\f') ++p;
+        const bool skippedSpace = (p != token);
+
+        bool negative = false;
+        if (*p == '+' || *p == '-') negative = (*p++ == '-');
+        uint32_t value = 0;
+        while (obj_digit(*p)) value = value * 10 + uint32_t(*p++ - '0');
+
+        token = obj_find_index_end(skippedSpace ? token : p);
+        return negative ? int(0u - value) : int(value);
+    }
+
+    // Zero-based indices, with -1 for a missing texcoord or normal
+    struct obj_corner { int32_t v, vt, vn; };
 
-    PostTransformCacheStatistics inputStats = analyzePostTransform(&input.faces[0].x, input.faces.size() * 3, input.vertices.size(), cacheSize);
-    std::cout << "input acmr: " << inputStats.acmr << ", cache hit %: " << inputStats.hit_percent << std::endl;
+    // A negative face index counts back from the number of elements read so far. Chunks only know
+    // their own counts, so such indices are stored chunk-local below this base and the element offset
+    // of earlier chunks is added once all chunks are parsed.
+    const int32_t obj_relative_base = -(1 << 30);
 
-    std::vector<uint32_t> inputIndices;
-    std::vector<uint32_t> reorderedIndices(input.faces.size() * 3);
+    enum class obj_directive { usemtl, mtllib, group, object };
+
+    struct obj_event
+    {
+        obj_directive type;
+        size_t triangle, face; // counts in file order before the directive
+        std::string name;
+    };
 
-    for (auto f : input.faces)
+    struct obj_chunk
     {
-        inputIndices.push_back(f.x);
-        inputIndices.push_back(f.y);
-        inputIndices.push_back(f.z);
+        std::vector<float3> positions, normals;
+        std::vector<float2> texcoords;
+        std::vector<obj_corner> corners; // three per triangle, polygons fan-triangulated like tinyobj
+        std::vector<obj_event> events;
+        size_t faces = 0;
+        std::string error;
+    };
+
+    // Resolves one index of a face triple the way tinyobj's fixIndex does
+    inline bool obj_fix_index(int index, size_t count, int32_t & result)
+    {
+        if (index > 0) { result = index - 1; return true; }
+        const int64_t local = int64_t(count) + index;
+        if (index == 0 || local < obj_relative_base) return false;
+        result = int32_t(obj_relative_base + local);
+        return true;
     }
 
+    void parse_obj_chunk(const char * begin, const char * end, obj_chunk & chunk)
     {
-        optimizePostTransform(reorderedIndices.data(), inputIndices.data(), inputIndices.size(), input.vertices.size(), cacheSize);
+        auto add_event = [&chunk](obj_directive type, const char * name, const char * nameEnd)
+        {
+            chunk.events.push_back({ type, chunk.corners.size() / 3, chunk.faces, std::string(name, nameEnd) });
+        };
+
+        for (const char * p = begin; p < end; p = obj_find_line_end(p) + 1)
+        {
+            const char * token = p = obj_skip_space(p);
+            if (obj_line_end(token[0]) || token[0] == '#') continue;
+
+            if (token[0] == 'v' && obj_space(token[1]))
+            {
+                token += 2;
+                float3 v;
+                v.x = obj_parse_real(token);
+                v.y = obj_parse_real(token);
+                v.z = obj_parse_real(token);
+                chunk.positions.push_back(v);
+                p = token;
+            }
+            else if (token[0] == 'v' && token[1] == 'n' && obj_space(token[2]))
+            {
+                token += 3;
+                float3 n;
+                n.x = obj_parse_real(token);
+                n.y = obj_parse_real(token);
+                n.z = obj_parse_real(token);
+                chunk.normals.push_back(n);
+                p = token;
+            }
+            else if (token[0] == 'v' && token[1] == 't' && obj_space(token[2]))
+            {
+                token += 3;
+                float2 t;
+                t.x = obj_parse_real(token);
+                t.y = obj_parse_real(token);
+                chunk.texcoords.push_back(t);
+                p = token;
+            }
+            else if (token[0] == 'f' && obj_space(token[1]))
+            {
+                // Polygons become fans around their first corner
+                obj_corner first = {}, previous = {};
+                size_t count = 0;
+                for (token = obj_skip_space(token + 2); !obj_line_end(*token); ++count)
+                {
+                    obj_corner c = { -1, -1, -1 };
+                    bool ok = obj_fix_index(obj_parse_index(token), chunk.positions.size(), c.v);
+                    if (ok && token[0] == '/')
+                    {
+                        ++token;
+                        if (token[0] == '/')
+                        {
+                            ++token;
+                            ok = obj_fix_index(obj_parse_index(token), chunk.normals.size(), c.vn);
+                        }
+                        else
+                        {
+                            ok = obj_fix_index(obj_parse_index(token), chunk.texcoords.size(), c.vt);
+                            if (ok && token[0] == '/')
+                            {
+                                ++token;
+                                ok = obj_fix_index(obj_parse_index(token), chunk.normals.size(), c.vn);
+                            }
+                        }
+                    }
+                    if (!ok)
+                    {
+                        chunk.error = "obj face has an invalid index";
+                        return;
+                    }
+
+                    if (count == 0) first = c;
+                    else if (count >= 2)
+                    {
+                        chunk.corners.push_back(first);
+                        chunk.corners.push_back(previous);
+                        chunk.corners.push_back(c);
+                    }
+                    previous = c;
+                    token = obj_skip_space(token);
+                }
+                ++chunk.faces;
+                p = token;
+            }
+            else if (strncmp(token, "usemtl", 6) == 0 && obj_space(token[6]))
+            {
+                add_event(obj_directive::usemtl, token + 7, p = obj_find_line_end(token + 7));
+            }
+            else if (strncmp(token, "mtllib", 6) == 0 && obj_space(token[6]))
+            {
+                add_event(obj_directive::mtllib, token + 7, p = obj_find_line_end(token + 7));
+            }
+            else if (token[0] == 'g' && obj_space(token[1]))
+            {
+                // The group name is the first word after g
+                const char * name = obj_skip_space(token + 1);
+                add_event(obj_directive::group, name, obj_find_token_end(name));
+            }
+            else if (token[0] == 'o' && obj_space(token[1]))
+            {
+                add_event(obj_directive::object, token + 2, p = obj_find_line_end(token + 2));
+            }
+        }
+    }
+
+    struct obj_range { size_t begin, end; int material; };
+
+    struct obj_shape
+    {
+        std::string name;
+        std::vector<obj_range> ranges; // triangle ranges in file order
+        size_t triangles = 0;
+    };
+
+    // Replays the directives in file order, grouping triangles into shapes exactly as tinyobj does:
+    // g keeps a shape that has triangles, o keeps one only if faces were read since the last flush,
+    // and a usemtl that changes the material flushes without starting a new shape
+    std::vector<obj_shape> replay_obj_directives(const std::vector<obj_chunk> & chunks, const std::vector<size_t> & triangleOffsets,
+        const std::vector<size_t> & faceOffsets, size_t triangleCount, size_t faceCount, const std::string & baseDir)
+    {
+        std::vector<obj_shape> shapes;
+        obj_shape shape;
+        std::string name;
+        int material = -1;
+        size_t pendingTriangle = 0, pendingFace = 0;
+
+        std::vector<tinyobj::material_t> materials;
+        std::map<std::string, int> materialMap;
+        tinyobj::MaterialFileReader readMaterials(baseDir);
+
+        // Moves the faces read since the last flush into the shape; afterwards nothing is pending
+        auto flush = [&](size_t triangle, size_t face)
+        {
+            if (face == pendingFace) return false;
+            if (triangle > pendingTriangle)
+            {
+                shape.ranges.push_back({ pendingTriangle, triangle, material });
+                shape.triangles += triangle - pendingTriangle;
+            }
+            pendingTriangle = triangle;
+            pendingFace = face;
+            return true;
+        };
+
+        auto keep = [&]()
+        {
+            shape.name = name;
+            shapes.push_back(std::move(shape));
+            shape = obj_shape();
+        };
+
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            for (const obj_event & e : chunks[c].events)
+            {
+                const size_t triangle = triangleOffsets[c] + e.triangle, face = faceOffsets[c] + e.face;
+                switch (e.type)
+                {
+                case obj_directive::usemtl:
+                {
+                    auto it = materialMap.find(e.name);
+                    const int id = (it != materialMap.end()) ? it->second : -1;
+                    if (id != material)
+                    {
+                        flush(triangle, face);
+                        material = id;
+                    }
+                    break;
+                }
+                case obj_directive::mtllib:
+                {
+                    // Files are split on single spaces and tried in order until one loads
+                    std::stringstream ss(e.name);
+                    std::string file, err;
+                    while (std::getline(ss, file, ' '))
+                    {
+                        if (readMaterials(file, &materials, &materialMap, &err)) break;
+                    }
+                    break;
+                }
+                case obj_directive::group:
+                    flush(triangle, face);
+                    if (shape.triangles > 0) keep();
+                    shape = obj_shape();
+                    name = e.name;
+                    break;
+                case obj_directive::object:
+                    if (flush(triangle, face)) keep();
+                    shape = obj_shape();
+                    name = e.name;
+                    break;
+                }
+            }
+        }
+
+        if (flush(triangleCount, faceCount) || shape.triangles > 0) keep();
+        return shapes;
     }
 
-    std::vector<float3> reorderedVertexBuffer(input.vertices.size());
+    // Open-addressing tables for vertex deduplication. Corners are looked up by their index triple;
+    // a triple seen for the first time falls back to a lookup by vertex value, because distinct
+    // triples may still name identical floats, which the value-keyed importer merged.
+    class obj_triple_table
+    {
+        struct entry { obj_corner key; uint32_t vertex; };
+        std::vector<entry> entries;
+        size_t count = 0;
+        uint32_t mask = 0;
+
+        static uint32_t hash(const obj_corner & c)
+        {
+            return _mm_crc32_u32(_mm_crc32_u32(_mm_crc32_u32(0, uint32_t(c.v)), uint32_t(c.vt)), uint32_t(c.vn));
+        }
+
+        void grow()
+        {
+            std::vector<entry> old(entries.size() * 2, entry{ { 0, 0, 0 }, UINT32_MAX });
+            old.swap(entries);
+            mask = uint32_t(entries.size() - 1);
+            for (const entry & e : old)
+            {
+                if (e.vertex == UINT32_MAX) continue;
+                uint32_t slot = hash(e.key) & mask;
+                while (entries[slot].vertex != UINT32_MAX) slot = (slot + 1) & mask;
+                entries[slot] = e;
+            }
+        }
+
+    public:
+        explicit obj_triple_table(size_t expected)
+        {
+            size_t capacity = 64;
+            while (capacity < expected * 2) capacity *= 2;
+            entries.assign(capacity, entry{ { 0, 0, 0 }, UINT32_MAX });
+            mask = uint32_t(capacity - 1);
+        }
+
+        // Returns the slot holding the key, or the empty slot where it belongs
+        entry & find(const obj_corner & key)
+        {
+            uint32_t slot = hash(key) & mask;
+            for (;;)
+            {
+                entry & e = entries[slot];
+                if (e.vertex == UINT32_MAX || (e.key.v == key.v && e.key.vt == key.vt && e.key.vn == key.vn)) return e;
+                slot = (slot + 1) & mask;
+            }
+        }
+
+        void insert(entry & slot, const obj_corner & key, uint32_t vertex)
+        {
+            slot.key = key;
+            slot.vertex = vertex;
+            if (++count * 2 > entries.size()) grow();
+        }
+    };
+
+    class obj_value_table
+    {
+        std::vector<uint32_t> slots; // vertex index + 1, zero is empty
+        size_t count = 0;
+        uint32_t mask = 0;
+        runtime_mesh & mesh;
+
+        uint32_t hash(uint32_t vertex) const
+        {
+            uint32_t h = crc32c(&mesh.vertices[vertex], sizeof(float3));
+            h = crc32c(&mesh.texcoord0[vertex], sizeof(float2), h);
+            return crc32c(&mesh.normals[vertex], sizeof(float3), h);
+        }
+
+        bool equal(uint32_t vertex, const unique_vertex & v) const
+        {
+            return !memcmp(&mesh.vertices[vertex], &v.position, sizeof(float3)) && !memcmp(&mesh.texcoord0[vertex], &v.texcoord, sizeof(float2))
+                && !memcmp(&mesh.normals[vertex], &v.normal, sizeof(float3));
+        }
+
+        void place(uint32_t vertex)
+        {
+            uint32_t slot = hash(vertex) & mask;
+            while (slots[slot]) slot = (slot + 1) & mask;
+            slots[slot] = vertex + 1;
+        }
+
+    public:
+        obj_value_table(runtime_mesh & mesh, size_t expected) : mesh(mesh)
+        {
+            size_t capacity = 64;
+            while (capacity < expected * 2) capacity *= 2;
+            slots.assign(capacity, 0);
+            mask = uint32_t(capacity - 1);
+        }
+
+        // Returns the vertex equal to v in every byte, or appends v to the mesh
+        uint32_t find_or_add(const unique_vertex & v)
+        {
+            uint32_t h = crc32c(&v.position, sizeof(float3));
+            h = crc32c(&v.texcoord, sizeof(float2), h);
+            h = crc32c(&v.normal, sizeof(float3), h);
+
+            for (uint32_t slot = h & mask; slots[slot]; slot = (slot + 1) & mask)
+            {
+                if (equal(slots[slot] - 1, v)) return slots[slot] - 1;
+            }
+
+            const uint32_t vertex = uint32_t(mesh.vertices.size());
+            mesh.vertices.push_back(v.position);
+            mesh.normals.push_back(v.normal);
+            mesh.texcoord0.push_back(v.texcoord);
+
+            if (++count * 2 > slots.size())
+            {
+                std::vector<uint32_t> old(slots.size() * 2, 0);
+                old.swap(slots);
+                mask = uint32_t(slots.size() - 1);
+                for (uint32_t s : old) if (s) place(s - 1);
+            }
+            else place(vertex);
+            return vertex;
+        }
+    };
+}
+
+std::map<std::string, runtime_mesh> import_obj_model(const std::string & path, uint32_t numThreads)
+{
+    // The file is parsed where it is mapped rather than copied into memory first. The scans rely on every
+    // line ending in a line break, so a last line without one is copied out and terminated.
+    std::unique_ptr<file_mapping> file;
+    try { file.reset(new file_mapping(path)); }
+    catch (const std::runtime_error &) { return {}; }
+
+    const char * text = reinterpret_cast<const char *>(file->data);
+    size_t size = file->size;
+    while (size > 0 && text[size - 1] != '\n') --size;
+    const std::string lastLine(text + size, text + file->size);
 
+    // Line-aligned chunks, a few per thread so uneven lines still balance
+    if (numThreads == 0) numThreads = hardware_thread_count();
+    const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size >> 18, size_t(numThreads) * 8));
+    std::vector<std::pair<const char *, const char *>> ranges;
+    const char * begin = text;
+    for (size_t c = 1; c < chunkCount; ++c)
     {
-        optimizePreTransform(reorderedVertexBuffer.data(), input.vertices.data(), reorderedIndices.data(), reorderedIndices.size(), input.vertices.size(), sizeof(float3));
+        const char * target = text + size * c / chunkCount;
+        if (target < begin) continue;
+        const char * newline = static_cast<const char *>(memchr(target, '\n', text + size - target));
+        if (!newline) break;
+        ranges.push_back({ begin, newline + 1 });
+        begin = newline + 1;
     }
+    ranges.push_back({ begin, text + size });
+    if (!lastLine.empty()) ranges.push_back({ lastLine.c_str(), lastLine.c_str() + lastLine.size() });
+
+    std::vector<obj_chunk> chunks(ranges.size());
+    parallel_for(0, chunks.size(), [&](size_t c) { parse_obj_chunk(ranges[c].first, ranges[c].second, chunks[c]); }, numThreads);
 
-    input.faces.clear();
-    for (int i = 0; i < reorderedIndices.size(); i += 3)
+    // Element offsets of each chunk. Vertex data stays with its chunk and is found through these.
+    std::vector<size_t> positionOffsets(chunks.size() + 1, 0), normalOffsets(chunks.size() + 1, 0), texcoordOffsets(chunks.size() + 1, 0);
+    std::vector<size_t> triangleOffsets(chunks.size() + 1, 0), faceOffsets(chunks.size() + 1, 0);
+    for (size_t c = 0; c < chunks.size(); ++c)
     {
-        input.faces.push_back(uint3(reorderedIndices[i], reorderedIndices[i + 1], reorderedIndices[i + 2]));
+        if (!chunks[c].error.empty()) throw std::runtime_error(chunks[c].error);
+        positionOffsets[c + 1] = positionOffsets[c] + chunks[c].positions.size();
+        normalOffsets[c + 1] = normalOffsets[c] + chunks[c].normals.size();
+        texcoordOffsets[c + 1] = texcoordOffsets[c] + chunks[c].texcoords.size();
+        triangleOffsets[c + 1] = triangleOffsets[c] + chunks[c].corners.size() / 3;
+        faceOffsets[c + 1] = faceOffsets[c] + chunks[c].faces;
     }
 
-    input.vertices.swap(reorderedVertexBuffer);
+    // Make relative indices global and check every index against the final counts, which is what
+    // tinyobj indexes with
+    std::vector<uint8_t> outOfRange(chunks.size(), 0);
+    parallel_for(0, chunks.size(), [&](size_t c)
+    {
+        auto resolve = [&](int32_t & index, const std::vector<size_t> & offsets, bool optional)
+        {
+            if (index < -1) index = int32_t(int64_t(index) - obj_relative_base + int64_t(offsets[c]));
+            if ((index == -1 && optional) || (index >= 0 && size_t(index) < offsets.back())) return;
+            outOfRange[c] = 1;
+        };
+        for (obj_corner & k : chunks[c].corners)
+        {
+            resolve(k.v, positionOffsets, false);
+            resolve(k.vt, texcoordOffsets, true);
+            resolve(k.vn, normalOffsets, true);
+        }
+    }, numThreads);
+
+    for (uint8_t bad : outOfRange) if (bad) throw std::runtime_error("obj face index out of range");
+
+    const std::string baseDir = parent_directory_from_filepath(path) + "/";
+    std::vector<obj_shape> shapes = replay_obj_directives(chunks, triangleOffsets, faceOffsets, triangleOffsets.back(), faceOffsets.back(), baseDir);
+
+    // Shapes sharing a name append to the same mesh in file order, so each name is one task
+    std::map<std::string, runtime_mesh> meshes;
+    std::map<std::string, std::vector<const obj_shape *>> shapesByName;
+    for (const obj_shape & s : shapes) shapesByName[s.name].push_back(&s);
+
+    std::vector<std::pair<runtime_mesh *, const std::vector<const obj_shape *> *>> tasks;
+    for (auto & n : shapesByName) tasks.push_back({ &meshes[n.first], &n.second });
+
+    auto chunk_of = [](const std::vector<size_t> & offsets, size_t index)
+    {
+        return size_t(std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1);
+    };
+
+    parallel_for(0, tasks.size(), [&](size_t t)
+    {
+        runtime_mesh & g = *tasks[t].first;
+        size_t triangles = 0;
+        for (const obj_shape * s : *tasks[t].second) triangles += s->triangles;
+        g.faces.reserve(triangles);
+
+        for (const obj_shape * s : *tasks[t].second)
+        {
+            // Each shape deduplicates on its own, as before
+            obj_triple_table triples(s->triangles / 2);
+            obj_value_table values(g, s->triangles / 2);
+
+            for (const obj_range & r : s->ranges)
+            {
+                size_t chunk = chunk_of(triangleOffsets, r.begin);
+                for (size_t f = r.begin; f < r.end; ++f)
+                {
+                    while (f >= triangleOffsets[chunk + 1]) ++chunk;
+                    const obj_corner * corners = &chunks[chunk].corners[(f - triangleOffsets[chunk]) * 3];
 
-    PostTransformCacheStatistics outStats = analyzePostTransform(&input.faces[0].x, input.faces.size() * 3, input.vertices.size(), cacheSize);
-    std::cout << "output acmr: " << outStats.acmr << ", cache hit %: " << outStats.hit_percent << std::endl;
+                    uint3 indices;
+                    for (int v = 0; v < 3; ++v)
+                    {
+                        const obj_corner & c = corners[v];
+                        auto & slot = triples.find(c);
+                        if (slot.vertex != UINT32_MAX)
+                        {
+                            indices[v] = slot.vertex;
+                            continue;
+                        }
+
+                        unique_vertex vertex;
+                        size_t k = chunk_of(positionOffsets, c.v);
+                        vertex.position = chunks[k].positions[c.v - positionOffsets[k]];
+                        if (c.vn != -1)
+                        {
+                            k = chunk_of(normalOffsets, c.vn);
+                            vertex.normal = chunks[k].normals[c.vn - normalOffsets[k]];
+                        }
+                        if (c.vt != -1)
+                        {
+                            k = chunk_of(texcoordOffsets, c.vt);
+                            vertex.texcoord = chunks[k].texcoords[c.vt - texcoordOffsets[k]];
+                        }
+
+                        indices[v] = values.find_or_add(vertex);
+                        triples.insert(slot, c, indices[v]);
+                    }
+
+                    if (r.material > 0) g.material.push_back(r.material);
+                    g.faces.push_back(indices);
+                }
+            }
+        }
+    }, numThreads);
+
+    return meshes;
 }
 
-runtime_mesh import_mesh_binary(const std::string & path)
+namespace
 {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.good()) throw std::runtime_error("couldn't open");
+    // Calls f on every per-vertex stream of a mesh; skin streams are optional
+    template<class F>
+    void for_each_vertex_stream(runtime_mesh & m, std::vector<int4> * boneIndices, std::vector<float4> * boneWeights, F f)
+    {
+        f(m.vertices); f(m.normals); f(m.colors); f(m.texcoord0); f(m.texcoord1); f(m.tangents); f(m.bitangents);
+        if (boneIndices) f(*boneIndices);
+        if (boneWeights) f(*boneWeights);
+    }
 
-    file.seekg(0, std::ios::end);
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    // Moves element i to remap[i]; elements mapped to ~0 are dropped
+    template<class T>
+    void remap_stream(std::vector<T> & stream, const std::vector<uint32_t> & remap, size_t newCount)
+    {
+        if (stream.empty()) return;
+        std::vector<T> result(newCount);
+        for (size_t i = 0; i < remap.size(); ++i) if (remap[i] != ~0u) result[remap[i]] = stream[i];
+        stream.swap(result);
+    }
 
-    runtime_mesh_binary_header h;
-    file.read((char*)&h, sizeof(runtime_mesh_binary_header));
+    void remap_faces(std::vector<uint3> & faces, const std::vector<uint32_t> & remap)
+    {
+        for (auto & f : faces) f = uint3(remap[f.x], remap[f.y], remap[f.z]);
+    }
 
-    assert(h.headerVersion == runtime_mesh_binary_version);
-    if (h.compressionVersion > 0) assert(h.compressionVersion == runtime_mesh_compression_version);
+    // Gives each distinct combination of attributes an index, in order of first use by the faces
+    std::vector<uint32_t> generate_vertex_remap(runtime_mesh & m, std::vector<int4> * boneIndices, std::vector<float4> * boneWeights, uint32_t & uniqueCount)
+    {
+        const size_t vertexCount = m.vertices.size();
 
-    runtime_mesh mesh;
+        size_t stride = 0;
+        for_each_vertex_stream(m, boneIndices, boneWeights, [&](auto & stream)
+        {
+            if (stream.empty()) return;
+            if (stream.size() != vertexCount) throw std::runtime_error("vertex streams differ in length");
+            stride += sizeof(stream[0]);
+        });
+
+        std::vector<uint8_t> keys(vertexCount * stride);
+        size_t offset = 0;
+        for_each_vertex_stream(m, boneIndices, boneWeights, [&](auto & stream)
+        {
+            if (stream.empty()) return;
+            const size_t size = sizeof(stream[0]);
+            for (size_t v = 0; v < vertexCount; ++v) memcpy(&keys[v * stride + offset], &stream[v], size);
+            offset += size;
+        });
+
+        auto hash = [&](uint32_t v)
+        {
+            uint64_t h = 14695981039346656037ull;
+            for (size_t i = 0; i < stride; ++i) h = (h ^ keys[v * stride + i]) * 1099511628211ull;
+            return h;
+        };
+
+        size_t capacity = 64;
+        while (capacity < vertexCount * 2) capacity *= 2;
+        std::vector<uint32_t> table(capacity, ~0u); // holds the first vertex seen with each key
+
+        std::vector<uint32_t> remap(vertexCount, ~0u);
+        uniqueCount = 0;
+        for (const auto & f : m.faces)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t v = f[c];
+                if (remap[v] != ~0u) continue;
+
+                size_t slot = size_t(hash(v)) & (capacity - 1);
+                while (table[slot] != ~0u && memcmp(&keys[table[slot] * stride], &keys[v * stride], stride)) slot = (slot + 1) & (capacity - 1);
+
+                if (table[slot] == ~0u)
+                {
+                    table[slot] = v;
+                    remap[v] = uniqueCount++;
+                }
+                else remap[v] = remap[table[slot]];
+            }
+        }
+        return remap;
+    }
+
+    // Vertex cache then overdraw order for one run of faces
+    void optimize_triangle_order(uint3 * faces, size_t faceCount, const std::vector<float3> & positions, const mesh_optimization_options & options)
+    {
+        if (!faceCount) return;
+        unsigned int * indices = &faces[0].x;
+        const size_t indexCount = faceCount * 3;
+
+        std::vector<unsigned int> cacheOrder(indexCount), clusters;
+        optimizePostTransform(cacheOrder.data(), indices, indexCount, positions.size(), options.cacheSize, &clusters);
+
+        if (options.overdrawThreshold > 0.0f) optimizeOverdraw(indices, cacheOrder.data(), indexCount, positions.data(), sizeof(float3), positions.size(), clusters, options.cacheSize, options.overdrawThreshold);
+        else std::copy(cacheOrder.begin(), cacheOrder.end(), indices);
+    }
+
+    void build_meshlets(runtime_mesh & m, size_t faceBegin, size_t faceEnd, const mesh_optimization_options & options, std::vector<uint32_t> & localIndex)
+    {
+        runtime_meshlet meshlet;
+        meshlet.vertexOffset = (uint32_t) m.meshletVertices.size();
+        meshlet.triangleOffset = (uint32_t) m.meshletTriangles.size() / 3;
+
+        auto flush = [&]()
+        {
+            if (!meshlet.triangleCount) return;
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i) localIndex[m.meshletVertices[meshlet.vertexOffset + i]] = ~0u;
+            m.meshlets.push_back(meshlet);
+            meshlet = runtime_meshlet();
+            meshlet.vertexOffset = (uint32_t) m.meshletVertices.size();
+            meshlet.triangleOffset = (uint32_t) m.meshletTriangles.size() / 3;
+        };
+
+        for (size_t t = faceBegin; t < faceEnd; ++t)
+        {
+            const uint3 & f = m.faces[t];
+            uint32_t added = 0;
+            for (int c = 0; c < 3; ++c) added += (localIndex[f[c]] == ~0u) && (c == 0 || f[c] != f[0]) && (c < 2 || f[c] != f[1]);
+            if (meshlet.vertexCount + added > options.meshletMaxVertices || meshlet.triangleCount + 1 > options.meshletMaxTriangles) flush();
+
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t & local = localIndex[f[c]];
+                if (local == ~0u)
+                {
+                    local = meshlet.vertexCount++;
+                    m.meshletVertices.push_back(f[c]);
+                }
+                m.meshletTriangles.push_back(uint8_t(local));
+            }
+            ++meshlet.triangleCount;
+        }
+        flush();
+    }
+
+    mesh_optimization_stats optimize_mesh(runtime_mesh & m, std::vector<int4> * boneIndices, std::vector<float4> * boneWeights, const mesh_optimization_options & options)
+    {
+        mesh_optimization_stats stats;
+        stats.verticesBefore = (uint32_t) m.vertices.size();
+        if (m.faces.empty() || m.vertices.empty()) return stats;
+        if (options.buildMeshlets && (options.meshletMaxVertices > 256 || options.meshletMaxVertices < 3 || options.meshletMaxTriangles < 1)) throw std::runtime_error("meshlets hold 3 to 256 vertices");
+
+        const PostTransformCacheStatistics before = analyzePostTransform(&m.faces[0].x, m.faces.size() * 3, m.vertices.size(), options.cacheSize);
+        stats.acmrBefore = before.acmr;
+        stats.atvrBefore = float(before.misses) / m.vertices.size();
+
+        // 1. Weld duplicates across every stream and drop unreferenced vertices
+        uint32_t uniqueCount = 0;
+        std::vector<uint32_t> remap = generate_vertex_remap(m, boneIndices, boneWeights, uniqueCount);
+        for_each_vertex_stream(m, boneIndices, boneWeights, [&](auto & stream) { remap_stream(stream, remap, uniqueCount); });
+        remap_faces(m.faces, remap);
+        for (auto & lod : m.lods) remap_faces(lod.faces, remap);
+
+        // 2. Group faces by material, then order each group for the vertex cache and overdraw
+        std::vector<size_t> groupStart = { 0 };
+        if (m.material.size() == m.faces.size())
+        {
+            std::vector<uint32_t> order(m.faces.size());
+            for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return m.material[a] < m.material[b]; });
+
+            std::vector<uint3> faces(m.faces.size());
+            std::vector<uint32_t> material(m.faces.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                faces[i] = m.faces[order[i]];
+                material[i] = m.material[order[i]];
+                if (i && material[i] != material[i - 1]) groupStart.push_back(i);
+            }
+            m.faces.swap(faces);
+            m.material.swap(material);
+        }
+        groupStart.push_back(m.faces.size());
+
+        for (size_t g = 0; g + 1 < groupStart.size(); ++g) optimize_triangle_order(&m.faces[groupStart[g]], groupStart[g + 1] - groupStart[g], m.vertices, options);
+        for (auto & lod : m.lods) optimize_triangle_order(lod.faces.data(), lod.faces.size(), m.vertices, options);
+
+        // 3. Number vertices in order of first use for fetch locality
+        std::fill(remap.begin(), remap.end(), ~0u);
+        remap.resize(uniqueCount, ~0u);
+        uint32_t next = 0;
+        for (const auto & f : m.faces) for (int c = 0; c < 3; ++c) if (remap[f[c]] == ~0u) remap[f[c]] = next++;
+        for_each_vertex_stream(m, boneIndices, boneWeights, [&](auto & stream) { remap_stream(stream, remap, next); });
+        remap_faces(m.faces, remap);
+        for (auto & lod : m.lods) remap_faces(lod.faces, remap);
+
+        // 4. Optionally split each material group into meshlets
+        m.meshlets.clear();
+        m.meshletVertices.clear();
+        m.meshletTriangles.clear();
+        if (options.buildMeshlets)
+        {
+            std::vector<uint32_t> localIndex(m.vertices.size(), ~0u);
+            for (size_t g = 0; g + 1 < groupStart.size(); ++g) build_meshlets(m, groupStart[g], groupStart[g + 1], options, localIndex);
+        }
+
+        const PostTransformCacheStatistics after = analyzePostTransform(&m.faces[0].x, m.faces.size() * 3, m.vertices.size(), options.cacheSize);
+        stats.acmrAfter = after.acmr;
+        stats.atvrAfter = float(after.misses) / m.vertices.size();
+        stats.verticesAfter = (uint32_t) m.vertices.size();
+        stats.meshletCount = m.meshlets.size();
+        return stats;
+    }
+}
+
+mesh_optimization_stats optimize_model(runtime_mesh & mesh, const mesh_optimization_options & options)
+{
+    return optimize_mesh(mesh, nullptr, nullptr, options);
+}
+
+mesh_optimization_stats optimize_model(runtime_skinned_mesh & mesh, const mesh_optimization_options & options)
+{
+    return optimize_mesh(mesh, &mesh.boneIndices, &mesh.boneWeights, options);
+}
+
+std::map<std::string, mesh_optimization_stats> optimize_models(std::map<std::string, runtime_mesh> & meshes, const mesh_optimization_options & options, uint32_t numThreads)
+{
+    std::vector<std::pair<const std::string *, runtime_mesh *>> list;
+    for (auto & m : meshes) list.emplace_back(&m.first, &m.second);
+
+    std::vector<mesh_optimization_stats> stats(list.size());
+    parallel_for(0, list.size(), [&](size_t i) { stats[i] = optimize_model(*list[i].second, options); }, numThreads);
+
+    std::map<std::string, mesh_optimization_stats> result;
+    for (size_t i = 0; i < list.size(); ++i) result[*list[i].first] = stats[i];
+    return result;
+}
+
+//////////////////////////////
+//   Mesh binary version 2  //
+//////////////////////////////
+
+struct mapped_runtime_mesh::mapping : file_mapping
+{
+    using file_mapping::file_mapping;
+};
+
+namespace
+{
+    void write_varint(std::vector<uint8_t> & out, uint64_t v)
+    {
+        while (v >= 0x80) { out.push_back(uint8_t(v | 0x80)); v >>= 7; }
+        out.push_back(uint8_t(v));
+    }
+
+    uint64_t read_varint(const uint8_t *& p, const uint8_t * end)
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p == end) throw std::runtime_error("truncated mesh section");
+            const uint8_t b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        throw std::runtime_error("bad varint in mesh section");
+    }
+
+    // Indices after vertex cache optimization are close to their predecessors, so zigzag deltas are mostly one byte
+    std::vector<uint8_t> encode_index_codec(const uint32_t * values, size_t count)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(count * 2);
+        int64_t previous = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int64_t delta = int64_t(values[i]) - previous;
+            previous = values[i];
+            write_varint(out, uint64_t((delta << 1) ^ (delta >> 63)));
+        }
+        return out;
+    }
+
+    void decode_index_codec(const uint8_t * src, size_t bytes, uint32_t * values, size_t count)
+    {
+        const uint8_t * end = src + bytes;
+        int64_t previous = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint64_t z = read_varint(src, end);
+            previous += int64_t(z >> 1) ^ -int64_t(z & 1);
+            values[i] = uint32_t(previous);
+        }
+        if (src != end) throw std::runtime_error("mesh section has trailing bytes");
+    }
+
+    // A zero run costs two bytes, so capping runs at 128 bounds how far a section can expand when decoded
+    const uint64_t vertex_codec_max_run = 128;
+    const uint64_t vertex_codec_max_expansion = vertex_codec_max_run / 2;
+
+    // Each byte position of an element becomes a plane of deltas from the previous element; the high bytes of
+    // floats and small integers change rarely, so their planes are mostly zeros, which are stored as runs
+    std::vector<uint8_t> encode_vertex_codec(const uint8_t * data, size_t count, size_t elementBytes)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(count * elementBytes / 2);
+        uint64_t zeros = 0;
+        auto flush = [&]()
+        {
+            while (zeros)
+            {
+                const uint64_t run = std::min(zeros, vertex_codec_max_run);
+                out.push_back(0);
+                write_varint(out, run - 1);
+                zeros -= run;
+            }
+        };
+        for (size_t k = 0; k < elementBytes; ++k)
+        {
+            uint8_t previous = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const uint8_t b = data[i * elementBytes + k], delta = uint8_t(b - previous);
+                previous = b;
+                if (delta == 0) { ++zeros; continue; }
+                flush();
+                out.push_back(delta);
+            }
+        }
+        flush();
+        return out;
+    }
+
+    void decode_vertex_codec(const uint8_t * src, size_t bytes, uint8_t * data, size_t count, size_t elementBytes)
+    {
+        const uint8_t * end = src + bytes;
+        uint64_t zeros = 0;
+        for (size_t k = 0; k < elementBytes; ++k)
+        {
+            uint8_t previous = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!zeros)
+                {
+                    if (src == end) throw std::runtime_error("truncated mesh section");
+                    const uint8_t delta = *src++;
+                    if (delta == 0)
+                    {
+                        zeros = read_varint(src, end) + 1;
+                        if (zeros > vertex_codec_max_run) throw std::runtime_error("bad zero run in mesh section");
+                    }
+                    else previous = uint8_t(previous + delta);
+                }
+                if (zeros) --zeros;
+                data[i * elementBytes + k] = previous;
+            }
+        }
+        if (zeros || src != end) throw std::runtime_error("mesh section has trailing bytes");
+    }
+
+    uint32_t section_element_bytes(runtime_mesh_section type)
+    {
+        switch (type)
+        {
+        case runtime_mesh_section::vertices: case runtime_mesh_section::normals: case runtime_mesh_section::tangents: case runtime_mesh_section::bitangents: return sizeof(float3);
+        case runtime_mesh_section::colors: return sizeof(float4);
+        case runtime_mesh_section::texcoord0: case runtime_mesh_section::texcoord1: return sizeof(float2);
+        case runtime_mesh_section::faces: case runtime_mesh_section::lod_faces: return sizeof(uint3);
+        case runtime_mesh_section::material: case runtime_mesh_section::meshlet_vertices: return sizeof(uint32_t);
+        case runtime_mesh_section::meshlets: return sizeof(runtime_meshlet);
+        case runtime_mesh_section::meshlet_triangles: return sizeof(uint8_t);
+        }
+        return 0;
+    }
+
+    bool is_index_section(runtime_mesh_section type)
+    {
+        return type == runtime_mesh_section::faces || type == runtime_mesh_section::lod_faces || type == runtime_mesh_section::meshlet_vertices;
+    }
+
+    template<class T> void set_span(runtime_span<T> & span, const uint8_t * data, uint64_t count)
+    {
+        span.data = reinterpret_cast<const T *>(data);
+        span.size = size_t(count);
+    }
+
+    uint64_t align_offset(uint64_t offset) { return (offset + runtime_mesh_binary_alignment - 1) & ~uint64_t(runtime_mesh_binary_alignment - 1); }
+
+    uint32_t table_checksum(runtime_mesh_binary_header_v2 header, const runtime_mesh_binary_section * sections)
+    {
+        header.tableChecksum = 0;
+        return crc32c(sections, size_t(header.sectionCount) * sizeof(runtime_mesh_binary_section), crc32c(&header, sizeof(header)));
+    }
+
+    // Checks a version 2 header against the size of its file
+    void check_header_v2(const runtime_mesh_binary_header_v2 & h, uint64_t size)
+    {
+        if (h.headerVersion != runtime_mesh_binary_version_2 || h.magic != runtime_mesh_binary_magic) throw std::runtime_error("not a version 2 mesh binary");
+        if (h.fileBytes != size || sizeof(h) + uint64_t(h.sectionCount) * sizeof(runtime_mesh_binary_section) > size) throw std::runtime_error("truncated mesh binary");
+    }
+
+    // The table bounds every read that follows, so it is checked even when section payloads are not
+    void check_section_table(const runtime_mesh_binary_header_v2 & h, const std::vector<runtime_mesh_binary_section> & sections)
+    {
+        if (table_checksum(h, sections.data()) != h.tableChecksum) throw std::runtime_error("mesh section table checksum mismatch");
+    }
+
+    // Returns false for sections from a newer writer, which readers skip, and throws for ones that cannot be read
+    bool check_section(const runtime_mesh_binary_section & s, uint64_t size, size_t sectionCount)
+    {
+        const uint32_t elementBytes = section_element_bytes(s.type);
+        if (elementBytes == 0) return false;
+        if (s.elementBytes != elementBytes || s.offset > size || s.storedBytes > size - s.offset) throw std::runtime_error("bad mesh section");
 
-    mesh.vertices.resize(h.verticesBytes / sizeof(float3));
-    mesh.normals.resize(h.normalsBytes / sizeof(float3));
-    mesh.colors.resize(h.colorsBytes / sizeof(float3));
-    mesh.texcoord0.resize(h.texcoord0Bytes / sizeof(float2));
-    mesh.texcoord1.resize(h.texcoord1Bytes / sizeof(float2));
-    mesh.tangents.resize(h.tangentsBytes / sizeof(float3));
-    mesh.bitangents.resize(h.bitangentsBytes / sizeof(float3));
-    mesh.faces.resize(h.facesBytes / sizeof(uint3));
-    mesh.material.resize(h.materialsBytes / sizeof(uint32_t));
-
-    file.read((char*)mesh.vertices.data(), h.verticesBytes);
-    file.read((char*)mesh.normals.data(), h.normalsBytes);
-    file.read((char*)mesh.colors.data(), h.colorsBytes);
-    file.read((char*)mesh.texcoord0.data(), h.texcoord0Bytes);
-    file.read((char*)mesh.texcoord1.data(), h.texcoord1Bytes);
-    file.read((char*)mesh.tangents.data(), h.tangentsBytes);
-    file.read((char*)mesh.bitangents.data(), h.bitangentsBytes);
-    file.read((char*)mesh.faces.data(), h.facesBytes);
-    file.read((char*)mesh.material.data(), h.materialsBytes);
+        // Every stored index takes at least a byte, and vertex-coded data expands by a bounded factor, so the
+        // element count is checked against the stored size before anything is allocated for it
+        uint64_t maxExpansion = 1;
+        if (s.codec == runtime_mesh_codec::index) maxExpansion = sizeof(uint32_t);
+        else if (s.codec == runtime_mesh_codec::vertex) maxExpansion = vertex_codec_max_expansion;
+        else if (s.codec != runtime_mesh_codec::none) throw std::runtime_error("unknown mesh section codec");
+        if (s.elementCount > s.storedBytes * maxExpansion / elementBytes) throw std::runtime_error("bad mesh section");
+        if (s.codec == runtime_mesh_codec::none && (s.storedBytes != s.elementCount * elementBytes || s.offset % alignof(float4))) throw std::runtime_error("bad mesh section");
 
+        // Each level has a section of its own, so a level past the section count is corrupt
+        if (s.type == runtime_mesh_section::lod_faces && s.index >= sectionCount) throw std::runtime_error("bad mesh section");
+        return true;
+    }
+
+    // Decodes a compressed section into elementCount * elementBytes bytes at dst
+    void decode_section(const runtime_mesh_binary_section & s, const uint8_t * stored, uint8_t * dst)
+    {
+        if (s.codec == runtime_mesh_codec::index) decode_index_codec(stored, size_t(s.storedBytes), reinterpret_cast<uint32_t *>(dst), size_t(s.elementCount * s.elementBytes / sizeof(uint32_t)));
+        else decode_vertex_codec(stored, size_t(s.storedBytes), dst, size_t(s.elementCount), s.elementBytes);
+    }
+}
+
+mapped_runtime_mesh::mapped_runtime_mesh(const std::string & path, bool verifyChecksums) : file(std::make_shared<mapping>(path))
+{
+    const uint8_t * base = file->data;
+    const size_t size = file->size;
+
+    runtime_mesh_binary_header_v2 h;
+    if (size < sizeof(h)) throw std::runtime_error("not a mesh binary");
+    std::memcpy(&h, base, sizeof(h));
+    check_header_v2(h, size);
+
+    std::vector<runtime_mesh_binary_section> sections(h.sectionCount);
+    if (h.sectionCount) std::memcpy(sections.data(), base + sizeof(h), sections.size() * sizeof(runtime_mesh_binary_section));
+    check_section_table(h, sections);
+
+    for (const auto & s : sections)
+    {
+        if (!check_section(s, size, sections.size())) continue;
+        if (verifyChecksums && crc32c(base + s.offset, size_t(s.storedBytes)) != s.checksum) throw std::runtime_error("mesh section checksum mismatch");
+
+        const uint8_t * data = base + s.offset;
+        if (s.codec != runtime_mesh_codec::none)
+        {
+            decoded.emplace_back(size_t(s.elementCount * s.elementBytes));
+            decode_section(s, data, decoded.back().data());
+            data = decoded.back().data();
+        }
+
+        auto & v = meshView;
+        switch (s.type)
+        {
+        case runtime_mesh_section::vertices: set_span(v.vertices, data, s.elementCount); break;
+        case runtime_mesh_section::normals: set_span(v.normals, data, s.elementCount); break;
+        case runtime_mesh_section::colors: set_span(v.colors, data, s.elementCount); break;
+        case runtime_mesh_section::texcoord0: set_span(v.texcoord0, data, s.elementCount); break;
+        case runtime_mesh_section::texcoord1: set_span(v.texcoord1, data, s.elementCount); break;
+        case runtime_mesh_section::tangents: set_span(v.tangents, data, s.elementCount); break;
+        case runtime_mesh_section::bitangents: set_span(v.bitangents, data, s.elementCount); break;
+        case runtime_mesh_section::faces: set_span(v.faces, data, s.elementCount); break;
+        case runtime_mesh_section::material: set_span(v.material, data, s.elementCount); break;
+        case runtime_mesh_section::lod_faces:
+            if (s.index >= v.lods.size()) v.lods.resize(s.index + 1);
+            set_span(v.lods[s.index].faces, data, s.elementCount);
+            v.lods[s.index].error = s.param;
+            break;
+        case runtime_mesh_section::meshlets: set_span(v.meshlets, data, s.elementCount); break;
+        case runtime_mesh_section::meshlet_vertices: set_span(v.meshletVertices, data, s.elementCount); break;
+        case runtime_mesh_section::meshlet_triangles: set_span(v.meshletTriangles, data, s.elementCount); break;
+        }
+    }
+}
+
+runtime_mesh runtime_mesh_view::to_mesh() const
+{
+    runtime_mesh mesh;
+    mesh.vertices = vertices.to_vector();
+    mesh.normals = normals.to_vector();
+    mesh.colors = colors.to_vector();
+    mesh.texcoord0 = texcoord0.to_vector();
+    mesh.texcoord1 = texcoord1.to_vector();
+    mesh.tangents = tangents.to_vector();
+    mesh.bitangents = bitangents.to_vector();
+    mesh.faces = faces.to_vector();
+    mesh.material = material.to_vector();
+    for (const auto & lod : lods)
+    {
+        runtime_mesh_lod l;
+        l.faces = lod.faces.to_vector();
+        l.error = lod.error;
+        mesh.lods.push_back(std::move(l));
+    }
+    mesh.meshlets = meshlets.to_vector();
+    mesh.meshletVertices = meshletVertices.to_vector();
+    mesh.meshletTriangles = meshletTriangles.to_vector();
     return mesh;
 }
 
+namespace
+{
+    runtime_mesh import_mesh_binary_v1(std::ifstream & file)
+    {
+        file.seekg(0, std::ios::end);
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        runtime_mesh_binary_header h;
+        file.read((char*)&h, sizeof(runtime_mesh_binary_header));
+
+        assert(h.headerVersion == runtime_mesh_binary_version);
+        if (h.compressionVersion > 0) assert(h.compressionVersion == runtime_mesh_compression_version);
+
+        runtime_mesh mesh;
+
+        mesh.vertices.resize(h.verticesBytes / sizeof(float3));
+        mesh.normals.resize(h.normalsBytes / sizeof(float3));
+        mesh.colors.resize(h.colorsBytes / sizeof(float3));
+        mesh.texcoord0.resize(h.texcoord0Bytes / sizeof(float2));
+        mesh.texcoord1.resize(h.texcoord1Bytes / sizeof(float2));
+        mesh.tangents.resize(h.tangentsBytes / sizeof(float3));
+        mesh.bitangents.resize(h.bitangentsBytes / sizeof(float3));
+        mesh.faces.resize(h.facesBytes / sizeof(uint3));
+        mesh.material.resize(h.materialsBytes / sizeof(uint32_t));
+
+        file.read((char*)mesh.vertices.data(), h.verticesBytes);
+        file.read((char*)mesh.normals.data(), h.normalsBytes);
+        file.read((char*)mesh.colors.data(), h.colorsBytes);
+        file.read((char*)mesh.texcoord0.data(), h.texcoord0Bytes);
+        file.read((char*)mesh.texcoord1.data(), h.texcoord1Bytes);
+        file.read((char*)mesh.tangents.data(), h.tangentsBytes);
+        file.read((char*)mesh.bitangents.data(), h.bitangentsBytes);
+        file.read((char*)mesh.faces.data(), h.facesBytes);
+        file.read((char*)mesh.material.data(), h.materialsBytes);
+
+        if (file.tellg() < size)
+        {
+            // The counts are checked against the bytes left in the file before anything is allocated for them
+            auto remaining = [&]() { return uint64_t(size - file.tellg()); };
+
+            uint32_t lodCount = 0;
+            file.read((char*)&lodCount, sizeof(uint32_t));
+            if (!file.good() || uint64_t(lodCount) * (sizeof(float) + sizeof(uint32_t)) > remaining()) throw std::runtime_error("truncated lod block");
+            mesh.lods.resize(lodCount);
+            for (auto & lod : mesh.lods)
+            {
+                uint32_t facesBytes = 0;
+                file.read((char*)&lod.error, sizeof(float));
+                file.read((char*)&facesBytes, sizeof(uint32_t));
+                if (!file.good() || facesBytes % sizeof(uint3) || facesBytes > remaining()) throw std::runtime_error("truncated lod block");
+                lod.faces.resize(facesBytes / sizeof(uint3));
+                file.read((char*)lod.faces.data(), facesBytes);
+            }
+            if (!file.good()) throw std::runtime_error("truncated lod block");
+        }
+
+        return mesh;
+    }
+
+    // Calls f on the mesh array a section fills
+    template<class F>
+    void with_section_array(runtime_mesh & mesh, const runtime_mesh_binary_section & s, F f)
+    {
+        switch (s.type)
+        {
+        case runtime_mesh_section::vertices: f(mesh.vertices); break;
+        case runtime_mesh_section::normals: f(mesh.normals); break;
+        case runtime_mesh_section::colors: f(mesh.colors); break;
+        case runtime_mesh_section::texcoord0: f(mesh.texcoord0); break;
+        case runtime_mesh_section::texcoord1: f(mesh.texcoord1); break;
+        case runtime_mesh_section::tangents: f(mesh.tangents); break;
+        case runtime_mesh_section::bitangents: f(mesh.bitangents); break;
+        case runtime_mesh_section::faces: f(mesh.faces); break;
+        case runtime_mesh_section::material: f(mesh.material); break;
+        case runtime_mesh_section::lod_faces:
+            if (s.index >= mesh.lods.size()) mesh.lods.resize(s.index + 1);
+            mesh.lods[s.index].error = s.param;
+            f(mesh.lods[s.index].faces);
+            break;
+        case runtime_mesh_section::meshlets: f(mesh.meshlets); break;
+        case runtime_mesh_section::meshlet_vertices: f(mesh.meshletVertices); break;
+        case runtime_mesh_section::meshlet_triangles: f(mesh.meshletTriangles); break;
+        }
+    }
+
+    // Copies or decodes each section straight into the array it fills. Going through mapped_runtime_mesh
+    // decoded compressed sections into buffers of its own and then copied every array out of the view.
+    runtime_mesh import_mesh_binary_v2(const std::string & path)
+    {
+        const file_mapping file(path);
+        const uint8_t * base = file.data;
+        const size_t size = file.size;
+
+        runtime_mesh_binary_header_v2 h;
+        if (size < sizeof(h)) throw std::runtime_error("not a mesh binary");
+        std::memcpy(&h, base, sizeof(h));
+        check_header_v2(h, size);
+
+        std::vector<runtime_mesh_binary_section> sections(h.sectionCount);
+        if (h.sectionCount) std::memcpy(sections.data(), base + sizeof(h), sections.size() * sizeof(runtime_mesh_binary_section));
+        check_section_table(h, sections);
+
+        runtime_mesh mesh;
+        for (const auto & s : sections)
+        {
+            if (!check_section(s, size, sections.size())) continue;
+            const uint8_t * stored = base + s.offset;
+            if (crc32c(stored, size_t(s.storedBytes)) != s.checksum) throw std::runtime_error("mesh section checksum mismatch");
+
+            with_section_array(mesh, s, [&](auto & array)
+            {
+                typedef typename std::decay<decltype(array)>::type::value_type T;
+                if (s.codec == runtime_mesh_codec::none)
+                {
+                    // Uncompressed sections are aligned in the mapping, so their elements can be read in place
+                    const T * elements = reinterpret_cast<const T *>(stored);
+                    array.assign(elements, elements + s.elementCount);
+                }
+                else
+                {
+                    array.resize(size_t(s.elementCount));
+                    decode_section(s, stored, reinterpret_cast<uint8_t *>(array.data()));
+                }
+            });
+        }
+        return mesh;
+    }
+}
+
+runtime_mesh import_mesh_binary(const std::string & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) throw std::runtime_error("couldn't open");
+
+    uint32_t version = 0;
+    file.read((char*)&version, sizeof(uint32_t));
+
+    if (version == runtime_mesh_binary_version) return import_mesh_binary_v1(file);
+    if (version != runtime_mesh_binary_version_2) throw std::runtime_error("unknown mesh binary version");
+
+    file.close();
+    return import_mesh_binary_v2(path);
+}
+
 void export_mesh_binary(const std::string & path, runtime_mesh & mesh, bool compressed)
 {
+    struct pending_section
+    {
+        runtime_mesh_binary_section header;
+        const uint8_t * data;
+        std::vector<uint8_t> encoded;
+    };
+
+    std::vector<pending_section> sections;
+    auto add = [&](runtime_mesh_section type, const void * data, size_t count, uint32_t index = 0, float param = 0.0f)
+    {
+        if (count == 0) return;
+        pending_section s;
+        s.header.type = type;
+        s.header.elementBytes = section_element_bytes(type);
+        s.header.elementCount = count;
+        s.header.index = index;
+        s.header.param = param;
+        s.data = static_cast<const uint8_t *>(data);
+        sections.push_back(std::move(s));
+    };
+
+    add(runtime_mesh_section::vertices, mesh.vertices.data(), mesh.vertices.size());
+    add(runtime_mesh_section::normals, mesh.normals.data(), mesh.normals.size());
+    add(runtime_mesh_section::colors, mesh.colors.data(), mesh.colors.size());
+    add(runtime_mesh_section::texcoord0, mesh.texcoord0.data(), mesh.texcoord0.size());
+    add(runtime_mesh_section::texcoord1, mesh.texcoord1.data(), mesh.texcoord1.size());
+    add(runtime_mesh_section::tangents, mesh.tangents.data(), mesh.tangents.size());
+    add(runtime_mesh_section::bitangents, mesh.bitangents.data(), mesh.bitangents.size());
+    add(runtime_mesh_section::faces, mesh.faces.data(), mesh.faces.size());
+    add(runtime_mesh_section::material, mesh.material.data(), mesh.material.size());
+    for (uint32_t l = 0; l < mesh.lods.size(); ++l) add(runtime_mesh_section::lod_faces, mesh.lods[l].faces.data(), mesh.lods[l].faces.size(), l, mesh.lods[l].error);
+    add(runtime_mesh_section::meshlets, mesh.meshlets.data(), mesh.meshlets.size());
+    add(runtime_mesh_section::meshlet_vertices, mesh.meshletVertices.data(), mesh.meshletVertices.size());
+    add(runtime_mesh_section::meshlet_triangles, mesh.meshletTriangles.data(), mesh.meshletTriangles.size());
+
+    // Sections are independent, so encode them in parallel
+    parallel_for(0, sections.size(), [&](size_t i)
+    {
+        auto & s = sections[i];
+        const size_t bytes = size_t(s.header.elementCount * s.header.elementBytes);
+        if (compressed)
+        {
+            if (is_index_section(s.header.type))
+            {
+                s.header.codec = runtime_mesh_codec::index;
+                s.encoded = encode_index_codec(reinterpret_cast<const uint32_t *>(s.data), bytes / sizeof(uint32_t));
+            }
+            else
+            {
+                s.header.codec = runtime_mesh_codec::vertex;
+                s.encoded = encode_vertex_codec(s.data, size_t(s.header.elementCount), s.header.elementBytes);
+            }
+            s.data = s.encoded.data();
+            s.header.storedBytes = s.encoded.size();
+        }
+        else s.header.storedBytes = bytes;
+        s.header.checksum = crc32c(s.data, size_t(s.header.storedBytes));
+    });
+
+    runtime_mesh_binary_header_v2 header;
+    header.sectionCount = (uint32_t)sections.size();
+    std::vector<runtime_mesh_binary_section> table;
+    uint64_t offset = sizeof(header) + sections.size() * sizeof(runtime_mesh_binary_section);
+    for (auto & s : sections)
+    {
+        s.header.offset = align_offset(offset);
+        offset = s.header.offset + s.header.storedBytes;
+        table.push_back(s.header);
+    }
+    header.fileBytes = offset;
+    header.tableChecksum = table_checksum(header, table.data());
+
     auto file = std::ofstream(path, std::ios::out | std::ios::binary);
+    if (!file.good()) throw std::runtime_error("couldn't open " + path + " for writing");
 
-    runtime_mesh_binary_header header;
-    header.headerVersion = runtime_mesh_binary_version;
-    header.compressionVersion = (compressed) ? runtime_mesh_compression_version : 0;
-    header.verticesBytes = (uint32_t)mesh.vertices.size() * sizeof(float3);
-    header.normalsBytes = (uint32_t)mesh.normals.size() * sizeof(float3);
-    header.colorsBytes = (uint32_t)mesh.colors.size() * sizeof(float3);
-    header.texcoord0Bytes = (uint32_t)mesh.texcoord0.size() * sizeof(float2);
-    header.texcoord1Bytes = (uint32_t)mesh.texcoord1.size() * sizeof(float2);
-    header.tangentsBytes = (uint32_t)mesh.tangents.size() * sizeof(float3);
-    header.bitangentsBytes = (uint32_t)mesh.bitangents.size() * sizeof(float3);
-    header.facesBytes = (uint32_t)mesh.faces.size() * sizeof(uint3);
-    header.materialsBytes = (uint32_t)mesh.material.size() * sizeof(uint32_t);
-
-    file.write(reinterpret_cast<char*>(&header), sizeof(runtime_mesh_binary_header));
-    file.write(reinterpret_cast<char*>(mesh.vertices.data()), header.verticesBytes);
-    file.write(reinterpret_cast<char*>(mesh.normals.data()), header.normalsBytes);
-    file.write(reinterpret_cast<char*>(mesh.colors.data()), header.colorsBytes);
-    file.write(reinterpret_cast<char*>(mesh.texcoord0.data()), header.texcoord0Bytes);
-    file.write(reinterpret_cast<char*>(mesh.texcoord1.data()), header.texcoord1Bytes);
-    file.write(reinterpret_cast<char*>(mesh.tangents.data()), header.tangentsBytes);
-    file.write(reinterpret_cast<char*>(mesh.bitangents.data()), header.bitangentsBytes);
-    file.write(reinterpret_cast<char*>(mesh.faces.data()), header.facesBytes);
-    file.write(reinterpret_cast<char*>(mesh.material.data()), header.materialsBytes);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), std::streamsize(table.size() * sizeof(runtime_mesh_binary_section)));
+
+    uint64_t written = sizeof(header) + sections.size() * sizeof(runtime_mesh_binary_section);
+    const char padding[runtime_mesh_binary_alignment] = {};
+    for (auto & s : sections)
+    {
+        file.write(padding, std::streamsize(s.header.offset - written));
+        file.write(reinterpret_cast<const char*>(s.data), std::streamsize(s.header.storedBytes));
+        written = s.header.offset + s.header.storedBytes;
+    }
 
+    if (!file.good()) throw std::runtime_error("couldn't write " + path);
     file.close();
 }
@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
 
 using namespace avl;
 
@@ -29,6 +30,7 @@ struct animation_track
     std::vector<std::shared_ptr<animation_keyframe>> keyframes;
 };
 
+// As imported; animation_clip.hpp converts it to a compact form for playback
 struct skeletal_animation
 {
     uint32_t total_frames() const { return endFrame - startFrame; }
@@ -40,6 +42,24 @@ struct skeletal_animation
     std::vector<std::shared_ptr<animation_track>> tracks;
 };
 
+// A cluster of at most a few dozen vertices and triangles, for mesh-shader style culling and drawing.
+// Its vertices are meshletVertices[vertexOffset ...] and its triangles are triples of local indices in
+// meshletTriangles[triangleOffset * 3 ...].
+struct runtime_meshlet
+{
+    uint32_t vertexOffset = 0;
+    uint32_t triangleOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+};
+
+// A coarser index list over the vertices of the mesh that owns it
+struct runtime_mesh_lod
+{
+    std::vector<uint3> faces;
+    float error = 0.0f; // simplification error relative to the mesh radius
+};
+
 struct runtime_mesh
 {
     std::vector<float3> vertices;
@@ -51,6 +71,10 @@ struct runtime_mesh
     std::vector<float3> bitangents;
     std::vector<uint3> faces;
     std::vector<uint32_t> material;
+    std::vector<runtime_mesh_lod> lods; // finest first, see mesh_lod.hpp
+    std::vector<runtime_meshlet> meshlets; // optional, built by optimize_model
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint8_t> meshletTriangles;
 };
 
 struct bone
@@ -92,12 +116,143 @@ struct runtime_mesh_binary_header
 };
 #pragma pack(pop)
 
-void optimize_model(runtime_mesh & input);
+// LODs follow the attribute arrays as an optional trailing block, which version 1 readers ignore:
+// a uint32_t level count, then for every level its float error, a uint32_t byte count and its faces.
+
+// Version 2 is what export_mesh_binary writes: the header, a table of sections, then each section's payload
+// at a 64-byte aligned offset, so an uncompressed file can be memory mapped and its arrays used in place
+// (mapped_runtime_mesh). Every section carries a CRC32C of its stored bytes, and the header one of itself
+// and the section table. Compressed sections use a lossless codec per kind of data: index-like sections
+// store zigzag deltas as varints, others store per-byte-plane deltas with runs of up to 128 zero bytes
+// collapsed, so no section decodes to more than 64 times its stored size. The vendored meshoptimizer
+// predates its own vertex and index codecs, so these stand in for them.
+
+#define runtime_mesh_binary_version_2 2
+#define runtime_mesh_binary_magic 0x4d4c5641 // "AVLM"
+#define runtime_mesh_binary_alignment 64
+
+enum class runtime_mesh_section : uint32_t
+{
+    vertices, normals, colors, texcoord0, texcoord1, tangents, bitangents, faces, material,
+    lod_faces,              // one per level: index is the level, param its error
+    meshlets, meshlet_vertices, meshlet_triangles
+};
+
+enum class runtime_mesh_codec : uint32_t { none, vertex, index };
+
+#pragma pack(push, 1)
+struct runtime_mesh_binary_header_v2
+{
+    uint32_t headerVersion{ runtime_mesh_binary_version_2 }; // where version 1 keeps its version too
+    uint32_t magic{ runtime_mesh_binary_magic };
+    uint32_t sectionCount{ 0 };
+    uint32_t flags{ 0 };
+    uint64_t fileBytes{ 0 };
+    uint32_t tableChecksum{ 0 };    // CRC32C of this header, with this field zero, followed by the section table
+    uint32_t reserved{ 0 };
+};
+
+struct runtime_mesh_binary_section
+{
+    runtime_mesh_section type{ runtime_mesh_section::vertices };
+    runtime_mesh_codec codec{ runtime_mesh_codec::none };
+    uint32_t elementBytes{ 0 };
+    uint32_t index{ 0 };
+    uint64_t offset{ 0 };           // from the start of the file
+    uint64_t storedBytes{ 0 };
+    uint64_t elementCount{ 0 };
+    uint32_t checksum{ 0 };         // CRC32C of the stored bytes
+    float param{ 0 };
+};
+#pragma pack(pop)
+
+// A read-only array in someone else's memory
+template<class T> struct runtime_span
+{
+    const T * data = nullptr;
+    size_t size = 0;
+    const T * begin() const { return data; }
+    const T * end() const { return data + size; }
+    bool empty() const { return size == 0; }
+    const T & operator[](size_t i) const { return data[i]; }
+    std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+};
+
+struct runtime_mesh_lod_view
+{
+    runtime_span<uint3> faces;
+    float error = 0.0f;
+};
+
+// runtime_mesh as spans, for uploading or reading a mesh without copying it
+struct runtime_mesh_view
+{
+    runtime_span<float3> vertices;
+    runtime_span<float3> normals;
+    runtime_span<float4> colors;
+    runtime_span<float2> texcoord0;
+    runtime_span<float2> texcoord1;
+    runtime_span<float3> tangents;
+    runtime_span<float3> bitangents;
+    runtime_span<uint3> faces;
+    runtime_span<uint32_t> material;
+    std::vector<runtime_mesh_lod_view> lods;
+    runtime_span<runtime_meshlet> meshlets;
+    runtime_span<uint32_t> meshletVertices;
+    runtime_span<uint8_t> meshletTriangles;
+
+    runtime_mesh to_mesh() const;
+};
+
+// A version 2 file mapped into memory. Uncompressed sections are viewed where they lie in the mapping;
+// compressed ones are decoded once into memory the object owns. Views stay valid while the object lives.
+class mapped_runtime_mesh
+{
+    struct mapping;
+    std::shared_ptr<mapping> file;
+    std::vector<std::vector<uint8_t>> decoded;
+    runtime_mesh_view meshView;
+public:
+    explicit mapped_runtime_mesh(const std::string & path, bool verifyChecksums = true);
+    const runtime_mesh_view & view() const { return meshView; }
+};
+
+struct mesh_optimization_options
+{
+    uint32_t cacheSize = 32;            // vertex cache size to optimize and analyze for
+    float overdrawThreshold = 1.05f;    // how far overdraw ordering may degrade ACMR; 0 skips it
+    bool buildMeshlets = false;
+    uint32_t meshletMaxVertices = 64;
+    uint32_t meshletMaxTriangles = 124;
+};
+
+// ACMR: transformed vertices per triangle. ATVR: transformed vertices per unique vertex, 1.0 is ideal.
+struct mesh_optimization_stats
+{
+    float acmrBefore = 0, acmrAfter = 0;
+    float atvrBefore = 0, atvrAfter = 0;
+    uint32_t verticesBefore = 0, verticesAfter = 0;
+    size_t meshletCount = 0;
+};
+
+// Welds vertices that are equal in every stream, then orders triangles for the vertex cache and overdraw
+// and vertices for fetch locality. Every vertex stream, including skin data, is remapped together, LOD
+// index lists follow the new vertex order, and faces with per-face materials are grouped by material.
+mesh_optimization_stats optimize_model(runtime_mesh & mesh, const mesh_optimization_options & options = mesh_optimization_options());
+mesh_optimization_stats optimize_model(runtime_skinned_mesh & mesh, const mesh_optimization_options & options = mesh_optimization_options());
+
+// Optimizes meshes in parallel
+std::map<std::string, mesh_optimization_stats> optimize_models(std::map<std::string, runtime_mesh> & meshes, const mesh_optimization_options & options = mesh_optimization_options(), uint32_t numThreads = 0);
+// Reads version 1 and 2 files, telling them apart by their leading version field
 runtime_mesh import_mesh_binary(const std::string & path);
 void export_mesh_binary(const std::string & path, runtime_mesh & mesh, bool compressed = false);
 
 std::map<std::string, runtime_mesh> import_fbx_model(const std::string & path);
-std::map<std::string, runtime_mesh> import_obj_model(const std::string & path);
+// Parses line-aligned chunks of the file in parallel and deduplicates vertices by their v/vt/vn index
+// triple. Output matches import_obj_model_tinyobj byte for byte, except that faces without normals get
+// zero normals instead of reading out of bounds. Malformed face indices throw.
+std::map<std::string, runtime_mesh> import_obj_model(const std::string & path, uint32_t numThreads = 0);
+std::map<std::string, runtime_mesh> import_obj_model_tinyobj(const std::string & path);
 std::map<std::string, runtime_mesh> import_model(const std::string & path);
 
 #endif // end runtime_mesh_hpp
@@ -17,12 +17,22 @@ static inline uint64_t system_time_ns()
     return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
 }
 
+// Assets loaded asynchronously are Pending, holding a placeholder, until they are assigned or fail
+enum class AssetState
+{
+    Unassigned,
+    Pending,
+    Ready,
+    Failed
+};
+
 // Note that the asset of `UniqueAsset` must be default constructable.
 template<typename T>
 struct UniqueAsset : public Noncopyable
 {
     T asset;
     bool assigned{ false };
+    AssetState state{ AssetState::Unassigned };
     uint64_t timestamp;
 };
 
@@ -94,6 +104,7 @@ public:
         handle = a;
         handle->asset = std::move(asset);
         handle->assigned = true;
+        handle->state = AssetState::Ready;
         handle->timestamp = system_time_ns();
 
         Logger::get_instance()->assetLog->info("asset type {} with id {} was assigned", typeid(this).name(), name);
@@ -101,6 +112,38 @@ public:
         return handle->asset;
     }
 
+    // Stands in for the asset while it loads. get() returns the placeholder, but the handle isn't assigned yet.
+    T & assign_placeholder(T && placeholder)
+    {
+        auto & a = table[name];
+        if (!a) a = std::make_shared<UniqueAsset<T>>();
+
+        handle = a;
+        handle->asset = std::move(placeholder);
+        handle->assigned = false;
+        handle->state = AssetState::Pending;
+        handle->timestamp = system_time_ns();
+        return handle->asset;
+    }
+
+    // The placeholder, if any, stays in place
+    void mark_failed(const std::string & reason)
+    {
+        auto & a = table[name];
+        if (!a) a = std::make_shared<UniqueAsset<T>>();
+
+        handle = a;
+        handle->state = AssetState::Failed;
+        Logger::get_instance()->assetLog->error("asset type {} with id {} failed to load: {}", typeid(this).name(), name, reason);
+    }
+
+    AssetState state() const
+    {
+        if (handle) return handle->state;
+        auto it = table.find(name);
+        return it != table.end() && it->second ? it->second->state : AssetState::Unassigned;
+    }
+
     bool assigned() const
     {
         if (handle && handle->assigned) return true;
@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef async_assets_hpp
+#define async_assets_hpp
+
+#include "assets.hpp"
+#include "string_utils.hpp"
+#include "asset_io.hpp"
+#include "async_asset_loader.hpp"
+
+// Texture loads through an AsyncAssetLoader: handles hold a placeholder while a worker reads and decodes,
+// and are assigned when the loader's process_uploads runs on the GL thread. Kept apart from assets.hpp so
+// that only code driving a loader pulls in the image decoders.
+
+// A 1x1 mid grey texture, or cubemap, for materials to sample until the real one arrives
+inline GlTexture2D make_placeholder_texture(bool cubemap = false)
+{
+    const uint8_t grey[4] = { 128, 128, 128, 255 };
+    GlTexture2D tex;
+    if (cubemap) tex.setup_cube(1, 1, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    else tex.setup(1, 1, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    return tex;
+}
+
+// Reads and decodes on a loader worker, then uploads in the loader's process_uploads. Until then the handle is Pending.
+inline GlTextureHandle load_image_async(AsyncAssetLoader & loader, const std::string & asset_id, const std::string & path, bool flip = false)
+{
+    GlTextureHandle handle(asset_id);
+    handle.assign_placeholder(make_placeholder_texture());
+    loader.submit([=]() -> AsyncAssetLoader::UploadFunction
+    {
+        auto image = std::make_shared<DecodedImage>(decode_image(read_file_binary(path), flip));
+        return [=]() { GlTextureHandle(asset_id).assign(upload_image(*image, path)); };
+    }, [=](const std::string & error) { GlTextureHandle(asset_id).mark_failed(error); });
+    return handle;
+}
+
+inline GlTextureHandle load_cubemap_async(AsyncAssetLoader & loader, const std::string & asset_id, const std::string & path)
+{
+    GlTextureHandle handle(asset_id);
+    handle.assign_placeholder(make_placeholder_texture(true));
+    loader.submit([=]() -> AsyncAssetLoader::UploadFunction
+    {
+        auto tex = std::make_shared<gli::texture_cube>(decode_cubemap(read_file_binary(path)));
+        return [=]() { GlTextureHandle(asset_id).assign(load_cubemap(*tex)); };
+    }, [=](const std::string & error) { GlTextureHandle(asset_id).mark_failed(error); });
+    return handle;
+}
+
+struct AssetManifestEntry
+{
+    std::string id;
+    std::string path;   // .dds files are loaded as cubemaps, anything else as a 2D image
+    bool flip{ false };
+};
+
+// Queues every entry at once, so decoding spreads over all of the loader's workers
+inline std::vector<GlTextureHandle> preload_manifest(AsyncAssetLoader & loader, const std::vector<AssetManifestEntry> & manifest)
+{
+    std::vector<GlTextureHandle> handles;
+    for (const auto & entry : manifest)
+    {
+        if (get_extension(entry.path) == "dds") handles.push_back(load_cubemap_async(loader, entry.id, entry.path));
+        else handles.push_back(load_image_async(loader, entry.id, entry.path, entry.flip));
+    }
+    return handles;
+}
+
+#endif // end async_assets_hpp
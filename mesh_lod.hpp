@@ -0,0 +1,368 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef mesh_lod_hpp
+#define mesh_lod_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "geometry.hpp"
+#include "parallel_for.hpp"
+
+#include <limits>
+#include <map>
+#include <queue>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert, "Simplifying Surfaces with Color and Texture
+// using Quadric Error Metrics", 1998) producing a chain of LODs for a runtime_mesh. Every vertex is a point
+// in a space of its position and its weighted attributes (normal, texcoord0, tangent, color), and each
+// triangle contributes the quadric measuring squared distance to its plane in that space, so collapses that
+// smear UVs or bend normals cost as much as ones that move the surface. Collapses are half-edge: a vertex
+// merges into a neighbour and no new vertices are made, so every level is only a new index list over the
+// mesh's own vertex buffer (runtime_mesh::lods) and the chain serializes with the mesh. Vertices on open
+// borders can be locked, and vertices on attribute seams (coincident positions split into several vertices)
+// always are, which keeps seams closed without having to collapse both sides in step.
+//
+// Errors are the square root of the area-normalized quadric error in a space where the mesh radius is one,
+// so 0.01 is roughly a deviation of 1% of the mesh size, attributes included.
+
+namespace avl
+{
+    struct LodLevel
+    {
+        float triangleRatio;                                        // stop at this fraction of the input triangles...
+        float maxError = std::numeric_limits<float>::infinity();    // ...or before the first collapse above this error
+    };
+
+    struct LodChainParams
+    {
+        std::vector<LodLevel> levels = { { 0.5f }, { 0.25f }, { 0.125f }, { 0.0625f } };
+        bool lockBorders = true;
+        float normalWeight = 0.5f;
+        float texcoordWeight = 1.0f;
+        float tangentWeight = 0.25f;
+        float colorWeight = 0.5f;
+    };
+
+    namespace impl
+    {
+        class QuadricSimplifier
+        {
+            struct Candidate
+            {
+                float cost;
+                uint32_t from, to, fromVersion, toVersion;
+                bool operator < (const Candidate & c) const { return cost > c.cost; } // min-heap
+            };
+
+            const runtime_mesh & mesh;
+            uint32_t dimension = 3, quadricSize = 0;
+            std::vector<double> points;             // per vertex, `dimension` coordinates
+            std::vector<double> quadrics;           // per vertex: upper triangle of A, then b, then c, then the summed area
+            std::vector<uint3> faces;
+            std::vector<uint8_t> faceAlive;
+            std::vector<std::vector<uint32_t>> vertexFaces;
+            std::vector<uint32_t> version;
+            std::vector<uint8_t> locked, dead;
+            std::priority_queue<Candidate> heap;
+            size_t liveFaces = 0;
+
+            const double * point(uint32_t v) const { return &points[size_t(v) * dimension]; }
+            double * quadric(uint32_t v) { return &quadrics[size_t(v) * quadricSize]; }
+
+            double evaluate(const double * q, const double * x) const
+            {
+                const uint32_t n = dimension;
+                const double * b = q + n * (n + 1) / 2;
+                double e = b[n]; // c
+                for (uint32_t i = 0, k = 0; i < n; ++i)
+                {
+                    e += q[k++] * x[i] * x[i];
+                    for (uint32_t j = i + 1; j < n; ++j) e += 2.0 * q[k++] * x[i] * x[j];
+                    e += 2.0 * b[i] * x[i];
+                }
+                return e;
+            }
+
+            // Adds the area-weighted quadric of the plane through three points
+            void add_face_quadric(const uint3 & f)
+            {
+                const uint32_t n = dimension;
+                const double * p = point(f.x), * q = point(f.y), * r = point(f.z);
+                std::vector<double> e1(n), e2(n);
+
+                double l1 = 0, d12 = 0;
+                for (uint32_t i = 0; i < n; ++i) { e1[i] = q[i] - p[i]; l1 += e1[i] * e1[i]; }
+                if (l1 <= 0) return;
+                l1 = std::sqrt(l1);
+                for (uint32_t i = 0; i < n; ++i) { e1[i] /= l1; d12 += e1[i] * (r[i] - p[i]); }
+
+                double l2 = 0;
+                for (uint32_t i = 0; i < n; ++i) { e2[i] = r[i] - p[i] - d12 * e1[i]; l2 += e2[i] * e2[i]; }
+                if (l2 <= 0) return;
+                l2 = std::sqrt(l2);
+                for (uint32_t i = 0; i < n; ++i) e2[i] /= l2;
+
+                const double3 a = double3(q[0] - p[0], q[1] - p[1], q[2] - p[2]), c = double3(r[0] - p[0], r[1] - p[1], r[2] - p[2]);
+                const double area = 0.5 * length(cross(a, c));
+                if (area <= 0) return;
+
+                double pe1 = 0, pe2 = 0, pp = 0;
+                for (uint32_t i = 0; i < n; ++i) { pe1 += p[i] * e1[i]; pe2 += p[i] * e2[i]; pp += p[i] * p[i]; }
+
+                std::vector<double> fq(quadricSize);
+                for (uint32_t i = 0, k = 0; i < n; ++i)
+                    for (uint32_t j = i; j < n; ++j) fq[k++] = area * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+                double * b = &fq[n * (n + 1) / 2];
+                for (uint32_t i = 0; i < n; ++i) b[i] = area * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+                b[n] = area * (pp - pe1 * pe1 - pe2 * pe2);
+                b[n + 1] = area;
+
+                for (uint32_t v : { f.x, f.y, f.z })
+                {
+                    double * dst = quadric(v);
+                    for (uint32_t i = 0; i < quadricSize; ++i) dst[i] += fq[i];
+                }
+            }
+
+            float collapse_cost(uint32_t from, uint32_t to)
+            {
+                // Dividing by the area turns the summed error into a mean squared distance
+                const double area = quadric(from)[quadricSize - 1] + quadric(to)[quadricSize - 1];
+                if (area <= 0) return 0.0f;
+                return float(std::max(0.0, evaluate(quadric(from), point(to)) + evaluate(quadric(to), point(to))) / area);
+            }
+
+            void push(uint32_t from, uint32_t to)
+            {
+                if (locked[from]) return;
+                heap.push({ collapse_cost(from, to), from, to, version[from], version[to] });
+            }
+
+            float3 position(uint32_t v) const { return float3(float(points[size_t(v) * dimension]), float(points[size_t(v) * dimension + 1]), float(points[size_t(v) * dimension + 2])); }
+
+            bool valid_collapse(uint32_t from, uint32_t to) const
+            {
+                // Link condition: the two vertices may only share the neighbours of the faces between them
+                std::vector<uint32_t> fromRing, toRing;
+                size_t shared = 0;
+                for (uint32_t t : vertexFaces[from])
+                {
+                    if (!faceAlive[t]) continue;
+                    const uint3 & f = faces[t];
+                    if (f.x == to || f.y == to || f.z == to) ++shared;
+                    for (uint32_t w : { f.x, f.y, f.z }) if (w != from && w != to) fromRing.push_back(w);
+                }
+                for (uint32_t t : vertexFaces[to])
+                {
+                    if (!faceAlive[t]) continue;
+                    const uint3 & f = faces[t];
+                    for (uint32_t w : { f.x, f.y, f.z }) if (w != from && w != to) toRing.push_back(w);
+                }
+                std::sort(fromRing.begin(), fromRing.end());
+                std::sort(toRing.begin(), toRing.end());
+                fromRing.erase(std::unique(fromRing.begin(), fromRing.end()), fromRing.end());
+                toRing.erase(std::unique(toRing.begin(), toRing.end()), toRing.end());
+                std::vector<uint32_t> common;
+                std::set_intersection(fromRing.begin(), fromRing.end(), toRing.begin(), toRing.end(), std::back_inserter(common));
+                if (shared == 0 || common.size() != shared) return false;
+
+                // No surviving face may flip or collapse to a sliver
+                const float3 target = position(to);
+                for (uint32_t t : vertexFaces[from])
+                {
+                    if (!faceAlive[t]) continue;
+                    const uint3 & f = faces[t];
+                    if (f.x == to || f.y == to || f.z == to) continue;
+                    float3 p[3] = { position(f.x), position(f.y), position(f.z) };
+                    const float3 before = cross(p[1] - p[0], p[2] - p[0]);
+                    for (int c = 0; c < 3; ++c) if (f[c] == from) p[c] = target;
+                    const float3 after = cross(p[1] - p[0], p[2] - p[0]);
+                    if (dot(before, after) <= 0.0f || length2(after) <= 1e-6f * length2(before)) return false;
+                }
+                return true;
+            }
+
+            void collapse(uint32_t from, uint32_t to)
+            {
+                for (uint32_t t : vertexFaces[from])
+                {
+                    if (!faceAlive[t]) continue;
+                    uint3 & f = faces[t];
+                    if (f.x == to || f.y == to || f.z == to)
+                    {
+                        faceAlive[t] = 0;
+                        --liveFaces;
+                        continue;
+                    }
+                    for (int c = 0; c < 3; ++c) if (f[c] == from) f[c] = to;
+                    vertexFaces[to].push_back(t);
+                }
+                vertexFaces[from].clear();
+                dead[from] = 1;
+
+                auto & around = vertexFaces[to];
+                around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !faceAlive[t]; }), around.end());
+
+                double * q = quadric(to);
+                const double * qf = quadric(from);
+                for (uint32_t i = 0; i < quadricSize; ++i) q[i] += qf[i];
+                ++version[to];
+
+                for (uint32_t t : around)
+                    for (uint32_t w : { faces[t].x, faces[t].y, faces[t].z })
+                    {
+                        if (w == to) continue;
+                        push(to, w);
+                        push(w, to);
+                    }
+            }
+
+            void snapshot(float error, std::vector<runtime_mesh_lod> & lods) const
+            {
+                if (liveFaces >= (lods.empty() ? faces.size() : lods.back().faces.size())) return; // no further reduction; omit the level
+                runtime_mesh_lod lod;
+                lod.error = error;
+                lod.faces.reserve(liveFaces);
+                for (size_t t = 0; t < faces.size(); ++t) if (faceAlive[t]) lod.faces.push_back(faces[t]);
+                lods.push_back(std::move(lod));
+            }
+
+        public:
+
+            QuadricSimplifier(const runtime_mesh & mesh, const LodChainParams & params) : mesh(mesh)
+            {
+                const size_t vertexCount = mesh.vertices.size();
+                auto has = [&](size_t count, float weight) { return count == vertexCount && weight > 0.0f; };
+                const bool normals = has(mesh.normals.size(), params.normalWeight), texcoords = has(mesh.texcoord0.size(), params.texcoordWeight);
+                const bool tangents = has(mesh.tangents.size(), params.tangentWeight), colors = has(mesh.colors.size(), params.colorWeight);
+                dimension = 3 + (normals ? 3 : 0) + (texcoords ? 2 : 0) + (tangents ? 3 : 0) + (colors ? 4 : 0);
+                quadricSize = dimension * (dimension + 1) / 2 + dimension + 2;
+
+                // Positions are normalized to a unit radius so attribute weights and errors do not depend on scale
+                Bounds3D bounds = compute_bounds(mesh);
+                const float3 center = bounds.center();
+                const float radius = std::max(1e-20f, length(bounds.size()) * 0.5f);
+
+                points.resize(vertexCount * dimension);
+                for (size_t v = 0; v < vertexCount; ++v)
+                {
+                    double * x = &points[v * dimension];
+                    const float3 p = (mesh.vertices[v] - center) / radius;
+                    *x++ = p.x; *x++ = p.y; *x++ = p.z;
+                    if (normals) for (int i = 0; i < 3; ++i) *x++ = mesh.normals[v][i] * params.normalWeight;
+                    if (texcoords) for (int i = 0; i < 2; ++i) *x++ = mesh.texcoord0[v][i] * params.texcoordWeight;
+                    if (tangents) for (int i = 0; i < 3; ++i) *x++ = mesh.tangents[v][i] * params.tangentWeight;
+                    if (colors) for (int i = 0; i < 4; ++i) *x++ = mesh.colors[v][i] * params.colorWeight;
+                }
+
+                faces.reserve(mesh.faces.size());
+                for (const auto & f : mesh.faces) if (f.x != f.y && f.y != f.z && f.x != f.z) faces.push_back(f);
+                faceAlive.assign(faces.size(), 1);
+                liveFaces = faces.size();
+
+                vertexFaces.resize(vertexCount);
+                for (uint32_t t = 0; t < faces.size(); ++t) for (uint32_t v : { faces[t].x, faces[t].y, faces[t].z }) vertexFaces[v].push_back(t);
+
+                quadrics.assign(vertexCount * quadricSize, 0.0);
+                for (const auto & f : faces) add_face_quadric(f);
+
+                version.assign(vertexCount, 0);
+                dead.assign(vertexCount, 0);
+                locked.assign(vertexCount, 0);
+
+                // Seams: several vertices at one position. Borders: position-space edges with a single face.
+                const std::vector<uint32_t> group = weld_positions(mesh.vertices, radius * 1e-6f);
+                std::vector<uint32_t> groupSize(vertexCount, 0);
+                for (size_t v = 0; v < vertexCount; ++v) ++groupSize[group[v]];
+                for (size_t v = 0; v < vertexCount; ++v) if (groupSize[group[v]] > 1) locked[v] = 1;
+
+                if (params.lockBorders)
+                {
+                    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edgeFaces;
+                    for (const auto & f : faces)
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            const uint32_t a = group[f[c]], b = group[f[(c + 1) % 3]];
+                            ++edgeFaces[std::make_pair(std::min(a, b), std::max(a, b))];
+                        }
+                    std::vector<uint8_t> borderGroup(vertexCount, 0);
+                    for (const auto & e : edgeFaces) if (e.second == 1) borderGroup[e.first.first] = borderGroup[e.first.second] = 1;
+                    for (size_t v = 0; v < vertexCount; ++v) if (borderGroup[group[v]]) locked[v] = 1;
+                }
+
+                for (const auto & f : faces)
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        push(f[c], f[(c + 1) % 3]);
+                        push(f[(c + 1) % 3], f[c]);
+                    }
+            }
+
+            // Simplifies progressively, recording a level each time one of the targets is reached
+            std::vector<runtime_mesh_lod> build(const std::vector<LodLevel> & levels)
+            {
+                std::vector<runtime_mesh_lod> lods;
+                const size_t inputFaces = faces.size();
+                double maxCost = 0;
+                size_t level = 0;
+
+                while (level < levels.size())
+                {
+                    const size_t target = size_t(levels[level].triangleRatio * inputFaces);
+                    const double errorLimit = double(levels[level].maxError) * levels[level].maxError;
+
+                    if (liveFaces <= target || heap.empty())
+                    {
+                        snapshot(float(std::sqrt(maxCost)), lods);
+                        ++level;
+                        continue;
+                    }
+
+                    const Candidate c = heap.top();
+                    if (dead[c.from] || dead[c.to] || c.fromVersion != version[c.from] || c.toVersion != version[c.to])
+                    {
+                        heap.pop();
+                        continue;
+                    }
+                    if (c.cost > errorLimit)
+                    {
+                        snapshot(float(std::sqrt(maxCost)), lods); // the candidate stays queued for coarser levels
+                        ++level;
+                        continue;
+                    }
+                    heap.pop();
+                    if (!valid_collapse(c.from, c.to)) continue;
+
+                    collapse(c.from, c.to);
+                    maxCost = std::max(maxCost, double(c.cost));
+                }
+                return lods;
+            }
+        };
+    }
+
+    // Replaces mesh.lods with a chain built by successive collapses, finest first. Levels that could not
+    // remove any more triangles than the previous one (locked borders, seams) are omitted.
+    inline void generate_lod_chain(runtime_mesh & mesh, const LodChainParams & params = LodChainParams())
+    {
+        mesh.lods = impl::QuadricSimplifier(mesh, params).build(params.levels);
+    }
+
+    // Meshes are independent, so chains for a whole model are built in parallel
+    inline void generate_lod_chains(const std::vector<runtime_mesh *> & meshes, const LodChainParams & params = LodChainParams(), uint32_t numThreads = 0)
+    {
+        parallel_for(0, meshes.size(), [&](size_t i) { generate_lod_chain(*meshes[i], params); }, numThreads);
+    }
+
+    inline void generate_lod_chains(std::map<std::string, runtime_mesh> & meshes, const LodChainParams & params = LodChainParams(), uint32_t numThreads = 0)
+    {
+        std::vector<runtime_mesh *> list;
+        for (auto & m : meshes) list.push_back(&m.second);
+        generate_lod_chains(list, params, numThreads);
+    }
+}
+
+#endif // end mesh_lod_hpp
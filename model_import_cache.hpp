@@ -0,0 +1,428 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef model_import_cache_hpp
+#define model_import_cache_hpp
+
+#include "geometry.hpp"
+#include "mesh_lod.hpp"
+#include "parallel_for.hpp"
+#include "worker_pool.hpp"
+#include "../lib-model-io/model-io-util.hpp"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+// Caches processed models on disk. Importing, welding, optimizing and building LODs for a large model takes
+// seconds; reading the result back from a .mesh file takes milliseconds. Artifacts are keyed by a hash of
+// the source file's bytes, the importer version and the processing options, so a renamed or copied file
+// still hits and an edited one misses. Hashing a large source is itself costly, so each source path also
+// keeps a record of the size and modification time it had when it was last hashed; while those match, the
+// recorded hash is trusted and the source is never read. As git does with its index, a record written in the
+// same second the file was modified is "racy" (a same-size edit later that second would go unnoticed) and is
+// always rehashed. The .mesh sections carry their own checksums, so a damaged artifact is rebuilt.
+//
+// A cache directory holds, for a key K: K.model, listing the mesh names, and K-0.mesh, K-1.mesh, ... one per
+// mesh; and for every source path, a src-P.record with its size, time and content hash. The .model file is
+// written last and carries a checksum, so the artifacts of an interrupted job, or behind a damaged manifest,
+// are never used.
+
+// Bump when the importers or the processing below change what they produce, to invalidate every artifact
+#define model_import_cache_version 2
+
+namespace avl
+{
+    struct ModelImportOptions
+    {
+        float rescaleRadius = 1.0f;     // rescale_geometry each mesh to this radius; 0 keeps the source scale
+        bool computeNormals = true;     // for meshes without any
+        bool computeTangents = true;    // likewise
+        bool optimize = true;
+        mesh_optimization_options optimization;
+        bool generateLods = true;
+        LodChainParams lods;
+        bool compressed = false;        // compress the cached .mesh files; smaller, but they can't be read in place
+    };
+
+    struct ModelImportResult
+    {
+        std::map<std::string, runtime_mesh> meshes;
+        uint64_t key = 0;               // of the artifacts the meshes were read from or written to
+        bool fromCache = false;
+        bool sourceHashed = false;      // false when the source record was trusted and the source never read
+    };
+
+    typedef std::shared_ptr<ModelImportResult> ModelImportHandle;
+
+    namespace impl
+    {
+        inline bool stat_file(const std::string & path, uint64_t & size, int64_t & mtime)
+        {
+#if defined(_WIN32)
+            struct _stat64 s;
+            if (_stat64(path.c_str(), &s) != 0) return false;
+#else
+            struct stat s;
+            if (stat(path.c_str(), &s) != 0) return false;
+#endif
+            size = uint64_t(s.st_size);
+            mtime = int64_t(s.st_mtime);
+            return true;
+        }
+
+        // Creates the directory and any missing parents; existing ones are left alone
+        inline void make_directories(const std::string & path)
+        {
+            for (size_t i = 1; i <= path.size(); ++i)
+            {
+                if (i < path.size() && path[i] != '/' && path[i] != '\\') continue;
+                const std::string prefix = path.substr(0, i);
+#if defined(_WIN32)
+                _mkdir(prefix.c_str());
+#else
+                mkdir(prefix.c_str(), 0755);
+#endif
+            }
+        }
+
+        // Writes through a temporary so readers never see a partial file
+        inline void replace_file(const std::string & temporary, const std::string & path)
+        {
+            std::remove(path.c_str());
+            if (std::rename(temporary.c_str(), path.c_str()) != 0) throw std::runtime_error("couldn't write " + path);
+        }
+
+        // Two CRC32C lanes over interleaved halves of each 16 bytes, so the 64 bits are not one CRC widened
+        inline uint64_t hash_bytes(const void * data, size_t size, uint64_t seed = 0)
+        {
+            const uint8_t * p = static_cast<const uint8_t *>(data);
+            uint64_t lo = uint32_t(seed) ^ 0x9e3779b9u, hi = uint32_t(seed >> 32) ^ 0x85ebca6bu;
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                uint64_t a, b;
+                std::memcpy(&a, p + i, 8);
+                std::memcpy(&b, p + i + 8, 8);
+                lo = _mm_crc32_u64(lo, a);
+                hi = _mm_crc32_u64(hi, b);
+            }
+            lo = crc32c(p + i, size - i, uint32_t(lo));
+            hi = _mm_crc32_u64(hi, uint64_t(size));
+            return (hi << 32) | lo;
+        }
+
+        inline uint64_t hash_options(const ModelImportOptions & o)
+        {
+            const mesh_optimization_options & m = o.optimization;
+            float values[] = { o.rescaleRadius, float(o.computeNormals), float(o.computeTangents), float(o.optimize), float(m.cacheSize),
+                m.overdrawThreshold, float(m.buildMeshlets), float(m.meshletMaxVertices), float(m.meshletMaxTriangles), float(o.generateLods),
+                float(o.compressed), float(o.lods.lockBorders), o.lods.normalWeight, o.lods.texcoordWeight, o.lods.tangentWeight, o.lods.colorWeight };
+            uint64_t h = hash_bytes(values, sizeof(values), model_import_cache_version);
+            if (o.generateLods) for (const auto & l : o.lods.levels) h = hash_bytes(&l, sizeof(l), h);
+            return h;
+        }
+
+        template<class T> void write_pod(std::ostream & out, const T & v) { out.write(reinterpret_cast<const char *>(&v), sizeof(T)); }
+        template<class T> bool read_pod(std::istream & in, T & v) { return bool(in.read(reinterpret_cast<char *>(&v), sizeof(T))); }
+
+        inline void write_string(std::ostream & out, const std::string & s)
+        {
+            write_pod(out, uint32_t(s.size()));
+            out.write(s.data(), s.size());
+        }
+
+        inline bool read_string(std::istream & in, std::string & s)
+        {
+            uint32_t size;
+            if (!read_pod(in, size) || size > (1u << 20)) return false;
+            s.resize(size);
+            return size == 0 || bool(in.read(&s[0], size));
+        }
+
+        inline std::string to_hex(uint64_t v)
+        {
+            char buf[17];
+            snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) v);
+            return buf;
+        }
+    }
+
+    class ModelImportCache
+    {
+        enum : uint32_t { recordMagic = 0x43524d41, modelMagic = 0x444d4d41 }; // "AMRC", "AMMD"
+
+        struct SourceRecord
+        {
+            uint64_t size = 0;
+            int64_t mtime = 0;
+            int64_t recordedAt = 0;     // seconds since the epoch when the hash was taken
+            uint64_t contentHash = 0;
+        };
+
+        std::string directory;
+        uint32_t processingThreads;
+
+        std::unordered_map<std::string, SourceRecord> records;
+        size_t hits = 0, misses = 0;
+        mutable std::mutex mutex;
+
+        KeyedWorkerPool<std::string, ModelImportHandle> pool; // last, so jobs finish before the records go away
+
+        static int64_t now_seconds()
+        {
+            return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        std::string record_path(const std::string & source) const { return directory + "src-" + impl::to_hex(impl::hash_bytes(source.data(), source.size())) + ".record"; }
+        std::string model_path(uint64_t key) const { return directory + impl::to_hex(key) + ".model"; }
+        std::string mesh_path(uint64_t key, size_t index) const { return directory + impl::to_hex(key) + "-" + std::to_string(index) + ".mesh"; }
+
+        static std::string in_flight_key(const std::string & path, const ModelImportOptions & options)
+        {
+            return path + "|" + impl::to_hex(impl::hash_options(options));
+        }
+
+        bool find_record(const std::string & path, SourceRecord & record)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = records.find(path);
+                if (it != records.end()) { record = it->second; return true; }
+            }
+
+            std::ifstream in(record_path(path), std::ios::binary);
+            uint32_t magic = 0;
+            std::string recordedPath;
+            if (!impl::read_pod(in, magic) || magic != recordMagic || !impl::read_string(in, recordedPath) || recordedPath != path) return false;
+            if (!impl::read_pod(in, record.size) || !impl::read_pod(in, record.mtime) || !impl::read_pod(in, record.recordedAt) || !impl::read_pod(in, record.contentHash)) return false;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            records[path] = record;
+            return true;
+        }
+
+        void store_record(const std::string & path, const SourceRecord & record)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                records[path] = record;
+            }
+            const std::string file = record_path(path), temporary = file + ".tmp" + impl::to_hex(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            {
+                std::ofstream out(temporary, std::ios::binary);
+                impl::write_pod(out, uint32_t(recordMagic));
+                impl::write_string(out, path);
+                impl::write_pod(out, record.size);
+                impl::write_pod(out, record.mtime);
+                impl::write_pod(out, record.recordedAt);
+                impl::write_pod(out, record.contentHash);
+                if (!out.good()) return; // the record only saves a rehash next time
+            }
+            try { impl::replace_file(temporary, file); } catch (...) {}
+        }
+
+        // Mesh names in artifact order, or false if the artifacts for this key are incomplete or damaged. The
+        // manifest ends in a CRC32C of everything before it, and is checked whole before any of it is trusted.
+        bool read_model(uint64_t key, std::vector<std::string> & names) const
+        {
+            std::ifstream file(model_path(key), std::ios::binary);
+            const std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (bytes.size() < 3 * sizeof(uint32_t) || bytes.size() > (1u << 26)) return false;
+
+            uint32_t crc;
+            const size_t contentSize = bytes.size() - sizeof(crc);
+            std::memcpy(&crc, bytes.data() + contentSize, sizeof(crc));
+            if (crc32c(bytes.data(), contentSize, 0) != crc) return false;
+
+            // Every name takes at least its four byte length, which bounds the count by the file size
+            std::istringstream in(bytes.substr(0, contentSize));
+            uint32_t magic = 0, count = 0;
+            if (!impl::read_pod(in, magic) || magic != modelMagic || !impl::read_pod(in, count)) return false;
+            if (count > contentSize / sizeof(uint32_t)) return false;
+            names.resize(count);
+            for (auto & n : names) if (!impl::read_string(in, n)) return false;
+            return true;
+        }
+
+        bool load_artifacts(uint64_t key, ModelImportResult & result) const
+        {
+            std::vector<std::string> names;
+            if (!read_model(key, names)) return false;
+            try
+            {
+                for (size_t i = 0; i < names.size(); ++i) result.meshes[names[i]] = import_mesh_binary(mesh_path(key, i));
+            }
+            catch (const std::exception &)
+            {
+                result.meshes.clear(); // missing or damaged: rebuild
+                return false;
+            }
+            return true;
+        }
+
+        void process(std::map<std::string, runtime_mesh> & meshes, const ModelImportOptions & options) const
+        {
+            std::vector<runtime_mesh *> list;
+            for (auto & m : meshes) list.push_back(&m.second);
+
+            parallel_for(0, list.size(), [&](size_t i)
+            {
+                runtime_mesh & mesh = *list[i];
+                if (mesh.vertices.empty()) return;
+                if (options.rescaleRadius > 0) rescale_geometry(mesh, options.rescaleRadius);
+                if (options.computeNormals && mesh.normals.empty()) compute_normals(mesh);
+                if (options.computeTangents && mesh.tangents.empty()) compute_tangents(mesh);
+                if (options.optimize) optimize_model(mesh, options.optimization);
+                if (options.generateLods) generate_lod_chain(mesh, options.lods);
+            }, processingThreads);
+        }
+
+        void store_artifacts(uint64_t key, std::map<std::string, runtime_mesh> & meshes, const ModelImportOptions & options) const
+        {
+            const std::string suffix = ".tmp" + impl::to_hex(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            size_t index = 0;
+            for (auto & m : meshes)
+            {
+                const std::string file = mesh_path(key, index++);
+                export_mesh_binary(file + suffix, m.second, options.compressed);
+                impl::replace_file(file + suffix, file);
+            }
+
+            const std::string file = model_path(key);
+            {
+                std::ostringstream manifest;
+                impl::write_pod(manifest, uint32_t(modelMagic));
+                impl::write_pod(manifest, uint32_t(meshes.size()));
+                for (auto & m : meshes) impl::write_string(manifest, m.first);
+                const std::string bytes = manifest.str();
+
+                std::ofstream out(file + suffix, std::ios::binary);
+                out.write(bytes.data(), bytes.size());
+                impl::write_pod(out, crc32c(bytes.data(), bytes.size(), 0));
+                if (!out.good()) throw std::runtime_error("couldn't write " + file);
+            }
+            impl::replace_file(file + suffix, file);
+        }
+
+        ModelImportHandle import_uncached(const std::string & path, const ModelImportOptions & options)
+        {
+            uint64_t size; int64_t mtime;
+            if (!impl::stat_file(path, size, mtime)) throw std::runtime_error("couldn't open " + path);
+
+            auto result = std::make_shared<ModelImportResult>();
+            const uint64_t optionsHash = impl::hash_options(options) ^ impl::hash_bytes(get_extension(path).data(), get_extension(path).size());
+
+            // Fast path: the source looks untouched since it was hashed
+            SourceRecord record;
+            if (find_record(path, record) && record.size == size && record.mtime == mtime && record.recordedAt > mtime)
+            {
+                result->key = impl::hash_bytes(&record.contentHash, sizeof(record.contentHash), optionsHash);
+                if (load_artifacts(result->key, *result))
+                {
+                    result->fromCache = true;
+                    return result;
+                }
+            }
+
+            // Hash the bytes; a touched but unchanged file still hits
+            const std::vector<uint8_t> bytes = size ? read_file_binary(path) : std::vector<uint8_t>();
+            record.size = size;
+            record.mtime = mtime;
+            record.recordedAt = now_seconds();
+            record.contentHash = impl::hash_bytes(bytes.data(), bytes.size());
+            result->sourceHashed = true;
+            result->key = impl::hash_bytes(&record.contentHash, sizeof(record.contentHash), optionsHash);
+
+            if (!load_artifacts(result->key, *result))
+            {
+                result->meshes = import_model(path);
+                process(result->meshes, options);
+                if (!result->meshes.empty()) store_artifacts(result->key, result->meshes, options);
+            }
+            else result->fromCache = true;
+
+            store_record(path, record);
+            return result;
+        }
+
+        ModelImportHandle run(const std::string & path, const ModelImportOptions & options)
+        {
+            ModelImportHandle result = import_uncached(path, options);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (result->fromCache) ++hits;
+            else ++misses;
+            return result;
+        }
+
+    public:
+
+        // The directory is created if missing. Import jobs run on numWorkers threads, and
+        // each job processes its meshes on processingThreads threads; zero uses all but one hardware thread for
+        // the former and every hardware thread for the latter. Imports still queued when the cache is destroyed
+        // resolve to null.
+        explicit ModelImportCache(const std::string & cacheDirectory, uint32_t numWorkers = 0, uint32_t processingThreads = 0)
+            : processingThreads(processingThreads), pool(numWorkers ? numWorkers : std::max(1u, hardware_thread_count() - 1))
+        {
+            directory = cacheDirectory;
+            if (!directory.empty() && directory.back() != '/' && directory.back() != '\\') directory += '/';
+            impl::make_directories(directory);
+        }
+
+        // Imports on the calling thread, or waits for a worker already importing the same path and options.
+        // Throws what the importer throws.
+        ModelImportHandle import(const std::string & path, const ModelImportOptions & options = ModelImportOptions())
+        {
+            return pool.run(in_flight_key(path, options), [&]() { return run(path, options); });
+        }
+
+        // Queues the import on a worker thread and returns immediately
+        std::shared_future<ModelImportHandle> request(const std::string & path, const ModelImportOptions & options = ModelImportOptions())
+        {
+            return pool.request(in_flight_key(path, options), [this, path, options]() { return run(path, options); });
+        }
+
+        // Forgets the size and time recorded for a source, so its next import rehashes it
+        void invalidate(const std::string & path)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                records.erase(path);
+            }
+            std::remove(record_path(path).c_str());
+        }
+
+        // The files holding a key's artifacts, the .model file first; empty if they are incomplete
+        std::vector<std::string> artifact_paths(uint64_t key) const
+        {
+            std::vector<std::string> names, paths;
+            if (!read_model(key, names)) return paths;
+            paths.push_back(model_path(key));
+            for (size_t i = 0; i < names.size(); ++i) paths.push_back(mesh_path(key, i));
+            return paths;
+        }
+
+        const std::string & cache_directory() const { return directory; }
+        size_t hit_count() const { std::lock_guard<std::mutex> lock(mutex); return hits; }
+        size_t miss_count() const { std::lock_guard<std::mutex> lock(mutex); return misses; }
+    };
+}
+
+#endif // end model_import_cache_hpp
@@ -0,0 +1,201 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef noise_field_hpp
+#define noise_field_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "simplex_noise.hpp"
+#include "parallel_for.hpp"
+#include "lru_cache.hpp"
+
+#include <array>
+#include <cstring>
+#include <memory>
+
+// Fills regular 2D and 3D grids with layered (fBm) simplex noise, optionally domain warped. Rows of the
+// grid are grouped into tiles that are evaluated in parallel with the batched noise functions. Finished
+// tiles can be kept in an LRU cache keyed by everything that determines their contents (seed, parameters,
+// grid placement, tile index and the permutation table itself, since seed 0 follows the default generator
+// and regenerate_permutation_table can change it), so an editor flipping between parameter sets or undoing
+// a change gets the earlier field back without evaluating any noise.
+
+namespace noise
+{
+    struct LayeredNoiseParams
+    {
+        uint32_t seed = 0;          // seeds a NoiseGenerator permutation; 0 uses the default generator
+        float frequency = 1.0f;     // scales grid coordinates before the first octave
+        float amplitude = 1.0f;     // scales the final value
+        uint8_t octaves = 4;
+        float lacunarity = 2.0f;
+        float gain = 0.5f;
+        float warpStrength = 0.0f;  // displacement of the sample position by a second fBm field; 0 disables warping
+        float warpFrequency = 1.0f; // frequency of the warp field relative to the base frequency
+        uint8_t warpOctaves = 2;
+    };
+
+    class NoiseFieldGenerator
+    {
+        // Every input that affects a tile, as raw bits, so lookups are exact
+        typedef std::array<uint32_t, 21> TileKey;
+
+        struct TileKeyHash
+        {
+            size_t operator()(const TileKey & k) const
+            {
+                uint64_t h = 14695981039346656037ull;
+                for (auto w : k) h = (h ^ w) * 1099511628211ull;
+                return size_t(h);
+            }
+        };
+
+        typedef std::shared_ptr<const std::vector<float>> Tile;
+        typedef LeastRecentlyUsedCache<TileKey, Tile, std::mutex, std::unordered_map<TileKey, std::list<KeyValuePair<TileKey, Tile>>::iterator, TileKeyHash>> TileCache;
+
+        std::unique_ptr<TileCache> cache;
+
+        static uint32_t bits(float f) { uint32_t u; std::memcpy(&u, &f, sizeof(u)); return u; }
+
+        // FNV-1a over the permutation, so tiles filled before the default generator is reseeded are not reused after
+        static uint32_t hash_permutation(const NoiseGenerator & gen)
+        {
+            uint32_t h = 2166136261u;
+            for (int i = 0; i < 256; ++i) h = (h ^ gen.get_tables().perm[i]) * 16777619u;
+            return h;
+        }
+
+        static TileKey make_key(const LayeredNoiseParams & p, uint32_t permutation, uint3 size, float3 origin, float3 spacing, uint32_t tile, uint32_t rowsPerTile)
+        {
+            return TileKey{{
+                p.seed, permutation, bits(p.frequency), bits(p.amplitude), p.octaves, bits(p.lacunarity), bits(p.gain),
+                bits(p.warpStrength), bits(p.warpFrequency), p.warpOctaves,
+                size.x, size.y, size.z, bits(origin.x), bits(origin.y), bits(origin.z),
+                bits(spacing.x), bits(spacing.y), bits(spacing.z), tile, rowsPerTile }};
+        }
+
+        // Evaluates `count` samples along one grid row (constant y and z) into out
+        static void fill_row(const NoiseGenerator & gen, const LayeredNoiseParams & p, bool is3D, float3 start, float dx, uint32_t count, float * out, std::vector<float> & scratch)
+        {
+            const int dims = is3D ? 3 : 2;
+            scratch.resize(size_t(count) * 9);
+            float * pos[3] = { scratch.data(), scratch.data() + count, scratch.data() + 2 * count };
+            float * warp[3] = { pos[2] + count, pos[2] + 2 * count, pos[2] + 3 * count };
+            float * disp[3] = { warp[2] + count, warp[2] + 2 * count, warp[2] + 3 * count };
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                pos[0][i] = (start.x + dx * i) * p.frequency;
+                pos[1][i] = start.y * p.frequency;
+                pos[2][i] = start.z * p.frequency;
+            }
+
+            if (p.warpStrength != 0.0f)
+            {
+                // pos += strength * fbm(pos * warpFrequency), one decorrelated fBm field per axis
+                for (int axis = 0; axis < dims; ++axis)
+                {
+                    const float shift = 17.3f * axis;
+                    for (int c = 0; c < dims; ++c)
+                        for (uint32_t i = 0; i < count; ++i) warp[c][i] = pos[c][i] * p.warpFrequency + shift;
+
+                    if (is3D) gen.noise_fb_batch(warp[0], warp[1], warp[2], disp[axis], count, p.warpOctaves, p.lacunarity, p.gain);
+                    else gen.noise_fb_batch(warp[0], warp[1], disp[axis], count, p.warpOctaves, p.lacunarity, p.gain);
+                }
+                for (int axis = 0; axis < dims; ++axis)
+                    for (uint32_t i = 0; i < count; ++i) pos[axis][i] += p.warpStrength * disp[axis][i];
+            }
+
+            if (is3D) gen.noise_fb_batch(pos[0], pos[1], pos[2], out, count, p.octaves, p.lacunarity, p.gain);
+            else gen.noise_fb_batch(pos[0], pos[1], out, count, p.octaves, p.lacunarity, p.gain);
+            if (p.amplitude != 1.0f) for (uint32_t i = 0; i < count; ++i) out[i] *= p.amplitude;
+        }
+
+    public:
+
+        uint32_t numThreads = 0;    // 0 = all hardware threads
+        uint32_t rowsPerTile = 16;  // rows (2D) or rows of a slice (3D) evaluated together and cached as one unit
+
+        // cachedTiles = 0 disables the tile cache
+        explicit NoiseFieldGenerator(size_t cachedTiles = 0)
+        {
+            if (cachedTiles) cache.reset(new TileCache(cachedTiles, cachedTiles / 8));
+        }
+
+        size_t cached_tile_count() const { return cache ? cache->size() : 0; }
+        void clear_cache() { if (cache) cache->clear(); }
+
+        // Row-major heightfield: value (i, j) = noise(origin + float2(i, j) * spacing) is stored at j * size.x + i
+        std::vector<float> fill(const LayeredNoiseParams & params, uint2 size, float2 origin, float2 spacing)
+        {
+            return fill_grid(params, uint3(size, 1), float3(origin, 0), float3(spacing, 0), false);
+        }
+
+        // Volume with x fastest, then y, then z
+        std::vector<float> fill(const LayeredNoiseParams & params, uint3 size, float3 origin, float3 spacing)
+        {
+            return fill_grid(params, size, origin, spacing, true);
+        }
+
+    private:
+
+        std::vector<float> fill_grid(const LayeredNoiseParams & params, uint3 size, float3 origin, float3 spacing, bool is3D)
+        {
+            std::vector<float> result(size_t(size.x) * size.y * size.z);
+            if (result.empty()) return result;
+
+            const uint32_t rows = size.y * size.z;
+            const uint32_t perTile = std::max(1u, rowsPerTile);
+            const uint32_t numTiles = (rows + perTile - 1) / perTile;
+            const NoiseGenerator seeded(params.seed);
+            const NoiseGenerator & gen = params.seed ? seeded : default_generator();
+            const uint32_t permutation = cache ? hash_permutation(gen) : 0;
+
+            parallel_for(0, numTiles, [&](size_t t)
+            {
+                const uint32_t firstRow = uint32_t(t) * perTile;
+                const uint32_t lastRow = std::min(rows, firstRow + perTile);
+                float * dst = result.data() + size_t(firstRow) * size.x;
+                const size_t tileValues = size_t(lastRow - firstRow) * size.x;
+
+                TileKey key;
+                if (cache)
+                {
+                    key = make_key(params, permutation, size, origin, spacing, uint32_t(t), perTile);
+                    Tile hit;
+                    if (cache->try_get(key, hit))
+                    {
+                        std::copy(hit->begin(), hit->end(), dst);
+                        return;
+                    }
+                }
+
+                std::vector<float> scratch;
+                for (uint32_t r = firstRow; r < lastRow; ++r)
+                {
+                    const float3 start(origin.x, origin.y + spacing.y * (r % size.y), origin.z + spacing.z * (r / size.y));
+                    fill_row(gen, params, is3D, start, spacing.x, size.x, result.data() + size_t(r) * size.x, scratch);
+                }
+
+                if (cache) cache->insert(key, std::make_shared<const std::vector<float>>(dst, dst + tileValues));
+            }, numThreads);
+
+            return result;
+        }
+    };
+
+    // One-shot helpers without caching
+    inline std::vector<float> make_noise_field(const LayeredNoiseParams & params, uint2 size, float2 origin, float2 spacing)
+    {
+        return NoiseFieldGenerator().fill(params, size, origin, spacing);
+    }
+
+    inline std::vector<float> make_noise_field(const LayeredNoiseParams & params, uint3 size, float3 origin, float3 spacing)
+    {
+        return NoiseFieldGenerator().fill(params, size, origin, spacing);
+    }
+}
+
+#endif // end noise_field_hpp
@@ -0,0 +1,62 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef parallel_for_hpp
+#define parallel_for_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace avl
+{
+    // Returns at least one, even on platforms where hardware_concurrency() is unknown
+    inline uint32_t hardware_thread_count()
+    {
+        return std::max<uint32_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // Invokes fn(i) for every i in [begin, end). Work is handed out in chunks of `grain` indices
+    // from a shared atomic counter, so the mapping of indices to threads is not deterministic.
+    // Callers that need reproducible results must make fn(i) depend only on i. A thread count of
+    // zero uses every hardware thread; a count of one runs inline on the calling thread.
+    template<typename Fn>
+    inline void parallel_for(size_t begin, size_t end, Fn && fn, uint32_t numThreads = 0, size_t grain = 1)
+    {
+        if (end <= begin) return;
+        if (numThreads == 0) numThreads = hardware_thread_count();
+        grain = std::max<size_t>(1, grain);
+
+        const size_t numChunks = (end - begin + grain - 1) / grain;
+        numThreads = (uint32_t) std::min<size_t>(numThreads, numChunks);
+
+        if (numThreads <= 1)
+        {
+            for (size_t i = begin; i < end; ++i) fn(i);
+            return;
+        }
+
+        std::atomic<size_t> next(begin);
+        auto worker = [&]()
+        {
+            for (;;)
+            {
+                const size_t first = next.fetch_add(grain);
+                if (first >= end) break;
+                const size_t last = std::min(end, first + grain);
+                for (size_t i = first; i < last; ++i) fn(i);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads - 1);
+        for (uint32_t t = 1; t < numThreads; ++t) threads.emplace_back(worker);
+        worker();
+        for (auto & t : threads) t.join();
+    }
+}
+
+#endif // end parallel_for_hpp
@@ -270,6 +270,21 @@ void shader_workbench::on_draw()
     ImGui::Text("Render Time %f ms", gpuTimer.elapsed_ms());
     ImGui::Text("Global Time %f s", timeSeconds);
 
+    // The curl field is baked the first time turbulence is switched on
+    if (ImGui::Checkbox("Curl Turbulence", &curlEnabled) && curlEnabled && !curlModifier)
+    {
+        noise::CurlFieldParams curlParams;
+        curlParams.frequency = 0.15f;
+        curlParams.frames = 16;
+        curlParams.period = 8.0f;
+        auto curlField = std::make_shared<noise::CurlFieldVolume>();
+        curlField->bake(curlParams, uint3(48, 48, 48), Bounds3D(float3(-16, -2, -16), float3(16, 14, 16)));
+        curlModifier = new curl_field_modifier(curlField, curlStrength);
+        particleSystem->add_modifier(std::unique_ptr<particle_modifier>(curlModifier));
+    }
+    ImGui::SliderFloat("Curl Strength", &curlStrength, 0.0f, 8.0f);
+    if (curlModifier) curlModifier->strength = curlEnabled ? curlStrength : 0.0f;
+
     igm->end_frame();
     if (gizmo) gizmo->draw();
 
@@ -124,6 +124,30 @@ struct vortex_modifier final : public particle_modifier
 };
 
 
+// Turbulence read from a baked curl field; the field is shared so several systems can reuse one bake
+struct curl_field_modifier final : public particle_modifier
+{
+    std::shared_ptr<const noise::CurlFieldVolume> field;
+    float strength;
+    float time = 0.0f;
+    std::vector<float> scratch;
+
+    curl_field_modifier(std::shared_ptr<const noise::CurlFieldVolume> field, float strength) : field(field), strength(strength) { }
+
+    // A strength of zero leaves the particles alone without sampling the field
+    void update(std::vector<particle> & particles, float dt) override
+    {
+        time += dt;
+        if (strength == 0.0f) return;
+        const size_t n = particles.size();
+        scratch.resize(n * 6);
+        float * x = scratch.data(), * y = x + n, * z = y + n, * vx = z + n, * vy = vx + n, * vz = vy + n;
+        for (size_t i = 0; i < n; ++i) { x[i] = particles[i].position.x; y[i] = particles[i].position.y; z[i] = particles[i].position.z; }
+        field->sample(x, y, z, vx, vy, vz, n, time);
+        for (size_t i = 0; i < n; ++i) particles[i].velocity += float3(vx[i], vy[i], vz[i]) * (strength * dt);
+    }
+};
+
 class particle_system
 {
     std::vector<particle> particles;
@@ -249,6 +273,9 @@ struct shader_workbench : public GLFWApp
 
     std::unique_ptr<particle_system> particleSystem;
     std::unique_ptr<gravity_modifier> gravityModifier;
+    curl_field_modifier * curlModifier = nullptr; // owned by particleSystem once created
+    bool curlEnabled = false;
+    float curlStrength = 2.0f;
 
     point_emitter pointEmitter;
     cube_emitter cubeEmitter = { Bounds3D(float3(-1.f), float3(1.f)) };
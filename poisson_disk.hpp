@@ -5,9 +5,11 @@
 #ifndef poisson_disk_sampling_h
 #define poisson_disk_sampling_h
 
-#include "math-spatial.hpp"
+#include "math-core.hpp"
 #include "util.hpp"
+#include "parallel_for.hpp"
 #include <functional>
+#include <numeric>
 #include <vector>
 
 #if defined(ANVIL_PLATFORM_WINDOWS)
@@ -249,6 +251,254 @@ namespace poisson
         }
     };
 
+    ////////////////////////////////////////
+    // Tiled, parallel & seedable sampling //
+    ////////////////////////////////////////
+
+    // The generators above support a spatially varying separation (distFunction), which is why their
+    // grid keeps a list of points per cell. With a constant separation, a cell size of r / sqrt(N) bounds
+    // every cell to at most one sample, so the acceleration structure collapses to a flat array holding a
+    // single sample index per cell. The domain is split into square tiles of cells that are processed in
+    // 2^N phases: tiles that share a phase are never adjacent, so they can run concurrently without
+    // touching each other's cells. Each tile draws from its own generator seeded by (seed, tile index),
+    // which makes the output a pure function of the seed, independent of the number of threads.
+    // Points are returned grouped by tile in row-major tile order, so consecutive points are spatially close.
+
+    // splitmix64, used both as a seed scrambler and as the per-tile generator
+    struct TileRandom
+    {
+        uint64_t state;
+
+        explicit TileRandom(uint64_t seed) : state(seed) {}
+
+        static uint64_t mix(uint64_t z)
+        {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        uint64_t next() { state += 0x9e3779b97f4a7c15ull; return mix(state); }
+        float random_float() { return float(next() >> 40) * (1.0f / 16777216.0f); } // [0, 1)
+        uint32_t random_int(uint32_t max) { return uint32_t(((next() >> 32) * uint64_t(max)) >> 32); } // [0, max)
+    };
+
+    // Uniform point in the shell [radius, 2 * radius) around center, by rejection from the enclosing cube.
+    // Cheaper than the polar form (no trigonometry) and, unlike the legacy 3D generator, not biased to the poles.
+    template<int N>
+    inline linalg::vec<float, N> random_annulus_point(TileRandom & r, const linalg::vec<float, N> & center, float radius)
+    {
+        linalg::vec<float, N> d;
+        float d2;
+        do
+        {
+            for (int i = 0; i < N; ++i) d[i] = (r.random_float() * 4.0f - 2.0f) * radius;
+            d2 = length2(d);
+        } while (d2 < radius * radius || d2 >= 4.0f * radius * radius);
+        return center + d;
+    }
+
+    template<int N>
+    class TiledPoissonSampler
+    {
+        typedef linalg::vec<float, N> point_t;
+
+        static int3 to_int3(const linalg::vec<int, 2> & v) { return int3(v.x, v.y, 0); }
+        static int3 to_int3(const linalg::vec<int, 3> & v) { return v; }
+
+        point_t boundsMin, boundsMax;
+        float radius, sqRadius, invCellSize;
+        int tileCells;
+        int3 numCells, numTiles;
+        uint32_t tileCapacity;
+
+        std::vector<int32_t> grid;       // one sample index per cell, -1 when empty
+        std::vector<point_t> samples;    // fixed-capacity block of tileCapacity slots per tile
+        std::vector<uint32_t> tileCounts;
+
+        int3 cell_of(const point_t & p) const
+        {
+            int3 c = to_int3(linalg::vec<int, N>((p - boundsMin) * invCellSize));
+            return linalg::clamp(c, int3(0), numCells - int3(1));
+        }
+
+        size_t cell_index(const int3 & c) const { return (size_t(c.z) * numCells.y + c.y) * numCells.x + c.x; }
+        size_t tile_index(const int3 & t) const { return (size_t(t.z) * numTiles.y + t.y) * numTiles.x + t.x; }
+
+        bool inside(const point_t & p) const
+        {
+            for (int i = 0; i < N; ++i) if (p[i] < boundsMin[i] || p[i] >= boundsMax[i]) return false;
+            return true;
+        }
+
+        // Separation is at least r and cells are r / sqrt(N) wide, so two cells in every direction suffice
+        bool has_neighbors(const point_t & p, const int3 & c) const
+        {
+            const int3 lo = linalg::max(c - int3(2), int3(0));
+            const int3 hi = linalg::min(c + int3(2), numCells - int3(1));
+            for (int z = lo.z; z <= hi.z; ++z)
+            {
+                for (int y = lo.y; y <= hi.y; ++y)
+                {
+                    const int32_t * row = &grid[(size_t(z) * numCells.y + y) * numCells.x];
+                    for (int x = lo.x; x <= hi.x; ++x)
+                    {
+                        const int32_t idx = row[x];
+                        if (idx >= 0 && length2(samples[idx] - p) < sqRadius) return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void process_tile(const int3 & tile, uint64_t seed, int k, const std::function<bool(const point_t &)> & rejectFunction)
+        {
+            const size_t tileIdx = tile_index(tile);
+            const uint32_t base = uint32_t(tileIdx * tileCapacity);
+            uint32_t & count = tileCounts[tileIdx];
+
+            const int3 tileLo = tile * tileCells;
+            const int3 tileHi = linalg::min(tileLo + int3(tileCells), numCells); // exclusive
+
+            TileRandom r(TileRandom::mix(seed ^ TileRandom::mix(tileIdx + 1)));
+            std::vector<point_t> processingList;
+
+            auto try_add = [&](const point_t & p) -> bool
+            {
+                if (!inside(p)) return false;
+                const int3 c = cell_of(p);
+                for (int i = 0; i < 3; ++i) if (c[i] < tileLo[i] || c[i] >= tileHi[i]) return false; // owned by another tile
+                if (grid[cell_index(c)] >= 0 || has_neighbors(p, c)) return false;
+                if (rejectFunction && rejectFunction(p)) return false;
+                samples[base + count] = p;
+                grid[cell_index(c)] = int32_t(base + count);
+                ++count;
+                processingList.push_back(p);
+                return true;
+            };
+
+            // Samples already committed by earlier phases whose annulus reaches into this tile seed the front.
+            // They are at most 2r (three cells in 2D, four in 3D) away, which tileCells >= 4 keeps inside the
+            // ring of neighboring tiles, none of which share our phase.
+            const int reach = (N == 2) ? 3 : 4;
+            const int3 lo = linalg::max(tileLo - int3(reach), int3(0));
+            const int3 hi = linalg::min(tileHi + int3(reach), numCells);
+            for (int z = lo.z; z < hi.z; ++z)
+                for (int y = lo.y; y < hi.y; ++y)
+                    for (int x = lo.x; x < hi.x; ++x)
+                    {
+                        const int32_t idx = grid[cell_index(int3(x, y, z))];
+                        if (idx >= 0) processingList.push_back(samples[idx]);
+                    }
+
+            // Nothing to grow from yet; throw a few darts inside the tile
+            if (processingList.empty())
+            {
+                point_t tileMin, tileMax;
+                for (int i = 0; i < N; ++i)
+                {
+                    tileMin[i] = boundsMin[i] + tileLo[i] / invCellSize;
+                    tileMax[i] = std::min(boundsMax[i], boundsMin[i] + tileHi[i] / invCellSize);
+                }
+                for (int i = 0; i < k && processingList.empty(); ++i)
+                {
+                    point_t p;
+                    for (int j = 0; j < N; ++j) p[j] = tileMin[j] + r.random_float() * (tileMax[j] - tileMin[j]);
+                    try_add(p);
+                }
+            }
+
+            // Bridson's algorithm: a point stays active until k consecutive candidates around it fail
+            while (!processingList.empty())
+            {
+                const uint32_t randPoint = r.random_int(uint32_t(processingList.size()));
+                const point_t center = processingList[randPoint];
+
+                bool found = false;
+                for (int i = 0; i < k && !found; ++i) found = try_add(random_annulus_point(r, center, radius));
+
+                if (!found)
+                {
+                    processingList[randPoint] = processingList.back();
+                    processingList.pop_back();
+                }
+            }
+        }
+
+    public:
+
+        std::vector<point_t> build(const point_t & bmin, const point_t & bmax, float separation, uint64_t seed, int k,
+            int tileSizeInCells, uint32_t numThreads, const std::function<bool(const point_t &)> & rejectFunction)
+        {
+            boundsMin = bmin;
+            boundsMax = bmax;
+            radius = separation;
+            sqRadius = separation * separation;
+            invCellSize = std::sqrt(float(N)) / separation;
+            tileCells = std::max(4, tileSizeInCells);
+
+            numCells = int3(1);
+            for (int i = 0; i < N; ++i) numCells[i] = std::max(1, int(std::ceil((bmax[i] - bmin[i]) * invCellSize)));
+            numTiles = (numCells + int3(tileCells - 1)) / tileCells;
+            tileCapacity = uint32_t(tileCells) * uint32_t(tileCells) * (N == 3 ? uint32_t(tileCells) : 1u);
+
+            const size_t totalTiles = size_t(numTiles.x) * numTiles.y * numTiles.z;
+            grid.assign(size_t(numCells.x) * numCells.y * numCells.z, -1);
+            samples.resize(totalTiles * tileCapacity);
+            tileCounts.assign(totalTiles, 0);
+
+            // Tiles of one phase differ by two in every coordinate, so they are separated by a full tile
+            std::vector<int3> phaseTiles;
+            for (int phase = 0; phase < (1 << N); ++phase)
+            {
+                phaseTiles.clear();
+                for (int z = (phase >> 2) & 1; z < numTiles.z; z += 2)
+                    for (int y = (phase >> 1) & 1; y < numTiles.y; y += 2)
+                        for (int x = phase & 1; x < numTiles.x; x += 2)
+                            phaseTiles.push_back(int3(x, y, z));
+
+                parallel_for(0, phaseTiles.size(), [&](size_t i)
+                {
+                    process_tile(phaseTiles[i], seed, k, rejectFunction);
+                }, numThreads);
+            }
+
+            std::vector<point_t> outputList;
+            outputList.reserve(std::accumulate(tileCounts.begin(), tileCounts.end(), size_t(0)));
+            for (size_t t = 0; t < totalTiles; ++t)
+            {
+                outputList.insert(outputList.end(), samples.begin() + t * tileCapacity, samples.begin() + t * tileCapacity + tileCounts[t]);
+            }
+            return outputList;
+        }
+    };
+
+    struct TiledPoissonDiskGenerator2D
+    {
+        std::function<bool(const float2 &)> boundsFunction; // must be safe to call concurrently
+        int tileSize = 32;                                  // in grid cells (r / sqrt(2) wide), minimum 4
+        uint32_t numThreads = 0;                            // 0 = all hardware threads
+
+        std::vector<float2> build(const Bounds2D & bounds, float separation, uint64_t seed, int k = 30)
+        {
+            TiledPoissonSampler<2> sampler;
+            return sampler.build(bounds.min(), bounds.max(), separation, seed, k, tileSize, numThreads, boundsFunction);
+        }
+    };
+
+    struct TiledPoissonDiskGenerator3D
+    {
+        std::function<bool(const float3 &)> boundsFunction; // must be safe to call concurrently
+        int tileSize = 16;                                  // in grid cells (r / sqrt(3) wide), minimum 4
+        uint32_t numThreads = 0;                            // 0 = all hardware threads
+
+        std::vector<float3> build(const Bounds3D & bounds, float separation, uint64_t seed, int k = 30)
+        {
+            TiledPoissonSampler<3> sampler;
+            return sampler.build(bounds.min(), bounds.max(), separation, seed, k, tileSize, numThreads, boundsFunction);
+        }
+    };
+
     // Returns a set of poisson disk samples inside a rectangular area, with a minimum separation and with
     // a packing determined by how high k is. The higher k is the higher the algorithm will be slow.
     // If no initialSet of points is provided the area center will be used as the initial point.
@@ -263,6 +513,19 @@ namespace poisson
         poisson::PoissonDiskGenerator3D gen;
         return gen.build(bounds, initialSet, k, separation);
     } 
+
+    // Deterministic variants: the same seed always yields the same points, regardless of thread count
+    inline std::vector<float2> make_tiled_poisson_disk_distribution(const Bounds2D & bounds, float separation, uint64_t seed, int k = 30)
+    {
+        poisson::TiledPoissonDiskGenerator2D gen;
+        return gen.build(bounds, separation, seed, k);
+    }
+
+    inline std::vector<float3> make_tiled_poisson_disk_distribution(const Bounds3D & bounds, float separation, uint64_t seed, int k = 30)
+    {
+        poisson::TiledPoissonDiskGenerator3D gen;
+        return gen.build(bounds, separation, seed, k);
+    }
 }
 
 #pragma warning(pop)
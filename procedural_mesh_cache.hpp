@@ -0,0 +1,247 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef procedural_mesh_cache_hpp
+#define procedural_mesh_cache_hpp
+
+#include "procedural_mesh.hpp"
+#include "parallel_for.hpp"
+#include "worker_pool.hpp"
+
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+// Memoizes procedural_mesh.hpp generators. A result is keyed by the generator function and the exact bits of
+// its arguments, so every caller asking for the same sphere shares one immutable Geometry. Misses can be
+// filled on the calling thread (get) or by a pool of worker threads (request), which lets a UI scrub
+// generator parameters without stalling: each frame it asks for the current parameters and draws the
+// newest finished result. Finished entries are evicted least recently used first once their combined size
+// exceeds a byte budget; handles already given out stay valid.
+
+namespace avl
+{
+    typedef std::shared_ptr<const Geometry> GeometryHandle;
+
+    inline size_t geometry_size_bytes(const Geometry & g)
+    {
+        size_t bytes = g.vertices.size() * sizeof(float3) + g.normals.size() * sizeof(float3) + g.colors.size() * sizeof(float4)
+            + g.texcoord0.size() * sizeof(float2) + g.texcoord1.size() * sizeof(float2) + g.tangents.size() * sizeof(float3)
+            + g.bitangents.size() * sizeof(float3) + g.faces.size() * sizeof(uint3) + g.material.size() * sizeof(uint32_t);
+        for (const auto & lod : g.lods) bytes += lod.faces.size() * sizeof(uint3);
+        return bytes;
+    }
+
+    // Identifies a generator invocation: the generator's address followed by the raw bytes of each argument
+    struct ProceduralMeshKey
+    {
+        std::string bytes;
+
+        void append(const void * data, size_t size) { bytes.append(static_cast<const char *>(data), size); }
+
+        template<class T> void append_value(const T & value)
+        {
+            static_assert(std::is_arithmetic<T>::value, "procedural mesh keys hold arithmetic arguments only");
+            append(&value, sizeof(T));
+        }
+
+        bool operator == (const ProceduralMeshKey & k) const { return bytes == k.bytes; }
+        bool operator != (const ProceduralMeshKey & k) const { return bytes != k.bytes; }
+    };
+
+    struct ProceduralMeshKeyHash
+    {
+        size_t operator()(const ProceduralMeshKey & k) const
+        {
+            uint64_t h = 14695981039346656037ull;
+            for (char c : k.bytes) h = (h ^ uint8_t(c)) * 1099511628211ull;
+            return size_t(h);
+        }
+    };
+
+    namespace impl
+    {
+        template<class Tuple, size_t... I>
+        void append_arguments(ProceduralMeshKey & key, const Tuple & args, std::index_sequence<I...>)
+        {
+            int expand[] = { 0, (key.append_value(std::get<I>(args)), 0)... };
+            (void) expand;
+        }
+
+        template<class... P, class Tuple, size_t... I>
+        Geometry invoke_generator(Geometry(*generator)(P...), const Tuple & args, std::index_sequence<I...>)
+        {
+            return generator(std::get<I>(args)...);
+        }
+    }
+
+    // Arguments are converted to the generator's parameter types first, so make_sphere(1) and make_sphere(1.0f) share a key
+    template<class... P, class... A>
+    ProceduralMeshKey make_procedural_mesh_key(Geometry(*generator)(P...), const A & ... args)
+    {
+        static_assert(sizeof...(P) == sizeof...(A), "pass every generator argument, including defaulted ones");
+        const std::tuple<typename std::decay<P>::type...> converted(args...);
+        ProceduralMeshKey key;
+        key.append(&generator, sizeof(generator));
+        impl::append_arguments(key, converted, std::index_sequence_for<P...>());
+        return key;
+    }
+
+    class ProceduralMeshCache
+    {
+        struct Entry
+        {
+            GeometryHandle geometry;
+            std::shared_future<GeometryHandle> result; // already satisfied, for request()
+            size_t bytes = 0;
+            uint64_t lastUsed = 0;
+        };
+
+        size_t budget;
+        size_t residentBytes = 0;
+        uint64_t useCounter = 0;
+        size_t hits = 0, misses = 0;
+        std::unordered_map<ProceduralMeshKey, Entry, ProceduralMeshKeyHash> entries;
+        mutable std::mutex mutex;
+
+        KeyedWorkerPool<ProceduralMeshKey, GeometryHandle, ProceduralMeshKeyHash> pool; // last, so jobs finish before the entries go away
+
+        // Evicts least recently used entries other than `keep` until the budget is met. The entry that just
+        // finished is kept even when it alone exceeds the budget; otherwise a caller polling request() for it
+        // would regenerate it forever.
+        void evict_over_budget(const ProceduralMeshKey * keep = nullptr)
+        {
+            while (residentBytes > budget)
+            {
+                auto victim = entries.end();
+                for (auto it = entries.begin(); it != entries.end(); ++it)
+                {
+                    if (keep && it->first == *keep) continue;
+                    if (victim == entries.end() || it->second.lastUsed < victim->second.lastUsed) victim = it;
+                }
+                if (victim == entries.end()) return;
+                residentBytes -= victim->second.bytes;
+                entries.erase(victim);
+            }
+        }
+
+        // Runs once per generation, on a worker or the calling thread. The entry is in place before the pool
+        // releases the key, so no caller can miss both and generate it twice.
+        GeometryHandle generate(const ProceduralMeshKey & key, const std::function<Geometry()> & generator)
+        {
+            GeometryHandle geometry = std::make_shared<const Geometry>(generator());
+
+            std::promise<GeometryHandle> ready;
+            ready.set_value(geometry);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++misses;
+            Entry & e = entries[key];
+            if (e.geometry) residentBytes -= e.bytes;
+            e.geometry = geometry;
+            e.result = ready.get_future().share();
+            e.bytes = geometry_size_bytes(*geometry);
+            e.lastUsed = ++useCounter;
+            residentBytes += e.bytes;
+            evict_over_budget(&key);
+            return geometry;
+        }
+
+        // Called with the lock held; a finished entry, marked used and counted as a hit, or null
+        Entry * touch(const ProceduralMeshKey & key)
+        {
+            auto it = entries.find(key);
+            if (it == entries.end()) return nullptr;
+            ++hits;
+            it->second.lastUsed = ++useCounter;
+            return &it->second;
+        }
+
+    public:
+
+        // budgetBytes bounds the geometry kept alive by the cache itself; numThreads = 0 uses all but one hardware thread.
+        // Requests still queued when the cache is destroyed resolve to null.
+        explicit ProceduralMeshCache(size_t budgetBytes = 64 * 1024 * 1024, uint32_t numThreads = 0)
+            : budget(budgetBytes), pool(numThreads ? numThreads : std::max(1u, hardware_thread_count() - 1)) {}
+
+        // Returns the memoized geometry, generating it on the calling thread on a miss. If a worker is
+        // already generating the same key, waits for it instead of duplicating the work.
+        GeometryHandle get(const ProceduralMeshKey & key, const std::function<Geometry()> & generator)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (Entry * e = touch(key)) return e->geometry;
+            }
+            return pool.run(key, [&]() { return generate(key, generator); });
+        }
+
+        // Queues generation on a worker thread on a miss and returns immediately
+        std::shared_future<GeometryHandle> request(const ProceduralMeshKey & key, std::function<Geometry()> generator)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (Entry * e = touch(key)) return e->result;
+            }
+            return pool.request(key, [this, key, generator]() { return generate(key, generator); });
+        }
+
+        // The finished geometry for a key, or null if it is missing or still generating; counts as a use
+        GeometryHandle try_get(const ProceduralMeshKey & key)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it == entries.end()) return nullptr;
+            it->second.lastUsed = ++useCounter;
+            return it->second.geometry;
+        }
+
+        // Generator-typed conveniences, e.g. cache.get(make_supershape_3d, 16, m, n1, n2, n3, 1.0f, 1.0f)
+        template<class... P, class... A>
+        GeometryHandle get(Geometry(*generator)(P...), const A & ... args)
+        {
+            const std::tuple<typename std::decay<P>::type...> converted(args...);
+            return get(make_procedural_mesh_key(generator, args...), [generator, converted]() { return impl::invoke_generator(generator, converted, std::index_sequence_for<P...>()); });
+        }
+
+        template<class... P, class... A>
+        std::shared_future<GeometryHandle> request(Geometry(*generator)(P...), const A & ... args)
+        {
+            const std::tuple<typename std::decay<P>::type...> converted(args...);
+            return request(make_procedural_mesh_key(generator, args...), [generator, converted]() { return impl::invoke_generator(generator, converted, std::index_sequence_for<P...>()); });
+        }
+
+        bool contains(const ProceduralMeshKey & key) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.count(key) > 0;
+        }
+
+        size_t size_bytes() const { std::lock_guard<std::mutex> lock(mutex); return residentBytes; }
+        size_t entry_count() const { std::lock_guard<std::mutex> lock(mutex); return entries.size(); }
+        size_t hit_count() const { std::lock_guard<std::mutex> lock(mutex); return hits; }
+        size_t miss_count() const { std::lock_guard<std::mutex> lock(mutex); return misses; }
+
+        void set_budget(size_t budgetBytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            budget = budgetBytes;
+            evict_over_budget();
+        }
+
+        // Drops finished entries; generations in progress finish and are cached normally
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.clear();
+            residentBytes = 0;
+        }
+    };
+}
+
+#endif // end procedural_mesh_cache_hpp
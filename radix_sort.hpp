@@ -9,6 +9,7 @@
 #include <memory>
 #include <stdint.h>
 #include <algorithm>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -75,7 +76,7 @@ class RadixSort
 
 public:
 
-    template<typename T = typename std::enable_if<std::is_integral<T>::value, T>::type>
+    template<typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
     void sort(T * data, size_t size)
     {
         radix_impl<T>(data, size);
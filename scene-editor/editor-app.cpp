@@ -96,24 +96,22 @@ scene_editor_app::scene_editor_app() : GLFWApp(1920, 1080, "Scene Editor")
     };
     scene.skybox->onParametersChanged(); // call for initial set
 
-    auto radianceBinary = read_file_binary("../assets/textures/envmaps/wells_radiance.dds");
-    auto irradianceBinary = read_file_binary("../assets/textures/envmaps/wells_irradiance.dds");
-    gli::texture_cube radianceHandle(gli::load_dds((char *)radianceBinary.data(), radianceBinary.size()));
-    gli::texture_cube irradianceHandle(gli::load_dds((char *)irradianceBinary.data(), irradianceBinary.size()));
-    create_handle_for_asset("wells-radiance-cubemap", load_cubemap(radianceHandle));
-    create_handle_for_asset("wells-irradiance-cubemap", load_cubemap(irradianceHandle));
-
-    create_handle_for_asset("rusted-iron-albedo", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_basecolor.tga", false));
-    create_handle_for_asset("rusted-iron-normal", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_n.tga", false));
-    create_handle_for_asset("rusted-iron-metallic", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_metallic.tga", false));
-    create_handle_for_asset("rusted-iron-roughness", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_roughness.tga", false));
-    create_handle_for_asset("rusted-iron-occlusion", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_ao.tga", false));
-
-    create_handle_for_asset("scifi-floor-albedo", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_basecolor.tga", false));
-    create_handle_for_asset("scifi-floor-normal", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_n.tga", false));
-    create_handle_for_asset("scifi-floor-metallic", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_metallic.tga", false));
-    create_handle_for_asset("scifi-floor-roughness", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_roughness.tga", false));
-    create_handle_for_asset("scifi-floor-occlusion", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_ao.tga", false));
+    // Textures decode on every core in the background and upload a few per frame in on_update; materials
+    // sample grey placeholders until then
+    preload_manifest(assetLoader, {
+        { "wells-radiance-cubemap", "../assets/textures/envmaps/wells_radiance.dds" },
+        { "wells-irradiance-cubemap", "../assets/textures/envmaps/wells_irradiance.dds" },
+        { "rusted-iron-albedo", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_basecolor.tga" },
+        { "rusted-iron-normal", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_n.tga" },
+        { "rusted-iron-metallic", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_metallic.tga" },
+        { "rusted-iron-roughness", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_roughness.tga" },
+        { "rusted-iron-occlusion", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_ao.tga" },
+        { "scifi-floor-albedo", "../assets/nonfree/Metal_ScifiHangarFloor_2k_basecolor.tga" },
+        { "scifi-floor-normal", "../assets/nonfree/Metal_ScifiHangarFloor_2k_n.tga" },
+        { "scifi-floor-metallic", "../assets/nonfree/Metal_ScifiHangarFloor_2k_metallic.tga" },
+        { "scifi-floor-roughness", "../assets/nonfree/Metal_ScifiHangarFloor_2k_roughness.tga" },
+        { "scifi-floor-occlusion", "../assets/nonfree/Metal_ScifiHangarFloor_2k_ao.tga" }
+    });
 
     std::shared_ptr<DefaultMaterial> default = std::make_shared<DefaultMaterial>();
     create_handle_for_asset("default-material", static_cast<std::shared_ptr<Material>>(default));
@@ -172,31 +170,11 @@ void scene_editor_app::on_drop(std::vector<std::string> filepaths)
 
         if (fileExtension == "png" || fileExtension == "tga" || fileExtension == "jpg")
         {
-            create_handle_for_asset(get_filename_without_extension(path).c_str(), load_image(path, false));
+            load_image_async(assetLoader, get_filename_without_extension(path), path, false);
             return;
         }
 
-        auto importedModel = import_model(path);
-
-        for (auto & m : importedModel)
-        {
-            auto & mesh = m.second;
-            rescale_geometry(mesh, 1.f);
-
-            if (mesh.normals.size() == 0) compute_normals(mesh);
-            if (mesh.tangents.size() == 0) compute_tangents(mesh);
-                
-            const std::string filename = get_filename_without_extension(path);
-            const std::string outputBasePath = "../assets/models/runtime/";
-            const std::string outputFile = outputBasePath + filename + "-" + m.first + "-" + ".mesh";
-
-            export_mesh_binary(outputFile, mesh, false);
-
-            auto importedMesh = import_mesh_binary(outputFile);
-
-            create_handle_for_asset(std::string(get_filename_without_extension(path) + "-" + m.first).c_str(), make_mesh_from_geometry(importedMesh));
-            create_handle_for_asset(std::string(get_filename_without_extension(path) + "-" + m.first).c_str(), std::move(importedMesh));
-        }
+        pendingImports.emplace_back(get_filename_without_extension(path), importCache.request(path));
 
         /*
         if (fileExtension == "ply")
@@ -306,6 +284,34 @@ void scene_editor_app::on_update(const UpdateEvent & e)
     flycam.update(e.timestep_ms);
     shaderMonitor.handle_recompile();
     editor->on_update(cam, float2(width, height));
+
+    assetLoader.process_uploads(4.0);
+
+    for (auto it = pendingImports.begin(); it != pendingImports.end();)
+    {
+        if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) { ++it; continue; }
+
+        try
+        {
+            const ModelImportHandle imported = it->second.get();
+            if (imported)
+            {
+                Logger::get_instance()->assetLog->info("imported {} ({})", it->first, imported->fromCache ? "cached" : "processed");
+                // The import result is shared with every other request for the same file, so it is copied, not moved
+                for (const auto & m : imported->meshes)
+                {
+                    const std::string name = it->first + "-" + m.first;
+                    create_handle_for_asset(name.c_str(), make_mesh_from_geometry(m.second));
+                    create_handle_for_asset(name.c_str(), runtime_mesh(m.second));
+                }
+            }
+        }
+        catch (const std::exception & ex)
+        {
+            Logger::get_instance()->assetLog->info("failed to import {}: {}", it->first, ex.what());
+        }
+        it = pendingImports.erase(it);
+    }
 }
 
 void scene_editor_app::on_draw()
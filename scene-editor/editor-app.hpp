@@ -5,7 +5,7 @@
 #include "material.hpp"
 #include "fwd_renderer.hpp"
 #include "uniforms.hpp"
-#include "assets.hpp"
+#include "async_assets.hpp"
 #include "scene.hpp"
 #include "gui.hpp"
 
@@ -170,6 +170,13 @@ struct scene_editor_app final : public GLFWApp
     auto_layout uiSurface;
     std::vector<std::shared_ptr<GLTextureView>> debugViews;
 
+    // Textures are read and decoded on worker threads; on_update uploads what's ready, within a per-frame budget
+    AsyncAssetLoader assetLoader;
+
+    // Dropped models are imported and processed on worker threads; finished ones are uploaded in on_update
+    ModelImportCache importCache { "../assets/models/runtime/cache/" };
+    std::vector<std::pair<std::string, std::shared_future<ModelImportHandle>>> pendingImports;
+
     scene_editor_app();
     ~scene_editor_app();
 
@@ -10,6 +10,11 @@
 
 #include "math-common.hpp"
 #include <random>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #if defined(ANVIL_PLATFORM_WINDOWS)
 #pragma warning(push)
@@ -123,6 +128,23 @@ float noise_iq_fb(const float2 & v, uint8_t octaves = 4, float lacunarity = 2.0f
 float noise_iq_fb(const float3 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f);
 float noise_iq_fb(const float2 & v, uint8_t octaves = 4, const float2x2 & mat = float2x2({1.6f, -1.2f}, {1.2f, 1.6f}), float gain = 0.5f); // mat2 to transform each octave
 
+///////////////////////////////////////////////////////
+//   Batched 2D/3D Simplex Noise Over SoA Coordinates   //
+///////////////////////////////////////////////////////
+
+// Each function evaluates `count` points whose coordinates are given as separate x/y(/z) arrays and writes
+// one result per point (derivative variants write the gradient into separate arrays as well). Points are
+// processed eight at a time with AVX2 when available, otherwise one at a time with the scalar functions.
+
+inline void noise_batch(const float * x, const float * y, float * out, size_t count);
+inline void noise_batch(const float * x, const float * y, const float * z, float * out, size_t count);
+inline void noise_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count);
+inline void noise_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count);
+inline void noise_fb_batch(const float * x, const float * y, float * out, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f);
+inline void noise_fb_batch(const float * x, const float * y, const float * z, float * out, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f);
+inline void noise_fb_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f);
+inline void noise_fb_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f);
+
 ///////////////
 //   Utils   //
 ///////////////
@@ -157,7 +179,7 @@ namespace impl
     // repeated twice to avoid wrapping the index at 255 for each lookup.
     // This needs to be exactly the same for all instances on all platforms,
     // so it's easiest to just keep it as static explicit data.
-    static uint8_t s_perm_table[512] = {
+    static const uint8_t s_perm_table[512] = {
         151,160,137,91,90,15,
         131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
         190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
@@ -188,7 +210,7 @@ namespace impl
     
     // Gradient tables. These could be programmed the Ken Perlin way with
     // some clever bit-twiddling, but this is more clear, and not really slower.
-    static float s_gradient_2_table[8][2] = {
+    static const float s_gradient_2_table[8][2] = {
         { -1.0f, -1.0f }, { 1.0f, 0.0f } , { -1.0f, 0.0f } , { 1.0f, 1.0f } ,
         { -1.0f, 1.0f } , { 0.0f, -1.0f } , { 0.0f, 1.0f } , { 1.0f, -1.0f }
     };
@@ -200,7 +222,7 @@ namespace impl
     // of two) work better. They are not random, they are carefully chosen
     // to represent a small, isotropic set of directions.
     
-    static float s_gradient_3_table[16][3] = {
+    static const float s_gradient_3_table[16][3] = {
         { 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 1.0f }, // 12 cube edges
         { -1.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 1.0f },
         { 1.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, -1.0f },
@@ -211,7 +233,7 @@ namespace impl
         { 0.0f, 1.0f, -1.0f }, { 0.0f, -1.0f, -1.0f }
     };
     
-    static float s_gradient_4_table[32][4] = {
+    static const float s_gradient_4_table[32][4] = {
         { 0.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 1.0f, -1.0f }, { 0.0f, 1.0f, -1.0f, 1.0f }, { 0.0f, 1.0f, -1.0f, -1.0f }, // 32 tesseract edges
         { 0.0f, -1.0f, 1.0f, 1.0f }, { 0.0f, -1.0f, 1.0f, -1.0f }, { 0.0f, -1.0f, -1.0f, 1.0f }, { 0.0f, -1.0f, -1.0f, -1.0f },
         { 1.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 1.0f, -1.0f }, { 1.0f, 0.0f, -1.0f, 1.0f }, { 1.0f, 0.0f, -1.0f, -1.0f },
@@ -232,7 +254,7 @@ namespace impl
     
     // a = sqrt(2)/sqrt(3) = 0.816496580
     
-    static float s_gradient_3d_u[16][3] = {
+    static const float s_gradient_3d_u[16][3] = {
         { 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 1.0f },
         { -1.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 1.0f },
         { 1.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, -1.0f },
@@ -243,7 +265,7 @@ namespace impl
         { 0.81649658f, -0.81649658f, -0.81649658f }, { -0.81649658f, 0.81649658f, -0.81649658f }
     };
 
-    static float s_gradient_3d_v[16][3] = {
+    static const float s_gradient_3d_v[16][3] = {
         { -0.81649658f, 0.81649658f, 0.81649658f }, { -0.81649658f, -0.81649658f, 0.81649658f },
         { 0.81649658f, -0.81649658f, 0.81649658f }, { 0.81649658f, 0.81649658f, 0.81649658f },
         { -0.81649658f, -0.81649658f, -0.81649658f }, { 0.81649658f, -0.81649658f, -0.81649658f },
@@ -254,6 +276,29 @@ namespace impl
         { 0.0f, 1.0f, -1.0f }, { 0.0f, -1.0f, -1.0f }
     };
     
+    // The tables a generator evaluates noise with: its own permutation and private copies of the
+    // gradient sets above. Every table starts on a cache line and the whole block is 1.6 KB, so the
+    // working set of a generator stays in L1 alongside another thread's.
+    struct NoiseTables
+    {
+        alignas(64) uint8_t perm[512];
+        alignas(64) float gradient2[8][2];
+        float gradient3[16][3];
+        alignas(64) float gradient4[32][4];
+        alignas(64) float gradient3u[16][3];
+        float gradient3v[16][3];
+
+        NoiseTables()
+        {
+            std::memcpy(perm, s_perm_table, sizeof(perm));
+            std::memcpy(gradient2, s_gradient_2_table, sizeof(gradient2));
+            std::memcpy(gradient3, s_gradient_3_table, sizeof(gradient3));
+            std::memcpy(gradient4, s_gradient_4_table, sizeof(gradient4));
+            std::memcpy(gradient3u, s_gradient_3d_u, sizeof(gradient3u));
+            std::memcpy(gradient3v, s_gradient_3d_v, sizeof(gradient3v));
+        }
+    };
+    
     // Helper functions to compute gradients-dot-residualvectors (1D to 4D)
     // Note that these generate gradients of more than unit length. To make
     // a close match with the value range of classic Perlin noise, the final
@@ -306,49 +351,49 @@ namespace impl
         if (h & 8) *gx = - *gx; // Make half of the gradients negative
     }
     
-    inline void grad2(int hash, float *gx, float *gy)
+    inline void grad2(const NoiseTables & t, int hash, float *gx, float *gy)
     {
         int h = hash & 7;
-        *gx = s_gradient_2_table[h][0];
-        *gy = s_gradient_2_table[h][1];
+        *gx = t.gradient2[h][0];
+        *gy = t.gradient2[h][1];
     }
     
-    inline void grad3(int hash, float *gx, float *gy, float *gz)
+    inline void grad3(const NoiseTables & t, int hash, float *gx, float *gy, float *gz)
     {
         int h = hash & 15;
-        *gx = s_gradient_3_table[h][0];
-        *gy = s_gradient_3_table[h][1];
-        *gz = s_gradient_3_table[h][2];
+        *gx = t.gradient3[h][0];
+        *gy = t.gradient3[h][1];
+        *gz = t.gradient3[h][2];
     }
     
-    inline void grad4(int hash, float *gx, float *gy, float *gz, float *gw)
+    inline void grad4(const NoiseTables & t, int hash, float *gx, float *gy, float *gz, float *gw)
     {
         int h = hash & 31;
-        *gx = s_gradient_4_table[h][0];
-        *gy = s_gradient_4_table[h][1];
-        *gz = s_gradient_4_table[h][2];
-        *gw = s_gradient_4_table[h][3];
+        *gx = t.gradient4[h][0];
+        *gy = t.gradient4[h][1];
+        *gz = t.gradient4[h][2];
+        *gw = t.gradient4[h][3];
     }
 
     // Helper functions to compute rotated gradients and gradients-dot-residual vectors in 2D and 3D.
-    inline void gradrot2(int hash, float sin_t, float cos_t, float *gx, float *gy)
+    inline void gradrot2(const NoiseTables & t, int hash, float sin_t, float cos_t, float *gx, float *gy)
     {
         int h = hash & 7;
-        float gx0 = s_gradient_2_table[h][0];
-        float gy0 = s_gradient_2_table[h][1];
+        float gx0 = t.gradient2[h][0];
+        float gy0 = t.gradient2[h][1];
         *gx = cos_t * gx0 - sin_t * gy0;
         *gy = sin_t * gx0 + cos_t * gy0;
     }
     
-    inline void gradrot3(int hash, float sin_t, float cos_t, float *gx, float *gy, float *gz)
+    inline void gradrot3(const NoiseTables & t, int hash, float sin_t, float cos_t, float *gx, float *gy, float *gz)
     {
         int h = hash & 15;
-        float gux = s_gradient_3d_u[h][0];
-        float guy = s_gradient_3d_u[h][1];
-        float guz = s_gradient_3d_u[h][2];
-        float gvx = s_gradient_3d_v[h][0];
-        float gvy = s_gradient_3d_v[h][1];
-        float gvz = s_gradient_3d_v[h][2];
+        float gux = t.gradient3u[h][0];
+        float guy = t.gradient3u[h][1];
+        float guz = t.gradient3u[h][2];
+        float gvx = t.gradient3v[h][0];
+        float gvy = t.gradient3v[h][1];
+        float gvz = t.gradient3v[h][2];
         *gx = cos_t * gux + sin_t * gvx;
         *gy = cos_t * guy + sin_t * gvy;
         *gz = cos_t * guz + sin_t * gvz;
@@ -366,21 +411,138 @@ namespace impl
     
 }
 
-inline void regenerate_permutation_table(std::mt19937 & gen)
+/////////////////////////
+//   Noise Generator   //
+/////////////////////////
+
+// Evaluates every noise function in this file against its own permutation and gradient tables. Member
+// functions are const and touch nothing outside the instance, so any number of threads can share one
+// generator, and generators with different seeds can run side by side (e.g. worlds generated on a thread
+// pool). The free functions below forward to default_generator().
+class NoiseGenerator
 {
-    for (int i = 0; i < 256; i++)
+    impl::NoiseTables tables;
+
+public:
+
+    // Uses Ken Perlin's reference permutation; matches the free functions
+    NoiseGenerator() = default;
+
+    // A Fisher-Yates shuffle of 0..255 driven by mt19937(seed), so the table is a permutation and is the
+    // same on every platform
+    explicit NoiseGenerator(uint32_t seed) { reseed(seed); }
+
+    void reseed(uint32_t seed)
+    {
+        // A plain modulo favours small indices. Draws below 2^32 mod n are rejected instead; unlike
+        // std::uniform_int_distribution, whose mapping differs between standard libraries, this keeps
+        // the table the same everywhere.
+        std::mt19937 gen(seed);
+        auto below = [&gen](uint32_t n)
+        {
+            const uint32_t threshold = (0u - n) % n;
+            uint32_t r;
+            do r = uint32_t(gen()); while (r < threshold);
+            return r % n;
+        };
+
+        for (int i = 0; i < 256; ++i) tables.perm[i] = uint8_t(i);
+        for (int i = 255; i > 0; --i) std::swap(tables.perm[i], tables.perm[below(uint32_t(i + 1))]);
+        std::memcpy(tables.perm + 256, tables.perm, 256);
+    }
+
+    // Fills the table with independent uniform draws, as regenerate_permutation_table always has
+    void regenerate(std::mt19937 & gen)
     {
-        auto num = std::uniform_int_distribution<int>(0, 255)(gen);
-        impl::s_perm_table[i] = num;
-        impl::s_perm_table[i + 256] = num;
+        for (int i = 0; i < 256; i++)
+        {
+            auto num = std::uniform_int_distribution<int>(0, 255)(gen);
+            tables.perm[i] = num;
+            tables.perm[i + 256] = num;
+        }
     }
+
+    const impl::NoiseTables & get_tables() const { return tables; }
+
+    float noise(float x) const;
+    float noise(const float2 & v) const;
+    float noise(const float3 & v) const;
+    float noise(const float4 & v) const;
+
+    float noise_ridged(float x) const;
+    float noise_ridged(const float2 & v) const;
+    float noise_ridged(const float3 & v) const;
+    float noise_ridged(const float4 & v) const;
+
+    float2 noise_deriv(float x) const;
+    float3 noise_deriv(const float2 & v) const;
+    float4 noise_deriv(const float3 & v) const;
+    std::array<float,5> noise_deriv(const float4 & v) const;
+
+    float noise_worley(const float2 & v) const;
+    float noise_worley(const float3 & v) const;
+    float noise_worley(const float2 & v, float falloff) const;
+    float noise_worley(const float3 & v, float falloff) const;
+
+    float noise_flow(const float2 & v, float angle) const;
+    float noise_flow(const float3 & v, float angle) const;
+
+    float3 noise_flow_deriv(const float2 & v, float angle) const;
+    float4 noise_flow_deriv(const float3 & v, float angle) const;
+
+    float2 noise_curl(const float2 & v) const; // 2d simplex noise
+    float2 noise_curl(const float2 & v, float t) const; // 2d simplex flow noise
+    float2 noise_curl(const float2 & v, uint8_t octaves, float lacunarity, float gain) const; // 2d fractal brownian motion sum
+    float3 noise_curl(const float3 & v) const; // 3d simplex noise
+    float3 noise_curl(const float3 & v, float t) const; // 3d simplex flow noise
+    float3 noise_curl(const float3 & v, uint8_t octaves, float lacunarity, float gain) const; // 3D simplex noise fractal brownian motion sum
+
+    float noise_fb(float x, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_fb(const float2 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_fb(const float3 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_fb(const float4 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+
+    float2 noise_fb_deriv(float x, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float3 noise_fb_deriv(const float2 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float4 noise_fb_deriv(const float3 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    std::array<float,5> noise_fb_deriv(const float4 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+
+    float noise_ridged_mf(float x, float ridgeOffset = 1.0f, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_ridged_mf(const float2 & v, float ridgeOffset = 1.0f, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_ridged_mf(const float3 & v, float ridgeOffset = 1.0f, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_ridged_mf(const float4 & v, float ridgeOffset = 1.0f, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+
+    float noise_iq_fb(const float2 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_iq_fb(const float3 & v, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    float noise_iq_fb(const float2 & v, uint8_t octaves = 4, const float2x2 & mat = float2x2({1.6f, -1.2f}, {1.2f, 1.6f}), float gain = 0.5f) const; // mat2 to transform each octave
+
+    void noise_batch(const float * x, const float * y, float * out, size_t count) const;
+    void noise_batch(const float * x, const float * y, const float * z, float * out, size_t count) const;
+    void noise_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count) const;
+    void noise_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count) const;
+    void noise_fb_batch(const float * x, const float * y, float * out, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    void noise_fb_batch(const float * x, const float * y, const float * z, float * out, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    void noise_fb_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+    void noise_fb_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f) const;
+};
+
+// The instance behind the free functions. Reseeding it is not synchronized with readers.
+inline NoiseGenerator & default_generator()
+{
+    static NoiseGenerator generator;
+    return generator;
+}
+
+inline void regenerate_permutation_table(std::mt19937 & gen)
+{
+    default_generator().regenerate(gen);
 }
     
 ///////////////////////////////////
 //   Dimensional Simplex Noise   //
 ///////////////////////////////////
 
-float noise(float x)
+inline float NoiseGenerator::noise(float x) const
 {
     int i0 = fast_floor(x);
     int i1 = i0 + 1;
@@ -391,11 +553,11 @@ float noise(float x)
     
     float t0 = 1.0f - x0*x0;
     t0 *= t0;
-    n0 = t0 * t0 * impl::grad(impl::s_perm_table[i0 & 0xff], x0);
+    n0 = t0 * t0 * impl::grad(tables.perm[i0 & 0xff], x0);
     
     float t1 = 1.0f - x1*x1;
     t1 *= t1;
-    n1 = t1 * t1 * impl::grad(impl::s_perm_table[i1 & 0xff], x1);
+    n1 = t1 * t1 * impl::grad(tables.perm[i1 & 0xff], x1);
 
     // The maximum value of this noise is 8*(3/4)^4 = 2.53125
     // A factor of 0.395 would scale to fit exactly within [-1,1], but
@@ -403,7 +565,7 @@ float noise(float x)
     return 0.25f * (n0 + n1);
 }
 
-float noise(const float2 & v)
+inline float NoiseGenerator::noise(const float2 & v) const
 {
     float n0, n1, n2; // Noise contributions from the three corners
     
@@ -434,7 +596,7 @@ float noise(const float2 & v)
     float x2 = x0 - 1.0f + 2.0f * G2; // Offsets for last corner in (x,y) unskewed coords
     float y2 = y0 - 1.0f + 2.0f * G2;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     
@@ -444,7 +606,7 @@ float noise(const float2 & v)
     else 
     {
         t0 *= t0;
-        n0 = t0 * t0 * impl::grad(impl::s_perm_table[ii+impl::s_perm_table[jj]], x0, y0);
+        n0 = t0 * t0 * impl::grad(tables.perm[ii+tables.perm[jj]], x0, y0);
     }
     
     float t1 = 0.5f - x1*x1-y1*y1;
@@ -452,7 +614,7 @@ float noise(const float2 & v)
     else 
     {
         t1 *= t1;
-        n1 = t1 * t1 * impl::grad(impl::s_perm_table[ii+i1+impl::s_perm_table[jj+j1]], x1, y1);
+        n1 = t1 * t1 * impl::grad(tables.perm[ii+i1+tables.perm[jj+j1]], x1, y1);
     }
     
     float t2 = 0.5f - x2*x2-y2*y2;
@@ -460,7 +622,7 @@ float noise(const float2 & v)
     else 
     {
         t2 *= t2;
-        n2 = t2 * t2 * impl::grad(impl::s_perm_table[ii+1+impl::s_perm_table[jj+1]], x2, y2);
+        n2 = t2 * t2 * impl::grad(tables.perm[ii+1+tables.perm[jj+1]], x2, y2);
     }
     
     // Add contributions from each corner to get the final noise value.
@@ -468,7 +630,7 @@ float noise(const float2 & v)
     return 40.0f * (n0 + n1 + n2); // TODO: The scale factor is preliminary!
 }
 
-float noise(const float3 & v)
+inline float NoiseGenerator::noise(const float3 & v) const
 {
     float n0, n1, n2, n3; // Noise contributions from the four corners
     
@@ -522,7 +684,7 @@ float noise(const float3 & v)
     float y3 = y0 - 1.0f + 3.0f * G3;
     float z3 = z0 - 1.0f + 3.0f * G3;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     int kk = k & 0xff;
@@ -533,7 +695,7 @@ float noise(const float3 & v)
     else 
     {
         t0 *= t0;
-        n0 = t0 * t0 * impl::grad(impl::s_perm_table[ii+impl::s_perm_table[jj+impl::s_perm_table[kk]]], x0, y0, z0);
+        n0 = t0 * t0 * impl::grad(tables.perm[ii+tables.perm[jj+tables.perm[kk]]], x0, y0, z0);
     }
     
     float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1;
@@ -541,7 +703,7 @@ float noise(const float3 & v)
     else 
     {
         t1 *= t1;
-        n1 = t1 * t1 * impl::grad(impl::s_perm_table[ii+i1+impl::s_perm_table[jj+j1+impl::s_perm_table[kk+k1]]], x1, y1, z1);
+        n1 = t1 * t1 * impl::grad(tables.perm[ii+i1+tables.perm[jj+j1+tables.perm[kk+k1]]], x1, y1, z1);
     }
     
     float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2;
@@ -549,7 +711,7 @@ float noise(const float3 & v)
     else 
     {
         t2 *= t2;
-        n2 = t2 * t2 * impl::grad(impl::s_perm_table[ii+i2+impl::s_perm_table[jj+j2+impl::s_perm_table[kk+k2]]], x2, y2, z2);
+        n2 = t2 * t2 * impl::grad(tables.perm[ii+i2+tables.perm[jj+j2+tables.perm[kk+k2]]], x2, y2, z2);
     }
     
     float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3;
@@ -557,7 +719,7 @@ float noise(const float3 & v)
     else 
     {
         t3 *= t3;
-        n3 = t3 * t3 * impl::grad(impl::s_perm_table[ii+1+impl::s_perm_table[jj+1+impl::s_perm_table[kk+1]]], x3, y3, z3);
+        n3 = t3 * t3 * impl::grad(tables.perm[ii+1+tables.perm[jj+1+tables.perm[kk+1]]], x3, y3, z3);
     }
     
     // Add contributions from each corner to get the final noise value.
@@ -580,7 +742,7 @@ namespace impl
     };
 }
 
-float noise(const float4 & v)
+inline float NoiseGenerator::noise(const float4 & v) const
 {
     float n0, n1, n2, n3, n4; // Noise contributions from the five corners
     
@@ -667,7 +829,7 @@ float noise(const float4 & v)
     float z4 = z0 - 1.0f + 4.0f*G4;
     float w4 = w0 - 1.0f + 4.0f*G4;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     int kk = k & 0xff;
@@ -679,7 +841,7 @@ float noise(const float4 & v)
     else 
     {
         t0 *= t0;
-        n0 = t0 * t0 * impl::grad(impl::s_perm_table[ii+impl::s_perm_table[jj+impl::s_perm_table[kk+impl::s_perm_table[ll]]]], x0, y0, z0, w0);
+        n0 = t0 * t0 * impl::grad(tables.perm[ii+tables.perm[jj+tables.perm[kk+tables.perm[ll]]]], x0, y0, z0, w0);
     }
     
     float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1 - w1*w1;
@@ -687,7 +849,7 @@ float noise(const float4 & v)
     else 
     {
         t1 *= t1;
-        n1 = t1 * t1 * impl::grad(impl::s_perm_table[ii+i1+impl::s_perm_table[jj+j1+impl::s_perm_table[kk+k1+impl::s_perm_table[ll+l1]]]], x1, y1, z1, w1);
+        n1 = t1 * t1 * impl::grad(tables.perm[ii+i1+tables.perm[jj+j1+tables.perm[kk+k1+tables.perm[ll+l1]]]], x1, y1, z1, w1);
     }
     
     float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2 - w2*w2;
@@ -695,7 +857,7 @@ float noise(const float4 & v)
     else 
     {
         t2 *= t2;
-        n2 = t2 * t2 * impl::grad(impl::s_perm_table[ii+i2+impl::s_perm_table[jj+j2+impl::s_perm_table[kk+k2+impl::s_perm_table[ll+l2]]]], x2, y2, z2, w2);
+        n2 = t2 * t2 * impl::grad(tables.perm[ii+i2+tables.perm[jj+j2+tables.perm[kk+k2+tables.perm[ll+l2]]]], x2, y2, z2, w2);
     }
     
     float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3 - w3*w3;
@@ -703,7 +865,7 @@ float noise(const float4 & v)
     else 
     {
         t3 *= t3;
-        n3 = t3 * t3 * impl::grad(impl::s_perm_table[ii+i3+impl::s_perm_table[jj+j3+impl::s_perm_table[kk+k3+impl::s_perm_table[ll+l3]]]], x3, y3, z3, w3);
+        n3 = t3 * t3 * impl::grad(tables.perm[ii+i3+tables.perm[jj+j3+tables.perm[kk+k3+tables.perm[ll+l3]]]], x3, y3, z3, w3);
     }
     
     float t4 = 0.6f - x4*x4 - y4*y4 - z4*z4 - w4*w4;
@@ -711,7 +873,7 @@ float noise(const float4 & v)
     else 
     {
         t4 *= t4;
-        n4 = t4 * t4 * impl::grad(impl::s_perm_table[ii+1+impl::s_perm_table[jj+1+impl::s_perm_table[kk+1+impl::s_perm_table[ll+1]]]], x4, y4, z4, w4);
+        n4 = t4 * t4 * impl::grad(tables.perm[ii+1+tables.perm[jj+1+tables.perm[kk+1+tables.perm[ll+1]]]], x4, y4, z4, w4);
     }
     
     // Sum up and scale the result to cover the range [-1,1]
@@ -725,34 +887,34 @@ float noise(const float4 & v)
 namespace impl 
 {
     template<typename T>
-    inline float compute_ridge_noise(const T & input) { return 1.0f - std::abs(noise(input)); }
+    inline float compute_ridge_noise(const NoiseGenerator & gen, const T & input) { return 1.0f - std::abs(gen.noise(input)); }
 }
 
-float noise_ridged(float x)
+inline float NoiseGenerator::noise_ridged(float x) const
 {
-    return impl::compute_ridge_noise(x);
+    return impl::compute_ridge_noise(*this, x);
 }
 
-float noise_ridged(const float2 & v)
+inline float NoiseGenerator::noise_ridged(const float2 & v) const
 {
-    return impl::compute_ridge_noise(v);
+    return impl::compute_ridge_noise(*this, v);
 }
 
-float noise_ridged(const float3 & v)
+inline float NoiseGenerator::noise_ridged(const float3 & v) const
 {
-    return impl::compute_ridge_noise(v);
+    return impl::compute_ridge_noise(*this, v);
 }
 
-float noise_ridged(const float4 & v)
+inline float NoiseGenerator::noise_ridged(const float4 & v) const
 {
-    return impl::compute_ridge_noise(v);
+    return impl::compute_ridge_noise(*this, v);
 }
 
 ////////////////////////////////////////////////
 //   Simplex Noise Via Analytical Derivative  //
 ////////////////////////////////////////////////
 
-float2 noise_deriv(float x)
+inline float2 NoiseGenerator::noise_deriv(float x) const
 {
     int i0 = fast_floor(x);
     int i1 = i0 + 1;
@@ -767,14 +929,14 @@ float2 noise_deriv(float x)
     float t0 = 1.0f - x20;
     t20 = t0 * t0;
     t40 = t20 * t20;
-    impl::grad1(impl::s_perm_table[i0 & 0xff], &gx0);
+    impl::grad1(tables.perm[i0 & 0xff], &gx0);
     n0 = t40 * gx0 * x0;
     
     float x21 = x1*x1;
     float t1 = 1.0f - x21;
     t21 = t1 * t1;
     t41 = t21 * t21;
-    impl::grad1(impl::s_perm_table[i1 & 0xff], &gx1);
+    impl::grad1(tables.perm[i1 & 0xff], &gx1);
     n1 = t41 * gx1 * x1;
     
     // Compute derivative according to:
@@ -797,7 +959,7 @@ float2 noise_deriv(float x)
     #endif
 }
 
-float3 noise_deriv(const float2 & v)
+inline float3 NoiseGenerator::noise_deriv(const float2 & v) const
 {
     float n0, n1, n2; // Noise contributions from the three corners
     
@@ -830,7 +992,7 @@ float3 noise_deriv(const float2 & v)
     float x2 = x0 - 1.0f + 2.0f * G2; // Offsets for last corner in (x,y) unskewed coords
     float y2 = y0 - 1.0f + 2.0f * G2;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     
@@ -842,7 +1004,7 @@ float3 noise_deriv(const float2 & v)
     if (t0 < 0.0f) t40 = t20 = t0 = n0 = gx0 = gy0 = 0.0f; // No influence
     else 
     {
-        impl::grad2(impl::s_perm_table[ii + impl::s_perm_table[jj]], &gx0, &gy0);
+        impl::grad2(tables, tables.perm[ii + tables.perm[jj]], &gx0, &gy0);
         t20 = t0 * t0;
         t40 = t20 * t20;
         n0 = t40 * (gx0 * x0 + gy0 * y0);
@@ -853,7 +1015,7 @@ float3 noise_deriv(const float2 & v)
     if (t1 < 0.0f) t21 = t41 = t1 = n1 = gx1 = gy1 = 0.0f; // No influence
     else 
     {
-        impl::grad2(impl::s_perm_table[ii + i1 + impl::s_perm_table[jj + j1]], &gx1, &gy1);
+        impl::grad2(tables, tables.perm[ii + i1 + tables.perm[jj + j1]], &gx1, &gy1);
         t21 = t1 * t1;
         t41 = t21 * t21;
         n1 = t41 * (gx1 * x1 + gy1 * y1);
@@ -864,7 +1026,7 @@ float3 noise_deriv(const float2 & v)
     if (t2 < 0.0f) t42 = t22 = t2 = n2 = gx2 = gy2 = 0.0f; // No influence
     else 
     {
-        impl::grad2(impl::s_perm_table[ii + 1 + impl::s_perm_table[jj + 1]], &gx2, &gy2);
+        impl::grad2(tables, tables.perm[ii + 1 + tables.perm[jj + 1]], &gx2, &gy2);
         t22 = t2 * t2;
         t42 = t22 * t22;
         n2 = t42 * (gx2 * x2 + gy2 * y2);
@@ -896,7 +1058,7 @@ float3 noise_deriv(const float2 & v)
     
 }
 
-float4 noise_deriv(const float3 & v)
+inline float4 NoiseGenerator::noise_deriv(const float3 & v) const
 {
     float n0, n1, n2, n3; // Noise contributions from the four simplex corners
     float noise;          // Return value
@@ -954,7 +1116,7 @@ float4 noise_deriv(const float3 & v)
     float y3 = y0 - 1.0f + 3.0f * G3;
     float z3 = z0 - 1.0f + 3.0f * G3;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     int kk = k & 0xff;
@@ -965,7 +1127,7 @@ float4 noise_deriv(const float3 & v)
     if (t0 < 0.0f) n0 = t0 = t20 = t40 = gx0 = gy0 = gz0 = 0.0f;
     else 
     {
-        impl::grad3(impl::s_perm_table[ii + impl::s_perm_table[jj + impl::s_perm_table[kk]]], &gx0, &gy0, &gz0);
+        impl::grad3(tables, tables.perm[ii + tables.perm[jj + tables.perm[kk]]], &gx0, &gy0, &gz0);
         t20 = t0 * t0;
         t40 = t20 * t20;
         n0 = t40 * (gx0 * x0 + gy0 * y0 + gz0 * z0);
@@ -976,7 +1138,7 @@ float4 noise_deriv(const float3 & v)
     if (t1 < 0.0f) n1 = t1 = t21 = t41 = gx1 = gy1 = gz1 = 0.0f;
     else 
     {
-        impl::grad3(impl::s_perm_table[ii + i1 + impl::s_perm_table[jj + j1 + impl::s_perm_table[kk + k1]]], &gx1, &gy1, &gz1);
+        impl::grad3(tables, tables.perm[ii + i1 + tables.perm[jj + j1 + tables.perm[kk + k1]]], &gx1, &gy1, &gz1);
         t21 = t1 * t1;
         t41 = t21 * t21;
         n1 = t41 * (gx1 * x1 + gy1 * y1 + gz1 * z1);
@@ -987,7 +1149,7 @@ float4 noise_deriv(const float3 & v)
     if (t2 < 0.0f) n2 = t2 = t22 = t42 = gx2 = gy2 = gz2 = 0.0f;
     else 
     {
-        impl::grad3(impl::s_perm_table[ii + i2 + impl::s_perm_table[jj + j2 + impl::s_perm_table[kk + k2]]], &gx2, &gy2, &gz2);
+        impl::grad3(tables, tables.perm[ii + i2 + tables.perm[jj + j2 + tables.perm[kk + k2]]], &gx2, &gy2, &gz2);
         t22 = t2 * t2;
         t42 = t22 * t22;
         n2 = t42 * (gx2 * x2 + gy2 * y2 + gz2 * z2);
@@ -998,7 +1160,7 @@ float4 noise_deriv(const float3 & v)
     if (t3 < 0.0f) n3 = t3 = t23 = t43 = gx3 = gy3 = gz3 = 0.0f;
     else 
     {
-        impl::grad3(impl::s_perm_table[ii + 1 + impl::s_perm_table[jj + 1 + impl::s_perm_table[kk + 1]]], &gx3, &gy3, &gz3);
+        impl::grad3(tables, tables.perm[ii + 1 + tables.perm[jj + 1 + tables.perm[kk + 1]]], &gx3, &gy3, &gz3);
         t23 = t3 * t3;
         t43 = t23 * t23;
         n3 = t43 * (gx3 * x3 + gy3 * y3 + gz3 * z3);
@@ -1041,7 +1203,7 @@ float4 noise_deriv(const float3 & v)
     return float4(noise, dnoise_dx, dnoise_dy, dnoise_dz);
 }
 
-std::array<float,5> noise_deriv(const float4 & v)
+inline std::array<float,5> NoiseGenerator::noise_deriv(const float4 & v) const
 {
     float n0, n1, n2, n3, n4; // Noise contributions from the five corners
     float noise; // Return value
@@ -1130,7 +1292,7 @@ std::array<float,5> noise_deriv(const float4 & v)
     float z4 = z0 - 1.0f + 4.0f * G4;
     float w4 = w0 - 1.0f + 4.0f * G4;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     int kk = k & 0xff;
@@ -1143,7 +1305,7 @@ std::array<float,5> noise_deriv(const float4 & v)
     {
         t20 = t0 * t0;
         t40 = t20 * t20;
-        impl::grad4(impl::s_perm_table[ii+impl::s_perm_table[jj+impl::s_perm_table[kk+impl::s_perm_table[ll]]]], &gx0, &gy0, &gz0, &gw0);
+        impl::grad4(tables, tables.perm[ii+tables.perm[jj+tables.perm[kk+tables.perm[ll]]]], &gx0, &gy0, &gz0, &gw0);
         n0 = t40 * (gx0 * x0 + gy0 * y0 + gz0 * z0 + gw0 * w0);
     }
     
@@ -1153,7 +1315,7 @@ std::array<float,5> noise_deriv(const float4 & v)
     {
         t21 = t1 * t1;
         t41 = t21 * t21;
-        impl::grad4(impl::s_perm_table[ii+i1+impl::s_perm_table[jj+j1+impl::s_perm_table[kk+k1+impl::s_perm_table[ll+l1]]]], &gx1, &gy1, &gz1, &gw1);
+        impl::grad4(tables, tables.perm[ii+i1+tables.perm[jj+j1+tables.perm[kk+k1+tables.perm[ll+l1]]]], &gx1, &gy1, &gz1, &gw1);
         n1 = t41 * (gx1 * x1 + gy1 * y1 + gz1 * z1 + gw1 * w1);
     }
     
@@ -1163,7 +1325,7 @@ std::array<float,5> noise_deriv(const float4 & v)
     {
         t22 = t2 * t2;
         t42 = t22 * t22;
-        impl::grad4(impl::s_perm_table[ii+i2+impl::s_perm_table[jj+j2+impl::s_perm_table[kk+k2+impl::s_perm_table[ll+l2]]]], &gx2, &gy2, &gz2, &gw2);
+        impl::grad4(tables, tables.perm[ii+i2+tables.perm[jj+j2+tables.perm[kk+k2+tables.perm[ll+l2]]]], &gx2, &gy2, &gz2, &gw2);
         n2 = t42 * (gx2 * x2 + gy2 * y2 + gz2 * z2 + gw2 * w2);
     }
     
@@ -1173,7 +1335,7 @@ std::array<float,5> noise_deriv(const float4 & v)
     {
         t23 = t3 * t3;
         t43 = t23 * t23;
-        impl::grad4(impl::s_perm_table[ii+i3+impl::s_perm_table[jj+j3+impl::s_perm_table[kk+k3+impl::s_perm_table[ll+l3]]]], &gx3, &gy3, &gz3, &gw3);
+        impl::grad4(tables, tables.perm[ii+i3+tables.perm[jj+j3+tables.perm[kk+k3+tables.perm[ll+l3]]]], &gx3, &gy3, &gz3, &gw3);
         n3 = t43 * (gx3 * x3 + gy3 * y3 + gz3 * z3 + gw3 * w3);
     }
     
@@ -1183,7 +1345,7 @@ std::array<float,5> noise_deriv(const float4 & v)
     {
         t24 = t4 * t4;
         t44 = t24 * t24;
-        impl::grad4(impl::s_perm_table[ii+1+impl::s_perm_table[jj+1+impl::s_perm_table[kk+1+impl::s_perm_table[ll+1]]]], &gx4, &gy4, &gz4, &gw4);
+        impl::grad4(tables, tables.perm[ii+1+tables.perm[jj+1+tables.perm[kk+1+tables.perm[ll+1]]]], &gx4, &gy4, &gz4, &gw4);
         n4 = t44 * (gx4 * x4 + gy4 * y4 + gz4 * z4 + gw4 * w4);
     }
     
@@ -1236,7 +1398,7 @@ std::array<float,5> noise_deriv(const float4 & v)
 //   2D Simplex Worley/Cellular Noise  //
 /////////////////////////////////////////
 
-float noise_worley(const float2 & v)
+inline float NoiseGenerator::noise_worley(const float2 & v) const
 {
     float2 p = floor(v);
     float2 f = fract(v);
@@ -1247,7 +1409,7 @@ float noise_worley(const float2 & v)
         for (int i=-1; i<=1; i++) 
         {
             float2 b = float2(i, j);
-            float2  r = float2(b) - f + (noise::noise(p + b) * 0.5f + 0.5f);
+            float2  r = float2(b) - f + (noise(p + b) * 0.5f + 0.5f);
             float d = dot(r, r);
             res = min(res, d);
         }
@@ -1255,7 +1417,7 @@ float noise_worley(const float2 & v)
     return sqrt(res);
 }
 
-float noise_worley(const float3 & v)
+inline float NoiseGenerator::noise_worley(const float3 & v) const
 {
     float3 p = floor(v);
     float3 f = fract(v);
@@ -1268,7 +1430,7 @@ float noise_worley(const float3 & v)
             for (int i=-1; i<=1; i++) 
             {
                 float3 b = float3(i, j, k);
-                float3 r = float3(b) - f + (noise::noise(p + b) * 0.5f + 0.5f);
+                float3 r = float3(b) - f + (noise(p + b) * 0.5f + 0.5f);
                 float d = dot(r, r);
                 res = min(res, d);
             }
@@ -1277,7 +1439,7 @@ float noise_worley(const float3 & v)
     return sqrt(res);
 }
 
-float noise_worley(const float2 & v, float falloff)
+inline float NoiseGenerator::noise_worley(const float2 & v, float falloff) const
 {
     auto p = floor(v);
     float2 f = fract(v);
@@ -1288,7 +1450,7 @@ float noise_worley(const float2 & v, float falloff)
         for (int i=-1; i<=1; i++) 
         {
             auto b = float2(i, j);
-            float2  r = float2(b) - f + (noise::noise(p + b) * 0.5f + 0.5f);
+            float2  r = float2(b) - f + (noise(p + b) * 0.5f + 0.5f);
             float d = length(r);
             res += exp(-falloff*d);
         }
@@ -1296,7 +1458,7 @@ float noise_worley(const float2 & v, float falloff)
     return -(1.0f / falloff) * log(res);
 }
 
-float noise_worley(const float3 & v, float falloff)
+inline float NoiseGenerator::noise_worley(const float3 & v, float falloff) const
 {
     float3 p = floor(v);
     float3 f = fract(v);
@@ -1309,7 +1471,7 @@ float noise_worley(const float3 & v, float falloff)
             for (int i=-1; i<=1; i++) 
             {
                 float3 b = float3(i, j, k);
-                float3 r = float3(b) - f + (noise::noise(p + b) * 0.5f + 0.5f);
+                float3 r = float3(b) - f + (noise(p + b) * 0.5f + 0.5f);
                 float d = length(r);
                 res += exp(-falloff*d);
             }
@@ -1322,7 +1484,7 @@ float noise_worley(const float3 & v, float falloff)
 //   2D/3D Simplex Flow Noise with Rotating Gradients  //
 /////////////////////////////////////////////////////////
 
-float noise_flow(const float2 & v, float angle)
+inline float NoiseGenerator::noise_flow(const float2 & v, float angle) const
 {
     float n0, n1, n2; // Noise contributions from the three simplex corners
     float gx0, gy0, gx1, gy1, gx2, gy2; // Gradients at simplex corners
@@ -1357,7 +1519,7 @@ float noise_flow(const float2 & v, float angle)
     float x2 = x0 - 1.0f + 2.0f * G2; // Offsets for last corner in (x,y) unskewed coords
     float y2 = y0 - 1.0f + 2.0f * G2;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     
@@ -1367,7 +1529,7 @@ float noise_flow(const float2 & v, float angle)
     if (t0 < 0.0f) t40 = t20 = t0 = n0 = gx0 = gy0 = 0.0f; // No influence
     else 
     {
-        impl::gradrot2(impl::s_perm_table[ii + impl::s_perm_table[jj]], sin_t, cos_t, &gx0, &gy0);
+        impl::gradrot2(tables, tables.perm[ii + tables.perm[jj]], sin_t, cos_t, &gx0, &gy0);
         t20 = t0 * t0;
         t40 = t20 * t20;
         n0 = t40 * impl::graddotp2(gx0, gy0, x0, y0);
@@ -1378,7 +1540,7 @@ float noise_flow(const float2 & v, float angle)
     if (t1 < 0.0f) t21 = t41 = t1 = n1 = gx1 = gy1 = 0.0f; // No influence
     else 
     {
-        impl::gradrot2(impl::s_perm_table[ii + i1 + impl::s_perm_table[jj + j1]], sin_t, cos_t, &gx1, &gy1);
+        impl::gradrot2(tables, tables.perm[ii + i1 + tables.perm[jj + j1]], sin_t, cos_t, &gx1, &gy1);
         t21 = t1 * t1;
         t41 = t21 * t21;
         n1 = t41 * impl::graddotp2(gx1, gy1, x1, y1);
@@ -1389,7 +1551,7 @@ float noise_flow(const float2 & v, float angle)
     if (t2 < 0.0f) t42 = t22 = t2 = n2 = gx2 = gy2 = 0.0f; // No influence
     else 
     {
-        impl::gradrot2(impl::s_perm_table[ii + 1 + impl::s_perm_table[jj + 1]], sin_t, cos_t, &gx2, &gy2);
+        impl::gradrot2(tables, tables.perm[ii + 1 + tables.perm[jj + 1]], sin_t, cos_t, &gx2, &gy2);
         t22 = t2 * t2;
         t42 = t22 * t22;
         n2 = t42 * impl::graddotp2(gx2, gy2, x2, y2);
@@ -1400,7 +1562,7 @@ float noise_flow(const float2 & v, float angle)
     return 40.0f * (n0 + n1 + n2);
 }
 
-float noise_flow(const float3 & v, float angle)
+inline float NoiseGenerator::noise_flow(const float3 & v, float angle) const
 {
     float n0, n1, n2, n3; // Noise contributions from the four simplex corners
     float gx0, gy0, gz0, gx1, gy1, gz1; // Gradients at simplex corners
@@ -1459,7 +1621,7 @@ float noise_flow(const float3 & v, float angle)
     float y3 = y0 - 1.0f + 3.0f * G3;
     float z3 = z0 - 1.0f + 3.0f * G3;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     int kk = k & 0xff;
@@ -1470,7 +1632,7 @@ float noise_flow(const float3 & v, float angle)
     if (t0 < 0.0f) n0 = t0 = t20 = t40 = gx0 = gy0 = gz0 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + impl::s_perm_table[jj + impl::s_perm_table[kk]]], sin_t, cos_t, &gx0, &gy0, &gz0);
+        impl::gradrot3(tables, tables.perm[ii + tables.perm[jj + tables.perm[kk]]], sin_t, cos_t, &gx0, &gy0, &gz0);
         t20 = t0 * t0;
         t40 = t20 * t20;
         n0 = t40 * impl::graddotp3(gx0, gy0, gz0, x0, y0, z0);
@@ -1481,7 +1643,7 @@ float noise_flow(const float3 & v, float angle)
     if (t1 < 0.0f) n1 = t1 = t21 = t41 = gx1 = gy1 = gz1 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + i1 + impl::s_perm_table[jj + j1 + impl::s_perm_table[kk + k1]]], sin_t, cos_t, &gx1, &gy1, &gz1);
+        impl::gradrot3(tables, tables.perm[ii + i1 + tables.perm[jj + j1 + tables.perm[kk + k1]]], sin_t, cos_t, &gx1, &gy1, &gz1);
         t21 = t1 * t1;
         t41 = t21 * t21;
         n1 = t41 * impl::graddotp3(gx1, gy1, gz1, x1, y1, z1);
@@ -1492,7 +1654,7 @@ float noise_flow(const float3 & v, float angle)
     if (t2 < 0.0f) n2 = t2 = t22 = t42 = gx2 = gy2 = gz2 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + i2 + impl::s_perm_table[jj + j2 + impl::s_perm_table[kk + k2]]], sin_t, cos_t, &gx2, &gy2, &gz2);
+        impl::gradrot3(tables, tables.perm[ii + i2 + tables.perm[jj + j2 + tables.perm[kk + k2]]], sin_t, cos_t, &gx2, &gy2, &gz2);
         t22 = t2 * t2;
         t42 = t22 * t22;
         n2 = t42 * impl::graddotp3(gx2, gy2, gz2, x2, y2, z2);
@@ -1503,7 +1665,7 @@ float noise_flow(const float3 & v, float angle)
     if (t3 < 0.0f) n3 = t3 = t23 = t43 = gx3 = gy3 = gz3 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + 1 + impl::s_perm_table[jj + 1 + impl::s_perm_table[kk + 1]]], sin_t, cos_t, &gx3, &gy3, &gz3);
+        impl::gradrot3(tables, tables.perm[ii + 1 + tables.perm[jj + 1 + tables.perm[kk + 1]]], sin_t, cos_t, &gx3, &gy3, &gz3);
         t23 = t3 * t3;
         t43 = t23 * t23;
         n3 = t43 * impl::graddotp3(gx3, gy3, gz3, x3, y3, z3);
@@ -1518,7 +1680,7 @@ float noise_flow(const float3 & v, float angle)
 //   2D/3D Simplex Flow Noise Via Analytical Derivative   //
 ////////////////////////////////////////////////////////////
 
-float3 noise_flow_deriv(const float2 & v, float angle)
+inline float3 NoiseGenerator::noise_flow_deriv(const float2 & v, float angle) const
 {
     
     float n0, n1, n2; // Noise contributions from the three simplex corners
@@ -1554,7 +1716,7 @@ float3 noise_flow_deriv(const float2 & v, float angle)
     float x2 = x0 - 1.0f + 2.0f * G2; // Offsets for last corner in (x,y) unskewed coords
     float y2 = y0 - 1.0f + 2.0f * G2;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     
@@ -1564,7 +1726,7 @@ float3 noise_flow_deriv(const float2 & v, float angle)
     if (t0 < 0.0f) t40 = t20 = t0 = n0 = gx0 = gy0 = 0.0f; // No influence
     else 
     {
-        impl::gradrot2(impl::s_perm_table[ii + impl::s_perm_table[jj]], sin_t, cos_t, &gx0, &gy0);
+        impl::gradrot2(tables, tables.perm[ii + tables.perm[jj]], sin_t, cos_t, &gx0, &gy0);
         t20 = t0 * t0;
         t40 = t20 * t20;
         n0 = t40 * impl::graddotp2(gx0, gy0, x0, y0);
@@ -1575,7 +1737,7 @@ float3 noise_flow_deriv(const float2 & v, float angle)
     if (t1 < 0.0f) t21 = t41 = t1 = n1 = gx1 = gy1 = 0.0f; // No influence
     else 
     {
-        impl::gradrot2(impl::s_perm_table[ii + i1 + impl::s_perm_table[jj + j1]], sin_t, cos_t, &gx1, &gy1);
+        impl::gradrot2(tables, tables.perm[ii + i1 + tables.perm[jj + j1]], sin_t, cos_t, &gx1, &gy1);
         t21 = t1 * t1;
         t41 = t21 * t21;
         n1 = t41 * impl::graddotp2(gx1, gy1, x1, y1);
@@ -1586,7 +1748,7 @@ float3 noise_flow_deriv(const float2 & v, float angle)
     if (t2 < 0.0f) t42 = t22 = t2 = n2 = gx2 = gy2 = 0.0f; // No influence
     else 
     {
-        impl::gradrot2(impl::s_perm_table[ii + 1 + impl::s_perm_table[jj + 1]], sin_t, cos_t, &gx2, &gy2);
+        impl::gradrot2(tables, tables.perm[ii + 1 + tables.perm[jj + 1]], sin_t, cos_t, &gx2, &gy2);
         t22 = t2 * t2;
         t42 = t22 * t22;
         n2 = t42 * impl::graddotp2(gx2, gy2, x2, y2);
@@ -1621,7 +1783,7 @@ float3 noise_flow_deriv(const float2 & v, float angle)
     return float3(noise, dnoise_dx, dnoise_dy);
 }
 
-float4 noise_flow_deriv(const float3 & v, float angle)
+inline float4 NoiseGenerator::noise_flow_deriv(const float3 & v, float angle) const
 {
     float n0, n1, n2, n3; // Noise contributions from the four simplex corners
     float noise;
@@ -1683,7 +1845,7 @@ float4 noise_flow_deriv(const float3 & v, float angle)
     float y3 = y0 - 1.0f + 3.0f * G3;
     float z3 = z0 - 1.0f + 3.0f * G3;
     
-    // Wrap the integer indices at 256, to avoid indexing impl::s_perm_table[] out of bounds
+    // Wrap the integer indices at 256, to avoid indexing tables.perm[] out of bounds
     int ii = i & 0xff;
     int jj = j & 0xff;
     int kk = k & 0xff;
@@ -1694,7 +1856,7 @@ float4 noise_flow_deriv(const float3 & v, float angle)
     if (t0 < 0.0f) n0 = t0 = t20 = t40 = gx0 = gy0 = gz0 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + impl::s_perm_table[jj + impl::s_perm_table[kk]]], sin_t, cos_t, &gx0, &gy0, &gz0);
+        impl::gradrot3(tables, tables.perm[ii + tables.perm[jj + tables.perm[kk]]], sin_t, cos_t, &gx0, &gy0, &gz0);
         t20 = t0 * t0;
         t40 = t20 * t20;
         n0 = t40 * impl::graddotp3(gx0, gy0, gz0, x0, y0, z0);
@@ -1705,7 +1867,7 @@ float4 noise_flow_deriv(const float3 & v, float angle)
     if (t1 < 0.0f) n1 = t1 = t21 = t41 = gx1 = gy1 = gz1 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + i1 + impl::s_perm_table[jj + j1 + impl::s_perm_table[kk + k1]]], sin_t, cos_t, &gx1, &gy1, &gz1);
+        impl::gradrot3(tables, tables.perm[ii + i1 + tables.perm[jj + j1 + tables.perm[kk + k1]]], sin_t, cos_t, &gx1, &gy1, &gz1);
         t21 = t1 * t1;
         t41 = t21 * t21;
         n1 = t41 * impl::graddotp3(gx1, gy1, gz1, x1, y1, z1);
@@ -1716,7 +1878,7 @@ float4 noise_flow_deriv(const float3 & v, float angle)
     if (t2 < 0.0f) n2 = t2 = t22 = t42 = gx2 = gy2 = gz2 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + i2 + impl::s_perm_table[jj + j2 + impl::s_perm_table[kk + k2]]], sin_t, cos_t, &gx2, &gy2, &gz2);
+        impl::gradrot3(tables, tables.perm[ii + i2 + tables.perm[jj + j2 + tables.perm[kk + k2]]], sin_t, cos_t, &gx2, &gy2, &gz2);
         t22 = t2 * t2;
         t42 = t22 * t22;
         n2 = t42 * impl::graddotp3(gx2, gy2, gz2, x2, y2, z2);
@@ -1727,7 +1889,7 @@ float4 noise_flow_deriv(const float3 & v, float angle)
     if (t3 < 0.0f) n3 = t3 = t23 = t43 = gx3 = gy3 = gz3 = 0.0f;
     else 
     {
-        impl::gradrot3(impl::s_perm_table[ii + 1 + impl::s_perm_table[jj + 1 + impl::s_perm_table[kk + 1]]], sin_t, cos_t, &gx3, &gy3, &gz3);
+        impl::gradrot3(tables, tables.perm[ii + 1 + tables.perm[jj + 1 + tables.perm[kk + 1]]], sin_t, cos_t, &gx3, &gy3, &gz3);
         t23 = t3 * t3;
         t43 = t23 * t23;
         n3 = t43 * impl::graddotp3(gx3, gy3, gz3, x3, y3, z3);
@@ -1779,25 +1941,25 @@ float4 noise_flow_deriv(const float3 & v, float angle)
 //   Compute Curl of 2D Simplex Noise   //
 //////////////////////////////////////////
 
-float2 noise_curl(const float2 & v)
+inline float2 NoiseGenerator::noise_curl(const float2 & v) const
 {
     const float3 derivative = noise_deriv(v);
     return float2(derivative.z, -derivative.y);
 }
 
-float2 noise_curl(const float2 & v, float t)
+inline float2 NoiseGenerator::noise_curl(const float2 & v, float t) const
 {
     const float3 derivative = noise_flow_deriv(v, t);
     return float2(derivative.z, -derivative.y);
 }
 
-float2 noise_curl(const float2 & v, uint8_t octaves, float lacunarity, float gain)
+inline float2 NoiseGenerator::noise_curl(const float2 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     const float3 derivative = noise_fb_deriv(v, octaves, lacunarity, gain);
     return float2(derivative.z, -derivative.y);
 }
 
-float3 noise_curl(const float3 & v)
+inline float3 NoiseGenerator::noise_curl(const float3 & v) const
 {
     const float4 derivX = noise_deriv(v);
     const float4 derivY = noise_deriv(v + float3(123.456f, 789.012f, 345.678f));
@@ -1805,7 +1967,7 @@ float3 noise_curl(const float3 & v)
     return float3(derivZ.z - derivY.w, derivX.w - derivZ.y, derivY.y - derivX.z);
 }
 
-float3 noise_curl(const float3 & v, float t)
+inline float3 NoiseGenerator::noise_curl(const float3 & v, float t) const
 {
     const float4 derivX = noise_flow_deriv(v, t);
     const float4 derivY = noise_flow_deriv(v + float3(123.456f, 789.012f, 345.678f), t);
@@ -1813,7 +1975,7 @@ float3 noise_curl(const float3 & v, float t)
     return float3(derivZ.z - derivY.w, derivX.w - derivZ.y, derivY.y - derivX.z);
 }
 
-float3 noise_curl(const float3 & v, uint8_t octaves, float lacunarity, float gain)
+inline float3 NoiseGenerator::noise_curl(const float3 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     const float4 derivX = noise_fb_deriv(v, octaves, lacunarity, gain);
     const float4 derivY = noise_fb_deriv(v + float3(123.456f, 789.012f, 345.678f), octaves, lacunarity, gain);
@@ -1821,7 +1983,7 @@ float3 noise_curl(const float3 & v, uint8_t octaves, float lacunarity, float gai
     return float3(derivZ.z - derivY.w, derivX.w - derivZ.y, derivY.y - derivX.z);
 }
 
-float2 curl(const float2 & v, const std::function<float(const float2&)> &potential, float delta)
+inline float2 curl(const float2 & v, const std::function<float(const float2&)> &potential, float delta)
 {
     const float2 deltaX = float2(delta, 0.0f);
     const float2 deltaY = float2(0.0f, delta);
@@ -1829,7 +1991,7 @@ float2 curl(const float2 & v, const std::function<float(const float2&)> &potenti
                    (potential(v + deltaX) - potential(v - deltaX))) / (2.0f * delta);
 }
     
-float3 curl(const float3 & v, const std::function<float3(const float3&)> &potential, float delta)
+inline float3 curl(const float3 & v, const std::function<float3(const float3&)> &potential, float delta)
 {
     const float3 deltaX = float3(delta, 0.0f, 0.0f);
     const float3 deltaY = float3(0.0f, delta, 0.0f);
@@ -1849,14 +2011,14 @@ float3 curl(const float3 & v, const std::function<float3(const float3&)> &potent
 namespace impl 
 {
     template<typename T>
-    float compute_fractal_brownian(const T & input, uint8_t octaves, float lacunarity, float gain)
+    float compute_fractal_brownian(const NoiseGenerator & gen, const T & input, uint8_t octaves, float lacunarity, float gain)
     {
         float sum  = 0.0f;
         float freq = 1.0f;
         float amp = 0.5f;
         for (uint8_t i = 0; i < octaves; i++)
         {
-            float n = noise(input * freq);
+            float n = gen.noise(input * freq);
             sum += n*amp;
             freq *= lacunarity;
             amp *= gain;
@@ -1865,31 +2027,31 @@ namespace impl
     }
 }
 
-float noise_fb(float x, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_fb(float x, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_fractal_brownian(x, octaves, lacunarity, gain);
+    return impl::compute_fractal_brownian(*this, x, octaves, lacunarity, gain);
 }
 
-float noise_fb(const float2 & v, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_fb(const float2 & v, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_fractal_brownian(v, octaves, lacunarity, gain);
+    return impl::compute_fractal_brownian(*this, v, octaves, lacunarity, gain);
 }
 
-float noise_fb(const float3 & v, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_fb(const float3 & v, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_fractal_brownian(v, octaves, lacunarity, gain);
+    return impl::compute_fractal_brownian(*this, v, octaves, lacunarity, gain);
 }
 
-float noise_fb(const float4 & v, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_fb(const float4 & v, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_fractal_brownian(v, octaves, lacunarity, gain);
+    return impl::compute_fractal_brownian(*this, v, octaves, lacunarity, gain);
 }
 
 ///////////////////////////////////////////////////////////
 //   Fractal Brownian Motion via Analytical Derivative   //
 ///////////////////////////////////////////////////////////
 
-float2 noise_fb_deriv(float x, uint8_t octaves, float lacunarity, float gain)
+inline float2 NoiseGenerator::noise_fb_deriv(float x, uint8_t octaves, float lacunarity, float gain) const
 {
     float2 sum = float2(0.0f);
     float freq = 1.0f;
@@ -1904,7 +2066,7 @@ float2 noise_fb_deriv(float x, uint8_t octaves, float lacunarity, float gain)
     return sum;
 }
 
-float3 noise_fb_deriv(const float2 & v, uint8_t octaves, float lacunarity, float gain)
+inline float3 NoiseGenerator::noise_fb_deriv(const float2 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     float3 sum = float3(0.0f);
     float freq = 1.0f;
@@ -1921,7 +2083,7 @@ float3 noise_fb_deriv(const float2 & v, uint8_t octaves, float lacunarity, float
     return sum;
 }
 
-float4 noise_fb_deriv(const float3 & v, uint8_t octaves, float lacunarity, float gain)
+inline float4 NoiseGenerator::noise_fb_deriv(const float3 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     float4 sum = float4(0.0f);
     float freq = 1.0f;
@@ -1936,7 +2098,7 @@ float4 noise_fb_deriv(const float3 & v, uint8_t octaves, float lacunarity, float
     return sum;
 }
 
-std::array<float,5> noise_fb_deriv(const float4 & v, uint8_t octaves, float lacunarity, float gain)
+inline std::array<float,5> NoiseGenerator::noise_fb_deriv(const float4 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     std::array<float,5> sum = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
     float freq  = 1.0f;
@@ -1968,7 +2130,7 @@ namespace impl
     }
     
     template<typename T>
-    float compute_ridged_multi_fractal(const T & input, float ridgeOffset, uint8_t octaves, float lacunarity, float gain)
+    float compute_ridged_multi_fractal(const NoiseGenerator & gen, const T & input, float ridgeOffset, uint8_t octaves, float lacunarity, float gain)
     {
         float sum = 0;
         float freq = 1.0;
@@ -1976,7 +2138,7 @@ namespace impl
         float prev = 1.0;
         for (uint8_t i = 0; i < octaves; i++)
         {
-            float n = ridge(noise(input * freq), ridgeOffset);
+            float n = ridge(gen.noise(input * freq), ridgeOffset);
             sum += n*amp*prev;
             prev = n;
             freq *= lacunarity;
@@ -1986,31 +2148,31 @@ namespace impl
     }
 }
 
-float noise_ridged_mf(float x, float ridgeOffset, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_ridged_mf(float x, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_ridged_multi_fractal(x, ridgeOffset, octaves, lacunarity, gain);
+    return impl::compute_ridged_multi_fractal(*this, x, ridgeOffset, octaves, lacunarity, gain);
 }
 
-float noise_ridged_mf(const float2 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_ridged_mf(const float2 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_ridged_multi_fractal(v, ridgeOffset, octaves, lacunarity, gain);
+    return impl::compute_ridged_multi_fractal(*this, v, ridgeOffset, octaves, lacunarity, gain);
 }
 
-float noise_ridged_mf(const float3 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_ridged_mf(const float3 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_ridged_multi_fractal(v, ridgeOffset, octaves, lacunarity, gain);
+    return impl::compute_ridged_multi_fractal(*this, v, ridgeOffset, octaves, lacunarity, gain);
 }
 
-float noise_ridged_mf(const float4 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_ridged_mf(const float4 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) const
 {
-    return impl::compute_ridged_multi_fractal(v, ridgeOffset, octaves, lacunarity, gain);
+    return impl::compute_ridged_multi_fractal(*this, v, ridgeOffset, octaves, lacunarity, gain);
 }
 
 /////////////////////////////////////////////////////
 //   Noise Fractal Variation Via Iñigo's Methods   //
 /////////////////////////////////////////////////////
 
-float noise_iq_fb(const float2 & v, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_iq_fb(const float2 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     float sum = 0.0;
     float amp = 0.5;
@@ -2029,7 +2191,7 @@ float noise_iq_fb(const float2 & v, uint8_t octaves, float lacunarity, float gai
     return sum;
 }
 
-float noise_iq_fb(const float3 & v, uint8_t octaves, float lacunarity, float gain)
+inline float NoiseGenerator::noise_iq_fb(const float3 & v, uint8_t octaves, float lacunarity, float gain) const
 {
     float sum = 0.0;
     float amp = 0.5;
@@ -2050,7 +2212,7 @@ float noise_iq_fb(const float3 & v, uint8_t octaves, float lacunarity, float gai
     return sum;
 }
 
-float noise_iq_fb(const float2 & v, uint8_t octaves, const float2x2 & mat, float gain)
+inline float NoiseGenerator::noise_iq_fb(const float2 & v, uint8_t octaves, const float2x2 & mat, float gain) const
 {
     float sum = 0.0;
     float amp = 1.0;
@@ -2067,6 +2229,525 @@ float noise_iq_fb(const float2 & v, uint8_t octaves, const float2x2 & mat, float
     return sum;
 }
 
+///////////////////////////////////////////////////////
+//   Batched 2D/3D Simplex Noise Over SoA Coordinates   //
+///////////////////////////////////////////////////////
+
+#if defined(__AVX2__)
+
+namespace impl
+{
+    // The vector paths below follow the scalar implementations step for step; branches on the simplex
+    // ordering and on corner falloff become masks and blends. Permutation lookups spill the eight indices
+    // and read the byte table with scalar loads, which is faster than vpgatherdd on most hardware and
+    // reads the same per-generator table as the scalar functions. Gradients are selected
+    // arithmetically or with in-register permutes, never through memory.
+    namespace simd
+    {
+        inline __m256 select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); } // mask ? a : b
+        inline __m256 mask_of(__m256i m) { return _mm256_castsi256_ps(m); }
+        inline __m256i bit_set(__m256i h, int bit) { const __m256i b = _mm256_set1_epi32(bit); return _mm256_cmpeq_epi32(_mm256_and_si256(h, b), b); }
+        inline __m256 negate_if(__m256i h, int bit, __m256 x) { return _mm256_xor_ps(x, _mm256_and_ps(mask_of(bit_set(h, bit)), _mm256_set1_ps(-0.0f))); }
+
+        inline __m256i floor_to_int(__m256 x) { return _mm256_cvttps_epi32(_mm256_floor_ps(x)); }
+
+        inline __m256i perm(const NoiseTables & tables, __m256i index)
+        {
+            alignas(32) int32_t lanes[8];
+            _mm256_store_si256((__m256i *) lanes, index);
+            for (int k = 0; k < 8; ++k) lanes[k] = tables.perm[lanes[k]];
+            return _mm256_load_si256((const __m256i *) lanes);
+        }
+
+        // 4th power falloff of a corner; negative kernels contribute nothing, as in the scalar code
+        inline __m256 clamp_kernel(__m256 t) { return _mm256_max_ps(t, _mm256_setzero_ps()); }
+
+        // impl::grad(hash, x, y)
+        inline __m256 grad(__m256i hash, __m256 x, __m256 y)
+        {
+            const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+            const __m256 lt4 = mask_of(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+            const __m256 u = select(lt4, x, y);
+            const __m256 v = select(lt4, y, x);
+            return _mm256_add_ps(negate_if(h, 1, u), negate_if(h, 2, _mm256_mul_ps(_mm256_set1_ps(2.0f), v)));
+        }
+
+        // impl::grad(hash, x, y, z)
+        inline __m256 grad(__m256i hash, __m256 x, __m256 y, __m256 z)
+        {
+            const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+            const __m256 lt8 = mask_of(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+            const __m256 lt4 = mask_of(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+            const __m256 is12or14 = mask_of(_mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(13)), _mm256_set1_epi32(12)));
+            const __m256 u = select(lt8, x, y);
+            const __m256 v = select(lt4, y, select(is12or14, x, z));
+            return _mm256_add_ps(negate_if(h, 1, u), negate_if(h, 2, v));
+        }
+
+        // impl::grad2(hash, ...): the 8 entry table lives in registers
+        inline void grad2(const NoiseTables & tables, __m256i hash, __m256 & gx, __m256 & gy)
+        {
+            const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+            gx = _mm256_permutevar8x32_ps(_mm256_setr_ps(tables.gradient2[0][0], tables.gradient2[1][0], tables.gradient2[2][0], tables.gradient2[3][0], tables.gradient2[4][0], tables.gradient2[5][0], tables.gradient2[6][0], tables.gradient2[7][0]), h);
+            gy = _mm256_permutevar8x32_ps(_mm256_setr_ps(tables.gradient2[0][1], tables.gradient2[1][1], tables.gradient2[2][1], tables.gradient2[3][1], tables.gradient2[4][1], tables.gradient2[5][1], tables.gradient2[6][1], tables.gradient2[7][1]), h);
+        }
+
+        // impl::grad3(hash, ...): two 8 entry halves, picked by bit 3
+        inline __m256 grad3_component(const NoiseTables & tables, __m256i h, __m256 upper, int c)
+        {
+            const __m256 lo = _mm256_setr_ps(tables.gradient3[0][c], tables.gradient3[1][c], tables.gradient3[2][c], tables.gradient3[3][c], tables.gradient3[4][c], tables.gradient3[5][c], tables.gradient3[6][c], tables.gradient3[7][c]);
+            const __m256 hi = _mm256_setr_ps(tables.gradient3[8][c], tables.gradient3[9][c], tables.gradient3[10][c], tables.gradient3[11][c], tables.gradient3[12][c], tables.gradient3[13][c], tables.gradient3[14][c], tables.gradient3[15][c]);
+            return select(upper, _mm256_permutevar8x32_ps(hi, h), _mm256_permutevar8x32_ps(lo, h));
+        }
+
+        inline void grad3(const NoiseTables & tables, __m256i hash, __m256 & gx, __m256 & gy, __m256 & gz)
+        {
+            const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+            const __m256 upper = mask_of(bit_set(h, 8));
+            gx = grad3_component(tables, h, upper, 0);
+            gy = grad3_component(tables, h, upper, 1);
+            gz = grad3_component(tables, h, upper, 2);
+        }
+
+        // Cell lookup shared by the 2D value and derivative kernels
+        struct Simplex2
+        {
+            __m256 x[3], y[3];
+            __m256i hash[3];
+
+            Simplex2(const NoiseTables & tables, __m256 vx, __m256 vy)
+            {
+                const __m256 s = _mm256_mul_ps(_mm256_add_ps(vx, vy), _mm256_set1_ps(F2));
+                const __m256i i = floor_to_int(_mm256_add_ps(vx, s));
+                const __m256i j = floor_to_int(_mm256_add_ps(vy, s));
+
+                const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(i, j)), _mm256_set1_ps(G2));
+                x[0] = _mm256_sub_ps(vx, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+                y[0] = _mm256_sub_ps(vy, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+
+                // x0 > y0 selects the lower triangle (i1 = 1, j1 = 0)
+                const __m256 lower = _mm256_cmp_ps(x[0], y[0], _CMP_GT_OQ);
+                const __m256 one = _mm256_set1_ps(1.0f);
+                const __m256 i1 = _mm256_and_ps(lower, one), j1 = _mm256_andnot_ps(lower, one);
+                x[1] = _mm256_add_ps(_mm256_sub_ps(x[0], i1), _mm256_set1_ps(G2));
+                y[1] = _mm256_add_ps(_mm256_sub_ps(y[0], j1), _mm256_set1_ps(G2));
+                x[2] = _mm256_add_ps(_mm256_sub_ps(x[0], one), _mm256_set1_ps(2.0f * G2));
+                y[2] = _mm256_add_ps(_mm256_sub_ps(y[0], one), _mm256_set1_ps(2.0f * G2));
+
+                const __m256i mask = _mm256_set1_epi32(0xff), ione = _mm256_set1_epi32(1);
+                const __m256i ii = _mm256_and_si256(i, mask), jj = _mm256_and_si256(j, mask);
+                const __m256i ii1 = _mm256_and_si256(_mm256_castps_si256(lower), ione);
+                const __m256i jj1 = _mm256_andnot_si256(_mm256_castps_si256(lower), ione);
+                hash[0] = perm(tables, _mm256_add_epi32(ii, perm(tables, jj)));
+                hash[1] = perm(tables, _mm256_add_epi32(_mm256_add_epi32(ii, ii1), perm(tables, _mm256_add_epi32(jj, jj1))));
+                hash[2] = perm(tables, _mm256_add_epi32(_mm256_add_epi32(ii, ione), perm(tables, _mm256_add_epi32(jj, ione))));
+            }
+
+            __m256 kernel(int c) const
+            {
+                return _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x[c], x[c])), _mm256_mul_ps(y[c], y[c]));
+            }
+        };
+
+        // Cell lookup shared by the 3D value and derivative kernels
+        struct Simplex3
+        {
+            __m256 x[4], y[4], z[4];
+            __m256i hash[4];
+
+            Simplex3(const NoiseTables & tables, __m256 vx, __m256 vy, __m256 vz)
+            {
+                const __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(vx, vy), vz), _mm256_set1_ps(F3));
+                const __m256i i = floor_to_int(_mm256_add_ps(vx, s));
+                const __m256i j = floor_to_int(_mm256_add_ps(vy, s));
+                const __m256i k = floor_to_int(_mm256_add_ps(vz, s));
+
+                const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(i, j), k)), _mm256_set1_ps(G3));
+                x[0] = _mm256_sub_ps(vx, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+                y[0] = _mm256_sub_ps(vy, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+                z[0] = _mm256_sub_ps(vz, _mm256_sub_ps(_mm256_cvtepi32_ps(k), t));
+
+                // The six orderings of the scalar branch ladder, reduced to comparisons
+                const __m256 xy = _mm256_cmp_ps(x[0], y[0], _CMP_GE_OQ);
+                const __m256 yz = _mm256_cmp_ps(y[0], z[0], _CMP_GE_OQ);
+                const __m256 xz = _mm256_cmp_ps(x[0], z[0], _CMP_GE_OQ);
+                const __m256 m_i1 = _mm256_and_ps(xy, xz);
+                const __m256 m_j1 = _mm256_andnot_ps(xy, yz);
+                const __m256 m_k1 = _mm256_andnot_ps(yz, _mm256_andnot_ps(xz, _mm256_castsi256_ps(_mm256_set1_epi32(-1))));
+                const __m256 m_i2 = _mm256_or_ps(xy, xz);
+                const __m256 m_j2 = _mm256_or_ps(_mm256_andnot_ps(xy, _mm256_castsi256_ps(_mm256_set1_epi32(-1))), yz);
+                const __m256 m_k2 = select(xy, _mm256_andnot_ps(yz, _mm256_castsi256_ps(_mm256_set1_epi32(-1))), _mm256_andnot_ps(xz, _mm256_castsi256_ps(_mm256_set1_epi32(-1))));
+
+                const __m256 one = _mm256_set1_ps(1.0f);
+                x[1] = _mm256_add_ps(_mm256_sub_ps(x[0], _mm256_and_ps(m_i1, one)), _mm256_set1_ps(G3));
+                y[1] = _mm256_add_ps(_mm256_sub_ps(y[0], _mm256_and_ps(m_j1, one)), _mm256_set1_ps(G3));
+                z[1] = _mm256_add_ps(_mm256_sub_ps(z[0], _mm256_and_ps(m_k1, one)), _mm256_set1_ps(G3));
+                x[2] = _mm256_add_ps(_mm256_sub_ps(x[0], _mm256_and_ps(m_i2, one)), _mm256_set1_ps(2.0f * G3));
+                y[2] = _mm256_add_ps(_mm256_sub_ps(y[0], _mm256_and_ps(m_j2, one)), _mm256_set1_ps(2.0f * G3));
+                z[2] = _mm256_add_ps(_mm256_sub_ps(z[0], _mm256_and_ps(m_k2, one)), _mm256_set1_ps(2.0f * G3));
+                x[3] = _mm256_add_ps(_mm256_sub_ps(x[0], one), _mm256_set1_ps(3.0f * G3));
+                y[3] = _mm256_add_ps(_mm256_sub_ps(y[0], one), _mm256_set1_ps(3.0f * G3));
+                z[3] = _mm256_add_ps(_mm256_sub_ps(z[0], one), _mm256_set1_ps(3.0f * G3));
+
+                const __m256i mask = _mm256_set1_epi32(0xff), ione = _mm256_set1_epi32(1);
+                const __m256i ii = _mm256_and_si256(i, mask), jj = _mm256_and_si256(j, mask), kk = _mm256_and_si256(k, mask);
+                auto offset = [&](__m256 m) { return _mm256_and_si256(_mm256_castps_si256(m), ione); };
+                auto corner = [&](__m256i di, __m256i dj, __m256i dk)
+                {
+                    return perm(tables, _mm256_add_epi32(_mm256_add_epi32(ii, di), perm(tables, _mm256_add_epi32(_mm256_add_epi32(jj, dj), perm(tables, _mm256_add_epi32(kk, dk))))));
+                };
+                const __m256i zero = _mm256_setzero_si256();
+                hash[0] = corner(zero, zero, zero);
+                hash[1] = corner(offset(m_i1), offset(m_j1), offset(m_k1));
+                hash[2] = corner(offset(m_i2), offset(m_j2), offset(m_k2));
+                hash[3] = corner(ione, ione, ione);
+            }
+
+            __m256 kernel(int c) const
+            {
+                return _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.6f), _mm256_mul_ps(x[c], x[c])), _mm256_mul_ps(y[c], y[c])), _mm256_mul_ps(z[c], z[c]));
+            }
+        };
+
+        inline __m256 noise(const NoiseTables & tables, __m256 vx, __m256 vy)
+        {
+            const Simplex2 s(tables, vx, vy);
+            __m256 sum = _mm256_setzero_ps();
+            for (int c = 0; c < 3; ++c)
+            {
+                __m256 t = clamp_kernel(s.kernel(c));
+                t = _mm256_mul_ps(t, t);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(t, t), grad(s.hash[c], s.x[c], s.y[c])));
+            }
+            return _mm256_mul_ps(_mm256_set1_ps(40.0f), sum);
+        }
+
+        inline __m256 noise(const NoiseTables & tables, __m256 vx, __m256 vy, __m256 vz)
+        {
+            const Simplex3 s(tables, vx, vy, vz);
+            __m256 sum = _mm256_setzero_ps();
+            for (int c = 0; c < 4; ++c)
+            {
+                __m256 t = clamp_kernel(s.kernel(c));
+                t = _mm256_mul_ps(t, t);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(t, t), grad(s.hash[c], s.x[c], s.y[c], s.z[c])));
+            }
+            return _mm256_mul_ps(_mm256_set1_ps(32.0f), sum);
+        }
+
+        inline void noise_deriv(const NoiseTables & tables, __m256 vx, __m256 vy, __m256 & n, __m256 & dx, __m256 & dy)
+        {
+            const Simplex2 s(tables, vx, vy);
+            __m256 sum = _mm256_setzero_ps(), ddx = _mm256_setzero_ps(), ddy = _mm256_setzero_ps();
+            __m256 gsumx = _mm256_setzero_ps(), gsumy = _mm256_setzero_ps();
+            for (int c = 0; c < 3; ++c)
+            {
+                __m256 gx, gy;
+                grad2(tables, s.hash[c], gx, gy);
+                const __m256 t = clamp_kernel(s.kernel(c));
+                const __m256 t2 = _mm256_mul_ps(t, t);
+                const __m256 t4 = _mm256_mul_ps(t2, t2);
+                const __m256 gdot = _mm256_add_ps(_mm256_mul_ps(gx, s.x[c]), _mm256_mul_ps(gy, s.y[c]));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(t4, gdot));
+                const __m256 temp = _mm256_mul_ps(_mm256_mul_ps(t2, t), gdot);
+                ddx = _mm256_add_ps(ddx, _mm256_mul_ps(temp, s.x[c]));
+                ddy = _mm256_add_ps(ddy, _mm256_mul_ps(temp, s.y[c]));
+                gsumx = _mm256_add_ps(gsumx, _mm256_mul_ps(t4, gx));
+                gsumy = _mm256_add_ps(gsumy, _mm256_mul_ps(t4, gy));
+            }
+            const __m256 scale = _mm256_set1_ps(40.0f), minus8 = _mm256_set1_ps(-8.0f);
+            dx = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ddx, minus8), gsumx), scale);
+            dy = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ddy, minus8), gsumy), scale);
+#ifdef SIMPLEX_DERIVATIVES_RESCALE
+            n = _mm256_mul_ps(_mm256_set1_ps(70.175438596f), sum);
+#else
+            n = _mm256_mul_ps(scale, sum);
+#endif
+        }
+
+        inline void noise_deriv(const NoiseTables & tables, __m256 vx, __m256 vy, __m256 vz, __m256 & n, __m256 & dx, __m256 & dy, __m256 & dz)
+        {
+            const Simplex3 s(tables, vx, vy, vz);
+            __m256 sum = _mm256_setzero_ps(), ddx = _mm256_setzero_ps(), ddy = _mm256_setzero_ps(), ddz = _mm256_setzero_ps();
+            __m256 gsumx = _mm256_setzero_ps(), gsumy = _mm256_setzero_ps(), gsumz = _mm256_setzero_ps();
+            for (int c = 0; c < 4; ++c)
+            {
+                __m256 gx, gy, gz;
+                grad3(tables, s.hash[c], gx, gy, gz);
+                const __m256 t = clamp_kernel(s.kernel(c));
+                const __m256 t2 = _mm256_mul_ps(t, t);
+                const __m256 t4 = _mm256_mul_ps(t2, t2);
+                const __m256 gdot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, s.x[c]), _mm256_mul_ps(gy, s.y[c])), _mm256_mul_ps(gz, s.z[c]));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(t4, gdot));
+                const __m256 temp = _mm256_mul_ps(_mm256_mul_ps(t2, t), gdot);
+                ddx = _mm256_add_ps(ddx, _mm256_mul_ps(temp, s.x[c]));
+                ddy = _mm256_add_ps(ddy, _mm256_mul_ps(temp, s.y[c]));
+                ddz = _mm256_add_ps(ddz, _mm256_mul_ps(temp, s.z[c]));
+                gsumx = _mm256_add_ps(gsumx, _mm256_mul_ps(t4, gx));
+                gsumy = _mm256_add_ps(gsumy, _mm256_mul_ps(t4, gy));
+                gsumz = _mm256_add_ps(gsumz, _mm256_mul_ps(t4, gz));
+            }
+            const __m256 scale = _mm256_set1_ps(28.0f), minus8 = _mm256_set1_ps(-8.0f);
+            dx = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ddx, minus8), gsumx), scale);
+            dy = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ddy, minus8), gsumy), scale);
+            dz = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ddz, minus8), gsumz), scale);
+#ifdef SIMPLEX_DERIVATIVES_RESCALE
+            n = _mm256_mul_ps(_mm256_set1_ps(34.525277436f), sum);
+#else
+            n = _mm256_mul_ps(scale, sum);
+#endif
+        }
+
+        // Runs fn(first) for every full block of eight points, then once more on a zero padded copy of the
+        // remainder. `in` and `out` list the coordinate and result arrays; fn reads and writes through them.
+        template<int NumIn, int NumOut, typename Fn>
+        inline void for_each_block(const float * const (&in)[NumIn], float * const (&out)[NumOut], size_t count, Fn && fn)
+        {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 vin[NumIn], vout[NumOut];
+                for (int c = 0; c < NumIn; ++c) vin[c] = _mm256_loadu_ps(in[c] + i);
+                fn(vin, vout);
+                for (int c = 0; c < NumOut; ++c) _mm256_storeu_ps(out[c] + i, vout[c]);
+            }
+            if (i < count)
+            {
+                alignas(32) float pad[8];
+                __m256 vin[NumIn], vout[NumOut];
+                for (int c = 0; c < NumIn; ++c)
+                {
+                    std::fill(pad, pad + 8, 0.0f);
+                    std::copy(in[c] + i, in[c] + count, pad);
+                    vin[c] = _mm256_load_ps(pad);
+                }
+                fn(vin, vout);
+                for (int c = 0; c < NumOut; ++c)
+                {
+                    _mm256_store_ps(pad, vout[c]);
+                    std::copy(pad, pad + (count - i), out[c] + i);
+                }
+            }
+        }
+    }
+}
+
+inline void NoiseGenerator::noise_batch(const float * x, const float * y, float * out, size_t count) const
+{
+    impl::simd::for_each_block<2, 1>({ x, y }, { out }, count, [&](const __m256 * in, __m256 * res)
+    {
+        res[0] = impl::simd::noise(tables, in[0], in[1]);
+    });
+}
+
+inline void NoiseGenerator::noise_batch(const float * x, const float * y, const float * z, float * out, size_t count) const
+{
+    impl::simd::for_each_block<3, 1>({ x, y, z }, { out }, count, [&](const __m256 * in, __m256 * res)
+    {
+        res[0] = impl::simd::noise(tables, in[0], in[1], in[2]);
+    });
+}
+
+inline void NoiseGenerator::noise_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count) const
+{
+    impl::simd::for_each_block<2, 3>({ x, y }, { out, dx, dy }, count, [&](const __m256 * in, __m256 * res)
+    {
+        impl::simd::noise_deriv(tables, in[0], in[1], res[0], res[1], res[2]);
+    });
+}
+
+inline void NoiseGenerator::noise_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count) const
+{
+    impl::simd::for_each_block<3, 4>({ x, y, z }, { out, dx, dy, dz }, count, [&](const __m256 * in, __m256 * res)
+    {
+        impl::simd::noise_deriv(tables, in[0], in[1], in[2], res[0], res[1], res[2], res[3]);
+    });
+}
+
+inline void NoiseGenerator::noise_fb_batch(const float * x, const float * y, float * out, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    impl::simd::for_each_block<2, 1>({ x, y }, { out }, count, [&](const __m256 * in, __m256 * res)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        float freq = 1.0f, amp = 0.5f;
+        for (uint8_t i = 0; i < octaves; i++)
+        {
+            const __m256 f = _mm256_set1_ps(freq);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(impl::simd::noise(tables, _mm256_mul_ps(in[0], f), _mm256_mul_ps(in[1], f)), _mm256_set1_ps(amp)));
+            freq *= lacunarity;
+            amp *= gain;
+        }
+        res[0] = sum;
+    });
+}
+
+inline void NoiseGenerator::noise_fb_batch(const float * x, const float * y, const float * z, float * out, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    impl::simd::for_each_block<3, 1>({ x, y, z }, { out }, count, [&](const __m256 * in, __m256 * res)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        float freq = 1.0f, amp = 0.5f;
+        for (uint8_t i = 0; i < octaves; i++)
+        {
+            const __m256 f = _mm256_set1_ps(freq);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(impl::simd::noise(tables, _mm256_mul_ps(in[0], f), _mm256_mul_ps(in[1], f), _mm256_mul_ps(in[2], f)), _mm256_set1_ps(amp)));
+            freq *= lacunarity;
+            amp *= gain;
+        }
+        res[0] = sum;
+    });
+}
+
+inline void NoiseGenerator::noise_fb_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    impl::simd::for_each_block<2, 3>({ x, y }, { out, dx, dy }, count, [&](const __m256 * in, __m256 * res)
+    {
+        for (int c = 0; c < 3; ++c) res[c] = _mm256_setzero_ps();
+        float freq = 1.0f, amp = 0.5f;
+        for (uint8_t i = 0; i < octaves; i++)
+        {
+            const __m256 f = _mm256_set1_ps(freq), a = _mm256_set1_ps(amp);
+            __m256 n[3];
+            impl::simd::noise_deriv(tables, _mm256_mul_ps(in[0], f), _mm256_mul_ps(in[1], f), n[0], n[1], n[2]);
+            for (int c = 0; c < 3; ++c) res[c] = _mm256_add_ps(res[c], _mm256_mul_ps(n[c], a));
+            freq *= lacunarity;
+            amp *= gain;
+        }
+    });
+}
+
+inline void NoiseGenerator::noise_fb_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    impl::simd::for_each_block<3, 4>({ x, y, z }, { out, dx, dy, dz }, count, [&](const __m256 * in, __m256 * res)
+    {
+        for (int c = 0; c < 4; ++c) res[c] = _mm256_setzero_ps();
+        float freq = 1.0f, amp = 0.5f;
+        for (uint8_t i = 0; i < octaves; i++)
+        {
+            const __m256 f = _mm256_set1_ps(freq), a = _mm256_set1_ps(amp);
+            __m256 n[4];
+            impl::simd::noise_deriv(tables, _mm256_mul_ps(in[0], f), _mm256_mul_ps(in[1], f), _mm256_mul_ps(in[2], f), n[0], n[1], n[2], n[3]);
+            for (int c = 0; c < 4; ++c) res[c] = _mm256_add_ps(res[c], _mm256_mul_ps(n[c], a));
+            freq *= lacunarity;
+            amp *= gain;
+        }
+    });
+}
+
+#else
+
+inline void NoiseGenerator::noise_batch(const float * x, const float * y, float * out, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i) out[i] = noise(float2(x[i], y[i]));
+}
+
+inline void NoiseGenerator::noise_batch(const float * x, const float * y, const float * z, float * out, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i) out[i] = noise(float3(x[i], y[i], z[i]));
+}
+
+inline void NoiseGenerator::noise_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float3 n = noise_deriv(float2(x[i], y[i]));
+        out[i] = n.x; dx[i] = n.y; dy[i] = n.z;
+    }
+}
+
+inline void NoiseGenerator::noise_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float4 n = noise_deriv(float3(x[i], y[i], z[i]));
+        out[i] = n.x; dx[i] = n.y; dy[i] = n.z; dz[i] = n.w;
+    }
+}
+
+inline void NoiseGenerator::noise_fb_batch(const float * x, const float * y, float * out, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    for (size_t i = 0; i < count; ++i) out[i] = noise_fb(float2(x[i], y[i]), octaves, lacunarity, gain);
+}
+
+inline void NoiseGenerator::noise_fb_batch(const float * x, const float * y, const float * z, float * out, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    for (size_t i = 0; i < count; ++i) out[i] = noise_fb(float3(x[i], y[i], z[i]), octaves, lacunarity, gain);
+}
+
+inline void NoiseGenerator::noise_fb_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float3 n = noise_fb_deriv(float2(x[i], y[i]), octaves, lacunarity, gain);
+        out[i] = n.x; dx[i] = n.y; dy[i] = n.z;
+    }
+}
+
+inline void NoiseGenerator::noise_fb_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count, uint8_t octaves, float lacunarity, float gain) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float4 n = noise_fb_deriv(float3(x[i], y[i], z[i]), octaves, lacunarity, gain);
+        out[i] = n.x; dx[i] = n.y; dy[i] = n.z; dz[i] = n.w;
+    }
+}
+
+#endif
+
+/////////////////////////////////////////////////
+//   Free Functions On The Default Generator   //
+/////////////////////////////////////////////////
+
+inline float noise(float x) { return default_generator().noise(x); }
+inline float noise(const float2 & v) { return default_generator().noise(v); }
+inline float noise(const float3 & v) { return default_generator().noise(v); }
+inline float noise(const float4 & v) { return default_generator().noise(v); }
+inline float noise_ridged(float x) { return default_generator().noise_ridged(x); }
+inline float noise_ridged(const float2 & v) { return default_generator().noise_ridged(v); }
+inline float noise_ridged(const float3 & v) { return default_generator().noise_ridged(v); }
+inline float noise_ridged(const float4 & v) { return default_generator().noise_ridged(v); }
+inline float2 noise_deriv(float x) { return default_generator().noise_deriv(x); }
+inline float3 noise_deriv(const float2 & v) { return default_generator().noise_deriv(v); }
+inline float4 noise_deriv(const float3 & v) { return default_generator().noise_deriv(v); }
+inline std::array<float,5> noise_deriv(const float4 & v) { return default_generator().noise_deriv(v); }
+inline float noise_worley(const float2 & v) { return default_generator().noise_worley(v); }
+inline float noise_worley(const float3 & v) { return default_generator().noise_worley(v); }
+inline float noise_worley(const float2 & v, float falloff) { return default_generator().noise_worley(v, falloff); }
+inline float noise_worley(const float3 & v, float falloff) { return default_generator().noise_worley(v, falloff); }
+inline float noise_flow(const float2 & v, float angle) { return default_generator().noise_flow(v, angle); }
+inline float noise_flow(const float3 & v, float angle) { return default_generator().noise_flow(v, angle); }
+inline float3 noise_flow_deriv(const float2 & v, float angle) { return default_generator().noise_flow_deriv(v, angle); }
+inline float4 noise_flow_deriv(const float3 & v, float angle) { return default_generator().noise_flow_deriv(v, angle); }
+inline float2 noise_curl(const float2 & v) { return default_generator().noise_curl(v); }
+inline float2 noise_curl(const float2 & v, float t) { return default_generator().noise_curl(v, t); }
+inline float2 noise_curl(const float2 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_curl(v, octaves, lacunarity, gain); }
+inline float3 noise_curl(const float3 & v) { return default_generator().noise_curl(v); }
+inline float3 noise_curl(const float3 & v, float t) { return default_generator().noise_curl(v, t); }
+inline float3 noise_curl(const float3 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_curl(v, octaves, lacunarity, gain); }
+inline float noise_fb(float x, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb(x, octaves, lacunarity, gain); }
+inline float noise_fb(const float2 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb(v, octaves, lacunarity, gain); }
+inline float noise_fb(const float3 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb(v, octaves, lacunarity, gain); }
+inline float noise_fb(const float4 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb(v, octaves, lacunarity, gain); }
+inline float2 noise_fb_deriv(float x, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb_deriv(x, octaves, lacunarity, gain); }
+inline float3 noise_fb_deriv(const float2 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb_deriv(v, octaves, lacunarity, gain); }
+inline float4 noise_fb_deriv(const float3 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb_deriv(v, octaves, lacunarity, gain); }
+inline std::array<float,5> noise_fb_deriv(const float4 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_fb_deriv(v, octaves, lacunarity, gain); }
+inline float noise_ridged_mf(float x, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_ridged_mf(x, ridgeOffset, octaves, lacunarity, gain); }
+inline float noise_ridged_mf(const float2 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_ridged_mf(v, ridgeOffset, octaves, lacunarity, gain); }
+inline float noise_ridged_mf(const float3 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_ridged_mf(v, ridgeOffset, octaves, lacunarity, gain); }
+inline float noise_ridged_mf(const float4 & v, float ridgeOffset, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_ridged_mf(v, ridgeOffset, octaves, lacunarity, gain); }
+inline float noise_iq_fb(const float2 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_iq_fb(v, octaves, lacunarity, gain); }
+inline float noise_iq_fb(const float3 & v, uint8_t octaves, float lacunarity, float gain) { return default_generator().noise_iq_fb(v, octaves, lacunarity, gain); }
+inline float noise_iq_fb(const float2 & v, uint8_t octaves, const float2x2 & mat, float gain) { return default_generator().noise_iq_fb(v, octaves, mat, gain); }
+inline void noise_batch(const float * x, const float * y, float * out, size_t count) { default_generator().noise_batch(x, y, out, count); }
+inline void noise_batch(const float * x, const float * y, const float * z, float * out, size_t count) { default_generator().noise_batch(x, y, z, out, count); }
+inline void noise_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count) { default_generator().noise_deriv_batch(x, y, out, dx, dy, count); }
+inline void noise_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count) { default_generator().noise_deriv_batch(x, y, z, out, dx, dy, dz, count); }
+inline void noise_fb_batch(const float * x, const float * y, float * out, size_t count, uint8_t octaves, float lacunarity, float gain) { default_generator().noise_fb_batch(x, y, out, count, octaves, lacunarity, gain); }
+inline void noise_fb_batch(const float * x, const float * y, const float * z, float * out, size_t count, uint8_t octaves, float lacunarity, float gain) { default_generator().noise_fb_batch(x, y, z, out, count, octaves, lacunarity, gain); }
+inline void noise_fb_deriv_batch(const float * x, const float * y, float * out, float * dx, float * dy, size_t count, uint8_t octaves, float lacunarity, float gain) { default_generator().noise_fb_deriv_batch(x, y, out, dx, dy, count, octaves, lacunarity, gain); }
+inline void noise_fb_deriv_batch(const float * x, const float * y, const float * z, float * out, float * dx, float * dy, float * dz, size_t count, uint8_t octaves, float lacunarity, float gain) { default_generator().noise_fb_deriv_batch(x, y, z, out, dx, dy, dz, count, octaves, lacunarity, gain); }
+
 } // end namespace noise
 
 #pragma warning(pop)
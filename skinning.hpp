@@ -0,0 +1,318 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef skinning_hpp
+#define skinning_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "animation_clip.hpp"
+#include "parallel_for.hpp"
+#include "../lib-model-io/model-io.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// CPU skinning for runtime_skinned_mesh. A pose (AnimationPose: rotation, translation and scale streams of
+// local bone transforms) is blended, composed down the hierarchy into model space, multiplied by the
+// inverse bind pose into a matrix palette, and applied to the mesh with linear blend skinning: each vertex is
+// transformed by the weighted sum of its (up to) four bones' palette matrices.
+//
+// bone::bindPose is taken as the bone's model-space transform when the mesh was bound, and bone::initialPose
+// as its local rest transform. A bone whose parentIndex is its own index or not a bone index is a root.
+//
+// Skinning handles two vertices per AVX register when compiled with AVX2, one 128-bit half each, and has a
+// scalar path otherwise; the scalar path is the reference the SIMD one is tested against. Many instances of
+// a mesh are skinned in parallel (skin_instances), split by instance and by ranges of vertices.
+
+namespace avl
+{
+    struct SkinningRig
+    {
+        std::vector<uint32_t> parents;          // per bone, as in the mesh
+        std::vector<uint32_t> order;            // every bone after its parent
+        std::vector<float4x4> inverseBindPose;
+        AnimationPose restPose;                 // from bone::initialPose
+
+        size_t bone_count() const { return parents.size(); }
+        bool is_root(uint32_t b) const { return parents[b] >= parents.size() || parents[b] == b; }
+    };
+
+    // Matrices and skinned streams for one instance
+    struct SkinnedVertices
+    {
+        std::vector<float4x4> palette;          // model transform times inverse bind pose, per bone
+        std::vector<float3> positions;
+        std::vector<float3> normals;            // only when the mesh has normals
+    };
+
+    namespace impl
+    {
+        // Both transforms are affine: the last row is (0, 0, 0, 1) and is neither read nor computed
+        inline float4x4 mul_affine(const float4x4 & a, const float4x4 & b)
+        {
+            const float3 ax = a.x.xyz(), ay = a.y.xyz(), az = a.z.xyz(), aw = a.w.xyz();
+            return { { ax * b.x.x + ay * b.x.y + az * b.x.z, 0 },
+                     { ax * b.y.x + ay * b.y.y + az * b.y.z, 0 },
+                     { ax * b.z.x + ay * b.z.y + az * b.z.z, 0 },
+                     { ax * b.w.x + ay * b.w.y + az * b.w.z + aw, 1 } };
+        }
+
+        inline float4x4 compose_transform(const float4 & q, const float3 & t, const float3 & s)
+        {
+            const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+            const float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2, xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+            const float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+            return { { (1 - (yy + zz)) * s.x, (xy + wz) * s.x, (xz - wy) * s.x, 0 },
+                     { (xy - wz) * s.y, (1 - (xx + zz)) * s.y, (yz + wx) * s.y, 0 },
+                     { (xz + wy) * s.z, (yz - wx) * s.z, (1 - (xx + yy)) * s.z, 0 },
+                     { t, 1 } };
+        }
+
+        // Influences with a bone index outside the palette (often -1 beside a zero weight) read bone 0
+        inline uint32_t influence_bone(int index, size_t boneCount)
+        {
+            return uint32_t(index) < boneCount ? uint32_t(index) : 0u;
+        }
+    }
+
+    inline SkinningRig make_skinning_rig(const std::vector<bone> & bones)
+    {
+        SkinningRig rig;
+        const uint32_t n = uint32_t(bones.size());
+        for (const auto & b : bones)
+        {
+            rig.parents.push_back(b.parentIndex);
+            rig.inverseBindPose.push_back(inverse(b.bindPose));
+        }
+
+        // Depth-first from the roots, so the order holds for bones listed before their parents
+        std::vector<std::vector<uint32_t>> children(n);
+        std::vector<uint32_t> stack;
+        for (uint32_t b = 0; b < n; ++b)
+        {
+            if (rig.is_root(b)) stack.push_back(b);
+            else children[rig.parents[b]].push_back(b);
+        }
+        std::reverse(stack.begin(), stack.end());
+        while (!stack.empty())
+        {
+            const uint32_t b = stack.back();
+            stack.pop_back();
+            rig.order.push_back(b);
+            for (auto c = children[b].rbegin(); c != children[b].rend(); ++c) stack.push_back(*c);
+        }
+        if (rig.order.size() != n) throw std::runtime_error("bone hierarchy has a cycle");
+
+        rig.restPose.resize(n);
+        for (uint32_t b = 0; b < n; ++b)
+        {
+            const float4x4 & m = bones[b].initialPose;
+            const float3 s(length(m.x.xyz()), length(m.y.xyz()), length(m.z.xyz()));
+            rig.restPose.translations[b] = m.w.xyz();
+            rig.restPose.scales[b] = s;
+            rig.restPose.rotations[b] = normalize(rotation_quat(float3x3(m.x.xyz() / s.x, m.y.xyz() / s.y, m.z.xyz() / s.z)));
+        }
+        return rig;
+    }
+
+    //////////////////////
+    //   Pose blending  //
+    //////////////////////
+
+    // weight 0 is a, 1 is b; rotations are normalized-lerped along the shorter arc
+    inline void blend_poses(const AnimationPose & a, const AnimationPose & b, float weight, AnimationPose & out)
+    {
+        const size_t n = a.rotations.size();
+        out.resize(n);
+        for (size_t i = 0; i < n; ++i) out.rotations[i] = impl::nlerp_rotation(a.rotations[i], b.rotations[i], weight);
+        for (size_t i = 0; i < n; ++i) out.translations[i] = lerp(a.translations[i], b.translations[i], weight);
+        for (size_t i = 0; i < n; ++i) out.scales[i] = lerp(a.scales[i], b.scales[i], weight);
+    }
+
+    // The difference that takes reference to pose, for apply_additive_pose
+    inline void make_additive_pose(const AnimationPose & pose, const AnimationPose & reference, AnimationPose & difference)
+    {
+        const size_t n = pose.rotations.size();
+        difference.resize(n);
+        for (size_t i = 0; i < n; ++i) difference.rotations[i] = qmul(qconj(reference.rotations[i]), pose.rotations[i]);
+        for (size_t i = 0; i < n; ++i) difference.translations[i] = pose.translations[i] - reference.translations[i];
+        for (size_t i = 0; i < n; ++i) difference.scales[i] = pose.scales[i] / reference.scales[i];
+    }
+
+    // Layers a weighted difference on a base pose: rotations in bone space, translations added, scales multiplied
+    inline void apply_additive_pose(const AnimationPose & base, const AnimationPose & difference, float weight, AnimationPose & out)
+    {
+        const size_t n = base.rotations.size();
+        out.resize(n);
+        const float4 identity(0, 0, 0, 1);
+        for (size_t i = 0; i < n; ++i) out.rotations[i] = qmul(base.rotations[i], impl::nlerp_rotation(identity, difference.rotations[i], weight));
+        for (size_t i = 0; i < n; ++i) out.translations[i] = base.translations[i] + difference.translations[i] * weight;
+        for (size_t i = 0; i < n; ++i) out.scales[i] = base.scales[i] * lerp(float3(1, 1, 1), difference.scales[i], weight);
+    }
+
+    ////////////////////////////////
+    //   Hierarchy and palettes   //
+    ////////////////////////////////
+
+    // Model-space transforms: every bone's local transform from the pose streams, then parents applied in rig order
+    inline void local_to_model(const SkinningRig & rig, const AnimationPose & pose, float4x4 * model)
+    {
+        const size_t n = rig.bone_count();
+        for (size_t b = 0; b < n; ++b) model[b] = impl::compose_transform(pose.rotations[b], pose.translations[b], pose.scales[b]);
+        for (uint32_t b : rig.order) if (!rig.is_root(b)) model[b] = impl::mul_affine(model[rig.parents[b]], model[b]);
+    }
+
+    // In place: model transforms in, skinning matrices out
+    inline void make_skinning_palette(const SkinningRig & rig, float4x4 * transforms)
+    {
+        for (size_t b = 0; b < rig.bone_count(); ++b) transforms[b] = impl::mul_affine(transforms[b], rig.inverseBindPose[b]);
+    }
+
+    inline void make_skinning_palette(const SkinningRig & rig, const AnimationPose & pose, std::vector<float4x4> & palette)
+    {
+        palette.resize(rig.bone_count());
+        local_to_model(rig, pose, palette.data());
+        make_skinning_palette(rig, palette.data());
+    }
+
+    //////////////////
+    //   Skinning   //
+    //////////////////
+
+    // Vertices [first, first + count). Normals are optional (null), transformed by the blended matrix and renormalized.
+    inline void skin_vertices_scalar(const runtime_skinned_mesh & mesh, const float4x4 * palette, size_t boneCount, float3 * positions, float3 * normals, size_t first, size_t count)
+    {
+        for (size_t v = first; v < first + count; ++v)
+        {
+            const int4 & index = mesh.boneIndices[v];
+            const float4 & weight = mesh.boneWeights[v];
+            float3 c[4];
+            for (int k = 0; k < 4; ++k) c[k] = float3(0, 0, 0);
+            for (int i = 0; i < 4; ++i)
+            {
+                const float4x4 & m = palette[impl::influence_bone(index[i], boneCount)];
+                for (int k = 0; k < 4; ++k) c[k] += m[k].xyz() * weight[i];
+            }
+            const float3 & p = mesh.vertices[v];
+            positions[v] = c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3];
+            if (normals)
+            {
+                const float3 & n = mesh.normals[v];
+                const float3 r = c[0] * n.x + c[1] * n.y + c[2] * n.z;
+                normals[v] = r / std::sqrt(dot(r, r));
+            }
+        }
+    }
+
+#if defined(__AVX2__)
+
+    namespace impl
+    {
+        inline __m256 load_pair(const float * a, const float * b)
+        {
+            return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+        }
+
+        inline __m256 broadcast_pair(float a, float b)
+        {
+            return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)), _mm_set1_ps(b), 1);
+        }
+
+        inline void store_float3(float3 & out, __m128 v)
+        {
+            _mm_storel_pi(reinterpret_cast<__m64 *>(&out.x), v);
+            _mm_store_ss(&out.z, _mm_movehl_ps(v, v));
+        }
+
+        // Two vertices, one per 128-bit half: the blended matrix's columns, then the transformed position and normal
+        inline void skin_vertex_pair(const runtime_skinned_mesh & mesh, const float4x4 * palette, size_t boneCount, size_t v0, size_t v1, float3 * positions, float3 * normals)
+        {
+            const int4 & i0 = mesh.boneIndices[v0], & i1 = mesh.boneIndices[v1];
+            const float4 & w0 = mesh.boneWeights[v0], & w1 = mesh.boneWeights[v1];
+
+            __m256 c[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                const float * m0 = &palette[influence_bone(i0[i], boneCount)].x.x;
+                const float * m1 = &palette[influence_bone(i1[i], boneCount)].x.x;
+                const __m256 w = broadcast_pair(w0[i], w1[i]);
+                for (int k = 0; k < 4; ++k)
+                {
+                    const __m256 column = _mm256_mul_ps(load_pair(m0 + k * 4, m1 + k * 4), w);
+                    c[k] = i ? _mm256_add_ps(c[k], column) : column;
+                }
+            }
+
+            const float3 & p0 = mesh.vertices[v0], & p1 = mesh.vertices[v1];
+            __m256 p = _mm256_add_ps(_mm256_mul_ps(c[0], broadcast_pair(p0.x, p1.x)), _mm256_mul_ps(c[1], broadcast_pair(p0.y, p1.y)));
+            p = _mm256_add_ps(_mm256_add_ps(p, _mm256_mul_ps(c[2], broadcast_pair(p0.z, p1.z))), c[3]);
+            store_float3(positions[v0], _mm256_castps256_ps128(p));
+            store_float3(positions[v1], _mm256_extractf128_ps(p, 1));
+
+            if (normals)
+            {
+                const float3 & n0 = mesh.normals[v0], & n1 = mesh.normals[v1];
+                __m256 n = _mm256_add_ps(_mm256_mul_ps(c[0], broadcast_pair(n0.x, n1.x)), _mm256_mul_ps(c[1], broadcast_pair(n0.y, n1.y)));
+                n = _mm256_add_ps(n, _mm256_mul_ps(c[2], broadcast_pair(n0.z, n1.z)));
+                n = _mm256_div_ps(n, _mm256_sqrt_ps(_mm256_dp_ps(n, n, 0x7f)));
+                store_float3(normals[v0], _mm256_castps256_ps128(n));
+                store_float3(normals[v1], _mm256_extractf128_ps(n, 1));
+            }
+        }
+    }
+
+#endif
+
+    inline void skin_vertices(const runtime_skinned_mesh & mesh, const float4x4 * palette, size_t boneCount, float3 * positions, float3 * normals, size_t first, size_t count)
+    {
+        if (mesh.normals.size() < mesh.vertices.size()) normals = nullptr;
+#if defined(__AVX2__)
+        size_t v = first;
+        for (; v + 2 <= first + count; v += 2) impl::skin_vertex_pair(mesh, palette, boneCount, v, v + 1, positions, normals);
+        if (v < first + count) impl::skin_vertex_pair(mesh, palette, boneCount, v, v, positions, normals);
+#else
+        skin_vertices_scalar(mesh, palette, boneCount, positions, normals, first, count);
+#endif
+    }
+
+    // Every vertex of the mesh into out's streams, which are sized to fit
+    inline void skin_vertices(const runtime_skinned_mesh & mesh, const std::vector<float4x4> & palette, SkinnedVertices & out)
+    {
+        out.positions.resize(mesh.vertices.size());
+        out.normals.resize(mesh.normals.size() < mesh.vertices.size() ? 0 : mesh.vertices.size());
+        skin_vertices(mesh, palette.data(), palette.size(), out.positions.data(), out.normals.empty() ? nullptr : out.normals.data(), 0, mesh.vertices.size());
+    }
+
+    // Palettes and skinned streams for many posed instances of one mesh. Palettes are built in parallel across
+    // instances, then vertices in parallel across instances and ranges of vertices.
+    inline void skin_instances(const SkinningRig & rig, const runtime_skinned_mesh & mesh, const AnimationPose * poses, size_t instanceCount, SkinnedVertices * out, uint32_t numThreads = 0)
+    {
+        const size_t vertexCount = mesh.vertices.size(), rangeSize = 4096;
+        const size_t ranges = (vertexCount + rangeSize - 1) / rangeSize;
+        const bool withNormals = mesh.normals.size() >= vertexCount;
+
+        parallel_for(0, instanceCount, [&](size_t i)
+        {
+            make_skinning_palette(rig, poses[i], out[i].palette);
+            out[i].positions.resize(vertexCount);
+            out[i].normals.resize(withNormals ? vertexCount : 0);
+        }, numThreads);
+
+        parallel_for(0, instanceCount * ranges, [&](size_t job)
+        {
+            SkinnedVertices & o = out[job / ranges];
+            const size_t first = (job % ranges) * rangeSize;
+            skin_vertices(mesh, o.palette.data(), o.palette.size(), o.positions.data(), withNormals ? o.normals.data() : nullptr, first, std::min(rangeSize, vertexCount - first));
+        }, numThreads);
+    }
+}
+
+#endif // end skinning_hpp
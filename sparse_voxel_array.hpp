@@ -0,0 +1,259 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef sparse_voxel_array_hpp
+#define sparse_voxel_array_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// A sparse stand-in for VoxelArray<T>. Voxels are grouped into 8^3 bricks, and only bricks that have been
+// written hold storage, which comes from a pool of fixed-size blocks with a free list. Brick entries live
+// in a two-level paged table: a dense directory of pages, each covering 16^3 bricks (128^3 voxels) and
+// allocated the first time one of its bricks is touched, so lookup is two array indexings with no
+// hashing. A brick is either background (never written), constant (one value, no storage) or allocated.
+// optimize() collapses uniform allocated bricks back into constants, which is how mostly-empty or
+// mostly-solid fields stay small after being written densely.
+
+namespace avl
+{
+    template<typename T>
+    class SparseVoxelArray
+    {
+    public:
+
+        static const int brickLog2 = 3;
+        static const int brickSize = 1 << brickLog2;                // voxels along a brick edge
+        static const int brickVoxels = brickSize * brickSize * brickSize;
+
+        // A non-background brick; voxels is null for constant bricks, otherwise brickVoxels values, x fastest
+        struct BrickView
+        {
+            int3 origin;        // voxel coordinates of the brick's min corner
+            const T * voxels;
+            T value;            // the constant of a constant brick
+        };
+
+    private:
+
+        static const int pageLog2 = 4;
+        static const int pageSize = 1 << pageLog2;                  // bricks along a page edge
+        static const int pageBricks = pageSize * pageSize * pageSize;
+        static const int blockBricks = 64;                          // bricks per pool allocation
+
+        static const uint32_t backgroundBrick = 0xffffffffu;
+        static const uint32_t constantFlag = 0x80000000u;           // low bits index `constants`
+
+        int3 size, pageCount;
+        T background;
+        std::vector<std::unique_ptr<uint32_t[]>> pages;             // brick entries, null until touched
+        std::vector<std::unique_ptr<T[]>> blocks;                   // pool storage
+        std::vector<uint32_t> freeSlots;
+        uint32_t slotCount = 0;
+        std::vector<T> constants;
+        std::vector<uint32_t> freeConstants;
+
+        static int brick_index(const int3 & local) { return (local.z * pageSize + local.y) * pageSize + local.x; }
+        static int voxel_index(const int3 & c) { return ((c.z & (brickSize - 1)) * brickSize + (c.y & (brickSize - 1))) * brickSize + (c.x & (brickSize - 1)); }
+
+        T * slot_data(uint32_t slot) const { return blocks[slot / blockBricks].get() + size_t(slot % blockBricks) * brickVoxels; }
+
+        uint32_t brick_entry(const int3 & brick) const
+        {
+            const int3 page = brick >> pageLog2;
+            const uint32_t * entries = pages[(page.z * pageCount.y + page.y) * pageCount.x + page.x].get();
+            return entries ? entries[brick_index(brick & (pageSize - 1))] : backgroundBrick;
+        }
+
+        uint32_t & touch_entry(const int3 & brick)
+        {
+            const int3 page = brick >> pageLog2;
+            auto & entries = pages[(page.z * pageCount.y + page.y) * pageCount.x + page.x];
+            if (!entries)
+            {
+                entries.reset(new uint32_t[pageBricks]);
+                std::fill(entries.get(), entries.get() + pageBricks, backgroundBrick);
+            }
+            return entries[brick_index(brick & (pageSize - 1))];
+        }
+
+        uint32_t allocate_slot(const T & fill)
+        {
+            if (freeSlots.empty())
+            {
+                blocks.emplace_back(new T[size_t(blockBricks) * brickVoxels]);
+                for (int i = blockBricks - 1; i >= 0; --i) freeSlots.push_back(slotCount + i);
+                slotCount += blockBricks;
+            }
+            const uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            std::fill(slot_data(slot), slot_data(slot) + brickVoxels, fill);
+            return slot;
+        }
+
+        uint32_t add_constant(const T & value)
+        {
+            if (freeConstants.empty())
+            {
+                constants.push_back(value);
+                return uint32_t(constants.size() - 1);
+            }
+            const uint32_t c = freeConstants.back();
+            freeConstants.pop_back();
+            constants[c] = value;
+            return c;
+        }
+
+        void release(uint32_t entry)
+        {
+            if (entry == backgroundBrick) return;
+            if (entry & constantFlag) freeConstants.push_back(entry & ~constantFlag);
+            else freeSlots.push_back(entry);
+        }
+
+        const T & entry_value(uint32_t entry) const { return entry == backgroundBrick ? background : constants[entry & ~constantFlag]; }
+
+        // Storage for a brick, allocating it (filled with its current uniform value) if necessary
+        T * brick_data(const int3 & brick)
+        {
+            uint32_t & entry = touch_entry(brick);
+            if (entry == backgroundBrick || (entry & constantFlag))
+            {
+                const T fill = entry_value(entry);
+                release(entry);
+                entry = allocate_slot(fill);
+            }
+            return slot_data(entry);
+        }
+
+        template<class F> void visit_entries(F f) const
+        {
+            for (int pz = 0; pz < pageCount.z; ++pz)
+                for (int py = 0; py < pageCount.y; ++py)
+                    for (int px = 0; px < pageCount.x; ++px)
+                    {
+                        const uint32_t * entries = pages[(pz * pageCount.y + py) * pageCount.x + px].get();
+                        if (!entries) continue;
+                        for (int i = 0; i < pageBricks; ++i)
+                        {
+                            if (entries[i] == backgroundBrick) continue;
+                            const int3 brick = int3(px, py, pz) * pageSize + int3(i % pageSize, (i / pageSize) % pageSize, i / (pageSize * pageSize));
+                            f(brick, entries[i]);
+                        }
+                    }
+        }
+
+    public:
+
+        SparseVoxelArray(const int3 & size, const T & background = T()) : size(size), background(background)
+        {
+            const int pageVoxels = brickSize * pageSize;
+            pageCount = (size + int3(pageVoxels - 1)) / pageVoxels;
+            pages.resize(size_t(pageCount.x) * pageCount.y * pageCount.z);
+        }
+
+        const int3 & get_size() const { return size; }
+        const T & get_background() const { return background; }
+
+        T operator[](const int3 & coords) const
+        {
+            const uint32_t entry = brick_entry(coords >> brickLog2);
+            if (entry == backgroundBrick) return background;
+            if (entry & constantFlag) return constants[entry & ~constantFlag];
+            return slot_data(entry)[voxel_index(coords)];
+        }
+
+        // Writable access allocates the brick, like every voxel of a VoxelArray being allocated up front.
+        // Prefer set() when writing values that may already be there.
+        T & operator[](const int3 & coords) { return brick_data(coords >> brickLog2)[voxel_index(coords)]; }
+
+        // Writes a voxel, leaving background and constant bricks alone if the value does not change them
+        void set(const int3 & coords, const T & value)
+        {
+            const int3 brick = coords >> brickLog2;
+            const uint32_t entry = brick_entry(brick);
+            if ((entry == backgroundBrick || (entry & constantFlag)) && entry_value(entry) == value) return;
+            brick_data(brick)[voxel_index(coords)] = value;
+        }
+
+        // Makes a whole brick (given in brick coordinates) one value without allocating storage
+        void fill_brick(const int3 & brick, const T & value)
+        {
+            uint32_t & entry = touch_entry(brick);
+            release(entry);
+            entry = (value == background) ? backgroundBrick : (constantFlag | add_constant(value));
+        }
+
+        // Collapses allocated bricks whose voxels are all equal into constant or background bricks
+        size_t optimize()
+        {
+            size_t collapsed = 0;
+            for (auto & page : pages)
+            {
+                if (!page) continue;
+                for (int i = 0; i < pageBricks; ++i)
+                {
+                    uint32_t & entry = page[i];
+                    if (entry == backgroundBrick || (entry & constantFlag)) continue;
+                    const T * v = slot_data(entry);
+                    if (!std::all_of(v + 1, v + brickVoxels, [v](const T & x) { return x == v[0]; })) continue;
+                    const T value = v[0];
+                    release(entry);
+                    entry = (value == background) ? backgroundBrick : (constantFlag | add_constant(value));
+                    ++collapsed;
+                }
+            }
+            return collapsed;
+        }
+
+        // Calls f(const BrickView &) for every brick that is not background, in z, y, x order of pages
+        template<class F> void for_each_active_brick(F f) const
+        {
+            visit_entries([&](const int3 & brick, uint32_t entry)
+            {
+                BrickView view;
+                view.origin = brick * brickSize;
+                view.voxels = (entry & constantFlag) ? nullptr : slot_data(entry);
+                view.value = (entry & constantFlag) ? constants[entry & ~constantFlag] : background;
+                f(view);
+            });
+        }
+
+        // Non-background bricks, for loops that want an iterator range
+        std::vector<BrickView> active_bricks() const
+        {
+            std::vector<BrickView> result;
+            for_each_active_brick([&](const BrickView & b) { result.push_back(b); });
+            return result;
+        }
+
+        size_t allocated_brick_count() const { return slotCount - freeSlots.size(); }
+        size_t constant_brick_count() const { return constants.size() - freeConstants.size(); }
+
+        // Bytes held: pool blocks, touched pages, the page directory and constants
+        size_t memory_bytes() const
+        {
+            size_t touched = 0;
+            for (auto & p : pages) touched += bool(p);
+            return blocks.size() * size_t(blockBricks) * brickVoxels * sizeof(T) + touched * pageBricks * sizeof(uint32_t)
+                + pages.size() * sizeof(pages[0]) + constants.size() * sizeof(T);
+        }
+    };
+
+    template<typename T> const int SparseVoxelArray<T>::brickLog2;
+    template<typename T> const int SparseVoxelArray<T>::brickSize;
+    template<typename T> const int SparseVoxelArray<T>::brickVoxels;
+    template<typename T> const int SparseVoxelArray<T>::pageLog2;
+    template<typename T> const int SparseVoxelArray<T>::pageSize;
+    template<typename T> const int SparseVoxelArray<T>::pageBricks;
+    template<typename T> const int SparseVoxelArray<T>::blockBricks;
+    template<typename T> const uint32_t SparseVoxelArray<T>::backgroundBrick;
+    template<typename T> const uint32_t SparseVoxelArray<T>::constantFlag;
+}
+
+#endif // end sparse_voxel_array_hpp
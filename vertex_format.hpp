@@ -0,0 +1,710 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef vertex_format_hpp
+#define vertex_format_hpp
+
+#include "util.hpp"
+#include "math-core.hpp"
+#include "geometry.hpp"
+#include "parallel_for.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// Interleaved vertex layouts for runtime meshes, described once by a VertexFormat that both the CPU encoder
+// below and the GL attribute setup in gl-mesh.hpp read, so the bytes written and the pointers declared to GL
+// cannot drift apart. make_float_vertex_format() is the historical all-float layout (56 bytes per vertex with
+// tangents and bitangents); make_packed_vertex_format() quantizes every stream:
+//
+//  position     unorm16 x3 (+ padding) over the mesh bounds; the shader applies positionOffset/positionScale
+//  normal       octahedral, 10:10 bits of a GL_INT_2_10_10_10_REV
+//  tangent      octahedral like normals, with the bitangent sign in the 2-bit w; the bitangent stream is dropped
+//  texcoord0    half floats
+//  color        unorm8 x4
+//  bones        uint8 indices (read as unnormalized floats) and unorm8 weights renormalized to sum to one
+//
+// which is 20 bytes for a vertex with normals, UVs and tangents. assets/shaders/renderer/packed_vertex.glsl
+// holds the matching decode functions. Octahedral encoding is from Cigolle et al., "A Survey of Efficient
+// Representations for Independent Unit Vectors" (JCGT 2014); quantization rounds to the nearest of the four
+// surrounding grid points by angle rather than per component.
+
+namespace avl
+{
+    // Attribute locations follow the order make_mesh_from_geometry has always used
+    enum class VertexAttribute : uint8_t { position, normal, color, texcoord0, tangent, bitangent, boneIndices, boneWeights };
+
+    enum class VertexEncoding : uint8_t
+    {
+        float2, float3, float4,
+        unorm16x4,          // 3 used components plus padding, positions only
+        oct_10_10_10_2,     // octahedral unit vector in x,y; sign in w (tangents)
+        half2,
+        unorm8x4,
+        uint8x4
+    };
+
+    inline uint32_t vertex_encoding_size(VertexEncoding e)
+    {
+        switch (e)
+        {
+        case VertexEncoding::float2: return 8;
+        case VertexEncoding::float3: return 12;
+        case VertexEncoding::float4: return 16;
+        case VertexEncoding::unorm16x4: return 8;
+        default: return 4;
+        }
+    }
+
+    struct VertexElement
+    {
+        VertexAttribute attribute;
+        VertexEncoding encoding;
+        uint32_t location;
+        uint32_t offset;            // bytes from the start of a vertex
+    };
+
+    struct VertexFormat
+    {
+        std::vector<VertexElement> elements;
+        uint32_t stride = 0;
+        float3 positionOffset = float3(0, 0, 0);     // object space position = positionOffset + positionScale * decoded
+        float3 positionScale = float3(1, 1, 1);
+
+        void add(VertexAttribute attribute, VertexEncoding encoding)
+        {
+            elements.push_back({ attribute, encoding, uint32_t(attribute), stride });
+            stride += vertex_encoding_size(encoding);
+        }
+
+        const VertexElement * find(VertexAttribute attribute) const
+        {
+            for (const auto & e : elements) if (e.attribute == attribute) return &e;
+            return nullptr;
+        }
+    };
+
+    // Bone streams are not part of runtime_mesh, so skinned meshes pass them alongside
+    struct VertexBoneStreams
+    {
+        const int4 * indices = nullptr;
+        const float4 * weights = nullptr;
+    };
+
+    inline VertexBoneStreams bone_streams(const runtime_skinned_mesh & mesh)
+    {
+        VertexBoneStreams bones;
+        if (!mesh.boneIndices.empty()) bones.indices = mesh.boneIndices.data();
+        if (!mesh.boneWeights.empty()) bones.weights = mesh.boneWeights.data();
+        return bones;
+    }
+
+    /////////////////////
+    //   Conversions   //
+    /////////////////////
+
+    // IEEE 754 binary16, rounding to nearest even; overflow becomes infinity
+    inline uint16_t float_to_half(float f)
+    {
+        uint32_t x;
+        std::memcpy(&x, &f, 4);
+        const uint32_t sign = (x >> 16) & 0x8000u;
+        const uint32_t absx = x & 0x7fffffffu;
+        if (absx >= 0x7f800000u) return uint16_t(sign | 0x7c00u | (absx > 0x7f800000u ? 0x200u : 0u));
+        if (absx >= 0x477ff000u) return uint16_t(sign | 0x7c00u); // rounds past 65504
+        if (absx < 0x38800000u) // half denormals and zero
+        {
+            if (absx < 0x33000000u) return uint16_t(sign);
+            const uint32_t e = absx >> 23, m = (absx & 0x7fffffu) | 0x800000u;
+            const uint32_t shift = 126 - e;                         // 14..24
+            uint32_t h = m >> shift;
+            const uint32_t rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+            if (rem > half || (rem == half && (h & 1))) ++h;
+            return uint16_t(sign | h);
+        }
+        uint32_t h = ((absx - 0x38000000u) >> 13);
+        const uint32_t rem = absx & 0x1fffu;
+        if (rem > 0x1000u || (rem == 0x1000u && (h & 1))) ++h;
+        return uint16_t(sign | h);
+    }
+
+    inline float half_to_float(uint16_t h)
+    {
+        const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+        uint32_t e = (h >> 10) & 0x1f, m = h & 0x3ffu, x;
+        if (e == 0x1f) x = sign | 0x7f800000u | (m << 13);
+        else if (e != 0) x = sign | ((e + 112) << 23) | (m << 13);
+        else if (m == 0) x = sign;
+        else
+        {
+            e = 113;
+            while (!(m & 0x400u)) { m <<= 1; --e; }
+            x = sign | (e << 23) | ((m & 0x3ffu) << 13);
+        }
+        float f;
+        std::memcpy(&f, &x, 4);
+        return f;
+    }
+
+    inline float sign_not_zero(float v) { return v < 0.0f ? -1.0f : 1.0f; }
+
+    // Maps a unit vector onto the [-1, 1]^2 octahedron parameterization
+    inline float2 oct_encode(const float3 & v)
+    {
+        const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (l1 == 0.0f) return float2(0, 0);
+        float2 p = float2(v.x, v.y) / l1;
+        if (v.z < 0.0f) p = float2((1.0f - std::abs(p.y)) * sign_not_zero(p.x), (1.0f - std::abs(p.x)) * sign_not_zero(p.y));
+        return p;
+    }
+
+    inline float3 oct_decode(const float2 & p)
+    {
+        float3 v(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+        if (v.z < 0.0f)
+        {
+            const float x = v.x;
+            v.x = (1.0f - std::abs(v.y)) * sign_not_zero(x);
+            v.y = (1.0f - std::abs(x)) * sign_not_zero(v.y);
+        }
+        return safe_normalize(v);
+    }
+
+    inline int32_t quantize_snorm10(float v) { return int32_t(std::round(clamp(v, -1.0f, 1.0f) * 511.0f)); }
+    inline float dequantize_snorm10(int32_t q) { return std::max(float(q) / 511.0f, -1.0f); }
+
+    // GL_INT_2_10_10_10_REV: x in the low bits, two's complement fields
+    inline uint32_t pack_snorm_10_10_10_2(int32_t x, int32_t y, int32_t z, int32_t w)
+    {
+        return (uint32_t(x) & 0x3ffu) | ((uint32_t(y) & 0x3ffu) << 10) | ((uint32_t(z) & 0x3ffu) << 20) | ((uint32_t(w) & 0x3u) << 30);
+    }
+
+    inline int4 unpack_snorm_10_10_10_2(uint32_t p)
+    {
+        auto field = [](uint32_t bits, int width) { const int32_t shift = 32 - width; return int32_t(bits << shift) >> shift; };
+        return int4(field(p & 0x3ffu, 10), field((p >> 10) & 0x3ffu, 10), field((p >> 20) & 0x3ffu, 10), field(p >> 30, 2));
+    }
+
+    // Octahedral encoding quantized to 10 bits per axis, picking the grid point that decodes closest to v
+    inline uint32_t pack_oct_10_10_10_2(const float3 & v, float w = 0.0f)
+    {
+        const float2 p = oct_encode(v);
+        const float fx = std::floor(clamp(p.x, -1.0f, 1.0f) * 511.0f), fy = std::floor(clamp(p.y, -1.0f, 1.0f) * 511.0f);
+        int32_t bestX = 0, bestY = 0;
+        float bestDot = -2.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            const int32_t qx = std::min(int32_t(fx) + (i & 1), 511), qy = std::min(int32_t(fy) + (i >> 1), 511);
+            const float d = dot(oct_decode(float2(dequantize_snorm10(qx), dequantize_snorm10(qy))), v);
+            if (d > bestDot) { bestDot = d; bestX = qx; bestY = qy; }
+        }
+        return pack_snorm_10_10_10_2(bestX, bestY, 0, w < 0.0f ? -1 : (w > 0.0f ? 1 : 0));
+    }
+
+    // Returns the unit vector in xyz and the w field (-1, 0 or 1)
+    inline float4 unpack_oct_10_10_10_2(uint32_t p)
+    {
+        const int4 q = unpack_snorm_10_10_10_2(p);
+        const float3 v = oct_decode(float2(dequantize_snorm10(q.x), dequantize_snorm10(q.y)));
+        return float4(v.x, v.y, v.z, std::max(float(q.w), -1.0f));
+    }
+
+    inline uint8_t quantize_unorm8(float v) { return uint8_t(std::round(clamp(v, 0.0f, 1.0f) * 255.0f)); }
+
+    // Rounds weights to 8 bits so that they still sum to exactly 255, handing the rounding error to the largest
+    inline void quantize_bone_weights(const float4 & w, uint8_t out[4])
+    {
+        const float sum = w.x + w.y + w.z + w.w;
+        const float4 n = sum > 0.0f ? w / sum : float4(1, 0, 0, 0);
+        int total = 0, largest = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i] = quantize_unorm8(n[i]);
+            total += out[i];
+            if (n[i] > n[largest]) largest = i;
+        }
+        out[largest] = uint8_t(int(out[largest]) + 255 - total);
+    }
+
+    ///////////////////
+    //   Builders    //
+    ///////////////////
+
+    namespace impl
+    {
+        inline void add_bone_elements(VertexFormat & format, const runtime_skinned_mesh & mesh, bool packed)
+        {
+            if (!mesh.boneIndices.empty()) format.add(VertexAttribute::boneIndices, packed ? VertexEncoding::uint8x4 : VertexEncoding::float4);
+            if (!mesh.boneWeights.empty()) format.add(VertexAttribute::boneWeights, packed ? VertexEncoding::unorm8x4 : VertexEncoding::float4);
+        }
+    }
+
+    // The layout make_mesh_from_geometry has always uploaded: floats, colors without alpha
+    inline VertexFormat make_float_vertex_format(const runtime_mesh & mesh)
+    {
+        VertexFormat format;
+        format.add(VertexAttribute::position, VertexEncoding::float3);
+        if (!mesh.normals.empty()) format.add(VertexAttribute::normal, VertexEncoding::float3);
+        if (!mesh.colors.empty()) format.add(VertexAttribute::color, VertexEncoding::float3);
+        if (!mesh.texcoord0.empty()) format.add(VertexAttribute::texcoord0, VertexEncoding::float2);
+        if (!mesh.tangents.empty()) format.add(VertexAttribute::tangent, VertexEncoding::float3);
+        if (!mesh.bitangents.empty()) format.add(VertexAttribute::bitangent, VertexEncoding::float3);
+        return format;
+    }
+
+    inline VertexFormat make_float_vertex_format(const runtime_skinned_mesh & mesh)
+    {
+        VertexFormat format = make_float_vertex_format(static_cast<const runtime_mesh &>(mesh));
+        impl::add_bone_elements(format, mesh, false);
+        return format;
+    }
+
+    inline VertexFormat make_packed_vertex_format(const runtime_mesh & mesh)
+    {
+        VertexFormat format;
+        format.add(VertexAttribute::position, VertexEncoding::unorm16x4);
+        if (!mesh.normals.empty()) format.add(VertexAttribute::normal, VertexEncoding::oct_10_10_10_2);
+        if (!mesh.colors.empty()) format.add(VertexAttribute::color, VertexEncoding::unorm8x4);
+        if (!mesh.texcoord0.empty()) format.add(VertexAttribute::texcoord0, VertexEncoding::half2);
+        if (!mesh.tangents.empty()) format.add(VertexAttribute::tangent, VertexEncoding::oct_10_10_10_2);
+        else if (!mesh.bitangents.empty()) format.add(VertexAttribute::bitangent, VertexEncoding::oct_10_10_10_2);
+
+        if (!mesh.vertices.empty())
+        {
+            const Bounds3D bounds = compute_bounds(mesh);
+            format.positionOffset = bounds.min();
+            format.positionScale = bounds.max() - bounds.min();
+        }
+        return format;
+    }
+
+    inline VertexFormat make_packed_vertex_format(const runtime_skinned_mesh & mesh)
+    {
+        VertexFormat format = make_packed_vertex_format(static_cast<const runtime_mesh &>(mesh));
+        impl::add_bone_elements(format, mesh, true);
+        return format;
+    }
+
+    ////////////////////////////
+    //   Interleaving writer  //
+    ////////////////////////////
+
+    // Vertices are written in blocks: every element of the format is written for a block with one tight
+    // strided loop (its encoding and source resolved once, not per vertex), into a staging block small
+    // enough to stay in cache, which is then copied to the destination whole. Copying whole blocks keeps the
+    // writes to dst sequential, which matters when dst is mapped, write-combined GPU memory. Blocks are
+    // independent, so large meshes are split across threads. With AVX2, position quantization and
+    // octahedral encoding run eight vertices at a time, and with F16C so does half conversion. They perform the
+    // scalar operations in the same order, so results match the scalar paths, except where the compiler fuses
+    // the scalar multiply-adds, which can move an octahedral near-tie to the neighbouring grid point.
+
+    namespace impl
+    {
+        struct VertexStreamJob;
+        typedef void(*VertexStreamWriter)(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block);
+
+        struct VertexStreamJob
+        {
+            VertexStreamWriter write;
+            const float * src = nullptr;            // float source, srcComponents per vertex
+            uint32_t srcComponents = 0;
+            const int4 * indices = nullptr;         // bone index source
+            bool tangentSign = false;               // oct w holds the bitangent sign...
+            const float3 * normals = nullptr;       // ...from these when the mesh has bitangents, else positive
+            const float3 * bitangents = nullptr;
+            uint32_t offset = 0, stride = 0;
+            float3 positionOffset, positionInvScale;
+        };
+
+        inline uint16_t quantize_position(float p, float offset, float invScale)
+        {
+            return uint16_t(clamp((p - offset) * invScale, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+
+        inline float tangent_sign(const VertexStreamJob & job, const float * t, size_t i)
+        {
+            if (!job.bitangents) return 1.0f;
+            return sign_not_zero(dot(cross(job.normals[i], float3(t[0], t[1], t[2])), job.bitangents[i]));
+        }
+
+        template<int N> void write_float_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const float * s = job.src + begin * job.srcComponents;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, s += job.srcComponents, d += job.stride) std::memcpy(d, s, N * sizeof(float));
+        }
+
+        inline void write_bone_index_floats(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, d += job.stride)
+            {
+                const float f[4] = { (float) job.indices[i].x, (float) job.indices[i].y, (float) job.indices[i].z, (float) job.indices[i].w };
+                std::memcpy(d, f, sizeof(f));
+            }
+        }
+
+        inline void write_bone_index_bytes(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, d += job.stride)
+            {
+                for (int c = 0; c < 4; ++c) d[c] = uint8_t(job.indices[i][c]);
+            }
+        }
+
+        inline void write_unorm8_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const float * s = job.src + begin * 4;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, s += 4, d += job.stride)
+            {
+                for (int c = 0; c < 4; ++c) d[c] = quantize_unorm8(s[c]);
+            }
+        }
+
+        inline void write_bone_weight_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const float * s = job.src + begin * 4;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, s += 4, d += job.stride) quantize_bone_weights(float4(s[0], s[1], s[2], s[3]), d);
+        }
+
+        inline void write_unorm16_positions_scalar(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const float * s = job.src + begin * 3;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, s += 3, d += job.stride)
+            {
+                uint16_t q[4] = { 0, 0, 0, 0 };
+                for (int c = 0; c < 3; ++c) q[c] = quantize_position(s[c], job.positionOffset[c], job.positionInvScale[c]);
+                std::memcpy(d, q, 8);
+            }
+        }
+
+        inline void write_half2_stream_scalar(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const float * s = job.src + begin * 2;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, s += 2, d += job.stride)
+            {
+                const uint16_t h[2] = { float_to_half(s[0]), float_to_half(s[1]) };
+                std::memcpy(d, h, 4);
+            }
+        }
+
+        inline void write_oct_stream_scalar(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const float * s = job.src + begin * 3;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < end; ++i, s += 3, d += job.stride)
+            {
+                const uint32_t p = pack_oct_10_10_10_2(float3(s[0], s[1], s[2]), job.tangentSign ? tangent_sign(job, s, i) : 0.0f);
+                std::memcpy(d, &p, 4);
+            }
+        }
+
+#if defined(__AVX2__)
+
+        inline void write_unorm16_positions(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const size_t simdEnd = begin + (end - begin) / 8 * 8;
+            const __m256i lanes = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+            const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), range = _mm256_set1_ps(65535.0f), half = _mm256_set1_ps(0.5f);
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < simdEnd; i += 8, d += 8 * job.stride)
+            {
+                alignas(32) uint32_t q[3][8];
+                for (int c = 0; c < 3; ++c)
+                {
+                    __m256 v = _mm256_i32gather_ps(job.src + i * 3 + c, lanes, 4);
+                    v = _mm256_mul_ps(_mm256_sub_ps(v, _mm256_set1_ps(job.positionOffset[c])), _mm256_set1_ps(job.positionInvScale[c]));
+                    v = _mm256_add_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, zero), one), range), half);
+                    _mm256_store_si256((__m256i *) q[c], _mm256_cvttps_epi32(v));
+                }
+                for (int k = 0; k < 8; ++k)
+                {
+                    const uint16_t packed[4] = { uint16_t(q[0][k]), uint16_t(q[1][k]), uint16_t(q[2][k]), 0 };
+                    std::memcpy(d + k * job.stride, packed, 8);
+                }
+            }
+            write_unorm16_positions_scalar(job, simdEnd, end, block + (simdEnd - begin) * job.stride);
+        }
+
+        // The scalar pack_oct_10_10_10_2, eight vectors at a time with the same operations in the same order
+        inline __m256 sign_not_zero_ps(__m256 v) { return _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_set1_ps(-1.0f), _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ)); }
+        inline __m256 abs_ps(__m256 v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+
+        inline void write_oct_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const size_t simdEnd = begin + (end - begin) / 8 * 8;
+            const __m256i lanes = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+            const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), minusOne = _mm256_set1_ps(-1.0f);
+            const __m256 q511 = _mm256_set1_ps(511.0f), epsilon = _mm256_set1_ps(1E-6f);
+            const __m256i max511 = _mm256_set1_epi32(511), mask10 = _mm256_set1_epi32(0x3ff);
+            uint8_t * d = block + job.offset;
+
+            for (size_t i = begin; i < simdEnd; i += 8, d += 8 * job.stride)
+            {
+                const float * s = job.src + i * 3;
+                const __m256 vx = _mm256_i32gather_ps(s + 0, lanes, 4), vy = _mm256_i32gather_ps(s + 1, lanes, 4), vz = _mm256_i32gather_ps(s + 2, lanes, 4);
+
+                // oct_encode
+                const __m256 l1 = _mm256_add_ps(_mm256_add_ps(abs_ps(vx), abs_ps(vy)), abs_ps(vz));
+                const __m256 degenerate = _mm256_cmp_ps(l1, zero, _CMP_EQ_OQ);
+                __m256 px = _mm256_div_ps(vx, l1), py = _mm256_div_ps(vy, l1);
+                const __m256 fold = _mm256_cmp_ps(vz, zero, _CMP_LT_OQ);
+                const __m256 fx = _mm256_mul_ps(_mm256_sub_ps(one, abs_ps(py)), sign_not_zero_ps(px));
+                const __m256 fy = _mm256_mul_ps(_mm256_sub_ps(one, abs_ps(px)), sign_not_zero_ps(py));
+                px = _mm256_blendv_ps(_mm256_blendv_ps(px, fx, fold), zero, degenerate);
+                py = _mm256_blendv_ps(_mm256_blendv_ps(py, fy, fold), zero, degenerate);
+
+                const __m256i baseX = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(px, minusOne), one), q511)));
+                const __m256i baseY = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(py, minusOne), one), q511)));
+
+                __m256i bestX = _mm256_setzero_si256(), bestY = _mm256_setzero_si256();
+                __m256 bestDot = _mm256_set1_ps(-2.0f);
+                for (int k = 0; k < 4; ++k)
+                {
+                    const __m256i qx = _mm256_min_epi32(_mm256_add_epi32(baseX, _mm256_set1_epi32(k & 1)), max511);
+                    const __m256i qy = _mm256_min_epi32(_mm256_add_epi32(baseY, _mm256_set1_epi32(k >> 1)), max511);
+
+                    // oct_decode of the dequantized candidate
+                    const __m256 ex = _mm256_max_ps(_mm256_div_ps(_mm256_cvtepi32_ps(qx), q511), minusOne);
+                    const __m256 ey = _mm256_max_ps(_mm256_div_ps(_mm256_cvtepi32_ps(qy), q511), minusOne);
+                    __m256 nx = ex, ny = ey;
+                    const __m256 nz = _mm256_sub_ps(_mm256_sub_ps(one, abs_ps(ex)), abs_ps(ey));
+                    const __m256 under = _mm256_cmp_ps(nz, zero, _CMP_LT_OQ);
+                    nx = _mm256_blendv_ps(nx, _mm256_mul_ps(_mm256_sub_ps(one, abs_ps(ey)), sign_not_zero_ps(ex)), under);
+                    ny = _mm256_blendv_ps(ny, _mm256_mul_ps(_mm256_sub_ps(one, abs_ps(ex)), sign_not_zero_ps(ey)), under);
+
+                    // safe_normalize, then the dot with the input
+                    const __m256 len = _mm256_max_ps(epsilon, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz))));
+                    const __m256 dx = _mm256_div_ps(nx, len), dy = _mm256_div_ps(ny, len), dz = _mm256_div_ps(nz, len);
+                    const __m256 dp = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, vx), _mm256_mul_ps(dy, vy)), _mm256_mul_ps(dz, vz));
+
+                    const __m256 better = _mm256_cmp_ps(dp, bestDot, _CMP_GT_OQ);
+                    bestDot = _mm256_blendv_ps(bestDot, dp, better);
+                    bestX = _mm256_blendv_epi8(bestX, qx, _mm256_castps_si256(better));
+                    bestY = _mm256_blendv_epi8(bestY, qy, _mm256_castps_si256(better));
+                }
+
+                alignas(32) uint32_t packed[8];
+                _mm256_store_si256((__m256i *) packed, _mm256_or_si256(_mm256_and_si256(bestX, mask10), _mm256_slli_epi32(_mm256_and_si256(bestY, mask10), 10)));
+                for (int k = 0; k < 8; ++k)
+                {
+                    uint32_t p = packed[k];
+                    if (job.tangentSign) p |= (tangent_sign(job, s + k * 3, i + k) < 0.0f ? 3u : 1u) << 30;
+                    std::memcpy(d + k * job.stride, &p, 4);
+                }
+            }
+            write_oct_stream_scalar(job, simdEnd, end, block + (simdEnd - begin) * job.stride);
+        }
+
+#else
+        inline void write_unorm16_positions(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block) { write_unorm16_positions_scalar(job, begin, end, block); }
+        inline void write_oct_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block) { write_oct_stream_scalar(job, begin, end, block); }
+#endif
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+
+        inline void write_half2_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block)
+        {
+            const size_t simdEnd = begin + (end - begin) / 4 * 4;
+            uint8_t * d = block + job.offset;
+            for (size_t i = begin; i < simdEnd; i += 4, d += 4 * job.stride)
+            {
+                alignas(16) uint32_t h[4];
+                _mm_store_si128((__m128i *) h, _mm256_cvtps_ph(_mm256_loadu_ps(job.src + i * 2), _MM_FROUND_TO_NEAREST_INT));
+                for (int k = 0; k < 4; ++k) std::memcpy(d + k * job.stride, &h[k], 4);
+            }
+            write_half2_stream_scalar(job, simdEnd, end, block + (simdEnd - begin) * job.stride);
+        }
+
+#else
+        inline void write_half2_stream(const VertexStreamJob & job, size_t begin, size_t end, uint8_t * block) { write_half2_stream_scalar(job, begin, end, block); }
+#endif
+
+        inline bool has_source(const runtime_mesh & mesh, const VertexBoneStreams & bones, VertexAttribute a)
+        {
+            switch (a)
+            {
+            case VertexAttribute::position: return mesh.vertices.size() > 0;
+            case VertexAttribute::normal: return mesh.normals.size() == mesh.vertices.size();
+            case VertexAttribute::color: return mesh.colors.size() == mesh.vertices.size();
+            case VertexAttribute::texcoord0: return mesh.texcoord0.size() == mesh.vertices.size();
+            case VertexAttribute::tangent: return mesh.tangents.size() == mesh.vertices.size();
+            case VertexAttribute::bitangent: return mesh.bitangents.size() == mesh.vertices.size();
+            case VertexAttribute::boneIndices: return bones.indices != nullptr;
+            case VertexAttribute::boneWeights: return bones.weights != nullptr;
+            }
+            return false;
+        }
+
+        inline const float * float_source(const runtime_mesh & mesh, const VertexBoneStreams & bones, VertexAttribute a, uint32_t & components)
+        {
+            switch (a)
+            {
+            case VertexAttribute::position: components = 3; return &mesh.vertices[0].x;
+            case VertexAttribute::normal: components = 3; return &mesh.normals[0].x;
+            case VertexAttribute::color: components = 4; return &mesh.colors[0].x;
+            case VertexAttribute::texcoord0: components = 2; return &mesh.texcoord0[0].x;
+            case VertexAttribute::tangent: components = 3; return &mesh.tangents[0].x;
+            case VertexAttribute::bitangent: components = 3; return &mesh.bitangents[0].x;
+            case VertexAttribute::boneWeights: components = 4; return &bones.weights[0].x;
+            default: components = 0; return nullptr;
+            }
+        }
+
+        // Resolves each element to a writer and its source once per mesh
+        inline std::vector<VertexStreamJob> plan_vertex_streams(const runtime_mesh & mesh, const VertexFormat & format, const VertexBoneStreams & bones)
+        {
+            std::vector<VertexStreamJob> jobs;
+            for (const auto & e : format.elements)
+            {
+                if (!has_source(mesh, bones, e.attribute)) throw std::runtime_error("vertex format has an attribute the mesh is missing");
+
+                VertexStreamJob job;
+                job.offset = e.offset;
+                job.stride = format.stride;
+                job.src = float_source(mesh, bones, e.attribute, job.srcComponents);
+                job.indices = bones.indices;
+
+                const uint32_t n = job.srcComponents;
+                const bool ok = [&]()
+                {
+                    switch (e.encoding)
+                    {
+                    case VertexEncoding::float2: job.write = &write_float_stream<2>; return n >= 2;
+                    case VertexEncoding::float3: job.write = &write_float_stream<3>; return n >= 3;
+                    case VertexEncoding::float4:
+                        job.write = e.attribute == VertexAttribute::boneIndices ? &write_bone_index_floats : &write_float_stream<4>;
+                        return n >= 4 || e.attribute == VertexAttribute::boneIndices;
+                    case VertexEncoding::unorm16x4: job.write = &write_unorm16_positions; return e.attribute == VertexAttribute::position;
+                    case VertexEncoding::oct_10_10_10_2: job.write = &write_oct_stream; return n == 3;
+                    case VertexEncoding::half2: job.write = &write_half2_stream; return n == 2;
+                    case VertexEncoding::unorm8x4:
+                        job.write = e.attribute == VertexAttribute::boneWeights ? &write_bone_weight_stream : &write_unorm8_stream;
+                        return n == 4;
+                    case VertexEncoding::uint8x4: job.write = &write_bone_index_bytes; return e.attribute == VertexAttribute::boneIndices;
+                    }
+                    return false;
+                }();
+                if (!ok) throw std::runtime_error("vertex encoding does not fit its attribute");
+
+                if (e.encoding == VertexEncoding::unorm16x4)
+                {
+                    job.positionOffset = format.positionOffset;
+                    for (int c = 0; c < 3; ++c) job.positionInvScale[c] = format.positionScale[c] > 0.0f ? 1.0f / format.positionScale[c] : 0.0f;
+                }
+
+                // Tangents carry the bitangent sign; without bitangents it is always positive
+                if (e.encoding == VertexEncoding::oct_10_10_10_2 && e.attribute == VertexAttribute::tangent)
+                {
+                    job.tangentSign = true;
+                    if (mesh.bitangents.size() == mesh.vertices.size() && mesh.normals.size() == mesh.vertices.size())
+                    {
+                        job.normals = mesh.normals.data();
+                        job.bitangents = mesh.bitangents.data();
+                    }
+                }
+
+                if (e.encoding == VertexEncoding::uint8x4)
+                {
+                    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+                    {
+                        for (int c = 0; c < 4; ++c) if (bones.indices[i][c] < 0 || bones.indices[i][c] > 255) throw std::runtime_error("bone index does not fit in 8 bits");
+                    }
+                }
+                jobs.push_back(job);
+            }
+            return jobs;
+        }
+    }
+
+    // Writes mesh.vertices.size() * format.stride bytes to dst, which may be mapped GPU memory. Meshes of at
+    // least parallelVertexCount vertices are split across numThreads threads (0 uses every hardware thread).
+    inline void encode_vertices(const runtime_mesh & mesh, const VertexFormat & format, uint8_t * dst, const VertexBoneStreams & bones = {}, uint32_t numThreads = 0)
+    {
+        const size_t blockVertices = 2048, parallelVertexCount = 65536;
+
+        const std::vector<impl::VertexStreamJob> jobs = impl::plan_vertex_streams(mesh, format, bones);
+        const size_t count = mesh.vertices.size();
+        const size_t blocks = (count + blockVertices - 1) / blockVertices;
+        if (count < parallelVertexCount) numThreads = 1;
+
+        parallel_for(0, blocks, [&](size_t b)
+        {
+            const size_t begin = b * blockVertices, end = std::min(count, begin + blockVertices);
+            thread_local std::vector<uint8_t> staging;
+            staging.resize(std::max(staging.size(), blockVertices * format.stride));
+            for (const auto & job : jobs) job.write(job, begin, end, staging.data());
+            std::memcpy(dst + begin * format.stride, staging.data(), (end - begin) * format.stride);
+        }, numThreads);
+    }
+
+    inline std::vector<uint8_t> encode_vertices(const runtime_mesh & mesh, const VertexFormat & format, const VertexBoneStreams & bones = {}, uint32_t numThreads = 0)
+    {
+        std::vector<uint8_t> buffer(mesh.vertices.size() * format.stride);
+        encode_vertices(mesh, format, buffer.data(), bones, numThreads);
+        return buffer;
+    }
+
+    // Reads one element of an encoded vertex back as the shader would see it after the packed_vertex.glsl
+    // decode: positions in object space, unit vectors normalized with the tangent sign in w, bone indices as integers
+    inline float4 decode_vertex_element(const VertexFormat & format, const VertexElement & e, const uint8_t * vertex)
+    {
+        const uint8_t * src = vertex + e.offset;
+        float4 v(0, 0, 0, 0);
+        switch (e.encoding)
+        {
+        case VertexEncoding::float2: std::memcpy(&v.x, src, 8); break;
+        case VertexEncoding::float3: std::memcpy(&v.x, src, 12); break;
+        case VertexEncoding::float4: std::memcpy(&v.x, src, 16); break;
+        case VertexEncoding::unorm16x4:
+        {
+            uint16_t q[4];
+            std::memcpy(q, src, 8);
+            for (int i = 0; i < 3; ++i) v[i] = format.positionOffset[i] + format.positionScale[i] * (q[i] / 65535.0f);
+            v.w = 1;
+            break;
+        }
+        case VertexEncoding::oct_10_10_10_2:
+        {
+            uint32_t p;
+            std::memcpy(&p, src, 4);
+            v = unpack_oct_10_10_10_2(p);
+            break;
+        }
+        case VertexEncoding::half2:
+        {
+            uint16_t h[2];
+            std::memcpy(h, src, 4);
+            v = float4(half_to_float(h[0]), half_to_float(h[1]), 0, 0);
+            break;
+        }
+        case VertexEncoding::unorm8x4:
+        case VertexEncoding::uint8x4:
+        {
+            const float scale = e.encoding == VertexEncoding::unorm8x4 ? 1.0f / 255.0f : 1.0f;
+            for (int i = 0; i < 4; ++i) v[i] = src[i] * scale;
+            break;
+        }
+        }
+        return v;
+    }
+
+    inline float4 decode_vertex_attribute(const VertexFormat & format, VertexAttribute attribute, const uint8_t * vertex)
+    {
+        const VertexElement * e = format.find(attribute);
+        return e ? decode_vertex_element(format, *e, vertex) : float4(0, 0, 0, 0);
+    }
+}
+
+#endif // end vertex_format_hpp
@@ -0,0 +1,307 @@
+#pragma once
+
+#ifndef bullet_shape_cache_hpp
+#define bullet_shape_cache_hpp
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "math-core.hpp"
+#include "geometry.hpp"
+#include "model_import_cache.hpp"
+#include "worker_pool.hpp"
+#include "bullet_utils.hpp"
+
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Bakes Bullet collision shapes from Geometry and caches them on disk. Building the BVH of a large static
+// triangle mesh takes a good part of a second per million triangles; Bullet can serialize the built tree as
+// one flat block and later use that block in place, so a cached shape costs a file read. Convex hulls are
+// reduced by btShapeHull to the hull of the mesh's support points in 42 directions, and stored as those
+// points. Files are keyed by a hash of the vertices, faces and bake parameters, and carry a checksum; a
+// damaged or foreign file is rebaked. The serialized BVH depends on the Bullet version, btScalar and pointer
+// sizes, which are part of the key.
+//
+// A cache directory holds one K.shape file per key K, written through a temporary.
+
+// Bump when baking changes what it produces, to invalidate every cached shape
+#define bullet_shape_cache_version 1
+
+enum class BulletShapeType : uint32_t
+{
+    TriangleMesh,   // btBvhTriangleMeshShape: static geometry only
+    ConvexHull      // btConvexHullShape: cheap to collide, usable for dynamic bodies
+};
+
+struct BulletShapeParams
+{
+    BulletShapeType type = BulletShapeType::TriangleMesh;
+    bool quantizeBvh = true;            // 16 bit node bounds; about half the memory of the float tree
+    float margin = 0.04f;               // Bullet's default collision margin
+};
+
+// Owns a shape and everything it references; keep it alive as long as any body uses the shape
+struct BulletShapeVR
+{
+    struct AlignedDeleter { void operator()(uint8_t * p) const { btAlignedFree(p); } };
+
+    BulletShapeType type = BulletShapeType::TriangleMesh;
+    uint64_t key = 0;
+    bool fromCache = false;
+
+    // Declared in dependency order, so the shape is destroyed before what it points into
+    std::vector<float3> vertices;
+    std::vector<uint3> faces;
+    std::unique_ptr<uint8_t, AlignedDeleter> bvhBuffer; // a deserialized BVH lives in here
+    unsigned bvhBufferSize = 0;
+    std::unique_ptr<btTriangleIndexVertexArray> meshInterface;
+    std::unique_ptr<btCollisionShape> shape;
+
+    btCollisionShape * get() const { return shape.get(); }
+};
+
+typedef std::shared_ptr<BulletShapeVR> BulletShapeHandle;
+
+namespace bullet_shape_impl
+{
+    enum : uint32_t { shapeMagic = 0x48534241 }; // "ABSH"
+
+    struct FileHeader
+    {
+        uint32_t magic = shapeMagic;
+        uint32_t version = bullet_shape_cache_version;
+        uint64_t key = 0;
+        uint32_t type = 0;
+        uint32_t payloadSize = 0;
+        uint32_t payloadCrc = 0;
+        uint32_t reserved = 0;
+    };
+
+    inline uint64_t hash_geometry(const Geometry & g, const BulletShapeParams & p)
+    {
+        const uint32_t build[] = { BT_BULLET_VERSION, uint32_t(sizeof(btScalar)), uint32_t(sizeof(void *)), bullet_shape_cache_version };
+        const float values[] = { float(p.type), float(p.quantizeBvh), p.margin };
+        uint64_t h = avl::impl::hash_bytes(build, sizeof(build));
+        h = avl::impl::hash_bytes(values, sizeof(values), h);
+        h = avl::impl::hash_bytes(g.vertices.data(), g.vertices.size() * sizeof(float3), h);
+        if (p.type == BulletShapeType::TriangleMesh) h = avl::impl::hash_bytes(g.faces.data(), g.faces.size() * sizeof(uint3), h);
+        return h;
+    }
+
+    inline void make_mesh_interface(BulletShapeVR & s)
+    {
+        btIndexedMesh mesh;
+        mesh.m_numTriangles = int(s.faces.size());
+        mesh.m_triangleIndexBase = reinterpret_cast<const unsigned char *>(s.faces.data());
+        mesh.m_triangleIndexStride = sizeof(uint3);
+        mesh.m_numVertices = int(s.vertices.size());
+        mesh.m_vertexBase = reinterpret_cast<const unsigned char *>(s.vertices.data());
+        mesh.m_vertexStride = sizeof(float3);
+        mesh.m_indexType = PHY_INTEGER;
+        mesh.m_vertexType = PHY_FLOAT;
+        s.meshInterface.reset(new btTriangleIndexVertexArray());
+        s.meshInterface->addIndexedMesh(mesh, PHY_INTEGER);
+    }
+
+    inline std::vector<float3> compute_hull(const Geometry & g)
+    {
+        // Without a margin, support points are mesh vertices
+        btConvexHullShape all(reinterpret_cast<const btScalar *>(g.vertices.data()), int(g.vertices.size()), sizeof(float3));
+        all.setMargin(0);
+
+        btShapeHull hull(&all);
+        if (!hull.buildHull(0)) throw std::runtime_error("couldn't compute a convex hull");
+
+        std::vector<float3> points;
+        for (int i = 0; i < hull.numVertices(); ++i) points.push_back(from_bt(hull.getVertexPointer()[i]));
+        return points;
+    }
+
+    inline void make_hull_shape(BulletShapeVR & s, const BulletShapeParams & p)
+    {
+        auto hull = new btConvexHullShape();
+        for (size_t i = 0; i < s.vertices.size(); ++i) hull->addPoint(to_bt(s.vertices[i]), i + 1 == s.vertices.size());
+        hull->setMargin(p.margin);
+        s.shape.reset(hull);
+    }
+}
+
+// Builds a shape from scratch, without touching the disk
+inline BulletShapeHandle make_bullet_shape(const Geometry & geometry, const BulletShapeParams & params = BulletShapeParams())
+{
+    if (geometry.vertices.empty() || (params.type == BulletShapeType::TriangleMesh && geometry.faces.empty())) throw std::runtime_error("can't make a collision shape from empty geometry");
+
+    auto s = std::make_shared<BulletShapeVR>();
+    s->type = params.type;
+    if (params.type == BulletShapeType::TriangleMesh)
+    {
+        s->vertices = geometry.vertices;
+        s->faces = geometry.faces;
+        bullet_shape_impl::make_mesh_interface(*s);
+        auto shape = new btBvhTriangleMeshShape(s->meshInterface.get(), params.quantizeBvh, true);
+        shape->setMargin(params.margin);
+        s->shape.reset(shape);
+    }
+    else
+    {
+        s->vertices = bullet_shape_impl::compute_hull(geometry);
+        bullet_shape_impl::make_hull_shape(*s, params);
+    }
+    return s;
+}
+
+class BulletShapeCacheVR
+{
+    std::string directory;
+
+    size_t hits = 0, misses = 0;
+    mutable std::mutex mutex;
+
+    avl::KeyedWorkerPool<uint64_t, BulletShapeHandle> pool;
+
+    BulletShapeHandle load(const Geometry & geometry, const BulletShapeParams & params, uint64_t key) const
+    {
+        using namespace bullet_shape_impl;
+
+        std::ifstream in(shape_path(key), std::ios::binary);
+        FileHeader header;
+        if (!avl::impl::read_pod(in, header) || header.magic != shapeMagic || header.version != bullet_shape_cache_version) return nullptr;
+        if (header.key != key || header.type != uint32_t(params.type) || header.payloadSize > (1u << 30)) return nullptr;
+
+        auto s = std::make_shared<BulletShapeVR>();
+        s->type = params.type;
+        s->key = key;
+        s->fromCache = true;
+
+        if (params.type == BulletShapeType::TriangleMesh)
+        {
+            // The aabb, then the tree, read straight into the 16 byte aligned block it will be used from
+            float3 bounds[2];
+            if (header.payloadSize < sizeof(bounds) || !avl::impl::read_pod(in, bounds)) return nullptr;
+            s->bvhBufferSize = header.payloadSize - sizeof(bounds);
+            s->bvhBuffer.reset(static_cast<uint8_t *>(btAlignedAlloc(s->bvhBufferSize, 16)));
+            if (!in.read(reinterpret_cast<char *>(s->bvhBuffer.get()), s->bvhBufferSize)) return nullptr;
+            const uint32_t crc = crc32c(s->bvhBuffer.get(), s->bvhBufferSize, crc32c(bounds, sizeof(bounds), 0));
+            if (crc != header.payloadCrc) return nullptr;
+
+            btOptimizedBvh * bvh = btOptimizedBvh::deSerializeInPlace(s->bvhBuffer.get(), s->bvhBufferSize, false);
+            if (!bvh) return nullptr;
+
+            s->vertices = geometry.vertices;
+            s->faces = geometry.faces;
+            make_mesh_interface(*s);
+            s->meshInterface->setPremadeAabb(to_bt(bounds[0]), to_bt(bounds[1])); // skips a pass over the triangles
+            auto shape = new btBvhTriangleMeshShape(s->meshInterface.get(), params.quantizeBvh, false);
+            shape->setOptimizedBvh(bvh);
+            shape->setMargin(params.margin);
+            s->shape.reset(shape);
+        }
+        else
+        {
+            if (header.payloadSize % sizeof(float3) != 0) return nullptr;
+            s->vertices.resize(header.payloadSize / sizeof(float3));
+            if (!in.read(reinterpret_cast<char *>(s->vertices.data()), header.payloadSize)) return nullptr;
+            if (crc32c(s->vertices.data(), header.payloadSize, 0) != header.payloadCrc) return nullptr;
+            make_hull_shape(*s, params);
+        }
+        return s;
+    }
+
+    void store(const BulletShapeVR & s) const
+    {
+        using namespace bullet_shape_impl;
+
+        FileHeader header;
+        header.key = s.key;
+        header.type = uint32_t(s.type);
+
+        std::vector<uint8_t> payload;
+        if (s.type == BulletShapeType::TriangleMesh)
+        {
+            auto shape = static_cast<btBvhTriangleMeshShape *>(s.shape.get());
+            const btOptimizedBvh * bvh = shape->getOptimizedBvh();
+            btVector3 aabbMin, aabbMax;
+            shape->getMeshInterface()->calculateAabbBruteForce(aabbMin, aabbMax);
+            const float3 bounds[2] = { from_bt(aabbMin), from_bt(aabbMax) };
+
+            const unsigned size = bvh->calculateSerializeBufferSize();
+            std::unique_ptr<uint8_t, BulletShapeVR::AlignedDeleter> buffer(static_cast<uint8_t *>(btAlignedAlloc(size, 16)));
+            if (!bvh->serializeInPlace(buffer.get(), size, false)) throw std::runtime_error("couldn't serialize a bvh");
+
+            payload.resize(sizeof(bounds) + size);
+            std::memcpy(payload.data(), bounds, sizeof(bounds));
+            std::memcpy(payload.data() + sizeof(bounds), buffer.get(), size);
+        }
+        else
+        {
+            payload.resize(s.vertices.size() * sizeof(float3));
+            std::memcpy(payload.data(), s.vertices.data(), payload.size());
+        }
+        header.payloadSize = uint32_t(payload.size());
+        header.payloadCrc = crc32c(payload.data(), payload.size(), 0);
+
+        const std::string file = shape_path(s.key), temporary = file + ".tmp" + avl::impl::to_hex(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            avl::impl::write_pod(out, header);
+            out.write(reinterpret_cast<const char *>(payload.data()), payload.size());
+            if (!out.good()) throw std::runtime_error("couldn't write " + file);
+        }
+        avl::impl::replace_file(temporary, file);
+    }
+
+    BulletShapeHandle bake_uncached(const Geometry & geometry, const BulletShapeParams & params, uint64_t key)
+    {
+        if (BulletShapeHandle cached = load(geometry, params, key)) return cached;
+
+        BulletShapeHandle s = make_bullet_shape(geometry, params);
+        s->key = key;
+        try { store(*s); } catch (const std::exception &) {} // the shape is still good, only uncached
+        return s;
+    }
+
+    BulletShapeHandle run(const Geometry & geometry, const BulletShapeParams & params, uint64_t key)
+    {
+        BulletShapeHandle result = bake_uncached(geometry, params, key);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (result->fromCache) ++hits;
+        else ++misses;
+        return result;
+    }
+
+public:
+
+    // The directory is created if missing. Zero workers uses all but one hardware thread. Bakes still queued
+    // when the cache is destroyed resolve to null.
+    explicit BulletShapeCacheVR(const std::string & cacheDirectory, uint32_t numWorkers = 0)
+        : pool(numWorkers ? numWorkers : std::max(1u, hardware_thread_count() - 1))
+    {
+        directory = cacheDirectory;
+        if (!directory.empty() && directory.back() != '/' && directory.back() != '\\') directory += '/';
+        avl::impl::make_directories(directory);
+    }
+
+    // Loads or bakes on the calling thread, or waits for a worker already baking the same shape
+    BulletShapeHandle bake(const Geometry & geometry, const BulletShapeParams & params = BulletShapeParams())
+    {
+        const uint64_t key = bullet_shape_impl::hash_geometry(geometry, params);
+        return pool.run(key, [&]() { return run(geometry, params, key); });
+    }
+
+    // Queues the bake on a worker thread and returns immediately. The geometry is hashed here, and copied.
+    std::shared_future<BulletShapeHandle> request(const Geometry & geometry, const BulletShapeParams & params = BulletShapeParams())
+    {
+        const uint64_t key = bullet_shape_impl::hash_geometry(geometry, params);
+        return pool.request(key, [this, geometry, params, key]() { return run(geometry, params, key); });
+    }
+
+    std::string shape_path(uint64_t key) const { return directory + avl::impl::to_hex(key) + ".shape"; }
+    const std::string & cache_directory() const { return directory; }
+    size_t hit_count() const { std::lock_guard<std::mutex> lock(mutex); return hits; }
+    size_t miss_count() const { std::lock_guard<std::mutex> lock(mutex); return misses; }
+};
+
+#endif // end bullet_shape_cache_hpp
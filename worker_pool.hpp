@@ -0,0 +1,218 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef worker_pool_hpp
+#define worker_pool_hpp
+
+#include "parallel_for.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Long-lived worker threads for the asset caches and loaders. WorkerPool runs jobs in submission order on a
+// fixed set of threads. KeyedWorkerPool adds deduplication on top: while a job for a key is queued or running,
+// asking for that key again returns the same shared_future instead of doing the work twice, whether the
+// job was queued for a worker (request) or is running on another caller's thread (run).
+
+namespace avl
+{
+    class WorkerPool
+    {
+        std::deque<std::function<void()>> jobs;
+        bool stopping = false;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::vector<std::thread> workers;
+
+        void work()
+        {
+            for (;;)
+            {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (stopping) return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+    public:
+
+        explicit WorkerPool(uint32_t numWorkers)
+        {
+            for (uint32_t t = 0; t < std::max(1u, numWorkers); ++t) workers.emplace_back(&WorkerPool::work, this);
+        }
+
+        ~WorkerPool() { stop(); }
+
+        // Drops queued jobs and waits for running ones to return; jobs submitted afterwards are dropped as well
+        void stop()
+        {
+            std::deque<std::function<void()>> dropped;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                dropped.swap(jobs);
+            }
+            jobAvailable.notify_all();
+            for (auto & w : workers) if (w.joinable()) w.join();
+        }
+
+        void submit(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) return;
+                jobs.push_back(std::move(job));
+            }
+            jobAvailable.notify_one();
+        }
+
+        // Invokes fn(i) for every i in [begin, end) on the workers and the calling thread, and returns once all
+        // are done. Unlike the free parallel_for, no threads are started per call, which matters for loops that
+        // run thousands of times a second. Jobs queued ahead are waited for too, so use a pool of its own.
+        template<typename Fn>
+        void parallel_for(size_t begin, size_t end, Fn && fn, size_t grain = 1)
+        {
+            if (end <= begin) return;
+            grain = std::max<size_t>(1, grain);
+            const size_t numChunks = (end - begin + grain - 1) / grain;
+            const size_t helpers = std::min(workers.size(), numChunks - 1);
+
+            std::atomic<size_t> next(begin);
+            auto chunks = [&]()
+            {
+                for (;;)
+                {
+                    const size_t first = next.fetch_add(grain);
+                    if (first >= end) break;
+                    const size_t last = std::min(end, first + grain);
+                    for (size_t i = first; i < last; ++i) fn(i);
+                }
+            };
+
+            // Helpers reference this frame, so every one must have returned before it unwinds
+            std::mutex doneMutex;
+            std::condition_variable doneSignal;
+            size_t running = helpers;
+            for (size_t h = 0; h < helpers; ++h)
+            {
+                submit([&]()
+                {
+                    chunks();
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    if (--running == 0) doneSignal.notify_one();
+                });
+            }
+            chunks();
+
+            std::unique_lock<std::mutex> lock(doneMutex);
+            doneSignal.wait(lock, [&] { return running == 0; });
+        }
+
+        size_t worker_count() const { return workers.size(); }
+    };
+
+    // Result must be default constructible: keys still queued when the pool is destroyed resolve to Result(),
+    // which for the caches' shared_ptr handles is null
+    template<class Key, class Result, class Hash = std::hash<Key>>
+    class KeyedWorkerPool
+    {
+    public:
+
+        typedef std::function<Result()> Function;
+        typedef std::shared_future<Result> Future;
+
+    private:
+
+        struct Pending
+        {
+            Future result;
+            std::shared_ptr<std::promise<Result>> promise;
+        };
+
+        std::unordered_map<Key, Pending, Hash> inFlight;
+        std::mutex mutex;
+        WorkerPool pool; // last, so workers are joined before the map they report to goes away
+
+        // Returns the pending result for the key, or registers a new one and hands its promise to the caller
+        Future lookup(const Key & key, std::shared_ptr<std::promise<Result>> & promise)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = inFlight.find(key);
+            if (it != inFlight.end()) return it->second.result;
+            promise = std::make_shared<std::promise<Result>>();
+            Pending & p = inFlight[key];
+            p.promise = promise;
+            p.result = promise->get_future().share();
+            return p.result;
+        }
+
+        // The key is released before waiters wake, so a failed job can be retried by the next request
+        void execute(const Key & key, const Function & fn, std::promise<Result> & promise)
+        {
+            Result result;
+            try { result = fn(); }
+            catch (...)
+            {
+                release(key);
+                promise.set_exception(std::current_exception());
+                return;
+            }
+            release(key);
+            promise.set_value(std::move(result));
+        }
+
+        void release(const Key & key)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight.erase(key);
+        }
+
+    public:
+
+        explicit KeyedWorkerPool(uint32_t numWorkers) : pool(numWorkers) {}
+
+        ~KeyedWorkerPool()
+        {
+            pool.stop();
+            for (auto & p : inFlight) p.second.promise->set_value(Result());
+        }
+
+        // Runs fn on the calling thread, or waits for the job already queued or running for the same key.
+        // Rethrows what fn throws.
+        Result run(const Key & key, const Function & fn)
+        {
+            std::shared_ptr<std::promise<Result>> promise;
+            Future result = lookup(key, promise);
+            if (promise) execute(key, fn, *promise);
+            return result.get();
+        }
+
+        // Queues fn on a worker, unless a job for the same key is already queued or running, and returns immediately
+        Future request(const Key & key, Function fn)
+        {
+            std::shared_ptr<std::promise<Result>> promise;
+            Future result = lookup(key, promise);
+            if (promise) pool.submit([this, key, fn, promise]() { execute(key, fn, *promise); });
+            return result;
+        }
+
+        size_t worker_count() const { return pool.worker_count(); }
+    };
+}
+
+#endif // end worker_pool_hpp